@@ -0,0 +1,118 @@
+/*! \file evaluate_trajectory.cpp
+ *  \brief A tool that evaluates a trajectory logged by the SLAM pipeline 
+ *         against a ground truth trajectory.
+ *  \note **Command line arguments**:
+ *  \note `estimate`: Trajectory file produced by the `T` control of `slam`.
+ *  \note `groundtruth`: Ground truth trajectory in the `TUM RGB-D` format (optional).
+ *  \note `delta`: Time interval (in s) for the relative pose error (defaults to 1 s).
+ *  \note **Usage example**:
+ *  \note `./bin/oclslam_evaluate_trajectory trajectory.txt groundtruth.txt 1.0`
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <oclslam/trajectory.hpp>
+
+using namespace cl_algo;
+
+
+/*! \brief Prints the statistics of a set of errors. */
+void printStats (const char *title, const oclslam::ErrorStats &stats, const char *unit)
+{
+    std::cout << title << " (" << stats.count << " pairs)" << std::endl;
+    std::cout << "    - RMSE                :    " << stats.rmse << " [" << unit << "]" << std::endl;
+    std::cout << "    - Mean                :    " << stats.mean << " [" << unit << "]" << std::endl;
+    std::cout << "    - Median              :    " << stats.median << " [" << unit << "]" << std::endl;
+    std::cout << "    - Std                 :    " << stats.stddev << " [" << unit << "]" << std::endl;
+    std::cout << "    - Min/Max             :    " << stats.min << " / " << stats.max << " [" << unit << "]" << std::endl;
+}
+
+
+int main (int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <estimate> [<groundtruth> [<delta>]]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<oclslam::TrajectoryRecord> est = oclslam::readTrajectory (argv[1]);
+    if (est.size () < 2)
+    {
+        std::cerr << "Error: The estimated trajectory has less than 2 poses" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Throughput =========================================================
+
+    double duration = est.back ().timestamp - est.front ().timestamp;
+    double latency = 0.0, preLatency = 0.0, icpLatency = 0.0, iterations = 0.0;
+    for (const oclslam::TrajectoryRecord &rec : est)
+    {
+        latency += rec.latency; preLatency += rec.preLatency;
+        icpLatency += rec.icpLatency; iterations += rec.icpIterations;
+    }
+
+    std::cout << std::endl << "Throughput (" << est.size () << " poses)" << std::endl;
+    std::cout << "    - Duration            :    " << duration << " [s]" << std::endl;
+    std::cout << "    - Frame rate          :    " << (est.size () - 1) / duration << " [fps]" << std::endl;
+    std::cout << "    - Latency             :    " << latency / est.size () << " [ms]" << std::endl;
+    std::cout << "    - Preprocessing       :    " << preLatency / est.size () << " [ms]" << std::endl;
+    std::cout << "    - ICP latency         :    " << icpLatency / est.size () << " [ms]" << std::endl;
+    std::cout << "    - ICP iterations      :    " << iterations / est.size () << std::endl;
+
+    if (argc < 3) return 0;
+
+    // Accuracy ===========================================================
+
+    std::vector<oclslam::TrajectoryRecord> gt = oclslam::readTrajectory (argv[2]);
+    double delta = (argc > 3) ? std::stod (argv[3]) : 1.0;  // s
+
+    std::vector<std::pair<unsigned int, unsigned int>> matches = oclslam::associate (est, gt);
+    if (matches.size () < 3)
+    {
+        std::cerr << "Error: Failed to associate the trajectories (" 
+                  << matches.size () << " pairs)" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Eigen::Matrix4d alignment;
+    oclslam::ErrorStats ate = oclslam::computeATE (est, gt, matches, false, &alignment);
+    oclslam::ErrorStats rpeT, rpeR;
+    oclslam::computeRPE (est, gt, matches, delta, rpeT, rpeR);
+
+    std::cout << std::endl;
+    printStats ("Absolute trajectory error", ate, "mm");
+    std::cout << std::endl;
+    printStats ("Relative pose error, translation", rpeT, "mm");
+    std::cout << std::endl;
+    printStats ("Relative pose error, rotation", rpeR, "degrees");
+    std::cout << std::endl;
+
+    return 0;
+}
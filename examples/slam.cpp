@@ -3,6 +3,48 @@
  *  \details It accepts RGB-D data from Kinect, performs registration on the GPU, 
  *           visualizes the resulting point clouds on the screen, and creates 
  *           an Octomap map that can be saved on disk.
+ *  \note **Command line arguments**:
+ *  \note `--icp=<config>`: ICP configuration, `{eigen,power}-{regular,weighted}`, 
+ *        or `auto` to benchmark all of them on the device and pick the fastest 
+ *        accurate one (defaults to `power-weighted`).
+ *  \note `--downsample`: processes the frames at half the sensor's resolution 
+ *        (e.g. 320x240), after downsampling them on the device.
+ *  \note `--placement=pre=<platform>:<device>,icp=<platform>:<device>`: OpenCL devices 
+ *        for the preprocessing and ICP stages, with `gl` for the device that renders 
+ *        (the default for both). The postprocessing stays on the `gl` device.
+ *  \note `--window=<radius>[,<archive>]`: keeps only the part of the map within 
+ *        `radius` meters of the sensor, and appends the rest to `archive`.
+ *  \note `--tiles=<dir>`: builds the map in tiles, which are stored in `dir` and 
+ *        loaded as the sensor moves, instead of keeping all of it in memory. The 
+ *        tiles take the place of the map, so saving the map writes them to `dir`, 
+ *        and it can't be combined with `--window`, `--distance`, `--batch`, `--grid`, 
+ *        `--frontiers`, or `--raycast`, which work on the map.
+ *  \note `--distance=<x>,<y>,<z>`: maintains the distance to the nearest obstacle, 
+ *        in a box of the given half-sizes (in meters) around the origin of the map.
+ *  \note `--batch=<frames>`: integrates the point clouds into the map in batches 
+ *        of `frames` (up to 65535), with one update per cell and batch.
+ *  \note `--grid=<min>,<max>[,<axis>]`: maintains a 2-D occupancy grid of the map, 
+ *        from the band between `min` and `max` (in meters) along `axis` (`x`, `y`, 
+ *        or `z`, the default).
+ *  \note `--frontiers`: maintains the frontier between the free and the unknown 
+ *        space of the map, for exploration.
+ *  \note `--raycast`: maintains the occupied cells of the map in bricks, which a 
+ *        `RayCastService` mirrors on a device, to cast batches of rays there.
+ *  \note `--snapshot=<seconds>`: minimum time between two snapshots of the map 
+ *        for the concurrent queries (defaults to 1s). A snapshot that a reader 
+ *        still holds has to be copied whole, so short periods cost more.
+ *  \note `--trace[=<file>]`: creates the queues with profiling enabled, so that a 
+ *        timeline of the pipeline can be recorded (with `P`), and written in the 
+ *        Chrome trace-event format. With a file, the recording starts right away.
+ *  \note `--tune`: sweeps the launch configurations of the `OCLSLAM` kernels on the 
+ *        device, for the frame size in use (see `--downsample`), and stores the 
+ *        fastest ones, which are used from then on.
+ *  \note `--cpu[=<frames>]`: runs the registration on the native `CPU` pipeline 
+ *        instead, without OpenCL or OpenGL, until `Ctrl+C` or for `frames` frames, 
+ *        and saves the map in a binary file. The options of the OpenCL pipeline 
+ *        are ignored.
+ *  \note **Usage example**:
+ *  \note `./bin/oclslam_slam --icp=auto --placement=pre=gl,icp=1:0`
  *  \author Nick Lamprianidis
  *  \version 0.1.0
  *  \date 2015
@@ -34,11 +76,17 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <csignal>
 #include <GL/glew.h>  // Add before CLUtils.hpp
 #include <CLUtils.hpp>
 #include <glut_viewer.hpp>
 #include <freenect_rgbd.hpp>
 #include <ocl_processing.hpp>
+#include <oclslam/cpu/algorithms.hpp>
 
 
 // Sensor parameters
@@ -51,12 +99,10 @@ octomap::OcTree map (res);  /*!< Map. */
 // octomap::ColorOcTree map (res);
 
 // OpenCL parameters
-// Remember to change the corresponding arguments in glut_viewer.cpp
-// const ICP::ICPStepConfigT CR = ICP::ICPStepConfigT::EIGEN;
-const ICP::ICPStepConfigT CR = ICP::ICPStepConfigT::POWER_METHOD;
-// const ICP::ICPStepConfigW CW = ICP::ICPStepConfigW::REGULAR;
-const ICP::ICPStepConfigW CW = ICP::ICPStepConfigW::WEIGHTED;
-OCLSLAM<CR, CW> *slam;
+OCLSLAMBase *slam;
+
+// CPU parameters
+volatile std::sig_atomic_t cpuStop = 0;  /*!< Set on `SIGINT` to stop the CPU pipeline. */
 
 
 /*! \brief Displays the available controls. */
@@ -71,12 +117,77 @@ void printInfo ()
     std::cout << "  3. RGB Guided Filter, On/Off   :  1\n";
     std::cout << "  4. Depth Guided Filter, On/Off :  2\n";
     std::cout << "  5. RGB Normalization, On/Off   :  3\n";
-    std::cout << "  6. Save Occupancy Map          :  W\n";
-    std::cout << "  7. Save Binary Map             :  B\n";
-    std::cout << "  8. Translate Camera            :  Arrows Keys\n";
-    std::cout << "  9. Rotate Camera               :  Left Mouse Button\n";
-    std::cout << " 10. Zoom In/Out                 :  Mouse Wheel\n";
-    std::cout << " 11. Quit                        :  Q or Esc\n\n";
+    std::cout << "  6. Loop Closure, On/Off        :  L\n";
+    std::cout << "  7. Device ICP Loop, On/Off     :  D\n";
+    std::cout << "  8. Trajectory Log, On/Off      :  T\n";
+    std::cout << "  9. Timeline Trace, On/Off      :  P\n";
+    std::cout << " 10. Save Occupancy Map          :  W\n";
+    std::cout << " 11. Save Binary Map             :  B\n";
+    std::cout << " 12. Translate Camera            :  Arrows Keys\n";
+    std::cout << " 13. Rotate Camera               :  Left Mouse Button\n";
+    std::cout << " 14. Zoom In/Out                 :  Mouse Wheel\n";
+    std::cout << " 15. Quit                        :  Q or Esc\n\n";
+}
+
+
+/*! \brief Registers the Kinect frames on the native `CPU` pipeline, 
+ *         and inserts the resulting point clouds into the map.
+ *
+ *  \param[in] frames number of frames to process (`0` for no limit).
+ */
+void runCPU (unsigned int frames)
+{
+    oclslam::cpu::Pipeline pipeline (kinect->getWidth (), kinect->getHeight ());
+    const unsigned int n = pipeline.getPoints ();
+    std::vector<uint8_t> rgb (3 * n);
+    std::vector<uint16_t> depth (n);
+    octomap::Pointcloud pc;
+    pc.reserve (n);
+
+    std::cout << "\nCPU pipeline: " << kinect->getWidth () << "x" << kinect->getHeight () 
+              << ", " << pipeline.getPool ().size () << " threads, " 
+              << oclslam::cpu::getInstructionSet () << "\n";
+    std::cout << "Press Ctrl+C to stop and save the map\n\n";
+
+    std::signal (SIGINT, [] (int) { cpuStop = 1; });
+    kinect->setBuffers ();
+    kinect->startVideo ();
+    kinect->startDepth ();
+
+    while (!cpuStop && (frames == 0 || pipeline.timeStep < frames))
+    {
+        if (!kinect->deliverFrames (rgb.data (), depth.data ()))
+        {
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+            continue;
+        }
+
+        pipeline.process (rgb.data (), depth.data ());
+
+        // The invalid points are at the origin, so they are left out
+        const float *pc3D = pipeline.getPointCloud3D ();
+        pc.clear ();
+        for (unsigned int i = 0; i < n; ++i, pc3D += 3)
+            if (pc3D[0] != 0.f || pc3D[1] != 0.f || pc3D[2] != 0.f)
+                pc.push_back (pc3D[0], pc3D[1], pc3D[2]);
+
+        octomap::point3d origin (pipeline.t_g[0] * 0.001, pipeline.t_g[1] * 0.001, 
+                                 pipeline.t_g[2] * 0.001);
+        map.insertPointCloud (pc, origin, -1, true, true);
+
+        if (pipeline.timeStep % 30 == 0)
+            std::cout << "Frame " << pipeline.timeStep << ": " << pipeline.latency 
+                      << " ms (ICP " << pipeline.lICP << " ms)" << std::endl;
+    }
+
+    kinect->stopVideo ();
+    kinect->stopDepth ();
+
+    // The insertions were lazy, so the inner nodes are updated once, at the end
+    map.updateInnerOccupancy ();
+    std::string filename = setFilename ("bt");
+    map.writeBinary (filename);
+    std::cout << "\n" << pipeline.timeStep << " frames, map saved in " << filename << std::endl;
 }
 
 
@@ -84,13 +195,160 @@ int main (int argc, char **argv)
 {
     try
     {
+        // ICP configuration
+        ICP::ICPStepConfigT CR = ICP::ICPStepConfigT::POWER_METHOD;
+        ICP::ICPStepConfigW CW = ICP::ICPStepConfigW::WEIGHTED;
+        StagePlacement placement;
+        bool profiling = false;
+        unsigned int decimation = 1;
+        std::string traceFile;
+        double windowRadius = 0.0;
+        std::string windowArchive;
+        std::string tilesDir;
+        octomap::point3d distanceBox;
+        int batchFrames = 1;
+        double gridMin = 0.0, gridMax = 0.0;
+        unsigned int gridAxis = 2;
+        bool frontiers = false;
+        bool raycast = false;
+        double snapshotPeriod = -1.0;
+        bool tune = false;
+        bool cpu = false;
+        unsigned int cpuFrames = 0;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg (argv[i]);
+            if (arg == "--tune")
+            {
+                tune = true;
+                continue;
+            }
+            if (arg.compare (0, 5, "--cpu") == 0)
+            {
+                cpu = true;
+                if (arg.size () > 6 && arg[5] == '=') cpuFrames = std::atoi (arg.substr (6).c_str ());
+                continue;
+            }
+            if (arg == "--downsample")
+            {
+                decimation = 2;
+                continue;
+            }
+            if (arg.compare (0, 9, "--window=") == 0)
+            {
+                std::string value = arg.substr (9);
+                size_t comma = value.find (',');
+                windowRadius = std::atof (value.substr (0, comma).c_str ());
+                if (comma != std::string::npos) windowArchive = value.substr (comma + 1);
+                continue;
+            }
+            if (arg.compare (0, 11, "--distance=") == 0)
+            {
+                std::istringstream value (arg.substr (11));
+                char comma;
+                value >> distanceBox.x () >> comma >> distanceBox.y () >> comma >> distanceBox.z ();
+                continue;
+            }
+            if (arg == "--frontiers")
+            {
+                frontiers = true;
+                continue;
+            }
+            if (arg == "--raycast")
+            {
+                raycast = true;
+                continue;
+            }
+            if (arg.compare (0, 7, "--grid=") == 0)
+            {
+                std::istringstream value (arg.substr (7));
+                char comma, axis = 'z';
+                value >> gridMin >> comma >> gridMax >> comma >> axis;
+                if (axis >= 'x' && axis <= 'z') gridAxis = axis - 'x';
+                continue;
+            }
+            if (arg.compare (0, 8, "--batch=") == 0)
+            {
+                batchFrames = std::max (std::atoi (arg.substr (8).c_str ()), 1);
+                continue;
+            }
+            if (arg.compare (0, 11, "--snapshot=") == 0)
+            {
+                snapshotPeriod = std::max (std::atof (arg.substr (11).c_str ()), 0.0);
+                continue;
+            }
+            if (arg.compare (0, 8, "--tiles=") == 0)
+            {
+                tilesDir = arg.substr (8);
+                continue;
+            }
+            if (arg.compare (0, 7, "--trace") == 0)
+            {
+                profiling = true;
+                if (arg.size () > 8 && arg[7] == '=') traceFile = arg.substr (8);
+                continue;
+            }
+            if (arg.compare (0, 12, "--placement=") == 0)
+            {
+                if (!parseStagePlacement (arg.substr (12), placement))
+                    std::cerr << "Invalid stage placement " << arg.substr (12) << std::endl;
+                continue;
+            }
+            if (arg.compare (0, 6, "--icp=") != 0) continue;
+
+            std::string config = arg.substr (6);
+            if (config == "auto")
+            {
+                std::cout << "\nBenchmarking the ICP configurations:\n";
+                if (!selectICPConfig (CR, CW))
+                    std::cout << "No configuration met the accuracy threshold\n";
+            }
+            else if (!parseICPConfigName (config, CR, CW))
+                std::cerr << "Unknown ICP configuration " << config << std::endl;
+        }
+        if (cpu)
+        {
+            runCPU (cpuFrames);
+            return 0;
+        }
+        if (tune)
+        {
+            // The kernels are tuned for the frames the pipeline is going to process
+            std::cout << "\nTuning the OCLSLAM kernels:\n";
+            tuneKernels (kinect->getWidth (), kinect->getHeight (), decimation);
+        }
+        if (!tilesDir.empty () && (windowRadius > 0.0 || distanceBox.norm () > 0.0 || batchFrames > 1 || 
+                                   gridMax > gridMin || frontiers || raycast))
+        {
+            std::cerr << "--tiles can't be combined with --window, --distance, --batch, "
+                      << "--grid, --frontiers, or --raycast" << std::endl;
+            exit (EXIT_FAILURE);
+        }
+        std::cout << "\nICP configuration: " << getICPConfigName (CR, CW) << std::endl;
+
         printInfo ();
 
         initGL (argc, argv);
 
         // The OpenCL environment must be created after the OpenGL environment 
         // has been initialized and before OpenGL starts rendering
-        slam = new OCLSLAM<CR, CW> (kinect, map);
+        slam = createOCLSLAM (CR, CW, kinect, map, placement, profiling, decimation);
+        if (!traceFile.empty ()) slam->startTrace (traceFile);
+        if (!tilesDir.empty () && !slam->getTiledMap ().open (tilesDir))
+            std::cerr << "Failed to open the map tiles in " << tilesDir << std::endl;
+        slam->getBatchedUpdate ().setFrames (batchFrames);
+        if (snapshotPeriod >= 0.0) slam->getMapServer ().setPeriod (snapshotPeriod);
+        if (gridMax > gridMin) slam->getOccupancyGrid ().setBand (gridMin, gridMax, gridAxis);
+        slam->getFrontierSet ().setEnabled (frontiers);
+        slam->getBrickMap ().setEnabled (raycast);
+        if (distanceBox.norm () > 0.0)
+            slam->getDistanceField ().setBounds (distanceBox * -1.f, distanceBox);
+        if (windowRadius > 0.0)
+        {
+            slam->getSlidingWindow ().setRadius (windowRadius);
+            if (!windowArchive.empty () && !slam->getSlidingWindow ().openArchive (windowArchive))
+                std::cerr << "Failed to open the map archive " << windowArchive << std::endl;
+        }
 
         glutMainLoop ();
 
@@ -30,6 +30,7 @@
 #define FREENECT_RGBD_HPP
 
 #include <mutex>
+#include <vector>
 #include <libfreenect.hpp>
 
 #if defined(__APPLE__) || defined(__MACOSX)
@@ -53,14 +54,26 @@ public:
     void DepthCallback (void *depth, uint32_t timestamp);
     /*! \brief Sets the host buffers for the RGB and Depth frames. */
     void setBuffers (cl::CommandQueue &queue, cl::Buffer &rgb, cl::Buffer &depth);
+    /*! \brief Allocates host buffers for the RGB and Depth frames, for use without OpenCL. */
+    void setBuffers ();
     /*! \brief Transfers the RGB and Depth frames to the specified OpenCL buffers. */
-    bool deliverFrames (cl::CommandQueue &queue, cl::Buffer &rgb, cl::Buffer &depth);
+    bool deliverFrames (cl::CommandQueue &queue, cl::Buffer &rgb, cl::Buffer &depth, 
+                        uint32_t *timestamp = nullptr);
+    /*! \brief Copies the RGB and Depth frames to the specified host arrays. */
+    bool deliverFrames (uint8_t *rgb, uint16_t *depth, uint32_t *timestamp = nullptr);
+    /*! \brief Returns the width of the frames. */
+    unsigned int getWidth () const { return width; }
+    /*! \brief Returns the height of the frames. */
+    unsigned int getHeight () const { return height; }
 
 private:
     std::mutex rgbMutex, depthMutex;
     cl_uchar *rgbPtr;  // Aligned to 4KB for pinning in OpenCL
     cl_ushort *depthPtr;  // Aligned to 4KB for pinning in OpenCL
+    std::vector<cl_uchar> hostRGB;  // Staging memory when there's no OpenCL buffer
+    std::vector<cl_ushort> hostDepth;
     bool newRGBFrame, newDepthFrame;
+    uint32_t rgbTimestamp, depthTimestamp;
     unsigned int width, height;
 
 };
@@ -46,7 +46,7 @@ void idleGLScene ();
 /*! \brief Reshape callback for the window. */
 void resizeGLScene (int width, int height);
 /*! \brief Creates a filename with a timestamp suffix. */
-std::string setFilename (const char *type);
+std::string setFilename (const char *type, const char *prefix = "map");
 /*! \brief Keyboard callback for the window. */
 void keyPressed (unsigned char key, int x, int y);
 /*! \brief Arrow key callback for the window. */
@@ -0,0 +1,69 @@
+/*! \file icp_config.hpp
+ *  \brief Declares the tools for naming, benchmarking, and selecting the `ICP` configurations.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef ICP_CONFIG_HPP
+#define ICP_CONFIG_HPP
+
+#include <string>
+#include <vector>
+#include <CLUtils.hpp>
+#include <ICP/algorithms.hpp>
+#include <eigen3/Eigen/Dense>
+
+
+extern const std::vector<std::string> kernel_files_rbc;  /*!< Kernel files of the `RBC` programs. */
+extern const std::vector<std::string> kernel_files_icp;  /*!< Kernel files of the `ICP` programs. */
+extern const std::string kernel_file_placeholder;        /*!< Kernel file of a trivial program, for reserving a program slot. */
+
+
+/*! \brief Holds the results of benchmarking an `ICP` configuration. */
+struct ICPBenchmarkResult
+{
+    ICP::ICPStepConfigT CR;  /*!< Method of rotation computation. */
+    ICP::ICPStepConfigW CW;  /*!< Regular or weighted computation. */
+    double latency;          /*!< Mean latency (in ms) of a registration. */
+    double rotError;         /*!< Rotation error (in degrees) of the estimated transformation. */
+    double transError;       /*!< Translation error (in mm) of the estimated transformation. */
+};
+
+/*! \brief Returns a name for an `ICP` configuration, e.g. `power-weighted`. */
+std::string getICPConfigName (ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW);
+/*! \brief Parses a name produced by `getICPConfigName`. */
+bool parseICPConfigName (const std::string &name, ICP::ICPStepConfigT &CR, ICP::ICPStepConfigW &CW);
+/*! \brief Benchmarks all the `ICP` configurations on the current device. */
+std::vector<ICPBenchmarkResult> benchmarkICP (unsigned int repeats = 10);
+/*! \brief Benchmarks the registration of the native `CPU` backend, as a baseline for the `ICP` configurations. */
+ICPBenchmarkResult benchmarkCPUICP (unsigned int repeats = 10);
+/*! \brief Selects the fastest `ICP` configuration that meets an accuracy threshold. */
+bool selectICPConfig (ICP::ICPStepConfigT &CR, ICP::ICPStepConfigW &CW, 
+                      double maxRotError = 0.1, double maxTransError = 1.0, unsigned int repeats = 10);
+/*! \brief Samples landmarks, on a `side` x `side` grid, from a synthetic smooth colored surface. */
+void generateLandmarks (unsigned int side, const Eigen::Matrix3f &R, const Eigen::Vector3f &t, 
+                        std::vector<cl_float8> &F, std::vector<cl_float8> &M);
+
+#endif  // ICP_CONFIG_HPP
@@ -29,8 +29,12 @@
 #ifndef OCL_PROCESSING_HPP
 #define OCL_PROCESSING_HPP
 
+#include <string>
+#include <vector>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <GL/glew.h>  // Add before CLUtils.hpp
 #include <CLUtils.hpp>
 #include <GuidedFilter/algorithms.hpp>
@@ -42,26 +46,337 @@
 // #include <octomap/ColorOcTree.h>
 #include <oclslam/pointcloud.hpp>
 #include <oclslam/algorithms.hpp>
+#include <oclslam/loop_closure.hpp>
+#include <oclslam/registration.hpp>
+#include <oclslam/map_server.hpp>
+#include <oclslam/sliding_window.hpp>
+#include <oclslam/map_maintenance.hpp>
+#include <oclslam/distance_field.hpp>
+#include <oclslam/batched_update.hpp>
+#include <oclslam/occupancy_grid.hpp>
+#include <oclslam/frontiers.hpp>
+#include <oclslam/brick_map.hpp>
+#include <oclslam/tiled_map.hpp>
+#include <oclslam/trajectory.hpp>
+#include <oclslam/program_cache.hpp>
+#include <oclslam/transfer.hpp>
+#include <oclslam/memory.hpp>
+#include <oclslam/scheduler.hpp>
+#include <oclslam/tracer.hpp>
+#include <oclslam/tuner.hpp>
+#include <oclslam/cpu/algorithms.hpp>
+#include <icp_config.hpp>
 
 using namespace cl_algo;
 
 
-/*! \brief Creates an OpenCL environment with CL-GL interoperability. */
+/*! \brief Identifies the OpenCL device a stage of the pipeline runs on. */
+struct StageDevice
+{
+    /*! \brief Places the stage on the device of the GL-shared context. */
+    StageDevice () : platform (-1), device (0) {}
+    /*! \brief Places the stage on a device of a platform. */
+    StageDevice (int platform, unsigned int device) : platform (platform), device (device) {}
+    /*! \brief Indicates whether the stage runs on the device of the GL-shared context. */
+    bool isGL () const { return platform < 0; }
+    bool operator== (const StageDevice &other) const 
+    { return isGL () ? other.isGL () : platform == other.platform && device == other.device; }
+
+    int platform;         /*!< Platform index, or a negative value for the GL device. */
+    unsigned int device;  /*!< Device index on the platform. */
+};
+
+
+/*! \brief Assigns the stages of the `SLAM` pipeline to OpenCL devices.
+ *  \details The preprocessing stage covers the filtering of the frames, 
+ *           the point cloud, and the landmarks. The ICP stage covers the 
+ *           registration and its evaluation. The postprocessing stage, that 
+ *           transforms the point cloud and hands it to OpenGL and OctoMap, 
+ *           always runs on the device of the GL-shared context.
+ *  \note The default places all the stages on the GL device.
+ */
+struct StagePlacement
+{
+    StageDevice pre;  /*!< Device for the preprocessing. */
+    StageDevice icp;  /*!< Device for the ICP. */
+};
+
+/*! \brief Parses a placement of the form `pre=<platform>:<device>,icp=<platform>:<device>`, 
+ *         where `gl` stands for the device of the GL-shared context. */
+bool parseStagePlacement (const std::string &spec, StagePlacement &placement);
+
+
+/*! \brief Creates an OpenCL environment with CL-GL interoperability.
+ *  \details Context `0` is the GL-shared context, with two queues. A stage placed 
+ *           on another device gets a context for the device's platform (shared 
+ *           with other stages on the same platform), two queues on the device, 
+ *           and its own copy of the programs.
+ *  \note With `profiling` set, the queues are created with `CL_QUEUE_PROFILING_ENABLE`, 
+ *        as a `Tracer` requires.
+ */
 class CLEnvGL : public clutils::CLEnv
 {
 public:
+    /*! \brief Stages of the pipeline. */
+    enum class Stage : uint8_t
+    {
+        PRE,   /*!< Preprocessing. */
+        ICP,   /*!< ICP registration. */
+        POST   /*!< Postprocessing. */
+    };
+
+    /*! \brief Programs built for every device of the pipeline, 
+     *         given as offsets from the first program of the device. */
+    enum Program : unsigned int
+    {
+        PROGRAM_GF,    /*!< GuidedFilter kernels. */
+        PROGRAM_RBC,   /*!< RandomBallCover kernels. */
+        PROGRAM_ICP,   /*!< ICP kernels. */
+        PROGRAM_SLAM,  /*!< OCLSLAM kernels. */
+        NUM_PROGRAMS
+    };
+
     /*! \brief Initializes the OpenCL environment. */
-    CLEnvGL (int width, int height, int numPC);
+    CLEnvGL (int width, int height, int numPC, const StagePlacement &placement = StagePlacement (), 
+             bool profiling = false);
+    /*! \brief Returns the environment info of a stage, for one of its programs. */
+    clutils::CLEnvInfo<2> getStageInfo (Stage stage, Program program, unsigned int qFirst = 0);
+    /*! \brief Gets the context of a stage. */
+    cl::Context& getStageContext (Stage stage) { return getContext (getLocation (stage).ctx); }
+    /*! \brief Gets one of the two queues of a stage. */
+    cl::CommandQueue& getStageQueue (Stage stage, unsigned int qIdx = 0);
+    /*! \brief Indicates whether two stages share their command queues (and device). */
+    bool shareQueues (Stage a, Stage b);
+    /*! \brief Gets the buffer pool of the context of a stage. */
+    oclslam::BufferPool& getStagePool (Stage stage) { return *pools[getLocation (stage).ctx]; }
+    /*! \brief Gets the tuner that holds the launch configurations of the kernels. */
+    oclslam::LaunchTuner& getTuner () { return tuner; }
+    /*! \brief Gets the variants of the `OCLSLAM` programs, specialized for a configuration. */
+    oclslam::ProgramVariants& getVariants () { return variants; }
 
 private:
+    /*! \brief Locates the resources of a device within the environment. */
+    struct Location
+    {
+        unsigned int ctx;   // Context index
+        unsigned int dev;   // Device index within the context
+        unsigned int q[2];  // Queue indices within the context
+        unsigned int pg;    // Index of the first program
+    };
+
     /*! \brief Initializes the OpenGL memory buffers. */
     void initGLMemObjects ();
+    /*! \brief Adds the resources for a device, unless they exist already. */
+    unsigned int addDevice (const StageDevice &device, oclslam::ProgramCache &cache);
+    /*! \brief Gets the location of a stage. */
+    Location& getLocation (Stage stage);
 
     int width, height, numPC;
+    cl_command_queue_properties queueProps;
+    std::vector<std::pair<StageDevice, Location>> locations;  // The first one is the GL device
+    std::vector<int> ctxPlatforms;  // Platform of every context, -1 for the GL-shared one
+    std::vector<unsigned int> ctxQueues;  // Number of queues in every context
+    std::vector<std::unique_ptr<oclslam::BufferPool>> pools;  // Buffer pool of every context
+    unsigned int stageLoc[3];  // Location of every stage
+    oclslam::LaunchTuner tuner;
+    oclslam::ProgramVariants variants;
 
 };
 
 
+/*! \brief Type-erased interface to the `SLAM` pipeline.
+ *  \details Allows the `ICP` configuration of `OCLSLAM` to be chosen at runtime. 
+ *           An instance is created with `createOCLSLAM`.
+ */
+class OCLSLAMBase
+{
+public:
+    virtual ~OCLSLAMBase () {}
+    /*! \brief Gets the width of the processed point clouds. */
+    virtual unsigned int getWidth () = 0;
+    /*! \brief Gets the height of the processed point clouds. */
+    virtual unsigned int getHeight () = 0;
+    /*! \brief Initializes the SLAM pipeline. */
+    virtual void init () = 0;
+    /*! \brief Registers a point cloud. */
+    virtual void registerPointCloud () = 0;
+    /*! \brief Stores an occupancy map on disk. */
+    virtual void write (std::string filename = std::string ("map.ot")) = 0;
+    /*! \brief Stores an binary map on disk. */
+    virtual void writeBinary (std::string filename = std::string ("map.bt")) = 0;
+    /*! \brief Waits until the map being stored (if any) is on disk. */
+    virtual void waitForWrite () = 0;
+    /*! \brief Gets the server that answers queries on the map, concurrently with the mapping. */
+    virtual oclslam::MapServer& getMapServer () = 0;
+    /*! \brief Gets the window that bounds the map around the sensor (disabled by default). */
+    virtual oclslam::SlidingWindow& getSlidingWindow () = 0;
+    /*! \brief Gets the tiled map, which takes the place of the map once it's opened.
+     *  \note The map stays empty then, so the window, the distance field, the batches, 
+     *        the grid, the frontiers, and the bricks don't apply, and the map files 
+     *        are replaced by the tiles. */
+    virtual oclslam::TiledMap& getTiledMap () = 0;
+    /*! \brief Gets the worker that refreshes and prunes the map in the background. */
+    virtual oclslam::MapMaintenance& getMapMaintenance () = 0;
+    /*! \brief Gets the distance field of the map (disabled until its bounds are set). */
+    virtual oclslam::DistanceField& getDistanceField () = 0;
+    /*! \brief Gets the accumulator that integrates the point clouds in batches (of one by default). */
+    virtual oclslam::BatchedUpdate& getBatchedUpdate () = 0;
+    /*! \brief Gets the 2-D occupancy grid of the map (disabled until its band is set). */
+    virtual oclslam::OccupancyGrid2D& getOccupancyGrid () = 0;
+    /*! \brief Gets the frontier of the map (disabled by default). */
+    virtual oclslam::FrontierSet& getFrontierSet () = 0;
+    /*! \brief Gets the occupied cells of the map, in bricks for the device (disabled by default). */
+    virtual oclslam::BrickMap& getBrickMap () = 0;
+    /*! \brief Prints on the console results about the current 
+     *         registration and localization. */
+    virtual void display () = 0;
+    /*! \brief Gets the number of point clouds registered. */
+    virtual int getTimeStep () = 0;
+    /*! \brief Gets the status of the automated SLAM process. */
+    virtual bool getSLAMStatus () = 0;
+    /*! \brief Sets the status of the automated SLAM process. */
+    virtual void setSLAMStatus (bool flag) = 0;
+    /*! \brief Toggles the status of the automated SLAM process. */
+    virtual void toggleSLAMStatus () = 0;
+    /*! \brief Gets the status of the RGB Guided Filter. */
+    virtual bool getGFRGBStatus () = 0;
+    /*! \brief Sets the status of the RGB Guided Filter. */
+    virtual void setGFRGBStatus (bool flag) = 0;
+    /*! \brief Toggles the status of the RGB Guided Filter. */
+    virtual void toggleGFRGBStatus () = 0;
+    /*! \brief Gets the status of the Depth Guided Filter. */
+    virtual bool getGFDStatus () = 0;
+    /*! \brief Sets the status of the Depth Guided Filter. */
+    virtual void setGFDStatus (bool flag) = 0;
+    /*! \brief Toggles the status of the Depth Guided Filter. */
+    virtual void toggleGFDStatus () = 0;
+    /*! \brief Gets the status of the RGB normalization. */
+    virtual int getRGBNormalization () = 0;
+    /*! \brief Sets the status of the RGB normalization. */
+    virtual void setRGBNormalization (int flag) = 0;
+    /*! \brief Toggles the status of the RGB normalization. */
+    virtual void toggleRGBNormalization () = 0;
+    /*! \brief Gets the window radius \f$r\f$ for the guided filter performed on the RGB frame. */
+    virtual int getGFRGBRadius () = 0;
+    /*! \brief Sets the window radius \f$r\f$ for the guided filter performed on the RGB frame. */
+    virtual void setGFRGBRadius (int radius) = 0;
+    /*! \brief Gets the variability threshold \f$\epsilon\f$ for the guided filter performed on the RGB frame. */
+    virtual float getGFRGBEps () = 0;
+    /*! \brief Sets the variability threshold \f$\epsilon\f$ for the guided filter performed on the RGB frame. */
+    virtual void setGFRGBEps (float eps) = 0;
+    /*! \brief Gets the window radius \f$r\f$ for the guided filter performed on the Depth frame. */
+    virtual int getGFDRadius () = 0;
+    /*! \brief Sets the window radius \f$r\f$ for the guided filter performed on the Depth frame. */
+    virtual void setGFDRadius (int radius) = 0;
+    /*! \brief Gets the variability threshold \f$\epsilon\f$ for the guided filter performed on the Depth frame. */
+    virtual float getGFDEps () = 0;
+    /*! \brief Sets the variability threshold \f$\epsilon\f$ for the guided filter performed on the Depth frame. */
+    virtual void setGFDEps (float eps) = 0;
+    /*! \brief Gets the scaling applied to the depth frame for processing with the guided filter. */
+    virtual float getGFDScaling () = 0;
+    /*! \brief Sets the scaling applied to the depth frame for processing with the guided filter. */
+    virtual void setGFDScaling (float scaling) = 0;
+    /*! \brief Gets the sensor's focal length. */
+    virtual float getSensorFocalLength () = 0;
+    /*! \brief Sets the sensor's focal length. */
+    virtual void setSensorFocalLength (float f) = 0;
+    /*! \brief Gets the parameter \f$ \alpha \f$ used in the distance function for the RBC data structure. */
+    virtual float getRBCAlpha () = 0;
+    /*! \brief Sets the parameter \f$ \alpha \f$ used in the distance function for the RBC data structure. */
+    virtual void setRBCAlpha (float _a) = 0;
+    /*! \brief Gets the scaling applying to the deviations when computing matrix `S` in the ICP algorithm. */
+    virtual float getICPSScaling () = 0;
+    /*! \brief Sets the scaling applying to the deviations when computing matrix `S` in the ICP algorithm. */
+    virtual void setICPSScaling (float _c) = 0;
+    /*! \brief Gets the maximum number of iterations considered for an ICP registration. */
+    virtual unsigned int getICPMaxIterations () = 0;
+    /*! \brief Sets the maximum number of iterations considered for an ICP registration. */
+    virtual void setICPMaxIterations (unsigned int maxIter) = 0;
+    /*! \brief Gets the angle threshold (in degrees) for the convergence check of the ICP. */
+    virtual double getICPAngleThreshold () = 0;
+    /*! \brief Sets the angle threshold (in degrees) for the convergence check of the ICP. */
+    virtual void setICPAngleThreshold (double at) = 0;
+    /*! \brief Gets the translation threshold (in mm) for the convergence check of the ICP. */
+    virtual double getICPTranslationThreshold () = 0;
+    /*! \brief Sets the translation threshold (in mm) for the convergence check of the ICP. */
+    virtual void setICPTranslationThreshold (double tt) = 0;
+    /*! \brief Gets the status of the device-resident ICP iteration loop. */
+    virtual bool getDeviceICPStatus () = 0;
+    /*! \brief Sets the status of the device-resident ICP iteration loop. */
+    virtual void setDeviceICPStatus (bool flag) = 0;
+    /*! \brief Toggles the status of the device-resident ICP iteration loop. */
+    virtual void toggleDeviceICPStatus () = 0;
+    /*! \brief Gets the status of the loop closure detection. */
+    virtual bool getLoopClosureStatus () = 0;
+    /*! \brief Sets the status of the loop closure detection. */
+    virtual void setLoopClosureStatus (bool flag) = 0;
+    /*! \brief Toggles the status of the loop closure detection. */
+    virtual void toggleLoopClosureStatus () = 0;
+    /*! \brief Gets the distance (in mm) the sensor has to travel before a new keyframe is created. */
+    virtual float getKeyframeDistance () = 0;
+    /*! \brief Sets the distance (in mm) the sensor has to travel before a new keyframe is created. */
+    virtual void setKeyframeDistance (float dist) = 0;
+    /*! \brief Gets the angle (in degrees) the sensor has to rotate before a new keyframe is created. */
+    virtual float getKeyframeAngle () = 0;
+    /*! \brief Sets the angle (in degrees) the sensor has to rotate before a new keyframe is created. */
+    virtual void setKeyframeAngle (float angle) = 0;
+    /*! \brief Gets the current pose corrected by the latest loop closure. */
+    virtual oclslam::Pose getCorrectedPose () = 0;
+    /*! \brief Gets the poses of the keyframes, as optimized after the loop closures. */
+    virtual std::vector<oclslam::Pose> getKeyframePoses () = 0;
+    /*! \brief Indicates whether the tracking has been lost (and the map integration is suspended). */
+    virtual bool getTrackingLost () = 0;
+    /*! \brief Gets the distance (in mm) under which a landmark is considered an inlier of a registration. */
+    virtual float getInlierDistance () = 0;
+    /*! \brief Sets the distance (in mm) under which a landmark is considered an inlier of a registration. */
+    virtual void setInlierDistance (float dist) = 0;
+    /*! \brief Gets the minimum inlier ratio for a registration to be accepted. */
+    virtual float getMinInlierRatio () = 0;
+    /*! \brief Sets the minimum inlier ratio for a registration to be accepted. */
+    virtual void setMinInlierRatio (float ratio) = 0;
+    /*! \brief Gets the maximum RMS residual (in mm) of the inliers for a registration to be accepted. */
+    virtual float getMaxResidual () = 0;
+    /*! \brief Sets the maximum RMS residual (in mm) of the inliers for a registration to be accepted. */
+    virtual void setMaxResidual (float res) = 0;
+    /*! \brief Gets the maximum translation (in mm) between two consecutive time steps. */
+    virtual float getMaxJumpDistance () = 0;
+    /*! \brief Sets the maximum translation (in mm) between two consecutive time steps. */
+    virtual void setMaxJumpDistance (float dist) = 0;
+    /*! \brief Gets the maximum rotation (in degrees) between two consecutive time steps. */
+    virtual float getMaxJumpAngle () = 0;
+    /*! \brief Sets the maximum rotation (in degrees) between two consecutive time steps. */
+    virtual void setMaxJumpAngle (float angle) = 0;
+    /*! \brief Gets the maximum scale change, as \f$ |\ln s| \f$, between two consecutive time steps. */
+    virtual float getMaxJumpScale () = 0;
+    /*! \brief Sets the maximum scale change, as \f$ |\ln s| \f$, between two consecutive time steps. */
+    virtual void setMaxJumpScale (float scale) = 0;
+    /*! \brief Starts logging the trajectory to a file. */
+    virtual bool startTrajectoryLog (std::string filename = std::string ("trajectory.txt")) = 0;
+    /*! \brief Stops logging the trajectory. */
+    virtual void stopTrajectoryLog () = 0;
+    /*! \brief Gets the status of the trajectory log. */
+    virtual bool getTrajectoryLogStatus () = 0;
+    /*! \brief Starts recording a timeline of the pipeline, to be written in a file. */
+    virtual bool startTrace (std::string filename = std::string ("trace.json")) = 0;
+    /*! \brief Stops recording the timeline, and writes the file. */
+    virtual void stopTrace () = 0;
+    /*! \brief Gets the status of the timeline recording. */
+    virtual bool getTraceStatus () = 0;
+
+};
+
+
+/*! \brief Finds the fastest launch configurations of the `OCLSLAM` kernels on the current device, 
+ *         for frames of the given size. */
+void tuneKernels (unsigned int width, unsigned int height, unsigned int decimation = 1, 
+                  unsigned int repeats = 20);
+/*! \brief Creates a `SLAM` pipeline with the requested `ICP` configuration. */
+OCLSLAMBase* createOCLSLAM (ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW, 
+                            Kinect *kinect, octomap::OcTree &map, 
+                            const StagePlacement &placement = StagePlacement (), bool profiling = false, 
+                            unsigned int decimation = 1);
+
+
 /*! \brief Interface class for the `SLAM` pipeline.
  *  \details Retrieves data, registers point clouds, and builds a map.
  *  \note In order to handle memory consumption, there is a limit 
@@ -73,13 +388,18 @@ private:
  *  \tparam CW configures the class for performing either regular or weighted computation.
  */
 template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
-class OCLSLAM
+class OCLSLAM : public OCLSLAMBase
 {
 public:
     /*! \brief Constructor. */
-    OCLSLAM (Kinect *kinect, octomap::OcTree &map);
+    OCLSLAM (Kinect *kinect, octomap::OcTree &map, const StagePlacement &placement = StagePlacement (), 
+             bool profiling = false, unsigned int decimation = 1);
     /*! \brief Destructor. */
     ~OCLSLAM ();
+    /*! \brief Gets the width of the processed point clouds. */
+    unsigned int getWidth () { return width; }
+    /*! \brief Gets the height of the processed point clouds. */
+    unsigned int getHeight () { return height; }
     /*! \brief Initializes the SLAM pipeline. */
     void init ();
     /*! \brief Registers a point cloud. */
@@ -88,9 +408,31 @@ public:
     void write (std::string filename = std::string ("map.ot"));
     /*! \brief Stores an binary map on disk. */
     void writeBinary (std::string filename = std::string ("map.bt"));
+    /*! \brief Waits until the map being stored (if any) is on disk. */
+    void waitForWrite () { if (mapWriter.joinable ()) mapWriter.join (); }
+    /*! \brief Gets the server that answers queries on the map, concurrently with the mapping. */
+    oclslam::MapServer& getMapServer () { return mapServer; }
+    /*! \brief Gets the window that bounds the map around the sensor (disabled by default). */
+    oclslam::SlidingWindow& getSlidingWindow () { return window; }
+    /*! \brief Gets the tiled map, which takes the place of the map once it's opened. */
+    oclslam::TiledMap& getTiledMap () { return tiles; }
+    /*! \brief Gets the worker that refreshes and prunes the map in the background. */
+    oclslam::MapMaintenance& getMapMaintenance () { return maintenance; }
+    /*! \brief Gets the distance field of the map (disabled until its bounds are set). */
+    oclslam::DistanceField& getDistanceField () { return distanceField; }
+    /*! \brief Gets the accumulator that integrates the point clouds in batches (of one by default). */
+    oclslam::BatchedUpdate& getBatchedUpdate () { return batch; }
+    /*! \brief Gets the 2-D occupancy grid of the map (disabled until its band is set). */
+    oclslam::OccupancyGrid2D& getOccupancyGrid () { return grid; }
+    /*! \brief Gets the frontier of the map (disabled by default). */
+    oclslam::FrontierSet& getFrontierSet () { return frontiers; }
+    /*! \brief Gets the occupied cells of the map, in bricks for the device (disabled by default). */
+    oclslam::BrickMap& getBrickMap () { return bricks; }
     /*! \brief Prints on the console results about the current 
      *         registration and localization. */
     void display ();
+    /*! \brief Gets the number of point clouds registered. */
+    int getTimeStep () { return timeStep; }
     /*! \brief Gets the status of the automated SLAM process. */
     bool getSLAMStatus () { return slamStatus; }
     /*! \brief Sets the status of the automated SLAM process. */
@@ -136,9 +478,9 @@ public:
     /*! \brief Sets the scaling applied to the depth frame for processing with the guided filter. */
     void setGFDScaling (float scaling) { gfDScaling = scaling; gfD.setDScaling (scaling); }
     /*! \brief Gets the sensor's focal length. */
-    float getSensorFocalLength () { return to8D.getFocalLength (); }
+    float getSensorFocalLength () { return focalLength; }
     /*! \brief Sets the sensor's focal length. */
-    void setSensorFocalLength (float f) { focalLength = f; to8D.setFocalLength (f); }
+    void setSensorFocalLength (float f) { focalLength = f; to8D.setFocalLength (f / decimation); }
     /*! \brief Gets the parameter \f$ \alpha \f$ used in the distance function for the RBC data structure. */
     float getRBCAlpha () { return icp.getAlpha (); }
     /*! \brief Sets the parameter \f$ \alpha \f$ used in the distance function for the RBC data structure. */
@@ -152,15 +494,82 @@ public:
     /*! \brief Gets the maximum number of iterations considered for an ICP registration. */
     unsigned int getICPMaxIterations () { return icp.getMaxIterations (); }
     /*! \brief Sets the maximum number of iterations considered for an ICP registration. */
-    void setICPMaxIterations (unsigned int maxIter) { max_iterations = maxIter; icp.setMaxIterations (maxIter); }
+    void setICPMaxIterations (unsigned int maxIter) 
+    { max_iterations = maxIter; icp.setMaxIterations (maxIter); devICP.setMaxIterations (maxIter); }
     /*! \brief Gets the angle threshold (in degrees) for the convergence check of the ICP. */
     double getICPAngleThreshold () { return icp.getAngleThreshold (); }
     /*! \brief Sets the angle threshold (in degrees) for the convergence check of the ICP. */
-    void setICPAngleThreshold (double at) { angle_threshold = at; icp.setAngleThreshold (at); }
+    void setICPAngleThreshold (double at) { angle_threshold = at; icp.setAngleThreshold (at); devICP.setAngleThreshold (at); }
     /*! \brief Gets the translation threshold (in mm) for the convergence check of the ICP. */
     double getICPTranslationThreshold () { return icp.getTranslationThreshold (); }
     /*! \brief Sets the translation threshold (in mm) for the convergence check of the ICP. */
-    void setICPTranslationThreshold (double tt) { translation_threshold = tt; icp.setTranslationThreshold (tt); }
+    void setICPTranslationThreshold (double tt) 
+    { translation_threshold = tt; icp.setTranslationThreshold (tt); devICP.setTranslationThreshold (tt); }
+    /*! \brief Gets the status of the device-resident ICP iteration loop. */
+    bool getDeviceICPStatus () { return deviceICPStatus; }
+    /*! \brief Sets the status of the device-resident ICP iteration loop. 
+     *  \details When on, the registration is performed by `oclslam::DeviceICP`, 
+     *           instead of the RBC based `ICP`, and the whole iteration loop 
+     *           stays on the device. */
+    void setDeviceICPStatus (bool flag) { deviceICPStatus = flag; }
+    /*! \brief Toggles the status of the device-resident ICP iteration loop. */
+    void toggleDeviceICPStatus () { deviceICPStatus = !deviceICPStatus; }
+    /*! \brief Gets the status of the loop closure detection. */
+    bool getLoopClosureStatus () { return loopClosureStatus; }
+    /*! \brief Sets the status of the loop closure detection. */
+    void setLoopClosureStatus (bool flag) { loopClosureStatus = flag; }
+    /*! \brief Toggles the status of the loop closure detection. */
+    void toggleLoopClosureStatus () { loopClosureStatus = !loopClosureStatus; }
+    /*! \brief Gets the distance (in mm) the sensor has to travel before a new keyframe is created. */
+    float getKeyframeDistance () { return kfDistance; }
+    /*! \brief Sets the distance (in mm) the sensor has to travel before a new keyframe is created. */
+    void setKeyframeDistance (float dist) { kfDistance = dist; }
+    /*! \brief Gets the angle (in degrees) the sensor has to rotate before a new keyframe is created. */
+    float getKeyframeAngle () { return kfAngle; }
+    /*! \brief Sets the angle (in degrees) the sensor has to rotate before a new keyframe is created. */
+    void setKeyframeAngle (float angle) { kfAngle = angle; }
+    /*! \brief Gets the current pose corrected by the latest loop closure. */
+    oclslam::Pose getCorrectedPose () { return loopClosure.correct (oclslam::Pose (R_g, t_g, s_g)); }
+    /*! \brief Gets the poses of the keyframes, as optimized after the loop closures. */
+    std::vector<oclslam::Pose> getKeyframePoses () { return loopClosure.getCorrectedPoses (); }
+    /*! \brief Indicates whether the tracking has been lost (and the map integration is suspended). */
+    bool getTrackingLost () { return trackingLost; }
+    /*! \brief Gets the distance (in mm) under which a landmark is considered an inlier of a registration. */
+    float getInlierDistance () { return inlierDistance; }
+    /*! \brief Sets the distance (in mm) under which a landmark is considered an inlier of a registration. */
+    void setInlierDistance (float dist) { inlierDistance = dist; }
+    /*! \brief Gets the minimum inlier ratio for a registration to be accepted. */
+    float getMinInlierRatio () { return minInlierRatio; }
+    /*! \brief Sets the minimum inlier ratio for a registration to be accepted. */
+    void setMinInlierRatio (float ratio) { minInlierRatio = ratio; }
+    /*! \brief Gets the maximum RMS residual (in mm) of the inliers for a registration to be accepted. */
+    float getMaxResidual () { return maxResidual; }
+    /*! \brief Sets the maximum RMS residual (in mm) of the inliers for a registration to be accepted. */
+    void setMaxResidual (float res) { maxResidual = res; }
+    /*! \brief Gets the maximum translation (in mm) between two consecutive time steps. */
+    float getMaxJumpDistance () { return maxJumpDistance; }
+    /*! \brief Sets the maximum translation (in mm) between two consecutive time steps. */
+    void setMaxJumpDistance (float dist) { maxJumpDistance = dist; }
+    /*! \brief Gets the maximum rotation (in degrees) between two consecutive time steps. */
+    float getMaxJumpAngle () { return maxJumpAngle; }
+    /*! \brief Sets the maximum rotation (in degrees) between two consecutive time steps. */
+    void setMaxJumpAngle (float angle) { maxJumpAngle = angle; }
+    /*! \brief Gets the maximum scale change, as \f$ |\ln s| \f$, between two consecutive time steps. */
+    float getMaxJumpScale () { return maxJumpScale; }
+    /*! \brief Sets the maximum scale change, as \f$ |\ln s| \f$, between two consecutive time steps. */
+    void setMaxJumpScale (float scale) { maxJumpScale = scale; }
+    /*! \brief Starts logging the trajectory to a file. */
+    bool startTrajectoryLog (std::string filename = std::string ("trajectory.txt"));
+    /*! \brief Stops logging the trajectory. */
+    void stopTrajectoryLog ();
+    /*! \brief Gets the status of the trajectory log. */
+    bool getTrajectoryLogStatus () { return trajLog.isOpen (); }
+    /*! \brief Starts recording a timeline of the pipeline, to be written in a file. */
+    bool startTrace (std::string filename = std::string ("trace.json"));
+    /*! \brief Stops recording the timeline, and writes the file. */
+    void stopTrace ();
+    /*! \brief Gets the status of the timeline recording. */
+    bool getTraceStatus () { return tracer.isOpen (); }
 
     /*! \brief Performs the SLAM process.
      *  \details Initially, it points to `init` for registering the first point cloud, and 
@@ -168,7 +577,9 @@ public:
      */
     std::function<void ()> slam;
 
-    volatile int timeStep;  /*!< Counts the discrete time steps, as in the number of point clouds registered. */
+    volatile int timeStep;  /*!< Counts the discrete time steps, as in the number of point clouds rendered 
+                             *   (it stops at `maxPCGL`). */
+    volatile unsigned int frameCount;  /*!< Counts the point clouds registered, past the rendering limit too. */
 
     // Global localization parameters
     Eigen::Matrix3f R_g;     /*!< Represents the orietation with respect to the global coordinate frame, 
@@ -184,6 +595,16 @@ public:
 
 private:
     void _mapping ();
+    void _checkKeyframe ();
+    void _logPose ();
+    void _runICP ();
+    bool _checkResiduals ();
+    bool _checkMotion (float maxDistance, float maxAngle);
+    bool _relocalize ();
+    void _storeKeyframe ();
+    void _setFilterStages ();
+    bool _flushTiles (const std::string &filename);
+    void _applyBatch ();
 
     // Internal parameters
     int gfRGBRadius;
@@ -203,19 +624,33 @@ private:
     volatile bool gfRGBStatus;
     volatile bool gfDStatus;
     volatile int rgbNorm;
+    volatile bool loopClosureStatus;
+    volatile bool deviceICPStatus;
+    float kfDistance;
+    float kfAngle;
+    float inlierDistance;
+    float minInlierRatio;
+    float maxResidual;
+    float maxJumpDistance;
+    float maxJumpAngle;
+    float maxJumpScale;
 
     size_t slamFuncHashCode;
     int maxPCGL;  // Limits in the number of point clouds held in memory for visualization
+    unsigned int decimation;  // Downsampling factor of the sensor frames
     unsigned int width, height;
     unsigned int n;  // Number of points in a point cloud
+    unsigned int lmSide;  // Side of the landmark grid
     unsigned int m;  // Number of landmarks
     unsigned int r;  // Number of representatives
 
     CLEnvGL env;
-    clutils::CLEnvInfo<2> infoGF;
+    clutils::CLEnvInfo<2> infoGF, infoGFD;
     clutils::CLEnvInfo<1> infoRBC, infoICP, infoSLAM;
-    cl::Context &context;
-    cl::CommandQueue &queue0, &queue1;
+    clutils::CLEnvInfo<1> infoLM, infoTransform, infoGL, infoMap;
+    cl::Context &context, &contextPre, &contextICP;
+    cl::CommandQueue &queue0, &queue1;  // Postprocessing queues, on the GL device
+    cl::CommandQueue &queuePre, &queueICP;
     
     Kinect *kinect;
 
@@ -223,6 +658,8 @@ private:
     cl::Buffer hBufferTg;
     cl::Buffer hBufferRGB, hBufferD;
     cl::Buffer dBufferRGB, dBufferD;
+    cl::Buffer dBufferRGBS, dBufferDS;  // Sensor frames (aliases of the above, at full resolution)
+    oclslam::BufferPlanner framePlan;  // Aliases the buffers of a time step with disjoint lifetimes
     std::vector<cl::BufferGL> dBufferGL;
 
     GF::Kinect::GuidedFilterRGB<GF::Kinect::GuidedFilterRGBConfig::SEPARATED> gfRGB;
@@ -230,17 +667,41 @@ private:
     GF::SeparateRGB<GF::SeparateRGBConfig::UCHAR_FLOAT> sepRGB;
     GF::Depth<GF::DepthConfig::USHORT_FLOAT> convD;
     GF::RGBDTo8D to8D;
-    ICP::ICPLMs lm;
+    oclslam::DownsampleRGBD down;
+    oclslam::ICPLMsGrid lm;
     ICP::ICP<CR, CW> icp;
     ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION> transform;
     GF::SplitPC8D sp8D;
     oclslam::SplitPC8D sp8DMap;
+    oclslam::ICPResiduals residuals;
+    oclslam::DeviceICP devICP;
+    oclslam::BufferTransfer lmTransfer;  // Landmarks, from the preprocessing to the ICP device
+    oclslam::BufferTransfer pcTransfer;  // Point cloud, from the preprocessing to the GL device
+
+    // Latest ICP registration, by either `icp` or `devICP`
+    Eigen::Matrix3f R_icp;
+    Eigen::Vector3f t_icp;
+    float s_icp;
+    unsigned int k_icp;
 
-    cl::Event eventGL;
-    std::vector<cl::Event> waitListGL;
+    // The stages of a time step, ordered by the buffers they access
+    oclslam::StageGraph stages;
+    unsigned int sDeliver, sDownsample, sGFRGB, sSepRGB, sGFD, sConvD, sTo8D, sLMsF, sLMs;
+    unsigned int sTransform, sCopyPC, sSplitMap, sSplitGL;
     clutils::CPUTimer<double, std::milli> timer;
     clutils::CPUTimer<double, std::milli> timerICP;
+    clutils::CPUTimer<double, std::milli> timerPre;
     volatile double lICP;
+    volatile double lPre;    // Latency of the stages before the ICP
+    volatile double latency;  // Latency of the time step
+
+    // Records the commands of the queues and the host steps, when requested
+    oclslam::Tracer tracer;
+
+    // Trajectory log parameters
+    oclslam::TrajectoryLog trajLog;
+    double hostTimestamp;      // Host time (in s) at which the frames were delivered
+    uint32_t sensorTimestamp;  // Time stamp of the depth frame reported by the sensor
 
     // Map parameters
     octomap::point3d global_pos;  // Global position in meters
@@ -248,6 +709,35 @@ private:
     // std::vector<octomap::ColorOcTreeNode::Color> cc;
     octomap::OcTree &map;
     // octomap::ColorOcTree &map;
+    oclslam::MapServer mapServer;  // Snapshots of the map for the readers
+    std::thread mapWriter;  // Writes a snapshot of the map to disk (W/B)
+    oclslam::SlidingWindow window;  // Evicts the map away from the sensor
+    oclslam::TiledMap tiles;  // Out-of-core alternative to the map
+    oclslam::MapMaintenance maintenance;  // Refreshes the lazily updated map
+    oclslam::DistanceField distanceField;  // Distances to the obstacles of the map
+    oclslam::BatchedUpdate batch;  // Point clouds waiting to be integrated together
+    oclslam::OccupancyGrid2D grid;  // Projection of the map for ground navigation
+    oclslam::FrontierSet frontiers;  // Boundary of the known free space, for exploration
+    oclslam::BrickMap bricks;  // Occupied cells, mirrored on a device for ray casting
+
+    // Loop closure parameters
+    oclslam::LoopClosure loopClosure;
+    oclslam::Pose kfLastPose;  // Pose of the latest keyframe
+    oclslam::Pose kfPose;      // Pose of the point cloud waiting to be mapped
+    unsigned int kfFrame;      // Number of the point cloud waiting to be mapped, as in `frameCount`
+    bool kfPending;            // Indicates whether the point cloud waiting to be mapped is a keyframe
+
+    // Tracking failure parameters
+    volatile bool trackingLost;
+    unsigned int lostFrames;      // Number of consecutive time steps without tracking
+    float inlierRatio;            // Inlier ratio of the latest registration
+    float rmsResidual;            // RMS residual (in mm) of the inliers of the latest registration
+    cl::Buffer dBufferLMsGood;    // Landmarks of the last successfully registered point cloud
+    cl::Buffer dBufferLMsKF;      // Landmarks of the most recent keyframes
+    unsigned int maxKFLMs;        // Number of keyframes for which landmarks are held on the device
+    unsigned int kfStored;        // Number of keyframes stored so far
+    unsigned int relocCandidates; // Number of keyframes tried at every time step during relocalization
+    std::vector<oclslam::Pose> kfLMsPoses;  // Poses of the keyframes held on the device
 };
 
 #endif  // OCL_PROCESSING_HPP
@@ -34,6 +34,11 @@
 
 #include <CLUtils.hpp>
 #include <oclslam/common.hpp>
+#include <oclslam/memory.hpp>
+#include <oclslam/tuner.hpp>
+#include <oclslam/program_cache.hpp>
+#include <oclslam/linear_octree.hpp>
+#include <oclslam/brick_map.hpp>
 #include <RBC/data_types.hpp>
 #include <RBC/algorithms.hpp>
 #include <eigen3/Eigen/Dense>
@@ -70,6 +75,7 @@ namespace oclslam
      *        | D_IN      | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$  width*height*sizeof\ (cl\_float8)\f$ |
      *        | D_OUT_PC3D| Buffer | Device | O | Processing  | CL_MEM_WRITE_ONLY | \f$3*width*height*sizeof\ (cl\_float) \f$ |
      *        | D_OUT_RGB | Buffer | Device | O | Processing  | CL_MEM_WRITE_ONLY | \f$3*width*height*sizeof\ (cl\_uchar) \f$ |
+     *  \note When given a `ProgramVariants`, `init` switches to a kernel specialized for the number of points.
      */
     class SplitPC8D
     {
@@ -89,7 +95,8 @@ namespace oclslam
         };
 
         /*! \brief Configures an OpenCL environment as specified by `_info`. */
-        SplitPC8D (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info);
+        SplitPC8D (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool = nullptr, 
+                   LaunchTuner *_tuner = nullptr, ProgramVariants *_variants = nullptr);
         /*! \brief Returns a reference to an internal memory object. */
         cl::Memory& get (SplitPC8D::Memory mem);
         /*! \brief Configures kernel execution parameters. */
@@ -102,6 +109,10 @@ namespace oclslam
                     const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
         /*! \brief Executes the necessary kernels. */
         void run (const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Finds the fastest launch configuration on the device, and stores it. */
+        LaunchConfig tune (LaunchTuner &tuner, unsigned int repeats = 10);
+        /*! \brief Gets the launch configuration. */
+        LaunchConfig getConfig () { return config; }
 
         cl_float *hPtrIn;       /*!< Mapping of the input staging buffer for the 8-D point cloud. */
         cl_float *hPtrOutPC3D;  /*!< Mapping of the output staging buffer for the 3-D coordinates. */
@@ -113,12 +124,697 @@ namespace oclslam
         cl::Context context;
         cl::CommandQueue queue;
         cl::Kernel kernel;
-        cl::NDRange global;
+        cl::NDRange global, local;
         Staging staging;
         unsigned int n;
         unsigned int bufferInSize, bufferOutPC3DSize, bufferOutRGBSize;
         cl::Buffer hBufferIn, hBufferOutPC3D, hBufferOutRGB;
         cl::Buffer dBufferIn, dBufferOutPC3D, dBufferOutRGB;
+        PooledBuffers pooled;
+        bool mappedPC3D, mappedRGB;  // Zero-copy outputs that are currently mapped
+        LaunchTuner *tuner;
+        ProgramVariants *variants;
+        LaunchConfig config;
+
+        /*! \brief Unmaps the zero-copy outputs before the kernel writes them again. */
+        void unmap ();
+        /*! \brief Sets the workspaces for a launch configuration. */
+        void setConfig (const LaunchConfig &_config);
+
+    public:
+        /*! \brief Executes the necessary kernels.
+         *  \details This `run` instance is used for profiling.
+         *  
+         *  \param[in] timer `GPUTimer` that does the profiling of the kernel executions.
+         *  \param[in] events a wait-list of events.
+         *  \return Τhe total execution time measured by the timer.
+         */
+        template <typename period>
+        double run (clutils::GPUTimer<period> &timer, const std::vector<cl::Event> *events = nullptr)
+        {
+            unmap ();
+            queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, local, events, &timer.event ());
+            queue.flush (); timer.wait ();
+
+            return timer.duration ();
+        }
+
+    };
+
+    /*! \brief Interface class for the `icpResiduals` kernel.
+     *  \details `icpResiduals` evaluates the quality of an `ICP` registration. It transforms 
+     *           a sample of the moving landmarks with the estimated transformation, and 
+     *           computes the squared distance of each one to its nearest fixed landmark.
+     *           For more details, look at the kernel's documentation.
+     *  \note The `icpResiduals` kernel is available in `kernels/slam_kernels.cl`.
+     *  \note The class creates its own buffers. If you would like to provide 
+     *        your own buffers, call `get` to get references to the placeholders 
+     *        within the class and assign them to your buffers. You will have to 
+     *        do this strictly before the call to `init`. You can also call `get` 
+     *        (after the call to `init`) to get a reference to a buffer within 
+     *        the class and assign it to another kernel class instance further 
+     *        down in your task pipeline.
+     *  
+     *        The following input/output `OpenCL` memory objects are created by an `ICPResiduals` instance:<br>
+     *        | Name | Type | Placement | I/O | Use | Properties | Size |
+     *        | ---  |:---: |   :---:   |:---:|:---:|   :---:    |:---: |
+     *        | H_IN_F | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$m*sizeof\ (cl\_float8)\f$ |
+     *        | H_IN_M | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$m*sizeof\ (cl\_float8)\f$ |
+     *        | H_OUT  | Buffer | Host   | O | Staging     | CL_MEM_READ_WRITE | \f$samples*sizeof\ (cl\_float)\f$ |
+     *        | D_IN_F | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$m*sizeof\ (cl\_float8)\f$ |
+     *        | D_IN_M | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$m*sizeof\ (cl\_float8)\f$ |
+     *        | D_OUT  | Buffer | Device | O | Processing  | CL_MEM_WRITE_ONLY | \f$samples*sizeof\ (cl\_float)\f$ |
+     */
+    class ICPResiduals
+    {
+    public:
+        /*! \brief Enumerates the memory objects handled by the class.
+         *  \note `H_*` names refer to staging buffers on the host.
+         *  \note `D_*` names refer to buffers on the device.
+         */
+        enum class Memory : uint8_t
+        {
+            H_IN_F,  /*!< Input staging buffer for the fixed landmarks. */
+            H_IN_M,  /*!< Input staging buffer for the moving landmarks. */
+            H_OUT,   /*!< Output staging buffer for the squared distances. */
+            D_IN_F,  /*!< Input buffer for the fixed landmarks. */
+            D_IN_M,  /*!< Input buffer for the moving landmarks. */
+            D_OUT    /*!< Output buffer for the squared distances. */
+        };
+
+        /*! \brief Configures an OpenCL environment as specified by `_info`. */
+        ICPResiduals (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool = nullptr, 
+                      LaunchTuner *_tuner = nullptr);
+        /*! \brief Returns a reference to an internal memory object. */
+        cl::Memory& get (ICPResiduals::Memory mem);
+        /*! \brief Configures kernel execution parameters. */
+        void init (unsigned int _m, unsigned int _samples = 1024, Staging _staging = Staging::IO);
+        /*! \brief Performs a data transfer to a device buffer. */
+        void write (ICPResiduals::Memory mem = ICPResiduals::Memory::D_IN_F, void *ptr = nullptr, bool block = CL_FALSE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Performs a data transfer to a staging buffer. */
+        void* read (ICPResiduals::Memory mem = ICPResiduals::Memory::H_OUT, bool block = CL_TRUE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Executes the necessary kernels. */
+        void run (const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Sets the transformation to be evaluated. */
+        void setTransformation (const Eigen::Quaternionf &q, const Eigen::Vector3f &t, float s);
+        /*! \brief Finds the fastest launch configuration on the device, and stores it. */
+        LaunchConfig tune (LaunchTuner &tuner, unsigned int repeats = 10);
+        /*! \brief Gets the launch configuration. */
+        LaunchConfig getConfig () { return config; }
+        /*! \brief Gets the number of samples. */
+        unsigned int getSamples () { return samples; }
+
+        cl_float *hPtrInF;  /*!< Mapping of the input staging buffer for the fixed landmarks. */
+        cl_float *hPtrInM;  /*!< Mapping of the input staging buffer for the moving landmarks. */
+        cl_float *hPtrOut;  /*!< Mapping of the output staging buffer for the squared distances. */
+
+    private:
+        clutils::CLEnv &env;
+        clutils::CLEnvInfo<1> info;
+        cl::Context context;
+        cl::CommandQueue queue;
+        cl::Kernel kernel;
+        cl::NDRange global, local;
+        Staging staging;
+        unsigned int m, samples;
+        unsigned int bufferInSize, bufferOutSize;
+        cl::Buffer hBufferInF, hBufferInM, hBufferOut;
+        cl::Buffer dBufferInF, dBufferInM, dBufferOut;
+        PooledBuffers pooled;
+        bool mappedOut;  // Zero-copy output is currently mapped
+        LaunchTuner *tuner;
+        LaunchConfig config;
+
+        /*! \brief Unmaps the zero-copy output before the kernel writes it again. */
+        void unmap ();
+        /*! \brief Sets the workspaces for a launch configuration. */
+        void setConfig (const LaunchConfig &_config);
+        /*! \brief Copies input data straight into a zero-copy device buffer. */
+        void writeMapped (cl::Buffer &buffer, void *ptr, bool block, 
+                          const std::vector<cl::Event> *events, cl::Event *event);
+
+    public:
+        /*! \brief Executes the necessary kernels.
+         *  \details This `run` instance is used for profiling.
+         *  
+         *  \param[in] timer `GPUTimer` that does the profiling of the kernel executions.
+         *  \param[in] events a wait-list of events.
+         *  \return Τhe total execution time measured by the timer.
+         */
+        template <typename period>
+        double run (clutils::GPUTimer<period> &timer, const std::vector<cl::Event> *events = nullptr)
+        {
+            unmap ();
+            queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, local, events, &timer.event ());
+            queue.flush (); timer.wait ();
+
+            return timer.duration ();
+        }
+
+    };
+
+    /*! \brief Interface class for the device-resident `ICP` registration.
+     *  \details `DeviceICP` keeps the whole `ICP` iteration loop on the device. Every 
+     *           iteration consists of two kernels, `icpAssociate`, which matches the 
+     *           landmarks and reduces the statistics of the pairs per work-group, and 
+     *           `icpSolve`, which computes the increment (power method on Horn's 
+     *           \f$ 4 \times 4 \f$ matrix), composes it with the current estimate, and 
+     *           tests for convergence. Once converged, the remaining kernels return 
+     *           immediately, so all iterations are enqueued at once, and only the final 
+     *           transformation and the iteration count are read back to the host.
+     *           For more details, look at the kernels' documentation.
+     *  \note The landmarks are matched within a window on the landmark grid, instead 
+     *        of with an RBC data structure, so the motion between the two sets has to 
+     *        be small, which is the case between consecutive frames.
+     *  \note The kernels are available in `kernels/slam_kernels.cl`.
+     *  \note The class creates its own buffers. If you would like to provide 
+     *        your own buffers, call `get` to get references to the placeholders 
+     *        within the class and assign them to your buffers. You will have to 
+     *        do this strictly before the call to `init`. You can also call `get` 
+     *        (after the call to `init`) to get a reference to a buffer within 
+     *        the class and assign it to another kernel class instance further 
+     *        down in your task pipeline.
+     *  
+     *        The following input/output `OpenCL` memory objects are created by a `DeviceICP` instance:<br>
+     *        | Name | Type | Placement | I/O | Use | Properties | Size |
+     *        | ---  |:---: |   :---:   |:---:|:---:|   :---:    |:---: |
+     *        | H_IN_F | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$m*sizeof\ (cl\_float8)\f$ |
+     *        | H_IN_M | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$m*sizeof\ (cl\_float8)\f$ |
+     *        | H_OUT  | Buffer | Host   | O | Staging     | CL_MEM_READ_WRITE | \f$sizeof\ (cl\_float8) + sizeof\ (cl\_uint4)\f$ |
+     *        | D_IN_F | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$m*sizeof\ (cl\_float8)\f$ |
+     *        | D_IN_M | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$m*sizeof\ (cl\_float8)\f$ |
+     *        | D_OUT  | Buffer | Device | O | Processing  | CL_MEM_READ_WRITE | \f$sizeof\ (cl\_float8)\f$ |
+     */
+    class DeviceICP
+    {
+    public:
+        /*! \brief Enumerates the memory objects handled by the class.
+         *  \note `H_*` names refer to staging buffers on the host.
+         *  \note `D_*` names refer to buffers on the device.
+         */
+        enum class Memory : uint8_t
+        {
+            H_IN_F,  /*!< Input staging buffer for the fixed landmarks. */
+            H_IN_M,  /*!< Input staging buffer for the moving landmarks. */
+            H_OUT,   /*!< Output staging buffer for the transformation and the iteration count. */
+            D_IN_F,  /*!< Input buffer for the fixed landmarks. */
+            D_IN_M,  /*!< Input buffer for the moving landmarks. */
+            D_OUT    /*!< Output buffer for the transformation, \f$ \left[ \begin{matrix} q_x & q_y & 
+                      *   q_z & q_w & t_x & t_y & t_z & s \end{matrix} \right] \f$. */
+        };
+
+        /*! \brief Configures an OpenCL environment as specified by `_info`. */
+        DeviceICP (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool = nullptr, 
+                   LaunchTuner *_tuner = nullptr);
+        /*! \brief Returns a reference to an internal memory object. */
+        cl::Memory& get (DeviceICP::Memory mem);
+        /*! \brief Configures kernel execution parameters. */
+        void init (unsigned int _gw, unsigned int _gh, unsigned int _maxIterations = 40, 
+                   float _angleThreshold = 0.001f, float _translationThreshold = 0.01f, 
+                   int _radius = 4, float _maxDistance = 100.f, Staging _staging = Staging::O);
+        /*! \brief Performs a data transfer to a device buffer. */
+        void write (DeviceICP::Memory mem = DeviceICP::Memory::D_IN_F, void *ptr = nullptr, bool block = CL_FALSE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Performs a data transfer to a staging buffer. */
+        void* read (DeviceICP::Memory mem = DeviceICP::Memory::H_OUT, bool block = CL_TRUE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Executes the necessary kernels. */
+        void run (const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Gets the maximum number of iterations. */
+        unsigned int getMaxIterations () { return maxIterations; }
+        /*! \brief Sets the maximum number of iterations. */
+        void setMaxIterations (unsigned int maxIter) { maxIterations = maxIter; }
+        /*! \brief Gets the angle threshold (in degrees) for the convergence check. */
+        float getAngleThreshold () { return angleThreshold; }
+        /*! \brief Sets the angle threshold (in degrees) for the convergence check. */
+        void setAngleThreshold (float at) { angleThreshold = at; solveKernel.setArg (4, at); }
+        /*! \brief Gets the translation threshold (in mm) for the convergence check. */
+        float getTranslationThreshold () { return translationThreshold; }
+        /*! \brief Sets the translation threshold (in mm) for the convergence check. */
+        void setTranslationThreshold (float tt) { translationThreshold = tt; solveKernel.setArg (5, tt); }
+        /*! \brief Gets the radius of the search window on the landmark grid. */
+        int getRadius () { return radius; }
+        /*! \brief Sets the radius of the search window on the landmark grid. */
+        void setRadius (int _radius) { radius = _radius; associateKernel.setArg (8, _radius); }
+        /*! \brief Gets the maximum distance (in mm) between two associated landmarks. */
+        float getMaxDistance () { return maxDistance; }
+        /*! \brief Sets the maximum distance (in mm) between two associated landmarks. */
+        void setMaxDistance (float dist) { maxDistance = dist; associateKernel.setArg (9, dist); }
+        /*! \brief Finds the fastest launch configuration on the device, and stores it. */
+        LaunchConfig tune (LaunchTuner &tuner, unsigned int repeats = 10);
+        /*! \brief Gets the launch configuration of `icpAssociate`. */
+        LaunchConfig getConfig () { return config; }
+
+        cl_float *hPtrInF;  /*!< Mapping of the input staging buffer for the fixed landmarks. */
+        cl_float *hPtrInM;  /*!< Mapping of the input staging buffer for the moving landmarks. */
+        cl_float *hPtrOut;  /*!< Mapping of the output staging buffer for the transformation and the iteration count. */
+
+        Eigen::Matrix3f R;  /*!< Rotation of the final transformation, \f$ p_F = sRp_M + t \f$. */
+        Eigen::Vector3f t;  /*!< Translation (in mm) of the final transformation. */
+        float s;            /*!< Scale of the final transformation. */
+        unsigned int k;     /*!< Number of iterations performed. */
+        bool converged;     /*!< Indicates whether the registration converged within the iterations. */
+
+    private:
+        clutils::CLEnv &env;
+        clutils::CLEnvInfo<1> info;
+        cl::Context context;
+        cl::CommandQueue queue;
+        cl::Kernel associateKernel, solveKernel;
+        cl::NDRange global, local;
+        Staging staging;
+        unsigned int gw, gh, m, groups;
+        unsigned int maxIterations;
+        float angleThreshold, translationThreshold;
+        int radius;
+        float maxDistance;
+        cl_float8 T0;
+        unsigned int bufferInSize, bufferOutSize;
+        cl::Buffer hBufferInF, hBufferInM, hBufferOut;
+        cl::Buffer dBufferInF, dBufferInM, dBufferOut;
+        cl::Buffer dBufferSums, dBufferState;
+        PooledBuffers pooled;
+        LaunchTuner *tuner;
+        LaunchConfig config;
+
+        /*! \brief Sets the workspaces for a launch configuration. */
+        void setConfig (const LaunchConfig &_config);
+
+    public:
+        /*! \brief Executes the necessary kernels.
+         *  \details This `run` instance is used for profiling.
+         *  
+         *  \param[in] timer `GPUTimer` that does the profiling of the kernel executions.
+         *  \param[in] events a wait-list of events.
+         *  \return Τhe total execution time measured by the timer.
+         */
+        template <typename period>
+        double run (clutils::GPUTimer<period> &timer, const std::vector<cl::Event> *events = nullptr)
+        {
+            double pTime = 0.0;
+            
+            queue.enqueueWriteBuffer (dBufferOut, CL_FALSE, 0, sizeof (cl_float8), &T0, events);
+            queue.enqueueFillBuffer<cl_uint> (dBufferState, 0, 0, sizeof (cl_uint4));
+            for (unsigned int i = 0; i < maxIterations; ++i)
+            {
+                queue.enqueueNDRangeKernel (associateKernel, cl::NullRange, global, local, nullptr, &timer.event ());
+                queue.flush (); timer.wait ();
+                pTime += timer.duration ();
+
+                queue.enqueueNDRangeKernel (solveKernel, cl::NullRange, cl::NDRange (1), cl::NDRange (1), nullptr, &timer.event ());
+                queue.flush (); timer.wait ();
+                pTime += timer.duration ();
+            }
+
+            return pTime;
+        }
+
+    };
+
+    /*! \brief Interface class for the `downsampleRGBD` kernel.
+     *  \details `downsampleRGBD` halves the resolution of an RGB-D frame pair. The RGB 
+     *           values get averaged over 2x2 blocks, and the depth is the lower median 
+     *           of the valid depths in a block. For more details, look at the kernel's 
+     *           documentation.
+     *  \note The `downsampleRGBD` kernel is available in `kernels/slam_kernels.cl`.
+     *  \note The class creates its own buffers. If you would like to provide 
+     *        your own buffers, call `get` to get references to the placeholders 
+     *        within the class and assign them to your buffers. You will have to 
+     *        do this strictly before the call to `init`. You can also call `get` 
+     *        (after the call to `init`) to get a reference to a buffer within 
+     *        the class and assign it to another kernel class instance further 
+     *        down in your task pipeline.
+     *  \note Zero-copy staging is not supported, and it falls back to `Staging::IO`.
+     *  
+     *        The following input/output `OpenCL` memory objects are created by a `DownsampleRGBD` instance:<br>
+     *        | Name | Type | Placement | I/O | Use | Properties | Size |
+     *        | ---  |:---: |   :---:   |:---:|:---:|   :---:    |:---: |
+     *        | H_IN_RGB  | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$3*width*height*sizeof\ (cl\_uchar) \f$ |
+     *        | H_IN_D    | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$  width*height*sizeof\ (cl\_ushort)\f$ |
+     *        | H_OUT_RGB | Buffer | Host   | O | Staging     | CL_MEM_READ_WRITE | \f$3*width*height/4*sizeof\ (cl\_uchar) \f$ |
+     *        | H_OUT_D   | Buffer | Host   | O | Staging     | CL_MEM_READ_WRITE | \f$  width*height/4*sizeof\ (cl\_ushort)\f$ |
+     *        | D_IN_RGB  | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$3*width*height*sizeof\ (cl\_uchar) \f$ |
+     *        | D_IN_D    | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$  width*height*sizeof\ (cl\_ushort)\f$ |
+     *        | D_OUT_RGB | Buffer | Device | O | Processing  | CL_MEM_WRITE_ONLY | \f$3*width*height/4*sizeof\ (cl\_uchar) \f$ |
+     *        | D_OUT_D   | Buffer | Device | O | Processing  | CL_MEM_WRITE_ONLY | \f$  width*height/4*sizeof\ (cl\_ushort)\f$ |
+     *  \note When given a `ProgramVariants`, `init` switches to a kernel specialized for the width of the frames.
+     */
+    class DownsampleRGBD
+    {
+    public:
+        /*! \brief Enumerates the memory objects handled by the class.
+         *  \note `H_*` names refer to staging buffers on the host.
+         *  \note `D_*` names refer to buffers on the device.
+         */
+        enum class Memory : uint8_t
+        {
+            H_IN_RGB,   /*!< Input staging buffer for the RGB frame. */
+            H_IN_D,     /*!< Input staging buffer for the depth frame. */
+            H_OUT_RGB,  /*!< Output staging buffer for the downsampled RGB frame. */
+            H_OUT_D,    /*!< Output staging buffer for the downsampled depth frame. */
+            D_IN_RGB,   /*!< Input buffer for the RGB frame. */
+            D_IN_D,     /*!< Input buffer for the depth frame. */
+            D_OUT_RGB,  /*!< Output buffer for the downsampled RGB frame. */
+            D_OUT_D     /*!< Output buffer for the downsampled depth frame. */
+        };
+
+        /*! \brief Configures an OpenCL environment as specified by `_info`. */
+        DownsampleRGBD (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool = nullptr, 
+                        ProgramVariants *_variants = nullptr);
+        /*! \brief Returns a reference to an internal memory object. */
+        cl::Memory& get (DownsampleRGBD::Memory mem);
+        /*! \brief Configures kernel execution parameters. */
+        void init (unsigned int _width, unsigned int _height, Staging _staging = Staging::IO);
+        /*! \brief Performs a data transfer to a device buffer. */
+        void write (DownsampleRGBD::Memory mem = DownsampleRGBD::Memory::D_IN_D, void *ptr = nullptr, bool block = CL_FALSE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Performs a data transfer to a staging buffer. */
+        void* read (DownsampleRGBD::Memory mem = DownsampleRGBD::Memory::H_OUT_D, bool block = CL_TRUE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Executes the necessary kernels. */
+        void run (const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+
+        cl_uchar *hPtrInRGB;   /*!< Mapping of the input staging buffer for the RGB frame. */
+        cl_ushort *hPtrInD;    /*!< Mapping of the input staging buffer for the depth frame. */
+        cl_uchar *hPtrOutRGB;  /*!< Mapping of the output staging buffer for the downsampled RGB frame. */
+        cl_ushort *hPtrOutD;   /*!< Mapping of the output staging buffer for the downsampled depth frame. */
+
+    private:
+        clutils::CLEnv &env;
+        clutils::CLEnvInfo<1> info;
+        cl::Context context;
+        cl::CommandQueue queue;
+        cl::Kernel kernel;
+        cl::NDRange global;
+        Staging staging;
+        unsigned int width, height;
+        unsigned int bufferInRGBSize, bufferInDSize, bufferOutRGBSize, bufferOutDSize;
+        cl::Buffer hBufferInRGB, hBufferInD, hBufferOutRGB, hBufferOutD;
+        cl::Buffer dBufferInRGB, dBufferInD, dBufferOutRGB, dBufferOutD;
+        PooledBuffers pooled;
+        ProgramVariants *variants;
+
+    public:
+        /*! \brief Executes the necessary kernels.
+         *  \details This `run` instance is used for profiling.
+         *  
+         *  \param[in] timer `GPUTimer` that does the profiling of the kernel executions.
+         *  \param[in] events a wait-list of events.
+         *  \return Τhe total execution time measured by the timer.
+         */
+        template <typename period>
+        double run (clutils::GPUTimer<period> &timer, const std::vector<cl::Event> *events = nullptr)
+        {
+            queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, cl::NullRange, events, &timer.event ());
+            queue.flush (); timer.wait ();
+
+            return timer.duration ();
+        }
+
+    };
+
+    /*! \brief Interface class for the `icpLMs_grid` kernel.
+     *  \details `icpLMs_grid` samples the landmarks of an organized 8-D point cloud 
+     *           of any resolution, on a \f$ side \times side \f$ grid. For more details, 
+     *           look at the kernel's documentation.
+     *  \note The `icpLMs_grid` kernel is available in `kernels/slam_kernels.cl`.
+     *  \note The class creates its own buffers. If you would like to provide 
+     *        your own buffers, call `get` to get references to the placeholders 
+     *        within the class and assign them to your buffers. You will have to 
+     *        do this strictly before the call to `init`. You can also call `get` 
+     *        (after the call to `init`) to get a reference to a buffer within 
+     *        the class and assign it to another kernel class instance further 
+     *        down in your task pipeline.
+     *  \note Zero-copy staging is not supported, and it falls back to `Staging::IO`.
+     *  
+     *        The following input/output `OpenCL` memory objects are created by an `ICPLMsGrid` instance:<br>
+     *        | Name | Type | Placement | I/O | Use | Properties | Size |
+     *        | ---  |:---: |   :---:   |:---:|:---:|   :---:    |:---: |
+     *        | H_IN  | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$width*height*sizeof\ (cl\_float8)\f$ |
+     *        | H_OUT | Buffer | Host   | O | Staging     | CL_MEM_READ_WRITE | \f$side*side*sizeof\ (cl\_float8)  \f$ |
+     *        | D_IN  | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$width*height*sizeof\ (cl\_float8)\f$ |
+     *        | D_OUT | Buffer | Device | O | Processing  | CL_MEM_WRITE_ONLY | \f$side*side*sizeof\ (cl\_float8)  \f$ |
+     *  \note When given a `ProgramVariants`, `init` switches to a kernel specialized for the dimensions of the point cloud.
+     */
+    class ICPLMsGrid
+    {
+    public:
+        /*! \brief Enumerates the memory objects handled by the class.
+         *  \note `H_*` names refer to staging buffers on the host.
+         *  \note `D_*` names refer to buffers on the device.
+         */
+        enum class Memory : uint8_t
+        {
+            H_IN,   /*!< Input staging buffer for the 8-D point cloud. */
+            H_OUT,  /*!< Output staging buffer for the landmarks. */
+            D_IN,   /*!< Input buffer for the 8-D point cloud. */
+            D_OUT   /*!< Output buffer for the landmarks. */
+        };
+
+        /*! \brief Configures an OpenCL environment as specified by `_info`. */
+        ICPLMsGrid (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool = nullptr, 
+                    ProgramVariants *_variants = nullptr);
+        /*! \brief Returns a reference to an internal memory object. */
+        cl::Memory& get (ICPLMsGrid::Memory mem);
+        /*! \brief Configures kernel execution parameters. */
+        void init (unsigned int _width, unsigned int _height, unsigned int _side, Staging _staging = Staging::IO);
+        /*! \brief Performs a data transfer to a device buffer. */
+        void write (ICPLMsGrid::Memory mem = ICPLMsGrid::Memory::D_IN, void *ptr = nullptr, bool block = CL_FALSE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Performs a data transfer to a staging buffer. */
+        void* read (ICPLMsGrid::Memory mem = ICPLMsGrid::Memory::H_OUT, bool block = CL_TRUE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Executes the necessary kernels. */
+        void run (const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Chooses the side of the landmark grid for a resolution. */
+        static unsigned int getSide (unsigned int width, unsigned int height);
+
+        cl_float *hPtrIn;   /*!< Mapping of the input staging buffer for the 8-D point cloud. */
+        cl_float *hPtrOut;  /*!< Mapping of the output staging buffer for the landmarks. */
+
+    private:
+        clutils::CLEnv &env;
+        clutils::CLEnvInfo<1> info;
+        cl::Context context;
+        cl::CommandQueue queue;
+        cl::Kernel kernel;
+        cl::NDRange global;
+        Staging staging;
+        unsigned int width, height, side;
+        unsigned int bufferInSize, bufferOutSize;
+        cl::Buffer hBufferIn, hBufferOut;
+        cl::Buffer dBufferIn, dBufferOut;
+        PooledBuffers pooled;
+        ProgramVariants *variants;
+
+    public:
+        /*! \brief Executes the necessary kernels.
+         *  \details This `run` instance is used for profiling.
+         *  
+         *  \param[in] timer `GPUTimer` that does the profiling of the kernel executions.
+         *  \param[in] events a wait-list of events.
+         *  \return Τhe total execution time measured by the timer.
+         */
+        template <typename period>
+        double run (clutils::GPUTimer<period> &timer, const std::vector<cl::Event> *events = nullptr)
+        {
+            queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, cl::NullRange, events, &timer.event ());
+            queue.flush (); timer.wait ();
+
+            return timer.duration ();
+        }
+
+    };
+
+    /*! \brief Interface class for the `linearOctreeQuery` kernel.
+     *  \details `linearOctreeQuery` looks up the log-odds of a batch of points in a 
+     *           `LinearOctree`, by binary search over the Morton codes of its leaves. 
+     *           For more details, look at the kernel's documentation.
+     *  \note The `linearOctreeQuery` kernel is available in `kernels/slam_kernels.cl`.
+     *  \note The class creates its own buffers. If you would like to provide 
+     *        your own buffers, call `get` to get references to the placeholders 
+     *        within the class and assign them to your buffers. You will have to 
+     *        do this strictly before the call to `init`. You can also call `get` 
+     *        (after the call to `init`) to get a reference to a buffer within 
+     *        the class and assign it to another kernel class instance further 
+     *        down in your task pipeline.
+     *  \note The octree is copied to the device by `upload`, and stays there, 
+     *        for any number of batches, until the next `upload`.
+     *  \note Zero-copy staging is not supported, and it falls back to `Staging::IO`.
+     *  
+     *        The following input/output `OpenCL` memory objects are created by a `LinearOctreeQuery` instance:<br>
+     *        | Name | Type | Placement | I/O | Use | Properties | Size |
+     *        | ---  |:---: |   :---:   |:---:|:---:|   :---:    |:---: |
+     *        | H_IN     | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$n*sizeof\ (cl\_float4)\f$ |
+     *        | H_OUT    | Buffer | Host   | O | Staging     | CL_MEM_READ_WRITE | \f$n*sizeof\ (cl\_float) \f$ |
+     *        | D_CODES  | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$leaves*sizeof\ (cl\_ulong)\f$ |
+     *        | D_LEVELS | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$leaves*sizeof\ (cl\_uchar)\f$ |
+     *        | D_VALUES | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$leaves*sizeof\ (cl\_float)\f$ |
+     *        | D_IN     | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$n*sizeof\ (cl\_float4)\f$ |
+     *        | D_OUT    | Buffer | Device | O | Processing  | CL_MEM_WRITE_ONLY | \f$n*sizeof\ (cl\_float) \f$ |
+     */
+    class LinearOctreeQuery
+    {
+    public:
+        /*! \brief Enumerates the memory objects handled by the class.
+         *  \note `H_*` names refer to staging buffers on the host.
+         *  \note `D_*` names refer to buffers on the device.
+         */
+        enum class Memory : uint8_t
+        {
+            H_IN,      /*!< Input staging buffer for the points. */
+            H_OUT,     /*!< Output staging buffer for the log-odds. */
+            D_CODES,   /*!< Input buffer for the Morton codes of the leaves. */
+            D_LEVELS,  /*!< Input buffer for the levels of the leaves. */
+            D_VALUES,  /*!< Input buffer for the log-odds of the leaves. */
+            D_IN,      /*!< Input buffer for the points. */
+            D_OUT      /*!< Output buffer for the log-odds. */
+        };
+
+        /*! \brief Configures an OpenCL environment as specified by `_info`. */
+        LinearOctreeQuery (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool = nullptr);
+        /*! \brief Returns a reference to an internal memory object. */
+        cl::Memory& get (LinearOctreeQuery::Memory mem);
+        /*! \brief Configures kernel execution parameters. */
+        void init (unsigned int _n, Staging _staging = Staging::IO);
+        /*! \brief Copies an octree to the device. */
+        void upload (const LinearOctree &tree, bool block = CL_TRUE, 
+                     const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Performs a data transfer to a device buffer. */
+        void write (LinearOctreeQuery::Memory mem = LinearOctreeQuery::Memory::D_IN, void *ptr = nullptr, bool block = CL_FALSE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Performs a data transfer to a staging buffer. */
+        void* read (LinearOctreeQuery::Memory mem = LinearOctreeQuery::Memory::H_OUT, bool block = CL_TRUE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Executes the necessary kernels. */
+        void run (const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+
+        cl_float *hPtrIn;   /*!< Mapping of the input staging buffer for the points. */
+        cl_float *hPtrOut;  /*!< Mapping of the output staging buffer for the log-odds. */
+
+    private:
+        clutils::CLEnv &env;
+        clutils::CLEnvInfo<1> info;
+        cl::Context context;
+        cl::CommandQueue queue;
+        cl::Kernel kernel;
+        cl::NDRange global;
+        Staging staging;
+        unsigned int n, leaves;
+        unsigned int bufferInSize, bufferOutSize;
+        cl::Buffer hBufferIn, hBufferOut;
+        cl::Buffer dBufferCodes, dBufferLevels, dBufferValues, dBufferIn, dBufferOut;
+        PooledBuffers pooled;
+
+    public:
+        /*! \brief Executes the necessary kernels.
+         *  \details This `run` instance is used for profiling.
+         *  
+         *  \param[in] timer `GPUTimer` that does the profiling of the kernel executions.
+         *  \param[in] events a wait-list of events.
+         *  \return Τhe total execution time measured by the timer.
+         */
+        template <typename period>
+        double run (clutils::GPUTimer<period> &timer, const std::vector<cl::Event> *events = nullptr)
+        {
+            queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, cl::NullRange, events, &timer.event ());
+            queue.flush (); timer.wait ();
+
+            return timer.duration ();
+        }
+
+    };
+
+    /*! \brief Interface class for the `rayCastBricks` kernel.
+     *  \details `rayCastBricks` casts a batch of rays against the occupied cells of the 
+     *           map, in one dispatch. The cells are mirrored on the device from a `BrickMap`, 
+     *           and `update` transfers only the bricks that changed since the last call. 
+     *           For more details, look at the kernel's documentation.
+     *  \note The `rayCastBricks` kernel is available in `kernels/slam_kernels.cl`.
+     *  \note The class creates its own buffers. If you would like to provide 
+     *        your own buffers, call `get` to get references to the placeholders 
+     *        within the class and assign them to your buffers. You will have to 
+     *        do this strictly before the call to `init`. You can also call `get` 
+     *        (after the call to `init`) to get a reference to a buffer within 
+     *        the class and assign it to another kernel class instance further 
+     *        down in your task pipeline.
+     *  \note The mirror is the only consumer of the changes of the `BrickMap`, 
+     *        and it has to be updated at least once before the first `run`.
+     *  \note Zero-copy staging is not supported, and it falls back to `Staging::IO`.
+     *  
+     *        The following input/output `OpenCL` memory objects are created by a `RayCastService` instance:<br>
+     *        | Name | Type | Placement | I/O | Use | Properties | Size |
+     *        | ---  |:---: |   :---:   |:---:|:---:|   :---:    |:---: |
+     *        | H_IN_O        | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$n*sizeof\ (cl\_float4)\f$ |
+     *        | H_IN_D        | Buffer | Host   | I | Staging     | CL_MEM_READ_WRITE | \f$n*sizeof\ (cl\_float4)\f$ |
+     *        | H_OUT         | Buffer | Host   | O | Staging     | CL_MEM_READ_WRITE | \f$n*sizeof\ (cl\_float4)\f$ |
+     *        | D_SLOT_CODES  | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$slots*sizeof\ (cl\_ulong)\f$ |
+     *        | D_SLOT_BRICKS | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$slots*sizeof\ (cl\_uint)\f$ |
+     *        | D_BRICKS      | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$16*bricks*sizeof\ (cl\_uint)\f$ |
+     *        | D_IN_O        | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$n*sizeof\ (cl\_float4)\f$ |
+     *        | D_IN_D        | Buffer | Device | I | Processing  | CL_MEM_READ_ONLY  | \f$n*sizeof\ (cl\_float4)\f$ |
+     *        | D_OUT         | Buffer | Device | O | Processing  | CL_MEM_WRITE_ONLY | \f$n*sizeof\ (cl\_float4)\f$ |
+     */
+    class RayCastService
+    {
+    public:
+        /*! \brief Enumerates the memory objects handled by the class.
+         *  \note `H_*` names refer to staging buffers on the host.
+         *  \note `D_*` names refer to buffers on the device.
+         */
+        enum class Memory : uint8_t
+        {
+            H_IN_O,         /*!< Input staging buffer for the origins of the rays. */
+            H_IN_D,         /*!< Input staging buffer for the directions of the rays. */
+            H_OUT,          /*!< Output staging buffer for the hits. */
+            D_SLOT_CODES,   /*!< Input buffer for the block codes of the slots of the table. */
+            D_SLOT_BRICKS,  /*!< Input buffer for the brick indices of the slots of the table. */
+            D_BRICKS,       /*!< Input buffer for the bricks. */
+            D_IN_O,         /*!< Input buffer for the origins of the rays. */
+            D_IN_D,         /*!< Input buffer for the directions of the rays. */
+            D_OUT           /*!< Output buffer for the hits. */
+        };
+
+        /*! \brief Configures an OpenCL environment as specified by `_info`. */
+        RayCastService (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool = nullptr);
+        /*! \brief Returns a reference to an internal memory object. */
+        cl::Memory& get (RayCastService::Memory mem);
+        /*! \brief Configures kernel execution parameters. */
+        void init (unsigned int _n, float _maxRange = 10.f, Staging _staging = Staging::IO);
+        /*! \brief Transfers the changes of a `BrickMap` to the device. */
+        size_t update (BrickMap &bricks);
+        /*! \brief Performs a data transfer to a device buffer. */
+        void write (RayCastService::Memory mem = RayCastService::Memory::D_IN_O, void *ptr = nullptr, bool block = CL_FALSE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Performs a data transfer to a staging buffer. */
+        void* read (RayCastService::Memory mem = RayCastService::Memory::H_OUT, bool block = CL_TRUE, 
+                    const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+        /*! \brief Executes the necessary kernels. */
+        void run (const std::vector<cl::Event> *events = nullptr, cl::Event *event = nullptr);
+
+        cl_float *hPtrInO;  /*!< Mapping of the input staging buffer for the origins of the rays. */
+        cl_float *hPtrInD;  /*!< Mapping of the input staging buffer for the directions of the rays. */
+        cl_float *hPtrOut;  /*!< Mapping of the output staging buffer for the hits. */
+
+    private:
+        clutils::CLEnv &env;
+        clutils::CLEnvInfo<1> info;
+        cl::Context context;
+        cl::CommandQueue queue;
+        cl::Kernel kernel;
+        cl::NDRange global;
+        Staging staging;
+        unsigned int n;
+        float maxRange;
+        size_t brickCapacity;  // Bricks that fit in the device buffer
+        BrickMap::Delta delta;
+        unsigned int bufferSize;
+        cl::Buffer hBufferInO, hBufferInD, hBufferOut;
+        cl::Buffer dBufferSlotCodes, dBufferSlotBricks, dBufferBricks;
+        cl::Buffer dBufferInO, dBufferInD, dBufferOut;
+        PooledBuffers pooled;
 
     public:
         /*! \brief Executes the necessary kernels.
@@ -0,0 +1,105 @@
+/*! \file batched_update.hpp
+ *  \brief Declares an accumulator that merges the occupancy updates of several point clouds.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_BATCHED_UPDATE_HPP
+#define OCLSLAM_BATCHED_UPDATE_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <mutex>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Integrates point clouds into a map in batches.
+     *  \details Consecutive point clouds mostly observe the same cells, and every 
+     *           cell update walks the tree from the root. Instead, the cells every 
+     *           point cloud marks as free or occupied (from its own origin) are 
+     *           counted in a hash map, and, once `frames` point clouds have been 
+     *           added, each cell gets a single update with the summed log-odds. 
+     *           So the tree is walked once per cell, rather than once per cell 
+     *           per point cloud.
+     *  \note The result matches the integration of the point clouds one by one, 
+     *        apart from cells that reach a clamping threshold and then turn back 
+     *        within a batch, since a batch gets clamped only once, as a sum.
+     */
+    class BatchedUpdate
+    {
+    public:
+        /*! \brief Statistics of the integration. */
+        struct Stats
+        {
+            uint64_t frames;        /*!< Point clouds added. */
+            uint64_t batches;       /*!< Batches applied. */
+            uint64_t cellUpdates;   /*!< Cell updates the point clouds would take one by one. */
+            uint64_t treeUpdates;   /*!< Cell updates applied to the map. */
+        };
+
+        /*! \brief Configures the batches. */
+        BatchedUpdate (size_t _frames = 1);
+        /*! \brief Sets the number of point clouds in a batch (up to 65535). */
+        void setFrames (size_t _frames);
+        /*! \brief Gets the number of point clouds in a batch. */
+        size_t getFrames () const;
+        /*! \brief Counts the cells a point cloud observes. */
+        void add (octomap::OcTree &map, const octomap::Pointcloud &pc, const octomap::point3d &origin, 
+                  double maxRange = -1.0, bool discretize = true);
+        /*! \brief Indicates whether a batch is complete. */
+        bool isReady () const;
+        /*! \brief Gets the bounding box of the cells counted so far. */
+        bool getBounds (const octomap::OcTree &map, octomap::point3d &min, octomap::point3d &max) const;
+        /*! \brief Applies the counted cells to the map, and starts a new batch. */
+        size_t apply (octomap::OcTree &map, bool lazy = false);
+        /*! \brief Gets the statistics of the integration. */
+        Stats getStats () const;
+
+    private:
+        /*! \brief Number of times a cell was observed free and occupied. */
+        struct Count
+        {
+            uint16_t free, occupied;
+        };
+
+        size_t frames, pending;
+        std::unordered_map<octomap::OcTreeKey, Count, octomap::OcTreeKey::KeyHash> counts;
+        octomap::OcTreeKey keyMin, keyMax;
+        octomap::KeySet freeCells, occupiedCells;  // Reused between point clouds
+        Stats stats;
+        mutable std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_BATCHED_UPDATE_HPP
@@ -0,0 +1,136 @@
+/*! \file brick_map.hpp
+ *  \brief Declares a sparse set of bricks with the occupied cells of the map.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_BRICK_MAP_HPP
+#define OCLSLAM_BRICK_MAP_HPP
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Keeps the occupied cells of the map in bricks, for the device.
+     *  \details The map is divided into blocks of 8x8x8 cells, and every block 
+     *           with an occupied cell gets a brick, 512 occupancy bits. The bricks 
+     *           are found through an open-addressing hash table on the code of 
+     *           their block. Both are flat arrays, to be mirrored on a device 
+     *           (by `RayCastService`), and the hash function is shared with the 
+     *           kernel.
+     *  \details The set is built once, from all the occupied leaves, on the first 
+     *           update after it's enabled. From then on, the map records the cells 
+     *           that change, and only those are updated. The bricks that change, 
+     *           and the table when it grows, are marked, so that the mirror gets 
+     *           only the changes.
+     *  \note The bricks are never freed. A block that gets cleared keeps an empty brick.
+     *  \note The map's change detection is shared with other consumers (e.g. 
+     *        `FrontierSet`), so the set doesn't reset it. Whoever owns the 
+     *        map resets it, after all of them have been updated.
+     */
+    class BrickMap
+    {
+    public:
+        /*! \brief The changes of the set since they were last taken. */
+        struct Delta
+        {
+            bool table;                        /*!< Indicates whether the table changed (and is included). */
+            unsigned int tableBits;            /*!< log2 of the number of slots of the table. */
+            std::vector<uint64_t> slotCodes;   /*!< Block codes of the slots (`emptySlot` for free slots). */
+            std::vector<uint32_t> slotBricks;  /*!< Brick indices of the slots. */
+            size_t bricks;                     /*!< Number of bricks in the set. */
+            std::vector<uint32_t> indices;     /*!< Indices of the changed bricks, in ascending order. */
+            std::vector<uint32_t> words;       /*!< Bits of the changed bricks, `brickWords` per brick. */
+        };
+
+        /*! \brief Statistics of the set. */
+        struct Stats
+        {
+            size_t bricks;     /*!< Bricks allocated. */
+            size_t cells;      /*!< Occupied cells. */
+            uint64_t updates;  /*!< Updates applied. */
+            uint64_t changes;  /*!< Cells that changed state in total. */
+        };
+
+        static const unsigned int brickWords = 16;  /*!< 32-bit words in a brick. */
+        static const uint64_t emptySlot = ~uint64_t (0);  /*!< Code of a free slot. */
+
+        /*! \brief Creates a disabled set. */
+        BrickMap ();
+        /*! \brief Enables or disables the set. */
+        void setEnabled (bool flag);
+        /*! \brief Indicates whether the set is enabled. */
+        bool isEnabled () const;
+        /*! \brief Updates the cells of the map that changed. */
+        size_t update (octomap::OcTree &map);
+        /*! \brief Indicates whether the cell that contains a point is occupied. */
+        bool isOccupied (const octomap::point3d &p) const;
+        /*! \brief Gets the resolution of the map. */
+        double getResolution () const;
+        /*! \brief Gets the key of the origin of the map. */
+        int getKeyOffset () const;
+        /*! \brief Takes the changes since the last call. */
+        void takeDelta (Delta &delta, bool all = false);
+        /*! \brief Gets the statistics of the set. */
+        Stats getStats () const;
+        /*! \brief Gets the code of a block (the key of a cell shifted by 3). */
+        static uint64_t blockCode (const octomap::OcTreeKey &key);
+        /*! \brief Gets the first slot to probe for a block. */
+        static uint32_t hash (uint64_t code, unsigned int bits);
+
+    private:
+        bool set (const octomap::OcTreeKey &key, bool occupied);
+        int64_t find (uint64_t code) const;
+        uint32_t insert (uint64_t code);
+        void grow ();
+
+        bool enabled, built;
+        double resolution;
+        int keyOffset;  // Key of the origin of the map
+        unsigned int tableBits;
+        size_t slotsUsed;
+        std::vector<uint64_t> slotCodes;
+        std::vector<uint32_t> slotBricks;
+        std::vector<uint32_t> words;  // brickWords per brick
+        std::vector<uint8_t> dirty;  // Per brick
+        std::vector<uint32_t> dirtyBricks;
+        bool tableDirty;
+        Stats stats;
+        mutable std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_BRICK_MAP_HPP
@@ -29,6 +29,7 @@
 #ifndef OCLSLAM_COMMON_HPP
 #define OCLSLAM_COMMON_HPP
 
+#include <CLUtils.hpp>
 
 namespace cl_algo
 {
@@ -45,9 +46,25 @@ namespace oclslam
         NONE,  /*!< Do not instantiate any staging buffers. */
         I,     /*!< Instantiate the input staging buffers. */
         O,     /*!< Instantiate the output staging buffers. */
-        IO     /*!< Instantiate both input and output staging buffers. */
+        IO,    /*!< Instantiate both input and output staging buffers. */
+        ZC     /*!< Zero-copy. On a device with unified memory, the device buffers 
+                *   are allocated in host-visible memory, and they get mapped, instead 
+                *   of copied, on `read`/`write`. Anywhere else, it falls back to `IO`. */
     };
 
+
+    /*! \brief Indicates whether a device shares its physical memory with the host, 
+     *         as integrated GPUs and CPU devices do.
+     *
+     *  \param[in] device OpenCL device.
+     *  \return The flag.
+     */
+    inline bool hasUnifiedMemory (const cl::Device &device)
+    {
+        return device.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY> () || 
+               (device.getInfo<CL_DEVICE_TYPE> () & CL_DEVICE_TYPE_CPU);
+    }
+
 }
 }
 
@@ -0,0 +1,353 @@
+/*! \file algorithms.hpp
+ *  \brief Declares the classes of the native `CPU` backend of the `%OCLSLAM` pipeline.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_CPU_ALGORITHMS_HPP
+#define OCLSLAM_CPU_ALGORITHMS_HPP
+
+#include <cstdint>
+#include <vector>
+#include <eigen3/Eigen/Dense>
+#include <oclslam/cpu/thread_pool.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+/*! \brief Offers a native implementation of the `%OCLSLAM` pipeline, for machines without 
+ *         an OpenCL device, and as a baseline for the OpenCL implementation.
+ *  \details Every class stands in for the OpenCL stage of the same name, and follows the 
+ *           same data layout, i.e. planar RGB and depth frames, and 8-D points (homogeneous 
+ *           coordinates in mm + RGBA values) with a zero depth marking an invalid point. 
+ *           The loops are split over a `ThreadPool`, and the compute bound ones are written 
+ *           with the vector types of the library, so they run on `AVX2` or `NEON` when the 
+ *           target supports them. The buffers are plain host arrays, owned by the caller, 
+ *           so the library has no OpenCL dependency.
+ */
+namespace cpu
+{
+
+    /*! \brief Returns the instruction set the backend was built for, i.e. `AVX2`, `NEON`, or `scalar`. */
+    const char* getInstructionSet ();
+
+
+    /*! \brief Converts a depth frame to floating-point values.
+     *  \details Stands in for `GF::Depth<GF::DepthConfig::USHORT_FLOAT>`.
+     */
+    class Depth
+    {
+    public:
+        /*! \brief Constructor. */
+        Depth (ThreadPool &pool);
+        /*! \brief Configures the stage. */
+        void init (unsigned int _n, float _scaling = 1.f);
+        /*! \brief Converts the frame, \f$ out = scaling \cdot in \f$. */
+        void run (const uint16_t *in, float *out);
+        /*! \brief Gets the scaling factor. */
+        float getScaling () { return scaling; }
+        /*! \brief Sets the scaling factor. */
+        void setScaling (float _scaling) { scaling = _scaling; }
+
+    private:
+        ThreadPool &pool;
+        unsigned int n;
+        float scaling;
+
+    };
+
+
+    /*! \brief Separates the channels of an RGB frame, and normalizes them to `[0,1]`.
+     *  \details Stands in for `GF::SeparateRGB<GF::SeparateRGBConfig::UCHAR_FLOAT>`.
+     */
+    class SeparateRGB
+    {
+    public:
+        /*! \brief Constructor. */
+        SeparateRGB (ThreadPool &pool);
+        /*! \brief Configures the stage. */
+        void init (unsigned int _n);
+        /*! \brief Separates the channels of an interleaved 8-bit RGB frame. */
+        void run (const uint8_t *in, float *outR, float *outG, float *outB);
+
+    private:
+        ThreadPool &pool;
+        unsigned int n;
+
+    };
+
+
+    /*! \brief Back-projects an RGB-D frame into an 8-D point cloud.
+     *  \details Stands in for `GF::RGBDTo8D`. A pixel \f$ (u,v) \f$ with depth \f$ d \f$ 
+     *           maps to \f$ \left[ \begin{matrix} (u - c_x) d/f & (v - c_y) d/f & d & 1 & 
+     *           r & g & b & 1 \end{matrix} \right] \f$, where \f$ (c_x,c_y) \f$ is the 
+     *           center of the frame. With the RGB normalization on, the colors are 
+     *           divided by their sum.
+     */
+    class RGBDTo8D
+    {
+    public:
+        /*! \brief Constructor. */
+        RGBDTo8D (ThreadPool &pool);
+        /*! \brief Configures the stage. */
+        void init (unsigned int _width, unsigned int _height, float _f, float _scaling = 1.f, int _rgbNorm = 1);
+        /*! \brief Computes the point cloud. */
+        void run (const float *inD, const float *inR, const float *inG, const float *inB, float *out);
+        /*! \brief Gets the focal length. */
+        float getFocalLength () { return f; }
+        /*! \brief Sets the focal length. */
+        void setFocalLength (float _f) { f = _f; }
+        /*! \brief Gets the status of the RGB normalization. */
+        int getRGBNorm () { return rgbNorm; }
+        /*! \brief Sets the status of the RGB normalization. */
+        void setRGBNorm (int _rgbNorm) { rgbNorm = _rgbNorm; }
+
+    private:
+        ThreadPool &pool;
+        unsigned int width, height;
+        float f, scaling;
+        int rgbNorm;
+
+    };
+
+
+    /*! \brief Samples the landmarks of a point cloud.
+     *  \details Stands in for `ICP::ICPLMs`. The landmarks are the points at the 
+     *           centers of the cells of a `side` x `side` grid laid over the frame.
+     */
+    class ICPLMs
+    {
+    public:
+        /*! \brief Constructor. */
+        ICPLMs (ThreadPool &pool);
+        /*! \brief Configures the stage. */
+        void init (unsigned int _width, unsigned int _height, unsigned int _side = 128);
+        /*! \brief Samples the landmarks. */
+        void run (const float *in, float *out);
+
+    private:
+        ThreadPool &pool;
+        unsigned int width, height, side;
+
+    };
+
+
+    /*! \brief Random ball cover, for nearest neighbor queries on 8-D points.
+     *  \details It's the exact variant. A set of representatives is drawn from the 
+     *           database, and every point is assigned to its nearest representative. 
+     *           A query searches the list of its nearest representative, and then 
+     *           only the lists that the triangle inequality can't rule out. The distance 
+     *           is \f$ \|p_{xyz} - q_{xyz}\|^2 + \alpha \|p_{rgb} - q_{rgb}\|^2 \f$. 
+     *           The representatives and the lists are kept in planar form, 
+     *           padded to the vector width, so every search is a vector loop.
+     */
+    class RBC
+    {
+    public:
+        /*! \brief Constructor. */
+        RBC (ThreadPool &pool);
+        /*! \brief Builds the data structure on a set of 8-D points. */
+        void build (const float *X, unsigned int m, unsigned int r, float a);
+        /*! \brief Finds the nearest neighbor of an 8-D point. */
+        unsigned int query (const float *q, float &dist) const;
+        /*! \brief Finds the nearest neighbors of a set of 8-D points. */
+        void query (const float *Q, unsigned int n, unsigned int *idx, float *dist);
+        /*! \brief Returns the number of representatives. */
+        unsigned int getRepresentatives () const { return r; }
+
+        static const unsigned int none = 0xFFFFFFFF;  /*!< Index reported when there's no neighbor. */
+
+    private:
+        ThreadPool &pool;
+        unsigned int r;      // Number of representatives
+        size_t rStride;      // Padded number of representatives
+        size_t lStride;      // Padded total length of the lists
+        float a;
+        std::vector<float> reps;           // Planar xyzrgb representatives
+        std::vector<float> lists;          // Planar xyzrgb lists, one after the other
+        std::vector<uint32_t> listIdx;     // Indices of the list points in the database
+        std::vector<size_t> offsets;       // Start of every list, plus the end of the last one
+        std::vector<float> radii;          // Largest distance (not squared) of a list point to its representative
+
+    };
+
+
+    /*! \brief Registers two sets of 8-D landmarks, with an `ICP` on top of an `RBC`.
+     *  \details Stands in for `ICP::ICP`. It finds the similarity transformation, 
+     *           \f$ T(p) = sRp + t \f$, that maps the moving landmarks onto the fixed 
+     *           ones. Every iteration associates the landmarks through the `RBC`, 
+     *           and solves for the increment in closed form, with the quaternion 
+     *           method of Horn. The statistics are accumulated in double precision, 
+     *           so, unlike on the device, the deviations need no scaling.
+     */
+    class ICP
+    {
+    public:
+        /*! \brief Constructor. */
+        ICP (ThreadPool &pool);
+        /*! \brief Configures the registration. */
+        void init (unsigned int _m, unsigned int _r, float _a, unsigned int _maxIterations, 
+                   double _angleThreshold, double _translationThreshold);
+        /*! \brief Builds the `RBC` on the fixed landmarks. */
+        void buildRBC (const float *F);
+        /*! \brief Registers the moving landmarks onto the fixed ones. */
+        unsigned int run (const float *M);
+        /*! \brief Gets the parameter \f$ \alpha \f$ of the `RBC` distance. */
+        float getAlpha () { return a; }
+        /*! \brief Sets the parameter \f$ \alpha \f$ of the `RBC` distance. */
+        void setAlpha (float _a) { a = _a; }
+        /*! \brief Gets the maximum number of iterations. */
+        unsigned int getMaxIterations () { return maxIterations; }
+        /*! \brief Sets the maximum number of iterations. */
+        void setMaxIterations (unsigned int _maxIterations) { maxIterations = _maxIterations; }
+        /*! \brief Gets the angle threshold (in degrees) for the convergence check. */
+        double getAngleThreshold () { return angleThreshold; }
+        /*! \brief Sets the angle threshold (in degrees) for the convergence check. */
+        void setAngleThreshold (double at) { angleThreshold = at; }
+        /*! \brief Gets the translation threshold (in mm) for the convergence check. */
+        double getTranslationThreshold () { return translationThreshold; }
+        /*! \brief Sets the translation threshold (in mm) for the convergence check. */
+        void setTranslationThreshold (double tt) { translationThreshold = tt; }
+
+        Eigen::Matrix3f R;  /*!< Estimated rotation. */
+        Eigen::Vector3f t;  /*!< Estimated translation (in mm). */
+        float s;            /*!< Estimated scale. */
+
+    private:
+        ThreadPool &pool;
+        RBC rbc;
+        const float *F;
+        unsigned int m, r;
+        float a;
+        unsigned int maxIterations;
+        double angleThreshold, translationThreshold;
+
+    };
+
+
+    /*! \brief Transforms an 8-D point cloud, \f$ p' = sR(q)p + t \f$.
+     *  \details Stands in for `ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>`.
+     */
+    class ICPTransform
+    {
+    public:
+        /*! \brief Constructor. */
+        ICPTransform (ThreadPool &pool);
+        /*! \brief Configures the stage. */
+        void init (unsigned int _n);
+        /*! \brief Sets the transformation. */
+        void setTransformation (const Eigen::Quaternionf &q, const Eigen::Vector3f &_t, float _s);
+        /*! \brief Transforms the point cloud. */
+        void run (const float *in, float *out);
+
+    private:
+        ThreadPool &pool;
+        unsigned int n;
+        Eigen::Matrix3f R;
+        Eigen::Vector3f t;
+        float s;
+
+    };
+
+
+    /*! \brief Splits an 8-D point cloud into 3-D coordinates (in meters) and 8-bit RGB values.
+     *  \details Stands in for `oclslam::SplitPC8D`, and produces the input of `OctoMap`.
+     */
+    class SplitPC8D
+    {
+    public:
+        /*! \brief Constructor. */
+        SplitPC8D (ThreadPool &pool);
+        /*! \brief Configures the stage. */
+        void init (unsigned int _n);
+        /*! \brief Splits the point cloud. */
+        void run (const float *in, float *outPC3D, uint8_t *outRGB);
+
+    private:
+        ThreadPool &pool;
+        unsigned int n;
+
+    };
+
+
+    /*! \brief Chains the `CPU` stages into the registration part of the `SLAM` pipeline.
+     *  \details Every pair of frames goes through the depth conversion, the RGB separation, 
+     *           the back-projection, and the landmark sampling. The landmarks are registered 
+     *           against those of the previous frame, and the point cloud is transformed by 
+     *           the resulting global pose and split for `OctoMap`.
+     */
+    class Pipeline
+    {
+    public:
+        /*! \brief Constructor. */
+        Pipeline (unsigned int _width, unsigned int _height, unsigned int threads = 0);
+        /*! \brief Processes a pair of frames. */
+        unsigned int process (const uint8_t *rgb, const uint16_t *depth);
+        /*! \brief Resets the global pose, and the registration history. */
+        void reset ();
+        /*! \brief Returns the latest point cloud, in the global coordinate frame. */
+        const float* getPointCloud () const { return pcT.data (); }
+        /*! \brief Returns the coordinates (in meters) of the latest point cloud, in the global coordinate frame. */
+        const float* getPointCloud3D () const { return pc3D.data (); }
+        /*! \brief Returns the 8-bit RGB values of the latest point cloud. */
+        const uint8_t* getRGB () const { return rgb3D.data (); }
+        /*! \brief Returns the number of points in a point cloud. */
+        unsigned int getPoints () const { return n; }
+        /*! \brief Returns the thread pool of the stages. */
+        ThreadPool& getPool () { return pool; }
+
+        Eigen::Matrix3f R_g;  /*!< Orientation with respect to the global coordinate frame. */
+        Eigen::Vector3f t_g;  /*!< Translation (in mm) with respect to the global coordinate frame. */
+        float s_g;            /*!< Scale with respect to the first point cloud. */
+        unsigned int timeStep;  /*!< Number of frames processed. */
+        double lPre;     /*!< Latency (in ms) of the stages before the ICP. */
+        double lICP;     /*!< Latency (in ms) of the ICP. */
+        double latency;  /*!< Latency (in ms) of the latest time step. */
+
+        ThreadPool pool;
+        Depth convD;
+        SeparateRGB sepRGB;
+        RGBDTo8D to8D;
+        ICPLMs lm;
+        ICP icp;
+        ICPTransform transform;
+        SplitPC8D sp8D;
+
+    private:
+        unsigned int width, height, n, m;
+        std::vector<float> bufferD, bufferR, bufferG, bufferB;
+        std::vector<float> pc, pcT, lmsF, lmsM, pc3D;
+        std::vector<uint8_t> rgb3D;
+
+    };
+
+}
+}
+}
+
+#endif  // OCLSLAM_CPU_ALGORITHMS_HPP
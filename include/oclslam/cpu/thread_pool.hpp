@@ -0,0 +1,97 @@
+/*! \file thread_pool.hpp
+ *  \brief Declares a pool of worker threads for the `CPU` backend.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_CPU_THREAD_POOL_HPP
+#define OCLSLAM_CPU_THREAD_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+namespace cpu
+{
+
+    /*! \brief A fixed set of worker threads that split loops into chunks.
+     *  \details A loop of `n` iterations is cut into chunks of `grain` iterations, 
+     *           and the workers, along with the calling thread, pull chunks off 
+     *           a shared counter until none is left. The chunks are the same on 
+     *           every call, so the index of a chunk, `begin / grain`, can address 
+     *           per chunk partial results.
+     *  \note `parallelFor` is not reentrant. A function running on the pool 
+     *        must not call back into it.
+     */
+    class ThreadPool
+    {
+    public:
+        /*! \brief Starts the worker threads. */
+        ThreadPool (unsigned int threads = 0);
+        /*! \brief Stops the worker threads. */
+        ~ThreadPool ();
+        ThreadPool (const ThreadPool &) = delete;
+        ThreadPool& operator= (const ThreadPool &) = delete;
+        /*! \brief Returns the number of threads that take part in a loop. */
+        unsigned int size () const { return workers.size () + 1; }
+        /*! \brief Returns the number of chunks a loop is cut into. */
+        static size_t getChunks (size_t n, size_t grain) { return (n + grain - 1) / grain; }
+        /*! \brief Runs a loop over `[0, n)` on the pool, and blocks until it's done. */
+        void parallelFor (size_t n, size_t grain, const std::function<void (size_t, size_t)> &func);
+
+    private:
+        void work ();
+        void runChunks ();
+
+        std::vector<std::thread> workers;
+        std::mutex callMtx;  // Serializes the loops issued from different threads
+        std::mutex mtx;
+        std::condition_variable cvWork, cvDone;
+        const std::function<void (size_t, size_t)> *job;
+        size_t jobSize, jobGrain;
+        std::atomic<size_t> next;
+        unsigned int active;  // Workers still on the current loop
+        uint64_t generation;  // Counts the loops
+        std::exception_ptr error;
+        bool quit;
+
+    };
+
+}
+}
+}
+
+#endif  // OCLSLAM_CPU_THREAD_POOL_HPP
@@ -0,0 +1,105 @@
+/*! \file distance_field.hpp
+ *  \brief Declares a Euclidean distance field that follows the changes of the map.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_DISTANCE_FIELD_HPP
+#define OCLSLAM_DISTANCE_FIELD_HPP
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+#include <dynamicEDT3D/dynamicEDTOctomap.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Maintains the distance to the nearest obstacle, within a bounding box of the map.
+     *  \details The field is a `DynamicEDTOctomap`, built on the first update after 
+     *           the bounds are set. From then on, the map records the cells whose 
+     *           occupancy changes, and every update propagates only those changes 
+     *           through the field, instead of recomputing it from scratch.
+     *  \note The queries don't touch the map, so they can be answered on any thread, 
+     *        concurrently with the mapping. They wait only while an update is applied.
+     */
+    class DistanceField
+    {
+    public:
+        /*! \brief Statistics of the field. */
+        struct Stats
+        {
+            uint64_t updates;  /*!< Updates applied. */
+            uint64_t changes;  /*!< Changed cells propagated in total. */
+        };
+
+        /*! \brief Configures the field. */
+        DistanceField (float _maxDist = 2.f);
+        /*! \brief Sets the region of the map the field covers. */
+        void setBounds (const octomap::point3d &_min, const octomap::point3d &_max, bool _unknownAsOccupied = false);
+        /*! \brief Indicates whether bounds have been set. */
+        bool isEnabled () const;
+        /*! \brief Propagates the changes of the map into the field. */
+        void update (octomap::OcTree &map);
+        /*! \brief Gets the distance (in meters) of a point to the nearest obstacle. */
+        float getDistance (const octomap::point3d &p) const;
+        /*! \brief Gets the distance (in meters) of a point to the nearest obstacle, and the obstacle. */
+        float getDistance (const octomap::point3d &p, octomap::point3d &obstacle) const;
+        /*! \brief Gets the distances (in meters) of a set of points to their nearest obstacles. */
+        void getDistances (const std::vector<octomap::point3d> &points, std::vector<float> &distances) const;
+        /*! \brief Gets the gradient of the distance at a point. */
+        bool getGradient (const octomap::point3d &p, octomap::point3d &gradient) const;
+        /*! \brief Gets the distance (in meters) at which the field saturates. */
+        float getMaxDistance () const { return maxDist; }
+        /*! \brief Gets the statistics of the field. */
+        Stats getStats () const;
+
+        /*! \brief Distance returned for the points out of the field. */
+        static const float unknown;
+
+    private:
+        float lookup (const octomap::point3d &p) const;
+
+        float maxDist;
+        octomap::point3d bbxMin, bbxMax;
+        bool unknownAsOccupied, configured;
+        double resolution;
+        std::unique_ptr<DynamicEDTOctomap> edt;
+        octomap::OcTree *source;  // The map the field was built on
+        Stats stats;
+        mutable std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_DISTANCE_FIELD_HPP
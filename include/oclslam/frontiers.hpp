@@ -0,0 +1,114 @@
+/*! \file frontiers.hpp
+ *  \brief Declares a set of frontier cells that follows the changes of the map.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_FRONTIERS_HPP
+#define OCLSLAM_FRONTIERS_HPP
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Maintains the frontier of the map, the free cells next to unknown space.
+     *  \details The set is built once, from all the leaves of the map, on the 
+     *           first update after it's enabled. From then on, the map records 
+     *           the cells that change state or get observed for the first time, 
+     *           and every update re-examines only those and their 6 neighbors. 
+     *           So the cost of an update follows the changes, not the map.
+     *  \note The frontier cells get grouped into regions (26-connected), when 
+     *        the regions are queried after a change. The queries don't touch 
+     *        the map, so they can be answered on any thread.
+     *  \note The map's change detection is shared with other consumers (e.g. 
+     *        `DistanceField`), so the set doesn't reset it. Whoever owns the 
+     *        map resets it, after all of them have been updated.
+     */
+    class FrontierSet
+    {
+    public:
+        /*! \brief A connected region of frontier cells. */
+        struct Region
+        {
+            octomap::point3d centroid;  /*!< Mean position (in meters) of the cells. */
+            octomap::point3d min, max;  /*!< Bounding box (in meters) of the cell centers. */
+            size_t size;                /*!< Number of cells. */
+        };
+
+        /*! \brief Statistics of the set. */
+        struct Stats
+        {
+            size_t cells;      /*!< Frontier cells. */
+            uint64_t updates;  /*!< Updates applied. */
+            uint64_t checked;  /*!< Cells re-examined in total. */
+        };
+
+        /*! \brief Creates a disabled set. */
+        FrontierSet ();
+        /*! \brief Enables or disables the set. */
+        void setEnabled (bool flag);
+        /*! \brief Indicates whether the set is enabled. */
+        bool isEnabled () const;
+        /*! \brief Re-examines the cells of the map that changed. */
+        size_t update (octomap::OcTree &map);
+        /*! \brief Indicates whether the cell that contains a point is a frontier cell. */
+        bool isFrontier (const octomap::point3d &p) const;
+        /*! \brief Gets the centers of the frontier cells. */
+        void getCells (std::vector<octomap::point3d> &centers) const;
+        /*! \brief Gets the regions of frontier cells, largest first. */
+        void getRegions (std::vector<Region> &regions, size_t minSize = 1) const;
+        /*! \brief Gets the region with the nearest centroid to a point. */
+        bool getNearestRegion (const octomap::point3d &p, Region &region, size_t minSize = 1) const;
+        /*! \brief Gets the statistics of the set. */
+        Stats getStats () const;
+
+    private:
+        bool check (const octomap::OcTree &map, const octomap::OcTreeKey &key) const;
+        octomap::point3d toCoord (const octomap::OcTreeKey &key) const;
+        void cluster () const;
+
+        bool enabled, built;
+        double resolution;
+        int keyOffset;  // Key of the origin of the map
+        octomap::KeySet cells;
+        mutable std::vector<Region> regions;  // Cached, until the cells change
+        mutable bool clustered;
+        Stats stats;
+        mutable std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_FRONTIERS_HPP
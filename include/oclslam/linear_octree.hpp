@@ -0,0 +1,146 @@
+/*! \file linear_octree.hpp
+ *  \brief Declares a pointerless, Morton-ordered copy of the map for bulk queries.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_LINEAR_OCTREE_HPP
+#define OCLSLAM_LINEAR_OCTREE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief A linear octree, the leaves of the map in Morton order, without pointers.
+     *  \details Every leaf is stored as the Morton code of its first cell, its 
+     *           level (the log2 of its side in cells), and its log-odds, in three 
+     *           arrays sorted by code. A leaf covers the `8^level` codes that 
+     *           follow its own, so the leaf that contains a cell is the last one 
+     *           with a code no greater than the cell's, found by search instead 
+     *           of by descending the tree.
+     *  \details The inner nodes at `blockLevel` are summarized by the range of 
+     *           their leaves, the number of known cells, and the maximum log-odds. 
+     *           The ray marching steps over the blocks that can't stop a ray 
+     *           (free and fully known) in one step.
+     *  \note The interleaving puts `x` in the lowest bit, like the child index 
+     *        of the `OcTree`, so the order is the depth-first order of the map.
+     *  \note The arrays are laid out to be copied as they are to a device 
+     *        (e.g. by `LinearOctreeQuery`). They're a snapshot, and don't follow 
+     *        the map; export a new copy after the map changes.
+     */
+    class LinearOctree
+    {
+    public:
+        /*! \brief The result of a ray cast. */
+        struct RayHit
+        {
+            bool hit;              /*!< Indicates whether an occupied cell was hit. */
+            octomap::point3d end;  /*!< Center of the occupied (or unknown) cell, or the end of the ray. */
+        };
+
+        /*! \brief Creates an empty octree. */
+        LinearOctree (unsigned int _blockLevel = 3);
+        /*! \brief Exports the leaves of a map. */
+        void build (const octomap::OcTree &map);
+        /*! \brief Indicates whether the octree has no leaves. */
+        bool empty () const { return codes.empty (); }
+        /*! \brief Gets the number of leaves. */
+        size_t size () const { return codes.size (); }
+        /*! \brief Gets the resolution of the map. */
+        double getResolution () const { return resolution; }
+        /*! \brief Gets the key of the origin of the map. */
+        int getKeyOffset () const { return keyOffset; }
+        /*! \brief Gets the occupancy threshold (in log-odds) of the map. */
+        float getOccupancyThresLog () const { return thresLog; }
+        /*! \brief Gets the Morton codes of the leaves (sorted). */
+        const std::vector<uint64_t>& getCodes () const { return codes; }
+        /*! \brief Gets the levels of the leaves. */
+        const std::vector<uint8_t>& getLevels () const { return levels; }
+        /*! \brief Gets the log-odds of the leaves. */
+        const std::vector<float>& getValues () const { return values; }
+        /*! \brief Gets the number of block summaries. */
+        size_t getBlockCount () const { return blocks.size (); }
+        /*! \brief Gets the memory (in bytes) taken by the arrays. */
+        size_t memoryUsage () const;
+        /*! \brief Finds the leaf that contains a cell. */
+        bool search (const octomap::OcTreeKey &key, float &logOdds) const;
+        /*! \brief Finds the leaf that contains a point. */
+        bool search (const octomap::point3d &p, float &logOdds) const;
+        /*! \brief Looks up the log-odds of a batch of points (`NAN` for unknown). */
+        void query (const std::vector<octomap::point3d> &points, std::vector<float> &logOdds) const;
+        /*! \brief Casts a ray, until it hits an occupied (or unknown) cell. */
+        bool castRay (const octomap::point3d &origin, const octomap::point3d &direction, 
+                      octomap::point3d &end, bool ignoreUnknown = false, double maxRange = -1.0) const;
+        /*! \brief Casts a batch of rays. */
+        void castRays (const std::vector<octomap::point3d> &origins, 
+                       const std::vector<octomap::point3d> &directions, std::vector<RayHit> &hits, 
+                       double maxRange = -1.0, bool ignoreUnknown = false) const;
+        /*! \brief Writes the octree to a file. */
+        bool write (const std::string &filename) const;
+        /*! \brief Reads an octree from a file. */
+        bool read (const std::string &filename);
+        /*! \brief Interleaves the bits of a key into a Morton code. */
+        static uint64_t encode (const octomap::OcTreeKey &key);
+        /*! \brief Separates the bits of a Morton code into a key. */
+        static octomap::OcTreeKey decode (uint64_t code);
+
+    private:
+        /*! \brief Summary of an inner node at `blockLevel`. */
+        struct Block
+        {
+            uint64_t code;   // Morton code of the node, shifted by 3*blockLevel
+            uint32_t first;  // Index of the first leaf
+            uint32_t cells;  // Known cells
+            float maxLogOdds;
+        };
+
+        size_t find (uint64_t code, size_t lo = 0) const;
+        const Block* findBlock (uint64_t code) const;
+        void summarize ();
+
+        unsigned int blockLevel;
+        double resolution;
+        float thresLog;
+        int keyOffset;  // Key of the origin of the map
+        octomap::OcTreeKey keyMin, keyMax;  // Bounding box of the leaves (in cells)
+        std::vector<uint64_t> codes;
+        std::vector<uint8_t> levels;
+        std::vector<float> values;
+        std::vector<Block> blocks;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_LINEAR_OCTREE_HPP
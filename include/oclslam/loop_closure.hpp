@@ -0,0 +1,140 @@
+/*! \file loop_closure.hpp
+ *  \brief Declares classes for detecting loop closures and correcting the trajectory.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_LOOP_CLOSURE_HPP
+#define OCLSLAM_LOOP_CLOSURE_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <eigen3/Eigen/Dense>
+#include <oclslam/pose_graph.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Represents a keyframe of the trajectory. */
+    struct Keyframe
+    {
+        unsigned int id;                      /*!< Index of the keyframe (and its node in the pose graph). */
+        unsigned int timeStep;                /*!< Number of point clouds registered, up to the keyframe. */
+        Pose pose;                            /*!< Pose estimated by the odometry at the time of capture. */
+        std::vector<float> descriptor;        /*!< Compact appearance descriptor. */
+        std::vector<Eigen::Vector3f> cloud;   /*!< Sparse point cloud in the sensor coordinate frame (in mm). */
+    };
+
+
+    /*! \brief Computes the descriptor of an organized point cloud.
+     *  \details The descriptor is a thumbnail of the depth image, with each element
+     *           holding the mean depth of a block of pixels. It's normalized to zero
+     *           mean and unit length, so two descriptors are compared by their dot product.
+     */
+    std::vector<float> computeDescriptor (const float *pc3d, unsigned int width, unsigned int height,
+                                          const Pose &pose, unsigned int block = 32);
+
+    /*! \brief Samples a sparse point cloud (in the sensor coordinate frame) from an organized point cloud. */
+    std::vector<Eigen::Vector3f> sampleCloud (const float *pc3d, unsigned int width, unsigned int height,
+                                              const Pose &pose, unsigned int stride = 8);
+
+    /*! \brief Aligns two sparse point clouds with point-to-point ICP. */
+    bool alignPointClouds (const std::vector<Eigen::Vector3f> &fixed, const std::vector<Eigen::Vector3f> &moving,
+                           Pose &T, float maxDistance, unsigned int maxIterations, float &rms, float &inlierRatio);
+
+
+    /*! \brief Detects loop closures and optimizes the trajectory.
+     *  \details Keyframes are handed over to a background thread. For every new
+     *           keyframe, the thread inserts a node in a pose graph, connected by
+     *           an odometry edge to the previous keyframe, and then looks for past
+     *           keyframes that look alike. The best candidates are verified geometrically
+     *           with ICP, and a successful alignment adds a loop edge to the graph and
+     *           triggers an optimization. The corrected poses are published at the end.
+     */
+    class LoopClosure
+    {
+    public:
+        /*! \brief Constructor. Starts the detection thread. */
+        LoopClosure ();
+        /*! \brief Destructor. Stops the detection thread. */
+        ~LoopClosure ();
+        /*! \brief Queues a keyframe for processing. */
+        unsigned int addKeyframe (unsigned int timeStep, const Pose &pose,
+                                  std::vector<float> &&descriptor, std::vector<Eigen::Vector3f> &&cloud);
+        /*! \brief Applies the latest correction to a pose estimated by the odometry. */
+        Pose correct (const Pose &pose);
+        /*! \brief Returns the corrected poses of the keyframes. */
+        std::vector<Pose> getCorrectedPoses ();
+        /*! \brief Returns the number of keyframes. */
+        size_t getNumKeyframes ();
+        /*! \brief Returns the number of loop closures detected. */
+        unsigned int getNumLoops () { return numLoops; }
+        /*! \brief Sets the minimum number of keyframes between two keyframes for them to be considered for a loop. */
+        void setMinSeparation (unsigned int sep) { minSeparation = sep; }
+        /*! \brief Sets the minimum descriptor similarity for a keyframe to be considered a loop candidate. */
+        void setMinSimilarity (float sim) { minSimilarity = sim; }
+        /*! \brief Sets the radius (in mm) around the current position within which to look for loop candidates (0 for no limit). */
+        void setSearchRadius (float radius) { searchRadius = radius; }
+        /*! \brief Sets the maximum RMS error (in mm) of the geometric verification. */
+        void setMaxRMS (float rms) { maxRMS = rms; }
+        /*! \brief Sets the minimum inlier ratio of the geometric verification. */
+        void setMinInlierRatio (float ratio) { minInlierRatio = ratio; }
+
+    private:
+        void _detect ();
+        void _process (const Keyframe &kf);
+
+        std::deque<Keyframe> keyframes;  // References remain valid on insertion
+        std::deque<unsigned int> pending;
+        std::vector<const Keyframe *> processed;  // Accessed only by the detection thread
+        PoseGraph graph;
+        std::vector<Pose> corrected;
+        Pose lastPose;  // Odometry pose of the latest processed keyframe
+        volatile unsigned int numLoops;
+
+        unsigned int minSeparation;
+        float minSimilarity;
+        float searchRadius;
+        float maxRMS;
+        float minInlierRatio;
+
+        std::mutex kfMtx;    // Controls access to the keyframes and the queue
+        std::mutex poseMtx;  // Controls access to the corrected poses
+        std::condition_variable cv;
+        bool running;
+        std::thread worker;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_LOOP_CLOSURE_HPP
@@ -0,0 +1,116 @@
+/*! \file map_maintenance.hpp
+ *  \brief Declares a worker that keeps a lazily updated map consistent and compact.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_MAP_MAINTENANCE_HPP
+#define OCLSLAM_MAP_MAINTENANCE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Computes the bounding box of the rays of a point cloud. */
+    void computeBounds (const octomap::Pointcloud &pc, const octomap::point3d &origin, double maxRange, 
+                        octomap::point3d &min, octomap::point3d &max);
+
+
+    /*! \brief Keeps a map that is integrated with lazy evaluation up to date.
+     *  \details When point clouds are inserted with `lazy_eval` set, only the 
+     *           leaves get updated, and the inner nodes are left stale. The map 
+     *           records the subtrees (at `subtreeDepth`) that every integration 
+     *           touched, and, during idle time, recomputes the inner occupancy, 
+     *           and prunes, only those subtrees and their ancestors. So the cost 
+     *           of the maintenance depends on the region that was updated, not 
+     *           on the size of the map.
+     *  \note The worker takes the map only when no one else holds it, and 
+     *        processes up to `budget` subtrees each time, so it doesn't delay 
+     *        the integration of the next point cloud.
+     */
+    class MapMaintenance
+    {
+    public:
+        /*! \brief Statistics of the map and the maintenance. */
+        struct Stats
+        {
+            size_t nodes;       /*!< Nodes in the map. */
+            size_t memory;      /*!< Approximate memory (in bytes) held by the map. */
+            uint64_t passes;    /*!< Maintenance passes performed. */
+            uint64_t subtrees;  /*!< Subtrees refreshed in total. */
+            uint64_t pruned;    /*!< Nodes collapsed in total. */
+        };
+
+        /*! \brief Configures the maintenance. */
+        MapMaintenance (unsigned int _subtreeDepth = 10, size_t _budget = 64);
+        /*! \brief Stops the worker. */
+        ~MapMaintenance ();
+        /*! \brief Starts a worker that maintains a map in the background. */
+        void start (octomap::OcTree &_map, std::mutex &_mapMtx, double period = 0.05);
+        /*! \brief Stops the worker. */
+        void stop ();
+        /*! \brief Records the subtrees touched by the integration of a point cloud. */
+        void touch (const octomap::OcTree &map, const octomap::Pointcloud &pc, 
+                    const octomap::point3d &origin, double maxRange = -1.0);
+        /*! \brief Records the subtrees within a bounding box. */
+        void touch (const octomap::OcTree &map, const octomap::point3d &min, const octomap::point3d &max);
+        /*! \brief Refreshes the recorded subtrees of a map. */
+        size_t run (octomap::OcTree &map, size_t _budget = 0);
+        /*! \brief Gets the number of subtrees waiting to be refreshed. */
+        size_t getPending () const;
+        /*! \brief Gets the statistics, as of the last pass. */
+        Stats getStats () const;
+
+    private:
+        size_t refresh (octomap::OcTree &map, octomap::OcTreeNode *node);
+        void work (double period);
+
+        unsigned int subtreeDepth;
+        size_t budget;
+        octomap::KeySet pending;  // Subtree keys, adjusted at subtreeDepth
+        Stats stats;
+        octomap::OcTree *map;
+        std::mutex *mapMtx;
+        std::thread worker;
+        bool running;
+        std::condition_variable cv;
+        mutable std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_MAP_MAINTENANCE_HPP
@@ -0,0 +1,158 @@
+/*! \file map_server.hpp
+ *  \brief Declares a server that publishes snapshots of the map for concurrent queries.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_MAP_SERVER_HPP
+#define OCLSLAM_MAP_SERVER_HPP
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Gives readers access to the map while it's being built.
+     *  \details The changes of the map are recorded by the thread that integrates 
+     *           the point clouds, while it holds the map, and they get applied to 
+     *           a new immutable snapshot every so often, once the map is released. 
+     *           Readers only take the latest snapshot (a shared pointer copy), and 
+     *           query it without any locks, so they never wait for the integration, 
+     *           and the integration never waits for them. A snapshot lives for as 
+     *           long as someone holds it.
+     *  \note Every snapshot gets an epoch, one more than the previous one, 
+     *        so readers can tell whether the map has changed since their last 
+     *        query. All the queries of a batch run on the same snapshot.
+     *  \note Recording costs as much as the cells that changed. The server keeps 
+     *        the previous snapshot, and once no reader holds it, it brings it up 
+     *        to date with the changes and publishes it again. Otherwise, it has 
+     *        to copy the whole latest snapshot, so `period` bounds that cost. 
+     *        Either way, the map isn't held for it. The server holds up to two 
+     *        copies of the map, besides the ones the readers hold.
+     */
+    class MapServer
+    {
+    public:
+        /*! \brief An immutable copy of the map. */
+        struct Snapshot
+        {
+            std::shared_ptr<const octomap::OcTree> map;  /*!< The map, `nullptr` before the first publication. */
+            uint64_t epoch;                              /*!< Number of the publication. */
+        };
+
+        /*! \brief Occupancy state of a point. */
+        enum class Occupancy : uint8_t
+        {
+            UNKNOWN,  /*!< The point hasn't been observed. */
+            FREE,     /*!< The point has been observed free. */
+            OCCUPIED  /*!< The point has been observed occupied. */
+        };
+
+        /*! \brief Result of a ray cast. */
+        struct RayHit
+        {
+            bool hit;               /*!< Whether an occupied cell was hit. */
+            octomap::point3d end;   /*!< Center of the cell that was hit, or where the ray ended. */
+        };
+
+        /*! \brief A leaf of the map. */
+        struct Leaf
+        {
+            octomap::point3d center;  /*!< Center of the leaf (in meters). */
+            double size;              /*!< Side of the leaf (in meters). */
+            float logOdds;            /*!< Occupancy of the leaf, in log-odds. */
+        };
+
+        /*! \brief Sets the minimum time between two snapshots. */
+        MapServer (double period = 1.0);
+        /*! \brief Records the cells of the map that changed. */
+        void record (octomap::OcTree &map);
+        /*! \brief Records nodes that were deleted from the map. */
+        void erase (const std::vector<std::pair<octomap::OcTreeKey, unsigned int>> &nodes);
+        /*! \brief Publishes a snapshot of the map, if the period has elapsed. */
+        bool publish (bool force = false);
+        /*! \brief Gets the latest snapshot. */
+        Snapshot getSnapshot () const;
+        /*! \brief Gets the epoch of the latest snapshot. */
+        uint64_t getEpoch () const { return getSnapshot ().epoch; }
+        /*! \brief Gets the minimum time (in seconds) between two snapshots. */
+        double getPeriod () const { return period.count (); }
+        /*! \brief Sets the minimum time (in seconds) between two snapshots. */
+        void setPeriod (double _period);
+
+        /*! \brief Looks up the occupancy at a batch of points. */
+        uint64_t queryOccupancy (const std::vector<octomap::point3d> &points, 
+                                 std::vector<Occupancy> &states) const;
+        /*! \brief Casts a batch of rays. */
+        uint64_t castRays (const std::vector<octomap::point3d> &origins, 
+                           const std::vector<octomap::point3d> &directions, 
+                           std::vector<RayHit> &hits, double maxRange = -1.0, 
+                           bool ignoreUnknown = false) const;
+        /*! \brief Collects the leaves within a bounding box. */
+        uint64_t queryBox (const octomap::point3d &min, const octomap::point3d &max, 
+                           std::vector<Leaf> &leaves, bool occupiedOnly = true) const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        /*! \brief A change of the map. */
+        struct Change
+        {
+            octomap::OcTreeKey key;  /*!< Key of the node. */
+            unsigned int depth;      /*!< Depth of the node, `0` for the maximum depth. */
+            float logOdds;           /*!< Occupancy of the node, in log-odds. */
+            bool erased;             /*!< Whether the node was deleted. */
+        };
+
+        /*! \brief Applies a list of changes to a tree. */
+        static void apply (octomap::OcTree &tree, const std::vector<Change> &changes);
+
+        Snapshot latest;
+        std::shared_ptr<octomap::OcTree> current;  // The tree of `latest`
+        std::shared_ptr<octomap::OcTree> spare;    // The previous snapshot, to be recycled
+        std::vector<Change> lag;                   // Changes from `spare` to `current`
+        std::vector<Change> pending;               // Changes since `current`
+        bool recording;
+        Clock::time_point lastPublished;
+        std::chrono::duration<double> period;
+        std::mutex publishMtx;   // Serializes the publications
+        mutable std::mutex mtx;  // Guards the swapping of `latest`, and the changes
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_MAP_SERVER_HPP
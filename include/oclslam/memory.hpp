@@ -0,0 +1,155 @@
+/*! \file memory.hpp
+ *  \brief Declares classes for managing the device memory of the pipeline.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_MEMORY_HPP
+#define OCLSLAM_MEMORY_HPP
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <CLUtils.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Keeps device buffers around for reuse, binned by size class.
+     *  \details A request is rounded up to its size class, and served from the 
+     *           buffers of that class that have been released earlier. Only when 
+     *           there are none is a new buffer allocated. The classes split every 
+     *           power of two in four, so a buffer is at most 25% larger than requested.
+     *  \note The pool has to outlive the buffers it hands out, and the classes that 
+     *        draw from it. It's safe to use from multiple threads.
+     */
+    class BufferPool
+    {
+    public:
+        /*! \brief Configures the pool for a context. */
+        BufferPool (const cl::Context &_context, cl_mem_flags _flags = CL_MEM_READ_WRITE);
+        /*! \brief Rounds a size up to its size class. */
+        static size_t getSizeClass (size_t size);
+        /*! \brief Gets a buffer of at least `size` bytes. */
+        cl::Buffer acquire (size_t size);
+        /*! \brief Returns a buffer to the pool. */
+        void release (const cl::Buffer &buffer);
+        /*! \brief Frees the buffers that are not in use. */
+        void trim ();
+        /*! \brief Gets the number of bytes allocated on the device. */
+        size_t getAllocatedSize ();
+        /*! \brief Gets the number of bytes handed out. */
+        size_t getInUseSize ();
+        /*! \brief Gets the number of device allocations performed so far. */
+        unsigned int getAllocations ();
+
+    private:
+        cl::Context context;
+        cl_mem_flags flags;
+        std::mutex mtx;
+        std::map<size_t, std::vector<cl::Buffer>> freeBuffers;  // Size class -> Released buffers
+        std::map<cl_mem, size_t> usedBuffers;  // Buffer -> Size class
+        size_t allocated, inUse;
+        unsigned int allocations;
+
+    };
+
+
+    /*! \brief Keeps track of the buffers that a class has drawn from a `BufferPool`.
+     *  \details On re-initialization, a buffer that is still large enough is kept, 
+     *           and a smaller one is swapped for one of the right size class. The 
+     *           buffers are returned to the pool on destruction.
+     *  \note Without a pool, the buffers are allocated directly on the context.
+     */
+    class PooledBuffers
+    {
+    public:
+        /*! \brief Configures the pool to draw from, if any. */
+        PooledBuffers (BufferPool *_pool = nullptr) : pool (_pool) {}
+        /*! \brief Returns the buffers to the pool. */
+        ~PooledBuffers () { releaseAll (); }
+        /*! \brief Makes sure a buffer holds at least `size` bytes. */
+        void ensure (cl::Buffer &buffer, const cl::Context &context, cl_mem_flags flags, size_t size);
+        /*! \brief Returns all the buffers to the pool. */
+        void releaseAll ();
+
+    private:
+        BufferPool *pool;
+        std::vector<std::pair<cl::Buffer, size_t>> owned;  // Buffer and its capacity
+
+    };
+
+
+    /*! \brief Lets buffers that are never live at the same time share device memory.
+     *  \details Every buffer is declared with its size and the interval of steps (e.g. the 
+     *           kernels of a time step, in the order they get enqueued) during which it's 
+     *           live, from the step that writes it to the last step that reads it. Buffers 
+     *           with disjoint intervals get assigned to the same slot, and every slot is 
+     *           backed by a single buffer from a `BufferPool`.
+     *  \note The aliased buffers have to be used through a single in-order command queue, 
+     *        or the steps have to be synchronized otherwise.
+     */
+    class BufferPlanner
+    {
+    public:
+        /*! \brief Describes the size and the lifetime of a buffer. */
+        struct Interval
+        {
+            size_t size;         /*!< Size in bytes. */
+            unsigned int first;  /*!< Step that writes the buffer. */
+            unsigned int last;   /*!< Last step that reads the buffer. */
+        };
+
+        /*! \brief Declares a buffer, and returns an id for it. */
+        unsigned int add (size_t size, unsigned int first, unsigned int last);
+        /*! \brief Assigns the buffers to slots, and acquires the slots from a pool. */
+        void plan (BufferPool &pool);
+        /*! \brief Gets the buffer with the requested id. */
+        cl::Buffer& get (unsigned int id) { return slots[assignment[id]]; }
+        /*! \brief Returns the slots to the pool, and forgets the declared buffers. */
+        void release (BufferPool &pool);
+        /*! \brief Gets the total size of the declared buffers. */
+        size_t getRequestedSize ();
+        /*! \brief Gets the total size of the slots. */
+        size_t getPlannedSize ();
+        /*! \brief Assigns a set of buffers to slots, and returns the slot of every buffer. */
+        static std::vector<unsigned int> assignSlots (const std::vector<Interval> &buffers, 
+                                                      std::vector<size_t> &slotSizes);
+
+    private:
+        std::vector<Interval> buffers;
+        std::vector<unsigned int> assignment;
+        std::vector<size_t> slotSizes;
+        std::vector<cl::Buffer> slots;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_MEMORY_HPP
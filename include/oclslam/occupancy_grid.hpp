@@ -0,0 +1,124 @@
+/*! \file occupancy_grid.hpp
+ *  \brief Declares a 2-D occupancy grid that follows a height band of the map.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_OCCUPANCY_GRID_HPP
+#define OCLSLAM_OCCUPANCY_GRID_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Projects a height band of the map onto a 2-D occupancy grid.
+     *  \details A column of the grid is occupied if any cell of the map within 
+     *           the band is occupied, free if it has only free cells, and unknown 
+     *           otherwise. The map records the regions every integration touched, 
+     *           and an update recomputes only the columns in them, with a single 
+     *           pass over the leaves in the band. The grid is stored in square 
+     *           tiles, each one a row-major array, and the tiles that change are 
+     *           marked dirty, so that a consumer copies only what's new.
+     *  \note The band is measured along the `axis` (`0`, `1`, or `2`, for x, y, or z) 
+     *        of the map, and the grid spans the next two, in cyclic order 
+     *        (y-z, z-x, or x-y, respectively).
+     */
+    class OccupancyGrid2D
+    {
+    public:
+        /*! \brief Values of the cells, as in a ROS `OccupancyGrid`. */
+        enum Cell : int8_t
+        {
+            UNKNOWN = -1, 
+            FREE = 0, 
+            OCCUPIED = 100
+        };
+
+        /*! \brief Index of a tile, along the two axes of the grid. */
+        typedef std::pair<int, int> TileIndex;
+
+        /*! \brief Statistics of the grid. */
+        struct Stats
+        {
+            size_t tiles;      /*!< Tiles in the grid. */
+            uint64_t updates;  /*!< Updates applied. */
+            uint64_t columns;  /*!< Columns recomputed in total. */
+        };
+
+        /*! \brief Configures the tiles. */
+        OccupancyGrid2D (unsigned int _tileSize = 64);
+        /*! \brief Sets the height band, and enables the grid. */
+        void setBand (double _min, double _max, unsigned int _axis = 2);
+        /*! \brief Indicates whether the band has been set. */
+        bool isEnabled () const;
+        /*! \brief Records the columns within a bounding box of the map. */
+        void touch (const octomap::point3d &min, const octomap::point3d &max);
+        /*! \brief Recomputes the recorded columns. */
+        size_t update (const octomap::OcTree &map);
+        /*! \brief Gets the value of the column that contains a point. */
+        Cell getCell (const octomap::point3d &p) const;
+        /*! \brief Gets the side (in cells) of the tiles. */
+        unsigned int getTileSize () const { return tileSize; }
+        /*! \brief Gets the whole grid, as a row-major array. */
+        bool getGrid (std::vector<int8_t> &cells, unsigned int &width, unsigned int &height, 
+                      double &originU, double &originV) const;
+        /*! \brief Gets a tile, as a row-major array. */
+        bool getTile (const TileIndex &idx, std::vector<int8_t> &cells, double &originU, double &originV) const;
+        /*! \brief Gets the tiles that changed since the last call, and clears their marks. */
+        std::vector<TileIndex> takeDirtyTiles ();
+        /*! \brief Gets the statistics of the grid. */
+        Stats getStats () const;
+
+    private:
+        TileIndex getTileIndex (int u, int v) const;
+
+        unsigned int tileSize, axis;
+        double bandMin, bandMax;
+        bool enabled;
+        double resolution;
+        int keyOffset;  // Key of the origin of the map
+        std::vector<std::pair<octomap::point3d, octomap::point3d>> pending;
+        std::map<TileIndex, std::vector<int8_t>> tiles;
+        std::set<TileIndex> dirty;
+        Stats stats;
+        mutable std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_OCCUPANCY_GRID_HPP
@@ -0,0 +1,131 @@
+/*! \file pose_graph.hpp
+ *  \brief Declares classes for representing and optimizing a graph of poses.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_POSE_GRAPH_HPP
+#define OCLSLAM_POSE_GRAPH_HPP
+
+#include <vector>
+#include <eigen3/Eigen/Dense>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Represents a similarity transformation, \f$ T(p) = sRp + t \f$.
+     *  \details It follows the conventions of the `%OCLSLAM` pipeline. A pose
+     *           maps the points of a point cloud (in mm) from the sensor
+     *           coordinate frame to the global coordinate frame.
+     */
+    struct Pose
+    {
+        Pose () : R (Eigen::Matrix3d::Identity ()), t (Eigen::Vector3d::Zero ()), s (1.0) {}
+        Pose (const Eigen::Matrix3d &R, const Eigen::Vector3d &t, double s) : R (R), t (t), s (s) {}
+        Pose (const Eigen::Matrix3f &R, const Eigen::Vector3f &t, float s) :
+            R (R.cast<double> ()), t (t.cast<double> ()), s (s) {}
+
+        /*! \brief Composes two transformations, \f$ (T_a \circ T_b)(p) = T_a(T_b(p)) \f$. */
+        Pose operator* (const Pose &other) const
+        {
+            return Pose (R * other.R, s * R * other.t + t, s * other.s);
+        }
+
+        /*! \brief Transforms a point. */
+        Eigen::Vector3d operator* (const Eigen::Vector3d &p) const { return s * R * p + t; }
+
+        /*! \brief Returns the inverse transformation. */
+        Pose inverse () const
+        {
+            return Pose (R.transpose (), -R.transpose () * t / s, 1.0 / s);
+        }
+
+        Eigen::Matrix3d R;  /*!< Rotation matrix. */
+        Eigen::Vector3d t;  /*!< Translation vector (in mm). */
+        double s;           /*!< Scale. */
+    };
+
+
+    /*! \brief Represents a graph of poses connected by relative pose measurements.
+     *  \details Nodes hold the absolute poses of the keyframes. An edge \f$ (i,j) \f$
+     *           holds a measurement of the relative pose \f$ Z_{ij} = T_i^{-1} \circ T_j \f$,
+     *           i.e. the transformation that maps the points of keyframe \f$ j \f$
+     *           onto the coordinate frame of keyframe \f$ i \f$. The graph is optimized
+     *           with Levenberg-Marquardt on the 7-DoF (rotation, translation, scale)
+     *           parameterization of the nodes. The first node is held fixed.
+     */
+    class PoseGraph
+    {
+    public:
+        /*! \brief Represents a relative pose measurement. */
+        struct Edge
+        {
+            unsigned int i, j;  /*!< Indices of the connected nodes. */
+            Pose Z;             /*!< Relative pose, \f$ Z_{ij} \f$. */
+            double weight;      /*!< Scales the information of the measurement. */
+        };
+
+        /*! \brief Constructor. */
+        PoseGraph (double wR = 1e4, double wT = 1e-2, double wS = 1e4);
+        /*! \brief Adds a node and returns its index. */
+        unsigned int addNode (const Pose &pose);
+        /*! \brief Adds an edge between two nodes. */
+        void addEdge (unsigned int i, unsigned int j, const Pose &Z, double weight = 1.0);
+        /*! \brief Optimizes the poses of the nodes. */
+        double optimize (unsigned int maxIterations = 20);
+        /*! \brief Returns the number of nodes in the graph. */
+        size_t size () const { return nodes.size (); }
+        /*! \brief Returns the pose of a node. */
+        const Pose& getPose (unsigned int i) const { return nodes[i]; }
+        /*! \brief Returns the edges of the graph. */
+        const std::vector<Edge>& getEdges () const { return edges; }
+        /*! \brief Computes the total weighted squared error of the graph. */
+        double error () const;
+
+    private:
+        typedef Eigen::Matrix<double, 7, 1> Vector7d;
+
+        Vector7d residual (const Edge &edge, const Pose &Ti, const Pose &Tj) const;
+
+        std::vector<Pose> nodes;
+        std::vector<Edge> edges;
+        Vector7d info;  // Diagonal information matrix
+
+    };
+
+
+    /*! \brief Applies a 7-DoF increment, \f$ [\omega, \nu, \sigma] \f$, to a pose. */
+    Pose perturb (const Pose &T, const Eigen::Matrix<double, 7, 1> &delta);
+
+    /*! \brief Computes the rotation vector (axis-angle) of a rotation matrix. */
+    Eigen::Vector3d logRotation (const Eigen::Matrix3d &R);
+
+}
+}
+
+#endif  // OCLSLAM_POSE_GRAPH_HPP
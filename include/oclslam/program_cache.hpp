@@ -0,0 +1,170 @@
+/*! \file program_cache.hpp
+ *  \brief Declares a persistent cache of OpenCL program binaries.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_PROGRAM_CACHE_HPP
+#define OCLSLAM_PROGRAM_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <CLUtils.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Describes an OpenCL program, as in the source files and the build options. */
+    struct ProgramSpec
+    {
+        std::vector<std::string> files;  /*!< Kernel source files, in the order they get concatenated. */
+        std::string options;             /*!< Build options. */
+    };
+
+
+    /*! \brief Computes the 64-bit FNV-1a hash of a string.
+     *
+     *  \param[in] data input string.
+     *  \param[in] hash initial value, for hashing a sequence of strings.
+     *  \return The hash.
+     */
+    inline uint64_t fnv1a (const std::string &data, uint64_t hash = 14695981039346656037ULL)
+    {
+        for (unsigned char c : data)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+
+    /*! \brief Hashes the identity of a device, as in its name and vendor, 
+     *         and the device and driver versions. */
+    uint64_t hashDevice (const cl::Device &device);
+
+
+    /*! \brief Builds OpenCL programs, and keeps their binaries on disk.
+     *  \details The binaries are keyed by the device, the driver version, the build 
+     *           options, and a hash of the sources, so any change to either of them 
+     *           leads to a rebuild. Programs that are missing from the cache are 
+     *           built from source concurrently, on separate threads, and their 
+     *           binaries are then stored for the next start.
+     *  \note The cache lives in `$OCLSLAM_CACHE_DIR`, or in `~/.cache/oclslam` 
+     *        if that's not set. An empty directory disables the cache, 
+     *        in which case the programs are just built in parallel.
+     */
+    class ProgramCache
+    {
+    public:
+        /*! \brief Sets the directory of the cache. */
+        ProgramCache (const std::string &_dir = getDefaultDirectory ());
+        /*! \brief Returns the default directory of the cache. */
+        static std::string getDefaultDirectory ();
+        /*! \brief Gets the directory of the cache. */
+        const std::string& getDirectory () { return dir; }
+        /*! \brief Loads a program from the cache, or builds it from source. */
+        cl::Program build (const cl::Context &context, const cl::Device &device, const ProgramSpec &spec);
+        /*! \brief Loads or builds a set of programs, building the missing ones in parallel. */
+        std::vector<cl::Program> build (const cl::Context &context, const cl::Device &device, 
+                                        const std::vector<ProgramSpec> &specs);
+        /*! \brief Gets the number of programs loaded from the cache. */
+        unsigned int getHits () { return hits; }
+        /*! \brief Gets the number of programs built from source. */
+        unsigned int getMisses () { return misses; }
+
+    private:
+        std::string getKey (const cl::Device &device, const ProgramSpec &spec, const std::string &source);
+        bool load (const cl::Context &context, const cl::Device &device, const std::string &key, cl::Program &program);
+        void store (const cl::Device &device, const std::string &key, const cl::Program &program);
+
+        std::string dir;
+        std::atomic<unsigned int> hits, misses;
+
+    };
+
+
+    /*! \brief Adds a set of programs to an OpenCL environment, through a `ProgramCache`. */
+    void addPrograms (clutils::CLEnv &env, unsigned int ctxIdx, const std::vector<ProgramSpec> &specs, 
+                      ProgramCache &cache, const std::string &placeholder, unsigned int devIdx = 0);
+
+
+    /*! \brief Composes a build option that defines a macro as an integer. */
+    std::string defineOption (const std::string &name, unsigned int value);
+    /*! \brief Composes a build option that defines a macro as a float (with every digit it needs). */
+    std::string defineOption (const std::string &name, float value);
+
+
+    /*! \brief Keeps variants of the programs of an OpenCL environment, 
+     *         specialized with compile-time definitions.
+     *  \details Values that stay fixed for a configuration, like the dimensions of 
+     *           the frames, can be defined as macros (`-D`) in place of kernel arguments, 
+     *           so the compiler is able to fold them. A program that gets registered 
+     *           with `add` is rebuilt for every distinct set of definitions requested, 
+     *           once, and the variants are kept for as long as the instance lives. 
+     *           The binaries go through a `ProgramCache`, so a configuration that 
+     *           has been seen before is loaded from disk.
+     *  \note The kernels have to fall back to their arguments when a macro is 
+     *        not defined, since the unspecialized programs get no definitions.
+     */
+    class ProgramVariants
+    {
+    public:
+        /*! \brief Sets the environment that holds the unspecialized programs. */
+        ProgramVariants (clutils::CLEnv &_env, const std::string &cacheDir = ProgramCache::getDefaultDirectory ());
+        /*! \brief Registers the specification of a program, so it can be specialized. */
+        void add (unsigned int pgIdx, unsigned int ctxIdx, const ProgramSpec &spec, unsigned int devIdx = 0);
+        /*! \brief Gets a program specialized with a set of definitions. */
+        cl::Program& get (unsigned int pgIdx, const std::string &defines);
+        /*! \brief Gets the number of variants created. */
+        unsigned int getCount ();
+
+    private:
+        /*! \brief Describes a program that can be specialized. */
+        struct Base
+        {
+            unsigned int ctxIdx, devIdx;
+            ProgramSpec spec;
+        };
+
+        clutils::CLEnv &env;
+        ProgramCache cache;
+        std::map<unsigned int, Base> bases;
+        std::map<std::pair<unsigned int, std::string>, cl::Program> variants;
+        std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_PROGRAM_CACHE_HPP
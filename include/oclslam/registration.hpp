@@ -0,0 +1,62 @@
+/*! \file registration.hpp
+ *  \brief Declares functions for evaluating and applying `ICP` registrations.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_REGISTRATION_HPP
+#define OCLSLAM_REGISTRATION_HPP
+
+#include <eigen3/Eigen/Dense>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Holds the statistics of the residuals of a registration. */
+    struct RegistrationStats
+    {
+        float inlierRatio;  /*!< Fraction of the valid samples that are inliers. */
+        float rmsResidual;  /*!< RMS residual (in mm) of the inliers. */
+    };
+
+    /*! \brief Computes the inlier ratio and the RMS residual of a registration. */
+    RegistrationStats computeRegistrationStats (const float *res, unsigned int samples, 
+                                                float inlierDistance);
+
+    /*! \brief Checks whether a relative motion is within the given bounds. */
+    bool checkMotion (const Eigen::Matrix3f &R, const Eigen::Vector3f &t, float s, 
+                      float maxDistance, float maxAngle, float maxScale);
+
+    /*! \brief Applies a registration to a pose, \f$ T = T_{icp} \circ T \f$. */
+    void applyRegistration (const Eigen::Matrix3f &R_icp, const Eigen::Vector3f &t_icp, float s_icp, 
+                            Eigen::Matrix3f &R, Eigen::Vector3f &t, float &s);
+
+}
+}
+
+#endif  // OCLSLAM_REGISTRATION_HPP
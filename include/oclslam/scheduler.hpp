@@ -0,0 +1,146 @@
+/*! \file scheduler.hpp
+ *  \brief Declares a scheduler that orders the stages of the pipeline by the buffers they access.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_SCHEDULER_HPP
+#define OCLSLAM_SCHEDULER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <CLUtils.hpp>
+#include <oclslam/tracer.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Dispatches the stages of a pipeline, and derives 
+     *         their synchronization from the buffers they access.
+     *  \details Every stage declares the buffers it reads and the buffers it writes. 
+     *           On dispatch, a stage waits for the last writer of the buffers it reads 
+     *           (RAW), and for the last writer and readers of the buffers it writes 
+     *           (WAW, WAR). Dependencies on earlier commands of the same in-order 
+     *           queue are implied, so they are dropped. Stages on different queues, 
+     *           or on an out-of-order queue, overlap whenever the data allow it.
+     *  \note Buffers are identified by their handles, so buffers that alias the same 
+     *        memory, like the ones of a `BufferPlanner`, get ordered correctly.
+     *  \note The stages have to be added in a valid sequential order of the pipeline. 
+     *        The dependencies persist across calls, so work of a previous time step 
+     *        is accounted for, when a stage of the next one reuses its buffers.
+     *  \note While a tracer is recording, every dispatch is recorded under the name of 
+     *        the stage. On an in-order queue, a marker precedes the task, so the entry 
+     *        covers all the commands of the stage, from the point the queue reached it.
+     */
+    class StageGraph
+    {
+    public:
+        StageGraph () : tracer (nullptr) {}
+
+        /*! \brief Enqueues the work of a stage.
+         *  \details It waits on `events`, and returns in `event` 
+         *           the event of the last command it enqueued.
+         */
+        typedef std::function<void (const std::vector<cl::Event> *events, cl::Event *event)> Task;
+
+        /*! \brief Adds a stage to the graph. */
+        unsigned int add (const std::string &name, cl::CommandQueue &queue, Task task, 
+                          const std::vector<cl::Memory> &inputs, const std::vector<cl::Memory> &outputs);
+        /*! \brief Wraps host-driven work, that doesn't take a wait-list, into a task. */
+        static Task fence (cl::CommandQueue &queue, std::function<void ()> work);
+        /*! \brief Sets a tracer to record the dispatches, or `nullptr` for none. */
+        void setTracer (Tracer *tracer) { this->tracer = tracer; }
+        /*! \brief Enables or disables a stage. */
+        void setEnabled (unsigned int stage, bool flag);
+        /*! \brief Indicates whether a stage is enabled. */
+        bool isEnabled (unsigned int stage) { return stages[stage].enabled; }
+        /*! \brief Dispatches a stage, if it's enabled. */
+        void dispatch (unsigned int stage);
+        /*! \brief Dispatches the enabled stages in the range `[first, last]`. */
+        void run (unsigned int first, unsigned int last);
+        /*! \brief Flushes the queues that have work pending. */
+        void flush ();
+        /*! \brief Waits for all the queues to finish. */
+        void finish ();
+        /*! \brief Forgets the recorded buffer accesses. */
+        void reset ();
+        /*! \brief Returns the event of the last dispatch of a stage. */
+        const cl::Event& getEvent (unsigned int stage) { return stages[stage].event; }
+        /*! \brief Returns the stages that the last dispatch of a stage waited on. */
+        const std::vector<unsigned int>& getDependencies (unsigned int stage) { return stages[stage].dependencies; }
+        /*! \brief Returns the name of a stage. */
+        const std::string& getName (unsigned int stage) { return stages[stage].name; }
+        /*! \brief Returns the number of stages. */
+        unsigned int size () { return stages.size (); }
+
+    private:
+        /*! \brief Stage of the pipeline. */
+        struct Stage
+        {
+            std::string name;
+            unsigned int queue;
+            Task task;
+            std::vector<cl_mem> inputs, outputs;
+            bool enabled;
+            cl::Event event;
+            std::vector<unsigned int> dependencies;
+        };
+
+        /*! \brief Command queue that stages are dispatched on. */
+        struct Queue
+        {
+            cl::CommandQueue queue;
+            bool inOrder;
+            bool pending;  // There is work that hasn't been flushed
+        };
+
+        /*! \brief Last accesses to a buffer, as stage indices. */
+        struct Accesses
+        {
+            int writer;
+            std::vector<unsigned int> readers;
+        };
+
+        /*! \brief Registers a queue, if it's not known already. */
+        unsigned int addQueue (cl::CommandQueue &queue);
+        /*! \brief Adds a dependency of `stage` on `other`, unless it's implied. */
+        void depend (unsigned int stage, unsigned int other);
+
+        std::vector<Stage> stages;
+        std::vector<Queue> queues;
+        std::map<cl_mem, Accesses> buffers;
+        Tracer *tracer;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_SCHEDULER_HPP
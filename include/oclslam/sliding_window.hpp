@@ -0,0 +1,104 @@
+/*! \file sliding_window.hpp
+ *  \brief Declares a sliding window that bounds the live map around the sensor.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_SLIDING_WINDOW_HPP
+#define OCLSLAM_SLIDING_WINDOW_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <mutex>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Keeps only the part of the map within a radius of the sensor.
+     *  \details The map is swept whenever the sensor has moved more than `step` 
+     *           since the last sweep. The sweep walks the tree down to nodes of 
+     *           about `step` in size, and every node that lies entirely outside 
+     *           the radius gets its leaves archived, and is then deleted with 
+     *           its whole subtree. So the live map stays bounded, and the cost 
+     *           of a sweep depends on the size of the window, not of the mission.
+     *  \note The archive is a binary file of leaves, appended to on every sweep. 
+     *        Every sweep writes a header, `uint32_t` number of leaves and `float` 
+     *        center (x, y, z, in meters), followed by the leaves, as in `uint16_t` 
+     *        key (x, y, z), `uint8_t` depth, and `float` log-odds, 11 bytes each. 
+     *        Later leaves supersede earlier ones, when a region is revisited.
+     */
+    class SlidingWindow
+    {
+    public:
+        /*! \brief Statistics of the map and the window. */
+        struct Stats
+        {
+            size_t nodes;           /*!< Nodes in the live map. */
+            size_t memory;          /*!< Approximate memory (in bytes) held by the live map. */
+            uint64_t sweeps;        /*!< Sweeps performed. */
+            uint64_t evicted;       /*!< Leaves evicted in total. */
+            uint64_t archiveBytes;  /*!< Bytes written to the archive. */
+        };
+
+        /*! \brief Configures the window. */
+        SlidingWindow (double _radius = 0.0, double _step = 1.0, const std::string &archive = std::string ());
+        /*! \brief Closes the archive. */
+        ~SlidingWindow ();
+        /*! \brief Sets the radius (in meters) of the window. A radius of `0` disables it. */
+        void setRadius (double _radius);
+        /*! \brief Gets the radius (in meters) of the window. */
+        double getRadius () const;
+        /*! \brief Opens a file to archive the evicted leaves in. */
+        bool openArchive (const std::string &filename);
+        /*! \brief Evicts the parts of the map that are out of the window. */
+        size_t update (octomap::OcTree &map, const octomap::point3d &center, bool force = false, 
+                       std::vector<std::pair<octomap::OcTreeKey, unsigned int>> *deleted = nullptr);
+        /*! \brief Gets the statistics, as of the last update. */
+        Stats getStats () const;
+        /*! \brief Loads the leaves of an archive into a map. */
+        static size_t readArchive (const std::string &filename, octomap::OcTree &map);
+
+    private:
+        double radius, step;
+        octomap::point3d lastCenter;
+        bool swept;
+        std::ofstream archive;
+        Stats stats;
+        mutable std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_SLIDING_WINDOW_HPP
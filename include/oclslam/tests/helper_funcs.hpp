@@ -30,7 +30,10 @@
 #define OCLSLAM_HELPERFUNCS_HPP
 
 #include <cassert>
+#include <cmath>
+#include <vector>
 #include <algorithm>
+#include <limits>
 #include <functional>
 #include <RBC/data_types.hpp>
 
@@ -148,6 +151,287 @@ namespace oclslam
         }
     }
 
+    /*! \brief Computes the residual errors of an `ICP` registration.
+     *  \details For a sample of the moving landmarks, transformed by \f$ T \f$, it finds 
+     *           the nearest fixed landmark and reports the squared distance to it.
+     *           It is just a naive serial implementation.
+     *
+     *  \param[in] F array with the fixed landmarks (8-D points).
+     *  \param[in] M array with the moving landmarks (8-D points).
+     *  \param[out] res array with the squared distances (negative for invalid landmarks).
+     *  \param[in] T transformation, \f$ \left[ \begin{matrix} q_x & q_y & q_z & q_w & 
+     *               t_x & t_y & t_z & s \end{matrix} \right] \f$.
+     *  \param[in] m number of landmarks in each set.
+     *  \param[in] samples number of samples.
+     */
+    template <typename T>
+    void cpuICPResiduals (T *F, T *M, T *res, const T *Tr, uint32_t m, uint32_t samples)
+    {
+        const T *q = Tr, *t = Tr + 4;
+        uint32_t stride = m / samples;
+
+        for (uint32_t k = 0; k < samples; ++k)
+        {
+            const T *p = M + 8 * std::min (k * stride, m - 1);
+            if (p[2] == 0) { res[k] = -1; continue; }
+
+            // v' = v + 2w(q x v) + 2q x (q x v)
+            T c[3] = { 2 * (q[1] * p[2] - q[2] * p[1]), 
+                       2 * (q[2] * p[0] - q[0] * p[2]), 
+                       2 * (q[0] * p[1] - q[1] * p[0]) };
+            T qc[3] = { q[1] * c[2] - q[2] * c[1], 
+                        q[2] * c[0] - q[0] * c[2], 
+                        q[0] * c[1] - q[1] * c[0] };
+            T pT[3];
+            for (uint32_t j = 0; j < 3; ++j)
+                pT[j] = Tr[7] * (p[j] + q[3] * c[j] + qc[j]) + t[j];
+
+            T minDist = std::numeric_limits<T>::infinity ();
+            for (uint32_t i = 0; i < m; ++i)
+            {
+                const T *f = F + 8 * i;
+                if (f[2] == 0) continue;
+
+                T d0 = f[0] - pT[0], d1 = f[1] - pT[1], d2 = f[2] - pT[2];
+                minDist = std::min (minDist, d0 * d0 + d1 * d1 + d2 * d2);
+            }
+            res[k] = minDist;
+        }
+    }
+
+    /*! \brief Transforms a point, \f$ p' = s R(q) p + t \f$.
+     *
+     *  \param[in] Tr transformation, \f$ \left[ \begin{matrix} q_x & q_y & q_z & q_w & 
+     *                t_x & t_y & t_z & s \end{matrix} \right] \f$.
+     *  \param[in] p point.
+     *  \param[out] pT transformed point.
+     */
+    template <typename T>
+    void cpuICPTransformPoint (const T *Tr, const T *p, T *pT)
+    {
+        const T *q = Tr;
+
+        // v' = v + 2w(q x v) + 2q x (q x v)
+        T c[3] = { 2 * (q[1] * p[2] - q[2] * p[1]), 
+                   2 * (q[2] * p[0] - q[0] * p[2]), 
+                   2 * (q[0] * p[1] - q[1] * p[0]) };
+        T qc[3] = { q[1] * c[2] - q[2] * c[1], 
+                    q[2] * c[0] - q[0] * c[2], 
+                    q[0] * c[1] - q[1] * c[0] };
+        for (uint32_t j = 0; j < 3; ++j)
+            pT[j] = Tr[7] * (p[j] + q[3] * c[j] + qc[j]) + Tr[4 + j];
+    }
+
+    /*! \brief Performs a device-resident `ICP` registration. 
+     *  \details It's the reference for the `icpAssociate` and `icpSolve` kernels, 
+     *           and it follows the same steps, including the per group statistics.
+     *
+     *  \param[in] F array with the fixed landmarks (8-D points), on a `gw` x `gh` grid.
+     *  \param[in] M array with the moving landmarks (8-D points), on a `gw` x `gh` grid.
+     *  \param[out] Tr the estimated transformation, \f$ \left[ \begin{matrix} q_x & q_y & q_z & q_w & 
+     *                 t_x & t_y & t_z & s \end{matrix} \right] \f$.
+     *  \param[in] gw width of the landmark grid.
+     *  \param[in] gh height of the landmark grid.
+     *  \param[in] radius radius of the search window on the landmark grid.
+     *  \param[in] maxDist maximum distance between two associated landmarks.
+     *  \param[in] maxIterations maximum number of iterations.
+     *  \param[in] angleThreshold angle threshold (in degrees) for the convergence check.
+     *  \param[in] translationThreshold translation threshold for the convergence check.
+     *  \param[in] groupSize number of landmarks in a group.
+     *  \return The number of iterations performed.
+     */
+    template <typename T>
+    unsigned int cpuDeviceICP (T *F, T *M, T *Tr, uint32_t gw, uint32_t gh, int radius, T maxDist, 
+                               uint32_t maxIterations, T angleThreshold, T translationThreshold, 
+                               uint32_t groupSize = 256)
+    {
+        const uint32_t m = gw * gh;
+        const uint32_t groups = m / groupSize;
+        Tr[0] = Tr[1] = Tr[2] = 0; Tr[3] = 1; Tr[4] = Tr[5] = Tr[6] = 0; Tr[7] = 1;
+
+        std::vector<T> pairs (6 * groupSize);
+        std::vector<char> found (groupSize);
+        std::vector<T> sums (18 * groups);
+
+        for (uint32_t iter = 0; iter < maxIterations; ++iter)
+        {
+            // Association ===================================================
+
+            for (uint32_t g = 0; g < groups; ++g)
+            {
+                T *v = sums.data () + 18 * g;
+                std::fill (v, v + 18, (T) 0);
+
+                for (uint32_t l = 0; l < groupSize; ++l)
+                {
+                    uint32_t k = g * groupSize + l;
+                    const T *p = M + 8 * k;
+                    T *pT = pairs.data () + 6 * l, *f = pT + 3;
+                    found[l] = 0;
+                    if (p[2] == 0) continue;
+
+                    cpuICPTransformPoint (Tr, p, pT);
+
+                    int x0 = k % gw, y0 = k / gw;
+                    T minDist = maxDist * maxDist;
+                    for (int y = std::max (y0 - radius, 0); y <= std::min (y0 + radius, (int) gh - 1); ++y)
+                    {
+                        for (int x = std::max (x0 - radius, 0); x <= std::min (x0 + radius, (int) gw - 1); ++x)
+                        {
+                            const T *c = F + 8 * (y * gw + x);
+                            T d0 = c[0] - pT[0], d1 = c[1] - pT[1], d2 = c[2] - pT[2];
+                            T dist = d0 * d0 + d1 * d1 + d2 * d2;
+                            if (c[2] != 0 && dist < minDist) { minDist = dist; std::copy (c, c + 3, f); found[l] = 1; }
+                        }
+                    }
+                    if (!found[l]) continue;
+
+                    v[0] += 1;
+                    for (uint32_t a = 0; a < 3; ++a) { v[1 + a] += pT[a]; v[4 + a] += f[a]; }
+                }
+
+                if (v[0] == 0) continue;
+                for (uint32_t a = 1; a < 7; ++a) v[a] /= v[0];
+
+                // Statistics centered on the means of the group
+                for (uint32_t l = 0; l < groupSize; ++l)
+                {
+                    if (!found[l]) continue;
+                    const T *pT = pairs.data () + 6 * l, *f = pT + 3;
+                    T d[3] = { pT[0] - v[1], pT[1] - v[2], pT[2] - v[3] };
+                    T e[3] = { f[0] - v[4], f[1] - v[5], f[2] - v[6] };
+                    for (uint32_t a = 0; a < 3; ++a)
+                    {
+                        for (uint32_t b = 0; b < 3; ++b)
+                            v[7 + 3 * a + b] += d[a] * e[b];
+                        v[16] += d[a] * d[a];
+                        v[17] += e[a] * e[a];
+                    }
+                }
+            }
+
+            // Solution ======================================================
+
+            T v[18] = { 0 };
+            for (uint32_t g = 0; g < groups; ++g)
+                for (uint32_t a = 0; a < 7; ++a)
+                    v[a] += (a == 0) ? sums[18 * g] : sums[18 * g] * sums[18 * g + a];
+
+            T n = v[0];
+            if (n < 3) return iter + 1;
+
+            T mM[3] = { v[1] / n, v[2] / n, v[3] / n };
+            T mF[3] = { v[4] / n, v[5] / n, v[6] / n };
+            T S[3][3] = { { 0 } }, varM = 0, varF = 0;
+            for (uint32_t g = 0; g < groups; ++g)
+            {
+                const T *w = sums.data () + 18 * g;
+                T d[3] = { w[1] - mM[0], w[2] - mM[1], w[3] - mM[2] };
+                T e[3] = { w[4] - mF[0], w[5] - mF[1], w[6] - mF[2] };
+                for (uint32_t a = 0; a < 3; ++a)
+                {
+                    for (uint32_t b = 0; b < 3; ++b)
+                        S[a][b] += w[7 + 3 * a + b] + w[0] * d[a] * e[b];
+                    varM += w[0] * d[a] * d[a];
+                    varF += w[0] * e[a] * e[a];
+                }
+                varM += w[16];
+                varF += w[17];
+            }
+
+            T N[4][4] = {
+                { S[0][0] + S[1][1] + S[2][2], S[1][2] - S[2][1], S[2][0] - S[0][2], S[0][1] - S[1][0] },
+                { S[1][2] - S[2][1], S[0][0] - S[1][1] - S[2][2], S[0][1] + S[1][0], S[2][0] + S[0][2] },
+                { S[2][0] - S[0][2], S[0][1] + S[1][0], -S[0][0] + S[1][1] - S[2][2], S[1][2] + S[2][1] },
+                { S[0][1] - S[1][0], S[2][0] + S[0][2], S[1][2] + S[2][1], -S[0][0] - S[1][1] + S[2][2] } };
+
+            // Power method on the shifted matrix
+            T shift = 0;
+            for (uint32_t i = 0; i < 4; ++i)
+                shift = std::max (shift, std::abs (N[i][0]) + std::abs (N[i][1]) + std::abs (N[i][2]) + std::abs (N[i][3]));
+            T e[4] = { 1, 0, 0, 0 };  // (w, x, y, z)
+            for (uint32_t k = 0; k < 32; ++k)
+            {
+                T ne[4], norm = 0;
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    ne[i] = shift * e[i];
+                    for (uint32_t j = 0; j < 4; ++j) ne[i] += N[i][j] * e[j];
+                    norm += ne[i] * ne[i];
+                }
+                norm = std::sqrt (norm);
+                for (uint32_t i = 0; i < 4; ++i) e[i] = ne[i] / norm;
+            }
+
+            // Increment
+            T dT[8] = { e[1], e[2], e[3], e[0], 0, 0, 0, std::sqrt (varF / varM) };
+            T rm[3];
+            cpuICPTransformPoint (dT, mM, rm);
+            for (uint32_t a = 0; a < 3; ++a) dT[4 + a] = mF[a] - rm[a];
+
+            // Composition, T = dT o T
+            const T *q1 = dT, *q2 = Tr;
+            T q[4] = { q1[3] * q2[0] + q2[3] * q1[0] + q1[1] * q2[2] - q1[2] * q2[1], 
+                       q1[3] * q2[1] + q2[3] * q1[1] + q1[2] * q2[0] - q1[0] * q2[2], 
+                       q1[3] * q2[2] + q2[3] * q1[2] + q1[0] * q2[1] - q1[1] * q2[0], 
+                       q1[3] * q2[3] - q1[0] * q2[0] - q1[1] * q2[1] - q1[2] * q2[2] };
+            T qn = std::sqrt (q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+            T t[3];
+            cpuICPTransformPoint (dT, Tr + 4, t);
+            for (uint32_t a = 0; a < 4; ++a) Tr[a] = q[a] / qn;
+            for (uint32_t a = 0; a < 3; ++a) Tr[4 + a] = t[a];
+            Tr[7] *= dT[7];
+
+            // Convergence check
+            T angle = 2 * std::asin (std::min (std::sqrt (e[1] * e[1] + e[2] * e[2] + e[3] * e[3]), (T) 1)) * 180 / M_PI;
+            T trans = std::sqrt (dT[4] * dT[4] + dT[5] * dT[5] + dT[6] * dT[6]);
+            if (angle < angleThreshold && trans < translationThreshold)
+                return iter + 1;
+        }
+
+        return maxIterations;
+    }
+
+    /*! \brief Downsamples an RGB-D frame pair by a factor of 2 in each dimension.
+     *  \details The RGB values of every 2x2 block get averaged, and the depth is 
+     *           the lower median of the valid (non-zero) depths in the block.
+     *           It is just a naive serial implementation.
+     *
+     *  \param[in] rgbIn array with the RGB frame (interleaved).
+     *  \param[in] dIn array with the depth frame.
+     *  \param[out] rgbOut array with the downsampled RGB frame.
+     *  \param[out] dOut array with the downsampled depth frame.
+     *  \param[in] width width of the input frames.
+     *  \param[in] height height of the input frames.
+     */
+    inline void cpuDownsampleRGBD (const cl_uchar *rgbIn, const cl_ushort *dIn, 
+                                   cl_uchar *rgbOut, cl_ushort *dOut, uint32_t width, uint32_t height)
+    {
+        const uint32_t w = width / 2, h = height / 2;
+
+        for (uint32_t y = 0; y < h; ++y)
+        {
+            for (uint32_t x = 0; x < w; ++x)
+            {
+                uint32_t idx[4] = { 2 * y * width + 2 * x, 2 * y * width + 2 * x + 1, 
+                                    (2 * y + 1) * width + 2 * x, (2 * y + 1) * width + 2 * x + 1 };
+
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    float sum = 0.f;
+                    for (uint32_t j = 0; j < 4; ++j) sum += rgbIn[3 * idx[j] + c];
+                    rgbOut[3 * (y * w + x) + c] = (cl_uchar) std::min (std::nearbyint (0.25f * sum), 255.f);
+                }
+
+                std::vector<cl_ushort> d;
+                for (uint32_t j = 0; j < 4; ++j)
+                    if (dIn[idx[j]] != 0) d.push_back (dIn[idx[j]]);
+                std::sort (d.begin (), d.end ());
+                dOut[y * w + x] = d.empty () ? 0 : d[(d.size () - 1) / 2];
+            }
+        }
+    }
+
 }
 
 #endif  // OCLSLAM_HELPERFUNCS_HPP
@@ -0,0 +1,137 @@
+/*! \file tiled_map.hpp
+ *  \brief Declares an out-of-core map, stored in tiles on disk.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_TILED_MAP_HPP
+#define OCLSLAM_TILED_MAP_HPP
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <list>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <octomap/octomap.h>
+#include <octomap/OcTree.h>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief A map partitioned into cubic tiles, which live on disk and 
+     *         get loaded into memory as the sensor moves around.
+     *  \details Every tile is an `OcTree` of its own, in the frame of the map, and 
+     *           is stored in a chunk file in the binary OctoMap format. The chunk 
+     *           files are written and read through memory mappings. At most 
+     *           `capacity` tiles are resident, and the least recently used ones 
+     *           get written back (if modified) and dropped, when there are more.
+     *  \details A point cloud is integrated by computing the free and occupied 
+     *           cells of all the rays at once, and routing every cell to the tile 
+     *           that contains it, so rays that cross tiles update all of them.
+     *  \note The tiles have to be larger than the sensor range by some margin, 
+     *        so that an integration touches only a few of them. Tiles touched 
+     *        by a single integration are all kept resident, regardless of `capacity`.
+     *  \note The chunk files are named `tile_<x>_<y>_<z>.ot`, after the index of the tile. 
+     *        They are full `OcTree` files, so the cells keep their log-odds across 
+     *        an eviction, and a revisited tile integrates like one that stayed in memory.
+     */
+    class TiledMap
+    {
+    public:
+        /*! \brief Index of a tile. */
+        typedef std::tuple<int, int, int> TileIndex;
+
+        /*! \brief Statistics of the tiles. */
+        struct Stats
+        {
+            size_t resident;     /*!< Tiles in memory. */
+            size_t stored;       /*!< Tiles on disk. */
+            size_t nodes;        /*!< Nodes in the resident tiles. */
+            uint64_t loads;      /*!< Tiles read from disk. */
+            uint64_t evictions;  /*!< Tiles dropped from memory. */
+        };
+
+        /*! \brief Configures the tiles. */
+        TiledMap (double _resolution = 0.1, double _tileSize = 20.0, size_t _capacity = 27);
+        /*! \brief Writes back the modified tiles. */
+        ~TiledMap ();
+        /*! \brief Sets the directory of the chunk files, and enables the map. */
+        bool open (const std::string &_dir);
+        /*! \brief Indicates whether the map has been opened. */
+        bool isOpen () const;
+        /*! \brief Gets the directory of the chunk files. */
+        std::string getDirectory () const;
+        /*! \brief Integrates a point cloud into the tiles. */
+        void insertPointCloud (const octomap::Pointcloud &pc, const octomap::point3d &origin, double maxRange = -1.0);
+        /*! \brief Loads the stored tiles around a position, and evicts the least recently used. */
+        void update (const octomap::point3d &center, double radius);
+        /*! \brief Writes back all the modified tiles. */
+        void flush ();
+        /*! \brief Gets a tile (loading it if necessary), or `nullptr` if it doesn't exist. */
+        std::shared_ptr<octomap::OcTree> getTile (const TileIndex &idx);
+        /*! \brief Gets the side (in meters) of the tiles. */
+        double getTileSize () const { return tileSize; }
+        /*! \brief Gets the index of the tile that contains a point. */
+        TileIndex getTileIndex (const octomap::point3d &p) const;
+        /*! \brief Gets the statistics of the tiles. */
+        Stats getStats () const;
+
+    private:
+        /*! \brief A resident tile. */
+        struct Tile
+        {
+            std::shared_ptr<octomap::OcTree> tree;
+            std::list<TileIndex>::iterator lru;  // Position in the LRU list
+            bool dirty;
+        };
+
+        std::string getChunkName (const TileIndex &idx) const;
+        Tile& acquire (const TileIndex &idx);
+        void evict (size_t keep);
+        void writeChunk (const TileIndex &idx, const octomap::OcTree &tree);
+        bool readChunk (const TileIndex &idx, std::shared_ptr<octomap::OcTree> &tree);
+
+        double resolution, tileSize;
+        size_t capacity;
+        std::string dir;
+        octomap::OcTree scratch;  // Computes the updates of the point clouds
+        std::map<TileIndex, Tile> tiles;
+        std::list<TileIndex> lru;  // Most recently used first
+        std::set<TileIndex> stored;
+        uint64_t loads, evictions;
+        mutable std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_TILED_MAP_HPP
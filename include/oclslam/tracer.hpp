@@ -0,0 +1,157 @@
+/*! \file tracer.hpp
+ *  \brief Declares a tracer that exports a timeline of the pipeline in the Chrome trace-event format.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_TRACER_HPP
+#define OCLSLAM_TRACER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <CLUtils.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Records a timeline of the commands and the host work of the pipeline.
+     *  \details Commands are recorded by their events, and get the queued, submit, 
+     *           start, and end times from the OpenCL profiling information. The events 
+     *           are resolved lazily, once they have completed, so recording never 
+     *           stalls the queues. Host work is recorded in spans, on a track per thread. 
+     *           `close` writes the timeline in the Chrome trace-event format, which can 
+     *           be loaded in `chrome://tracing` or in Perfetto.
+     *  \note Every device gets a process in the timeline, and every queue two tracks: 
+     *        one with the execution of the commands, and one with the time they spent 
+     *        waiting in the queue, from queued to start. Gaps on the first and long 
+     *        waits on the second point at the serialization in the pipeline.
+     *  \note The queues have to be created with `CL_QUEUE_PROFILING_ENABLE`. The clock 
+     *        of every queue is mapped to the host clock with a marker, on `open`.
+     *  \note Once `capacity` entries have been recorded, new ones are dropped, 
+     *        and their number is reported in the file.
+     */
+    class Tracer
+    {
+    public:
+        /*! \brief Records the host work from its construction to its destruction. */
+        class Span
+        {
+        public:
+            Span (Tracer &tracer, const char *name) : 
+                tracer (tracer), name (name), start (tracer.isOpen () ? now () : -1.0) {}
+            ~Span () { if (start >= 0.0) tracer.recordSpan (name, start, now ()); }
+
+        private:
+            Tracer &tracer;
+            const char *name;
+            double start;
+        };
+
+        Tracer (size_t capacity = 1 << 18) : tracing (false), capacity (capacity), origin (0.0), dropped (0) {}
+        ~Tracer () { close (); }
+        /*! \brief Names a queue. Its commands appear under the name in the timeline. */
+        void addQueue (const cl::CommandQueue &queue, const std::string &name);
+        /*! \brief Starts recording, for a file to be written on `close`. */
+        bool open (const std::string &filename);
+        /*! \brief Waits for the recorded commands, and writes the file. */
+        void close ();
+        /*! \brief Indicates whether recording is in progress. */
+        bool isOpen () { return tracing; }
+        /*! \brief Records a command, or a sequence of commands, of a queue. */
+        void record (const cl::CommandQueue &queue, const std::string &name, 
+                     const cl::Event &event, const cl::Event &first = cl::Event ());
+        /*! \brief Records a span of host work on the track of the calling thread. */
+        void recordSpan (const std::string &name, double start, double end);
+        /*! \brief Returns the number of entries dropped for lack of capacity. */
+        size_t getDropped () { return dropped; }
+        /*! \brief Returns the time (in us) on the host clock. */
+        static double now ();
+        /*! \brief Indicates whether a queue was created with profiling enabled. */
+        static bool isProfiling (const cl::CommandQueue &queue);
+
+    private:
+        /*! \brief Queue whose commands are recorded. */
+        struct Lane
+        {
+            cl::CommandQueue queue;
+            std::string name;
+            unsigned int pid, tid;  // Process of the device, and track of the queue
+            double offset;          // Device time (in us) to host time
+            bool enabled;           // The queue has profiling enabled
+        };
+
+        /*! \brief Command waiting to be resolved. */
+        struct Command
+        {
+            unsigned int lane;
+            std::string name;
+            cl::Event first, last;
+        };
+
+        /*! \brief Complete event of the timeline. */
+        struct Entry
+        {
+            std::string name;
+            unsigned int pid, tid;
+            double ts, dur;  // in us, on the host clock
+            bool device;     // A command, with its profiling times
+            bool wait;       // Time the command spent in the queue
+            double queued, submit, start, end;  // in us, on the host clock
+        };
+
+        /*! \brief Finds the lane of a queue, and adds it if it's not known. */
+        unsigned int getLane (const cl::CommandQueue &queue);
+        /*! \brief Maps the clock of a queue to the host clock. */
+        void calibrate (Lane &lane);
+        /*! \brief Turns the completed commands into entries. */
+        void resolve (bool wait);
+        /*! \brief Writes the entries in the Chrome trace-event format. */
+        void write (std::ostream &out);
+
+        std::atomic<bool> tracing;
+        size_t capacity;
+        std::string filename;
+        double origin;  // Host time (in us) at which recording started
+        std::vector<Lane> lanes;
+        std::vector<cl::Device> devices;  // Device of every process after the host (pid 0)
+        std::map<std::thread::id, unsigned int> threads;  // Track of every host thread
+        std::vector<Command> pending;
+        std::vector<Entry> entries;
+        size_t dropped;
+        std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_TRACER_HPP
@@ -0,0 +1,118 @@
+/*! \file trajectory.hpp
+ *  \brief Declares classes for logging and evaluating the estimated trajectory.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_TRAJECTORY_HPP
+#define OCLSLAM_TRAJECTORY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <eigen3/Eigen/Dense>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Holds the localization results and statistics of a time step. */
+    struct TrajectoryRecord
+    {
+        double timestamp;            /*!< Host time (in s) at which the frames were delivered. */
+        Eigen::Vector3f t;           /*!< Translation (in mm) with respect to the global coordinate frame. */
+        Eigen::Quaternion<float, Eigen::DontAlign> q;  /*!< Orientation with respect to the global coordinate frame. */
+        float s;                     /*!< Scale with respect to the first point cloud. */
+        uint32_t sensorTimestamp;    /*!< Timestamp reported by the sensor for the depth frame. */
+        unsigned int timeStep;       /*!< Number of point clouds registered, up to this one. */
+        unsigned int icpIterations;  /*!< Number of ICP iterations. */
+        float latency;               /*!< Latency (in ms) of the time step. */
+        float preLatency;            /*!< Latency (in ms) of the stages before the ICP. */
+        float icpLatency;            /*!< Latency (in ms) of the ICP. */
+    };
+
+
+    /*! \brief Writes a trajectory on disk.
+     *  \details The file is in the `TUM RGB-D` format, `timestamp tx ty tz qx qy qz qw`,
+     *           with the translation in meters, so it can be consumed directly by the
+     *           standard evaluation tools. The rest of the fields in a `TrajectoryRecord`
+     *           are appended as extra columns, which those tools ignore.
+     */
+    class TrajectoryLog
+    {
+    public:
+        ~TrajectoryLog () { close (); }
+        /*! \brief Opens a file for writing, and writes the header. */
+        bool open (const std::string &filename);
+        /*! \brief Flushes and closes the file. */
+        void close ();
+        /*! \brief Indicates whether a file is open. */
+        bool isOpen ();
+        /*! \brief Appends a record to the file. */
+        void append (const TrajectoryRecord &record);
+
+    private:
+        std::ofstream file;
+        std::mutex mtx;
+
+    };
+
+
+    /*! \brief Reads a trajectory written by `TrajectoryLog`, or any file in the `TUM RGB-D` format. */
+    std::vector<TrajectoryRecord> readTrajectory (const std::string &filename);
+
+
+    /*! \brief Holds statistics of a set of errors. */
+    struct ErrorStats
+    {
+        double rmse, mean, median, stddev, min, max;
+        unsigned int count;
+    };
+
+    /*! \brief Computes statistics of a set of errors. */
+    ErrorStats computeStats (std::vector<double> errors);
+
+    /*! \brief Associates the records of two trajectories by their timestamps. */
+    std::vector<std::pair<unsigned int, unsigned int>>
+    associate (const std::vector<TrajectoryRecord> &est, const std::vector<TrajectoryRecord> &gt, double maxDiff = 0.02);
+
+    /*! \brief Computes the absolute trajectory error (ATE) of the positions (in mm). */
+    ErrorStats computeATE (const std::vector<TrajectoryRecord> &est, const std::vector<TrajectoryRecord> &gt,
+                           const std::vector<std::pair<unsigned int, unsigned int>> &matches,
+                           bool withScale = false, Eigen::Matrix4d *alignment = nullptr);
+
+    /*! \brief Computes the relative pose error (RPE) for a fixed time interval. */
+    void computeRPE (const std::vector<TrajectoryRecord> &est, const std::vector<TrajectoryRecord> &gt,
+                     const std::vector<std::pair<unsigned int, unsigned int>> &matches, double delta,
+                     ErrorStats &trans, ErrorStats &rot);
+
+}
+}
+
+#endif  // OCLSLAM_TRAJECTORY_HPP
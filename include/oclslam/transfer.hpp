@@ -0,0 +1,89 @@
+/*! \file transfer.hpp
+ *  \brief Declares a class for moving buffers between the devices of the pipeline.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_TRANSFER_HPP
+#define OCLSLAM_TRANSFER_HPP
+
+#include <CLUtils.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Copies a buffer from one command queue to another, 
+     *         when two stages of the pipeline run on different devices.
+     *  \details Within a context, the copy is enqueued on the destination queue, 
+     *           and waits on a marker of the source queue. Across contexts, 
+     *           which is the case for devices of different platforms, the data 
+     *           go through a pinned host buffer, with a read on the source 
+     *           queue and a write on the destination queue.
+     *  \note The transfer is split in two halves. `begin` is called as soon as the 
+     *        source buffer has been enqueued for computation, and `end` right before 
+     *        the destination buffer is needed, so that the transfer overlaps with 
+     *        whatever work gets enqueued in between. Until `init` is called, 
+     *        both halves do nothing, which is the case of two stages that 
+     *        share a command queue and the buffer itself.
+     */
+    class BufferTransfer
+    {
+    public:
+        /*! \brief Constructor. */
+        BufferTransfer ();
+        /*! \brief Destructor. */
+        ~BufferTransfer ();
+        /*! \brief Configures the transfer. */
+        void init (cl::Context &srcContext, cl::CommandQueue &srcQueue, const cl::Buffer &src, 
+                   cl::Context &dstContext, cl::CommandQueue &dstQueue, const cl::Buffer &dst, size_t size);
+        /*! \brief Enqueues the source side of the transfer. */
+        void begin ();
+        /*! \brief Enqueues the destination side of the transfer. */
+        void end ();
+        /*! \brief Performs the whole transfer. */
+        void run () { begin (); end (); }
+        /*! \brief Indicates whether the transfer has been configured. */
+        bool isActive () { return active; }
+        /*! \brief Indicates whether the transfer goes through host memory. */
+        bool isStaged () { return staged; }
+
+    private:
+        cl::CommandQueue *srcQueue, *dstQueue;
+        cl::Buffer src, dst;
+        cl::Buffer hBuffer;
+        void *hPtr;
+        size_t size;
+        bool active, staged, pending;
+        cl::Event srcEvent, dstEvent;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_TRANSFER_HPP
@@ -0,0 +1,103 @@
+/*! \file tuner.hpp
+ *  \brief Declares a facility that finds the fastest launch configurations of the kernels on a device.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_TUNER_HPP
+#define OCLSLAM_TUNER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <CLUtils.hpp>
+#include <oclslam/program_cache.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \brief Launch configuration of a kernel. */
+    struct LaunchConfig
+    {
+        unsigned int local;  /*!< Local size. `0` leaves it to the driver. */
+        unsigned int ppw;    /*!< Points processed by each work-item. */
+
+        bool operator== (const LaunchConfig &other) const
+        {
+            return local == other.local && ppw == other.ppw;
+        }
+    };
+
+
+    /*! \brief Finds the fastest launch configurations of the kernels 
+     *         on a device, and keeps them on disk.
+     *  \details The classes of the pipeline that take a tuner sweep their candidate 
+     *           configurations with `tune`, and then look up the winners at `init`. 
+     *           The configurations are keyed by the device, as in its name and vendor, 
+     *           and the device and driver versions, so a driver update calls for 
+     *           a new sweep. Kernels without a stored configuration keep their defaults.
+     *  \note The configurations live in a text file per device, in the directory 
+     *        of the `ProgramCache`. An empty directory keeps them in memory only.
+     */
+    class LaunchTuner
+    {
+    public:
+        /*! \brief Sets the directory of the stored configurations. */
+        LaunchTuner (const std::string &_dir = ProgramCache::getDefaultDirectory ());
+        /*! \brief Looks up the configuration of a kernel for a problem size on a device. */
+        bool lookup (const cl::Device &device, const std::string &kernel, unsigned int size, 
+                     LaunchConfig &config);
+        /*! \brief Stores the configuration of a kernel for a problem size on a device. */
+        void store (const cl::Device &device, const std::string &kernel, unsigned int size, 
+                    const LaunchConfig &config);
+        /*! \brief Returns the power-of-2 local sizes a kernel can be launched with on a device. */
+        static std::vector<unsigned int> getLocalSizes (const cl::Kernel &kernel, const cl::Device &device, 
+                                                        unsigned int minSize = 32, unsigned int maxSize = 256);
+        /*! \brief Times a set of configurations, and applies the fastest one. */
+        static LaunchConfig sweep (cl::CommandQueue &queue, const std::vector<LaunchConfig> &candidates, 
+                                   std::function<void (const LaunchConfig &)> apply, 
+                                   std::function<void ()> run, unsigned int repeats = 10);
+
+    private:
+        typedef std::map<std::pair<std::string, unsigned int>, LaunchConfig> Table;
+
+        Table& getTable (const cl::Device &device, std::string &path);
+        void save (const std::string &path, const Table &table);
+
+        std::string dir;
+        std::map<std::string, Table> tables;  // Per device file
+        std::mutex mtx;
+
+    };
+
+}
+}
+
+#endif  // OCLSLAM_TUNER_HPP
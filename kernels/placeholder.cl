@@ -0,0 +1,10 @@
+/*! \file placeholder.cl
+ *  \brief A trivial program for reserving a program slot in a `clutils::CLEnv`.
+ *  \details The slot gets assigned afterwards a program from `oclslam::ProgramCache`.
+ */
+
+kernel
+void placeholder (global uint *out)
+{
+    out[get_global_id (0)] = 0;
+}
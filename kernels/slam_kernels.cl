@@ -27,22 +27,622 @@
  */
 
 
+/* Compile-time specialization
+ * The host can define the following macros (`-D`) to build a variant of the 
+ * program for a particular configuration. Where a kernel takes the same value 
+ * as an argument, the argument is ignored in favor of the macro.
+ *   PC_SCALE      scale from the units of the point cloud to meters
+ *   RGB_SCALE     scale from the normalized RGB values to 8-bit values
+ *   NUM_POINTS    number of points in a point cloud
+ *   FRAME_WIDTH   width of the frames
+ *   FRAME_HEIGHT  height of the frames
+ */
+#ifndef PC_SCALE
+#define PC_SCALE 0.001f
+#endif
+
+#ifndef RGB_SCALE
+#define RGB_SCALE 255.f
+#endif
+
+#ifdef NUM_POINTS
+#define POINTS(n) NUM_POINTS
+#else
+#define POINTS(n) (n)
+#endif
+
+#ifdef FRAME_WIDTH
+#define WIDTH(w) FRAME_WIDTH
+#else
+#define WIDTH(w) (w)
+#endif
+
+#ifdef FRAME_HEIGHT
+#define HEIGHT(h) FRAME_HEIGHT
+#else
+#define HEIGHT(h) (h)
+#endif
+
+
 /*! \brief Splits an 8-D point cloud into 3-D coordinates (in meters) 
  *         and 8-bit RGB values.
- *  \note The global workspace should be one-dimensional. The **x** dimension 
- *        of the global workspace, \f$ gXdim \f$, should be equal to the number 
- *        of points in the point cloud. The local workspace is irrelevant.
+ *  \note The global workspace should be one-dimensional. Every work-item 
+ *        processes the points \f$ gX, gX + gXdim, \dots \f$, so the **x** dimension 
+ *        of the global workspace, \f$ gXdim \f$, can be anything up to the number 
+ *        of points in the point cloud, and work-items past the last point stay idle. 
+ *        The local workspace is irrelevant.
  *
  *  \param[in] pc8d array with 8-D points (homogeneous coordinates + RGBA values).
  *  \param[out] pc3d array with 3-D coordinates (in meters).
  *  \param[out] rgb array with 8-bit RGB values.
+ *  \param[in] n number of points in the point cloud.
+ */
+kernel
+void splitPC8D_octomap (global float8 *pc8d, global float *pc3d, global uchar *rgb, uint n)
+{
+    for (uint gX = get_global_id (0); gX < POINTS (n); gX += get_global_size (0))
+    {
+        float8 point = pc8d[gX];
+        vstore3 (point.s012 * PC_SCALE, gX, pc3d);
+        vstore3 (convert_uchar3 (point.s456 * RGB_SCALE), gX, rgb);
+    }
+}
+
+
+/*! \brief Computes the residual errors of an `ICP` registration.
+ *  \details For a sample of the moving landmarks, transformed by the estimated 
+ *           transformation, it finds the nearest fixed landmark (brute force) 
+ *           and reports the squared distance to it. The fixed landmarks are 
+ *           staged in local memory, one tile of \f$ lXdim \f$ points at a time.
+ *  \note Invalid landmarks lie on the sensor origin (\f$ z = 0 \f$). Invalid moving 
+ *        landmarks get a negative residual, and invalid fixed landmarks are ignored.
+ *  \note The global workspace should be one-dimensional. The **x** dimension 
+ *        of the global workspace, \f$ gXdim \f$, should be equal to the number 
+ *        of samples, and a multiple of the **x** dimension of the local workspace.
+ *
+ *  \param[in] F array with the fixed landmarks (8-D points).
+ *  \param[in] M array with the moving landmarks (8-D points).
+ *  \param[in] tile local buffer. Its size should be `lXdim` float4 elements.
+ *  \param[out] res array with the squared distances (in \f$ mm^2 \f$) of the samples.
+ *  \param[in] T transformation, \f$ \left[ \begin{matrix} q_x & q_y & q_z & q_w & 
+ *               t_x & t_y & t_z & s \end{matrix} \right] \f$, that maps the moving 
+ *               landmarks onto the fixed ones, \f$ p_F = s R(q) p_M + t \f$.
+ *  \param[in] m number of landmarks in each set.
+ *  \param[in] stride distance (in landmarks) between two consecutive samples.
+ */
+kernel
+void icpResiduals (global float8 *F, global float8 *M, local float4 *tile, 
+                   global float *res, float8 T, uint m, uint stride)
+{
+    uint gX = get_global_id (0);
+    uint lX = get_local_id (0);
+    uint lXdim = get_local_size (0);
+
+    float4 p = M[min (gX * stride, m - 1)].s0123;
+    bool valid = (p.z != 0.f);
+
+    // Rotate with the quaternion, v' = v + 2w(q x v) + 2q x (q x v)
+    float3 q = T.s012;
+    float3 c = 2.f * cross (q, p.xyz);
+    float3 pT = T.s7 * (p.xyz + T.s3 * c + cross (q, c)) + T.s456;
+
+    float minDist = INFINITY;
+    for (uint base = 0; base < m; base += lXdim)
+    {
+        float4 f = (base + lX < m) ? F[base + lX].s0123 : (float4) (0.f);
+        tile[lX] = (float4) (f.xyz, (f.z != 0.f) ? 1.f : 0.f);
+        barrier (CLK_LOCAL_MEM_FENCE);
+
+        uint size = min (lXdim, m - base);
+        for (uint k = 0; k < size; ++k)
+        {
+            float4 t = tile[k];
+            float3 d = t.xyz - pT;
+            float dist = dot (d, d);
+            if (t.w != 0.f && dist < minDist) minDist = dist;
+        }
+        barrier (CLK_LOCAL_MEM_FENCE);
+    }
+
+    res[gX] = valid ? minDist : -1.f;
+}
+
+
+/*! \brief Rotates and scales a point and then translates it, \f$ p' = s R(q) p + t \f$.
+ *
+ *  \param[in] T transformation, \f$ \left[ \begin{matrix} q_x & q_y & q_z & q_w & 
+ *               t_x & t_y & t_z & s \end{matrix} \right] \f$.
+ *  \param[in] p point.
+ *  \return The transformed point.
+ */
+inline
+float3 icpTransformPoint (float8 T, float3 p)
+{
+    // Rotate with the quaternion, v' = v + 2w(q x v) + 2q x (q x v)
+    float3 q = T.s012;
+    float3 c = 2.f * cross (q, p);
+    return T.s7 * (p + T.s3 * c + cross (q, c)) + T.s456;
+}
+
+
+/*! \brief Sums a value over the work-group.
+ *  \note It has to be reached by all work-items in the work-group. The local 
+ *        workspace should be one-dimensional, and its size a power of 2.
+ *
+ *  \param[in] scratch local buffer. Its size should be `lXdim` float elements.
+ *  \param[in] x value of the work-item.
+ *  \return The sum, to every work-item.
+ */
+inline
+float icpGroupSum (local float *scratch, float x)
+{
+    uint lX = get_local_id (0);
+
+    scratch[lX] = x;
+    barrier (CLK_LOCAL_MEM_FENCE);
+
+    for (uint s = get_local_size (0) >> 1; s > 0; s >>= 1)
+    {
+        if (lX < s) scratch[lX] += scratch[lX + s];
+        barrier (CLK_LOCAL_MEM_FENCE);
+    }
+
+    float sum = scratch[0];
+    barrier (CLK_LOCAL_MEM_FENCE);
+
+    return sum;
+}
+
+
+/*! \brief Performs the association step of a device-resident `ICP` iteration.
+ *  \details Each moving landmark, transformed by the current estimate, is matched 
+ *           to the nearest fixed landmark in a window around the same position 
+ *           on the landmark grid. The statistics of the matched pairs, needed for 
+ *           the next increment, are reduced per work-group and centered on the 
+ *           means of the work-group, so that they hold up in single precision:
+ *           \f$ \left[ \begin{matrix} n & \bar{p}_M^T & \bar{p}_F^T & vec(C)^T & 
+ *           \sum \|p_M - \bar{p}_M\|^2 & \sum \|p_F - \bar{p}_F\|^2 \end{matrix} \right] \f$, 
+ *           where \f$ C = \sum (p_M - \bar{p}_M)(p_F - \bar{p}_F)^T \f$ (18 values).
+ *  \note Invalid landmarks lie on the sensor origin (\f$ z = 0 \f$) and are ignored. 
+ *        Pairs further apart than `maxDist` are rejected.
+ *  \note The kernel does nothing once `state[0]` (the convergence flag) is set.
+ *  \note The global workspace should be one-dimensional. The **x** dimension 
+ *        of the global workspace, \f$ gXdim \f$, should be equal to the number 
+ *        of landmarks, and a multiple of the **x** dimension of the local workspace,
+ *        \f$ lXdim \f$, which should be a power of 2.
+ *
+ *  \param[in] F array with the fixed landmarks (8-D points), on a `gw` x `gh` grid.
+ *  \param[in] M array with the moving landmarks (8-D points), on a `gw` x `gh` grid.
+ *  \param[in] T current estimate of the transformation (see `icpTransformPoint`).
+ *  \param[in] state array with the convergence flag and the iteration count.
+ *  \param[in] scratch local buffer. Its size should be `lXdim` float elements.
+ *  \param[out] sums array with the statistics, 18 for every work-group.
+ *  \param[in] gw width of the landmark grid.
+ *  \param[in] gh height of the landmark grid.
+ *  \param[in] radius radius of the search window on the landmark grid.
+ *  \param[in] maxDist maximum distance (in mm) between two associated landmarks.
+ */
+kernel
+void icpAssociate (global float8 *F, global float8 *M, global float8 *T, global uint *state, 
+                   local float *scratch, global float *sums, uint gw, uint gh, int radius, float maxDist)
+{
+    if (state[0]) return;
+
+    uint gX = get_global_id (0);
+    uint lX = get_local_id (0);
+    global float *v = sums + get_group_id (0) * 18;
+
+    float3 pT = (float3) (0.f);
+    float3 f = (float3) (0.f);
+
+    float3 p = M[gX].s012;
+    if (p.z != 0.f)
+    {
+        pT = icpTransformPoint (T[0], p);
+
+        int x0 = gX % gw, y0 = gX / gw;
+        int xl = max (x0 - radius, 0), xh = min (x0 + radius, (int) gw - 1);
+        int yl = max (y0 - radius, 0), yh = min (y0 + radius, (int) gh - 1);
+
+        float minDist = maxDist * maxDist;
+        for (int y = yl; y <= yh; ++y)
+        {
+            for (int x = xl; x <= xh; ++x)
+            {
+                float3 c = F[y * gw + x].s012;
+                float3 d = c - pT;
+                float dist = dot (d, d);
+                if (c.z != 0.f && dist < minDist) { minDist = dist; f = c; }
+            }
+        }
+    }
+    float w = (f.z != 0.f) ? 1.f : 0.f;
+
+    // Means of the group
+    float n = icpGroupSum (scratch, w);
+    float3 mM, mF;
+    mM.x = icpGroupSum (scratch, w * pT.x);
+    mM.y = icpGroupSum (scratch, w * pT.y);
+    mM.z = icpGroupSum (scratch, w * pT.z);
+    mF.x = icpGroupSum (scratch, w * f.x);
+    mF.y = icpGroupSum (scratch, w * f.y);
+    mF.z = icpGroupSum (scratch, w * f.z);
+    if (n > 0.f) { mM /= n; mF /= n; }
+
+    // Centered statistics
+    float3 d = w * (pT - mM);
+    float3 e = w * (f - mF);
+    float C[9];
+    C[0] = icpGroupSum (scratch, d.x * e.x);
+    C[1] = icpGroupSum (scratch, d.x * e.y);
+    C[2] = icpGroupSum (scratch, d.x * e.z);
+    C[3] = icpGroupSum (scratch, d.y * e.x);
+    C[4] = icpGroupSum (scratch, d.y * e.y);
+    C[5] = icpGroupSum (scratch, d.y * e.z);
+    C[6] = icpGroupSum (scratch, d.z * e.x);
+    C[7] = icpGroupSum (scratch, d.z * e.y);
+    C[8] = icpGroupSum (scratch, d.z * e.z);
+    float sM = icpGroupSum (scratch, dot (d, d));
+    float sF = icpGroupSum (scratch, dot (e, e));
+
+    if (lX == 0)
+    {
+        v[0] = n;
+        vstore3 (mM, 0, v + 1);
+        vstore3 (mF, 0, v + 4);
+        for (uint k = 0; k < 9; ++k) v[7 + k] = C[k];
+        v[16] = sM;
+        v[17] = sF;
+    }
+}
+
+
+/*! \brief Performs the solution step of a device-resident `ICP` iteration.
+ *  \details Combines the statistics of the work-groups from `icpAssociate`, computes 
+ *           the increment with the method of Horn (the rotation is the dominant 
+ *           eigenvector of matrix \f$ N \f$, found with the power method), composes 
+ *           it with the current estimate, \f$ T \leftarrow \Delta T \circ T \f$, and 
+ *           tests it against the convergence thresholds.
+ *  \note The kernel does nothing once `state[0]` (the convergence flag) is set. 
+ *        Otherwise, it increments the iteration count, `state[1]`. The flag is also 
+ *        set when fewer than 3 pairs are found, in which case `state[2]` is set too.
+ *  \note The kernel should be executed by a single work-item.
+ *
+ *  \param[in] sums array with the statistics from `icpAssociate`.
+ *  \param[in] groups number of work-groups in `icpAssociate`.
+ *  \param[in,out] T current estimate of the transformation (see `icpTransformPoint`).
+ *  \param[in,out] state array with the convergence flag, the iteration count, and the failure flag.
+ *  \param[in] angleThreshold angle threshold (in degrees) for the convergence check.
+ *  \param[in] translationThreshold translation threshold (in mm) for the convergence check.
+ */
+kernel
+void icpSolve (global float *sums, uint groups, global float8 *T, global uint *state, 
+               float angleThreshold, float translationThreshold)
+{
+    if (state[0]) return;
+    state[1]++;
+
+    // Means
+    float n = 0.f;
+    float3 mM = (float3) (0.f), mF = (float3) (0.f);
+    for (uint g = 0; g < groups; ++g)
+    {
+        global float *v = sums + g * 18;
+        n += v[0];
+        mM += v[0] * vload3 (0, v + 1);
+        mF += v[0] * vload3 (0, v + 4);
+    }
+
+    if (n < 3.f)
+    {
+        state[0] = 1; state[2] = 1;
+        return;
+    }
+    mM /= n; mF /= n;
+
+    // Cross-covariance and variances, combined with the parallel axis theorem
+    float3 S0 = (float3) (0.f), S1 = (float3) (0.f), S2 = (float3) (0.f);
+    float varM = 0.f, varF = 0.f;
+    for (uint g = 0; g < groups; ++g)
+    {
+        global float *v = sums + g * 18;
+        float3 d = vload3 (0, v + 1) - mM;
+        float3 e = vload3 (0, v + 4) - mF;
+        S0 += vload3 (0, v + 7) + v[0] * d.x * e;
+        S1 += vload3 (0, v + 10) + v[0] * d.y * e;
+        S2 += vload3 (0, v + 13) + v[0] * d.z * e;
+        varM += v[16] + v[0] * dot (d, d);
+        varF += v[17] + v[0] * dot (e, e);
+    }
+
+    float Sxx = S0.x, Sxy = S0.y, Sxz = S0.z;
+    float Syx = S1.x, Syy = S1.y, Syz = S1.z;
+    float Szx = S2.x, Szy = S2.y, Szz = S2.z;
+
+    // Matrix N, with its eigenvectors given as (w, x, y, z)
+    float4 N0 = (float4) (Sxx + Syy + Szz, Syz - Szy, Szx - Sxz, Sxy - Syx);
+    float4 N1 = (float4) (Syz - Szy, Sxx - Syy - Szz, Sxy + Syx, Szx + Sxz);
+    float4 N2 = (float4) (Szx - Sxz, Sxy + Syx, -Sxx + Syy - Szz, Syz + Szy);
+    float4 N3 = (float4) (Sxy - Syx, Szx + Sxz, Syz + Szy, -Sxx - Syy + Szz);
+
+    // Power method on N + shift * I, where the shift (Gershgorin bound) 
+    // makes the dominant eigenvalue the largest algebraic one
+    float shift = fmax (fmax (dot (fabs (N0), (float4) (1.f)), dot (fabs (N1), (float4) (1.f))), 
+                        fmax (dot (fabs (N2), (float4) (1.f)), dot (fabs (N3), (float4) (1.f))));
+    float4 e = (float4) (1.f, 0.f, 0.f, 0.f);  // The increment is close to the identity
+    for (uint k = 0; k < 32; ++k)
+    {
+        e = (float4) (dot (N0, e), dot (N1, e), dot (N2, e), dot (N3, e)) + shift * e;
+        e = normalize (e);
+    }
+
+    // Increment
+    float8 dT = (float8) (e.s1, e.s2, e.s3, e.s0, 0.f, 0.f, 0.f, sqrt (varF / varM));
+    dT.s456 = mF - icpTransformPoint (dT, mM);
+
+    // Composition
+    float8 Tk = T[0];
+    float4 q1 = dT.s0123, q2 = Tk.s0123;
+    float4 q = (float4) (q1.w * q2.xyz + q2.w * q1.xyz + cross (q1.xyz, q2.xyz), 
+                         q1.w * q2.w - dot (q1.xyz, q2.xyz));
+    T[0] = (float8) (normalize (q), icpTransformPoint (dT, Tk.s456), dT.s7 * Tk.s7);
+
+    // Convergence check
+    float angle = 2.f * asin (fmin (length (e.s123), 1.f)) * 57.2957795f;  // in degrees
+    if (angle < angleThreshold && length (dT.s456) < translationThreshold) state[0] = 1;
+}
+
+
+/*! \brief Downsamples an RGB-D frame pair by a factor of 2 in each dimension.
+ *  \details Every output pixel covers a 2x2 block of the input. The RGB values get 
+ *           averaged. The depth is the lower median of the valid (non-zero) depths 
+ *           in the block, so that depths on either side of a discontinuity never 
+ *           get blended into points that lie on neither surface.
+ *  \note The global workspace should be two-dimensional, \f$ width/2 \times height/2 \f$. 
+ *        The local workspace is irrelevant.
+ *
+ *  \param[in] rgbIn array with the RGB frame (8-bit values, interleaved).
+ *  \param[in] dIn array with the depth frame (in mm).
+ *  \param[out] rgbOut array with the downsampled RGB frame.
+ *  \param[out] dOut array with the downsampled depth frame.
+ *  \param[in] width width of the input frames.
+ */
+kernel
+void downsampleRGBD (global uchar *rgbIn, global ushort *dIn, 
+                     global uchar *rgbOut, global ushort *dOut, uint width)
+{
+    uint gX = get_global_id (0);
+    uint gY = get_global_id (1);
+    uint i0 = 2 * gY * WIDTH (width) + 2 * gX;
+    uint i1 = i0 + WIDTH (width);
+
+    float3 rgb = convert_float3 (vload3 (i0, rgbIn)) + convert_float3 (vload3 (i0 + 1, rgbIn)) + 
+                 convert_float3 (vload3 (i1, rgbIn)) + convert_float3 (vload3 (i1 + 1, rgbIn));
+    vstore3 (convert_uchar3_sat_rte (0.25f * rgb), gY * get_global_size (0) + gX, rgbOut);
+
+    // Invalid depths get sorted last
+    ushort4 d = (ushort4) (dIn[i0], dIn[i0 + 1], dIn[i1], dIn[i1 + 1]);
+    uint valid = (d.s0 != 0) + (d.s1 != 0) + (d.s2 != 0) + (d.s3 != 0);
+    d = select (d, (ushort4) (USHRT_MAX), d == (ushort4) (0));
+
+    // Sorting network
+    ushort4 lo = min (d.s02, d.s13), hi = max (d.s02, d.s13);
+    d = (ushort4) (min (lo.s0, lo.s1), max (lo.s0, lo.s1), min (hi.s0, hi.s1), max (hi.s0, hi.s1));
+    d.s12 = (ushort2) (min (d.s1, d.s2), max (d.s1, d.s2));
+
+    ushort depth = 0;
+    if (valid > 0) depth = (valid > 2) ? d.s1 : d.s0;
+    dOut[gY * get_global_size (0) + gX] = depth;
+}
+
+
+/*! \brief Samples the landmarks of a point cloud on a regular grid.
+ *  \details The frame is divided into \f$ side \times side \f$ cells, 
+ *           and every landmark is the point at the center of a cell.
+ *  \note The global workspace should be two-dimensional, \f$ side \times side \f$. 
+ *        The local workspace is irrelevant.
+ *
+ *  \param[in] pc8d array with the 8-D point cloud (organized).
+ *  \param[out] lms array with the 8-D landmarks (organized as a \f$ side \times side \f$ grid).
+ *  \param[in] width width of the point cloud.
+ *  \param[in] height height of the point cloud.
  */
 kernel
-void splitPC8D_octomap (global float8 *pc8d, global float *pc3d, global uchar *rgb)
+void icpLMs_grid (global float8 *pc8d, global float8 *lms, uint width, uint height)
 {
     uint gX = get_global_id (0);
+    uint gY = get_global_id (1);
+    uint side = get_global_size (0);
+
+    uint x = (2 * gX + 1) * WIDTH (width) / (2 * side);
+    uint y = (2 * gY + 1) * HEIGHT (height) / (2 * side);
+    lms[gY * side + gX] = pc8d[y * WIDTH (width) + x];
+}
+
+
+/*! \brief Interleaves the bits of a cell's key into a Morton code.
+ *  \details The bits of `x` go to the lowest position, like in the child 
+ *           index of an `OcTree` node.
+ *
+ *  \param[in] key key of the cell (16-bit components).
+ *  \return The Morton code of the cell.
+ */
+inline
+ulong mortonCode (uint3 key)
+{
+    ulong3 v = convert_ulong3 (key & (uint3) (0xFFFF));
+    v = (v | (v << 16)) & (ulong3) (0x0000FF0000FFUL);
+    v = (v | (v <<  8)) & (ulong3) (0x00F00F00F00FUL);
+    v = (v | (v <<  4)) & (ulong3) (0x0C30C30C30C3UL);
+    v = (v | (v <<  2)) & (ulong3) (0x249249249249UL);
+    return v.x | (v.y << 1) | (v.z << 2);
+}
+
+
+/*! \brief Looks up the log-odds of points in a linear octree.
+ *  \details The leaves of the octree are sorted by the Morton code of their 
+ *           first cell, and a leaf of level \f$ l \f$ covers the \f$ 8^l \f$ 
+ *           codes that follow its own. So the leaf that contains a point is 
+ *           the last one with a code no greater than the point's, found by 
+ *           binary search.
+ *  \note The global workspace should be one-dimensional, equal to the number 
+ *        of points. The local workspace is irrelevant.
+ *
+ *  \param[in] codes array with the Morton codes of the leaves (sorted).
+ *  \param[in] levels array with the levels of the leaves (log2 of their side in cells).
+ *  \param[in] values array with the log-odds of the leaves.
+ *  \param[in] n number of leaves.
+ *  \param[in] points array with the points (in meters).
+ *  \param[out] logOdds array with the log-odds of the points, or `NAN` for 
+ *                      the points in unknown space.
+ *  \param[in] invResolution inverse of the resolution of the map.
+ *  \param[in] keyOffset key of the origin of the map.
+ */
+kernel
+void linearOctreeQuery (global ulong *codes, global uchar *levels, global float *values, uint n, 
+                        global float4 *points, global float *logOdds, float invResolution, int keyOffset)
+{
+    uint gX = get_global_id (0);
+
+    int3 key = convert_int3_rtn (points[gX].xyz * invResolution) + keyOffset;
+    float result = NAN;
+
+    if (all (key >= 0) && all (key < 2 * keyOffset))
+    {
+        ulong code = mortonCode (convert_uint3 (key));
+
+        // First leaf with a greater code
+        uint lo = 0, hi = n;
+        while (lo < hi)
+        {
+            uint mid = (lo + hi) >> 1;
+            if (codes[mid] <= code) lo = mid + 1;
+            else hi = mid;
+        }
+
+        if (lo > 0 && code - codes[lo - 1] < (1UL << (3 * levels[lo - 1])))
+            result = values[lo - 1];
+    }
+
+    logOdds[gX] = result;
+}
+
+
+/*! \brief Finds the brick of a block in the hash table of a `BrickMap`.
+ *  \details The table is probed linearly, from the slot given by Fibonacci 
+ *           hashing, the same as on the host.
+ *
+ *  \param[in] slotCodes array with the block codes of the slots (`ULONG_MAX` for free slots).
+ *  \param[in] slotBricks array with the brick indices of the slots.
+ *  \param[in] bits log2 of the number of slots.
+ *  \param[in] code code of the block.
+ *  \return The index of the brick, or -1 if the block has none.
+ */
+inline
+int brickFind (global ulong *slotCodes, global uint *slotBricks, uint bits, ulong code)
+{
+    uint mask = (1u << bits) - 1;
+    uint h = (bits == 0) ? 0 : (uint) ((code * 0x9E3779B97F4A7C15UL) >> (64 - bits));
+    for (uint i = 0; i <= mask; ++i, h = (h + 1) & mask)
+    {
+        ulong c = slotCodes[h];
+        if (c == code) return slotBricks[h];
+        if (c == ULONG_MAX) break;
+    }
+    return -1;
+}
+
+
+/*! \brief Casts rays against the occupied cells of a `BrickMap`.
+ *  \details Every ray is marched cell by cell, in the order of `OcTree::castRay`. 
+ *           The brick of a block is looked up once, when the ray enters it, 
+ *           and the blocks without a brick are crossed without any memory access. 
+ *           The unknown cells don't stop the rays; only the occupied ones do.
+ *  \details A query with a zero direction checks only the cell of its origin, 
+ *           so rays and point queries can be mixed in a batch.
+ *  \note The global workspace should be one-dimensional, equal to the number 
+ *        of queries. The local workspace is irrelevant.
+ *
+ *  \param[in] slotCodes array with the block codes of the slots of the table.
+ *  \param[in] slotBricks array with the brick indices of the slots of the table.
+ *  \param[in] bits log2 of the number of slots of the table.
+ *  \param[in] bricks array with the bricks, 16 words (512 bits) per brick.
+ *  \param[in] origins array with the origins of the rays (in meters). The `w` 
+ *                     component is the maximum range of the ray; if not positive, 
+ *                     `maxRange` is used.
+ *  \param[in] directions array with the directions of the rays. They don't 
+ *                        need to be normalized.
+ *  \param[out] hits array with the results. The `xyz` components are the center of 
+ *                   the occupied cell that was hit, or the end of the ray. The `w` 
+ *                   component is the distance to the cell, or -1 for a miss.
+ *  \param[in] resolution resolution of the map.
+ *  \param[in] keyOffset key of the origin of the map.
+ *  \param[in] maxRange default maximum range of the rays (in meters).
+ */
+kernel
+void rayCastBricks (global ulong *slotCodes, global uint *slotBricks, uint bits, global uint *bricks, 
+                    global float4 *origins, global float4 *directions, global float4 *hits, 
+                    float resolution, int keyOffset, float maxRange)
+{
+    uint gX = get_global_id (0);
+
+    float4 origin = origins[gX];
+    float3 d = directions[gX].xyz;
+    float range = (origin.w > 0.f) ? origin.w : maxRange;
+    float len = length (d);
+    if (len > 0.f) d /= len;
+    else range = 0.f;
+
+    // The cell of the origin, and the position in it
+    float3 p = origin.xyz / resolution;
+    float3 f = p - floor (p);
+    int3 cell = convert_int3_rtn (p) + keyOffset;
+
+    int3 step = convert_int3 (sign (d));
+    float3 tDelta = select ((float3) (INFINITY), 1.f / fabs (d), isnotequal (d, (float3) (0.f)));
+    float3 tMax = select ((float3) (INFINITY), select (f, 1.f - f, step > 0) / fabs (d), isnotequal (d, (float3) (0.f)));
+
+    float tEnd = range / resolution;
+    float t = 0.f;
+    float4 result = (float4) (origin.xyz + d * range, -1.f);
+    int3 block = (int3) (-1);
+    int brick = -1;
+    while (t <= tEnd)
+    {
+        if (any (cell < 0) || any (cell >= 2 * keyOffset)) break;
+
+        // Look up the brick once per block
+        int3 b = cell >> 3;
+        if (any (b != block))
+        {
+            block = b;
+            ulong code = (ulong) b.x | ((ulong) b.y << 13) | ((ulong) b.z << 26);
+            brick = brickFind (slotCodes, slotBricks, bits, code);
+        }
+
+        if (brick >= 0)
+        {
+            int3 c = cell & 7;
+            uint bit = (c.z * 8 + c.y) * 8 + c.x;
+            if (bricks[brick * 16 + (bit >> 5)] & (1u << (bit & 31)))
+            {
+                result = (float4) ((convert_float3 (cell - keyOffset) + 0.5f) * resolution, t * resolution);
+                break;
+            }
+        }
+
+        // Step to the next cell, breaking ties like OcTree::castRay
+        if (tMax.x < tMax.y)
+        {
+            if (tMax.x < tMax.z) { cell.x += step.x; t = tMax.x; tMax.x += tDelta.x; }
+            else                 { cell.z += step.z; t = tMax.z; tMax.z += tDelta.z; }
+        }
+        else
+        {
+            if (tMax.y < tMax.z) { cell.y += step.y; t = tMax.y; tMax.y += tDelta.y; }
+            else                 { cell.z += step.z; t = tMax.z; tMax.z += tDelta.z; }
+        }
+    }
 
-    float8 point = pc8d[gX];
-    vstore3 (point.s012 * 0.001f, gX, pc3d);
-    vstore3 (convert_uchar3 (point.s456 * 255.f), gX, rgb);
+    hits[gX] = result;
 }
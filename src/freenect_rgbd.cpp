@@ -35,7 +35,9 @@
  *  \param[in] idx index of the device on the bus.
  */
 Kinect::Kinect (freenect_context *ctx, int idx) : 
-    Freenect::FreenectDevice (ctx, idx), newRGBFrame (false), newDepthFrame (false), 
+    Freenect::FreenectDevice (ctx, idx), rgbPtr (nullptr), depthPtr (nullptr), 
+    newRGBFrame (false), newDepthFrame (false), 
+    rgbTimestamp (0), depthTimestamp (0), 
     width (freenect_find_video_mode (FREENECT_RESOLUTION_MEDIUM, FREENECT_VIDEO_RGB).width), 
     height (freenect_find_video_mode (FREENECT_RESOLUTION_MEDIUM, FREENECT_VIDEO_RGB).height)
 {
@@ -54,6 +56,7 @@ void Kinect::VideoCallback (void *rgb, uint32_t timestamp)
     std::lock_guard<std::mutex> lock (rgbMutex);
     
     std::copy ((cl_uchar *) rgb, (cl_uchar *) rgb + getVideoBufferSize (), rgbPtr);
+    rgbTimestamp = timestamp;
     newRGBFrame = true;
 }
 
@@ -68,6 +71,7 @@ void Kinect::DepthCallback (void *depth, uint32_t timestamp)
     std::lock_guard<std::mutex> lock (depthMutex);
     
     std::copy ((cl_ushort *) depth, (cl_ushort *) depth + getDepthBufferSize () / 2, depthPtr);
+    depthTimestamp = timestamp;
     newDepthFrame = true;
 }
 
@@ -90,14 +94,31 @@ void Kinect::setBuffers (cl::CommandQueue &queue, cl::Buffer &hBufferRGB, cl::Bu
 }
 
 
+/*! \details The buffers are owned by the object, and they are used instead of 
+ *           any OpenCL buffers that were set before.
+ */
+void Kinect::setBuffers ()
+{
+    std::lock_guard<std::mutex> lockRGB (rgbMutex);
+    std::lock_guard<std::mutex> lockDepth (depthMutex);
+
+    hostRGB.resize (width * height * 3);
+    hostDepth.resize (width * height);
+    rgbPtr = hostRGB.data ();
+    depthPtr = hostDepth.data ();
+}
+
+
 /*! \note Transfers the frames from the staging buffers to the provided device buffers.
  *
  *  \param[in] queue command queue that will handle the frame transfers.
  *  \param[out] rgb OpenCL buffer to which to transfer the RGB frame.
  *  \param[out] depth OpenCL buffer to which to transfer the Depth frame.
+ *  \param[out] timestamp time stamp reported by the sensor for the Depth frame.
  *  \return A flag to indicate whether new frames were present and got transfered.
  */
-bool Kinect::deliverFrames (cl::CommandQueue &queue, cl::Buffer &rgb, cl::Buffer &depth)
+bool Kinect::deliverFrames (cl::CommandQueue &queue, cl::Buffer &rgb, cl::Buffer &depth, 
+                            uint32_t *timestamp)
 {
     std::lock_guard<std::mutex> lockRGB (rgbMutex);
     std::lock_guard<std::mutex> lockDepth (depthMutex);
@@ -109,6 +130,37 @@ bool Kinect::deliverFrames (cl::CommandQueue &queue, cl::Buffer &rgb, cl::Buffer
     queue.enqueueWriteBuffer (rgb, CL_FALSE, 0, getVideoBufferSize (), (void *) rgbPtr);
     queue.enqueueWriteBuffer (depth, CL_TRUE, 0, getDepthBufferSize (), (void *) depthPtr);
     
+    if (timestamp != nullptr)
+        *timestamp = depthTimestamp;
+
+    newRGBFrame = false;
+    newDepthFrame = false;
+
+    return true;
+}
+
+
+/*! \note Copies the frames from the staging buffers to the provided arrays.
+ *
+ *  \param[out] rgb array (`3 * width * height` elements) to which to copy the RGB frame.
+ *  \param[out] depth array (`width * height` elements) to which to copy the Depth frame.
+ *  \param[out] timestamp time stamp reported by the sensor for the Depth frame.
+ *  \return A flag to indicate whether new frames were present and got copied.
+ */
+bool Kinect::deliverFrames (uint8_t *rgb, uint16_t *depth, uint32_t *timestamp)
+{
+    std::lock_guard<std::mutex> lockRGB (rgbMutex);
+    std::lock_guard<std::mutex> lockDepth (depthMutex);
+    
+    if (!newRGBFrame || !newDepthFrame)
+        return false;
+
+    std::copy (rgbPtr, rgbPtr + getVideoBufferSize (), rgb);
+    std::copy (depthPtr, depthPtr + getDepthBufferSize () / 2, depth);
+    
+    if (timestamp != nullptr)
+        *timestamp = depthTimestamp;
+
     newRGBFrame = false;
     newDepthFrame = false;
 
@@ -49,13 +49,8 @@ float zoom = 1.0f;
 // OpenGL buffer parameters
 GLuint glPC4DBuffer, glRGBABuffer;
 
-// Point cloud parameters
-const int width = 640;
-const int height = 480;
-
 // OpenCL parameters
-extern OCLSLAM<ICP::ICPStepConfigT::POWER_METHOD, 
-    ICP::ICPStepConfigW::WEIGHTED> *slam;
+extern OCLSLAMBase *slam;
 
 extern std::mutex glMtx;  // Controls access to OpenGL buffers
 extern std::mutex mapMtx;  // Controls access to the map
@@ -77,7 +72,7 @@ void drawGLScene ()
     glColorPointer (4, GL_FLOAT, 0, NULL);
     glEnableClientState (GL_COLOR_ARRAY);
 
-    glDrawArrays (GL_POINTS, 0, slam->timeStep * width * height);
+    glDrawArrays (GL_POINTS, 0, slam->getTimeStep () * slam->getWidth () * slam->getHeight ());
 
     glDisableClientState (GL_VERTEX_ARRAY);
     glDisableClientState (GL_COLOR_ARRAY);
@@ -133,15 +128,16 @@ void resizeGLScene (int width, int height)
 /*! \details The timestamp has the following format YYYYMMDDHHMMSS.
  *
  *  \param[in] type file type.
+ *  \param[in] prefix first part of the filename.
  *  \return A complete filename with the current timestamp.
  */
-std::string setFilename (const char *type)
+std::string setFilename (const char *type, const char *prefix)
 {
     time_t now = time (0);
     tm *ltm = localtime (&now);
 
     std::ostringstream dt;
-    dt << "map_" << 1900 + ltm->tm_year << 1 + ltm->tm_mon << ltm->tm_mday 
+    dt << prefix << "_" << 1900 + ltm->tm_year << 1 + ltm->tm_mon << ltm->tm_mday 
        << ltm->tm_hour << ltm->tm_min << ltm->tm_sec << "." << type;
 
     return dt.str ();
@@ -155,6 +151,8 @@ void keyPressed (unsigned char key, int x, int y)
         case 0x1B:  // ESC
         case  'Q':
         case  'q':
+            if (slam->getTraceStatus ()) slam->stopTrace ();
+            slam->waitForWrite ();
             glMtx.lock ();
             mapMtx.lock ();
             glutDestroyWindow (glWinId);
@@ -176,6 +174,16 @@ void keyPressed (unsigned char key, int x, int y)
             slam->toggleSLAMStatus ();
             std::cout << "SLAM " << slam->getSLAMStatus () << std::endl;
             break;
+        case 'L':
+        case 'l':
+            slam->toggleLoopClosureStatus ();
+            std::cout << "Loop Closure " << slam->getLoopClosureStatus () << std::endl;
+            break;
+        case 'D':
+        case 'd':
+            slam->toggleDeviceICPStatus ();
+            std::cout << "Device ICP " << slam->getDeviceICPStatus () << std::endl;
+            break;
         case 'I':
         case 'i':
             std::thread ([&] { slam->init (); }).detach ();
@@ -192,6 +200,22 @@ void keyPressed (unsigned char key, int x, int y)
         case 'b':
             std::thread ([&] { slam->writeBinary (setFilename ("bt")); }).detach ();
             break;
+        case 'T':
+        case 't':
+            if (slam->getTrajectoryLogStatus ())
+                slam->stopTrajectoryLog ();
+            else
+                slam->startTrajectoryLog (setFilename ("txt", "trajectory"));
+            std::cout << "Trajectory Log " << slam->getTrajectoryLogStatus () << std::endl;
+            break;
+        case 'P':
+        case 'p':
+            if (slam->getTraceStatus ())
+                slam->stopTrace ();
+            else
+                slam->startTrace (setFilename ("json", "trace"));
+            std::cout << "Trace " << slam->getTraceStatus () << std::endl;
+            break;
     }
 }
 
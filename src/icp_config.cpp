@@ -0,0 +1,300 @@
+/*! \file icp_config.cpp
+ *  \brief Defines the tools for naming, benchmarking, and selecting the `ICP` configurations.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <oclslam/program_cache.hpp>
+#include <oclslam/cpu/algorithms.hpp>
+#include <icp_config.hpp>
+
+using namespace cl_algo;
+
+
+const std::vector<std::string> kernel_files_rbc = { "kernels/RBC/reduce_kernels.cl", 
+                                                    "kernels/RBC/scan_kernels.cl", 
+                                                    "kernels/RBC/rbc_kernels.cl" };
+
+const std::vector<std::string> kernel_files_icp = { "kernels/ICP/reduce_kernels.cl", 
+                                                    "kernels/ICP/icp_kernels.cl" };
+
+const std::string kernel_file_placeholder = "kernels/oclslam/placeholder.cl";
+
+
+/*! \param[in] CR method of rotation computation.
+ *  \param[in] CW regular or weighted computation.
+ *  \return The name of the configuration.
+ */
+std::string getICPConfigName (ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW)
+{
+    std::string name = (CR == ICP::ICPStepConfigT::EIGEN) ? "eigen" : "power";
+    return name + ((CW == ICP::ICPStepConfigW::REGULAR) ? "-regular" : "-weighted");
+}
+
+
+/*! \param[in] name name of the configuration, `{eigen,power}-{regular,weighted}`.
+ *  \param[out] CR method of rotation computation.
+ *  \param[out] CW regular or weighted computation.
+ *  \return `false` if the name isn't recognized.
+ */
+bool parseICPConfigName (const std::string &name, ICP::ICPStepConfigT &CR, ICP::ICPStepConfigW &CW)
+{
+    for (ICP::ICPStepConfigT cr : { ICP::ICPStepConfigT::EIGEN, ICP::ICPStepConfigT::POWER_METHOD })
+    {
+        for (ICP::ICPStepConfigW cw : { ICP::ICPStepConfigW::REGULAR, ICP::ICPStepConfigW::WEIGHTED })
+        {
+            if (name == getICPConfigName (cr, cw))
+            {
+                CR = cr; CW = cw;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+/*! \param[in] side side of the landmark grid.
+ *  \param[in] R rotation that maps the moving landmarks onto the fixed ones.
+ *  \param[in] t translation (in mm) that maps the moving landmarks onto the fixed ones.
+ *  \param[out] F fixed landmarks.
+ *  \param[out] M moving landmarks.
+ */
+void generateLandmarks (unsigned int side, const Eigen::Matrix3f &R, const Eigen::Vector3f &t, 
+                        std::vector<cl_float8> &F, std::vector<cl_float8> &M)
+{
+    const unsigned int m = side * side;
+
+    F.resize (m); M.resize (m);
+    for (unsigned int k = 0; k < m; ++k)
+    {
+        float x = 15.f * ((int) (k % side) - (int) side / 2);
+        float y = 15.f * ((int) (k / side) - (int) side / 2);
+        float z = 2000.f + 150.f * std::sin (x / 250.f) * std::cos (y / 300.f) + 0.1f * x;
+        Eigen::Vector3f pF (x, y, z);
+        Eigen::Vector3f pM = R.transpose () * (pF - t);
+        Eigen::Vector3f c (0.5f + 0.5f * std::sin (x / 200.f), 0.5f + 0.5f * std::cos (y / 200.f), 
+                           0.5f + 0.5f * std::sin ((x + y) / 300.f));
+
+        F[k] = { pF[0], pF[1], pF[2], 1.f, c[0], c[1], c[2], 1.f };
+        M[k] = { pM[0], pM[1], pM[2], 1.f, c[0], c[1], c[2], 1.f };
+    }
+}
+
+
+
+namespace
+{
+    /*! \brief Times the registration of two landmark sets with an `ICP` configuration.
+     *  \details The parameters are the defaults of the `SLAM` pipeline.
+     *
+     *  \param[in] env OpenCL environment with the `RBC` and `ICP` programs.
+     *  \param[in] F fixed landmarks.
+     *  \param[in] M moving landmarks.
+     *  \param[in] R true rotation that maps the moving landmarks onto the fixed ones.
+     *  \param[in] t true translation (in mm) that maps the moving landmarks onto the fixed ones.
+     *  \param[in] repeats number of timed registrations.
+     *  \return The results of the benchmark.
+     */
+    template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+    ICPBenchmarkResult benchmarkICPConfig (clutils::CLEnv &env, std::vector<cl_float8> &F, 
+                                           std::vector<cl_float8> &M, const Eigen::Matrix3f &R, 
+                                           const Eigen::Vector3f &t, unsigned int repeats)
+    {
+        const unsigned int m = F.size (), r = 256;
+        cl::Context &context = env.getContext (0);
+        cl::CommandQueue &queue = env.getQueue (0, 0);
+        clutils::CLEnvInfo<1> infoRBC (0, 0, 0, { 0 }, 0), infoICP (0, 0, 0, { 0 }, 1);
+
+        ICP::ICP<CR, CW> icp (env, infoRBC, infoICP);
+        icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F) = cl::Buffer (context, CL_MEM_READ_WRITE, m * sizeof (cl_float8));
+        icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M) = cl::Buffer (context, CL_MEM_READ_WRITE, m * sizeof (cl_float8));
+        icp.init (m, r, 2e2f, 1e-6f, 40, 0.001, 0.01, ICP::Staging::NONE);
+
+        queue.enqueueWriteBuffer ((cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F), 
+            CL_FALSE, 0, m * sizeof (cl_float8), F.data ());
+        queue.enqueueWriteBuffer ((cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M), 
+            CL_TRUE, 0, m * sizeof (cl_float8), M.data ());
+
+        icp.buildRBC ();
+        icp.run ();  // Warm up
+        queue.finish ();
+
+        clutils::CPUTimer<double, std::milli> timer;
+        double total = 0.0;
+        for (unsigned int i = 0; i < repeats; ++i)
+        {
+            icp.buildRBC ();
+            queue.finish ();
+
+            timer.start ();
+            icp.run ();
+            queue.finish ();
+            total += timer.stop ();
+        }
+
+        ICPBenchmarkResult result = { CR, CW, total / repeats, INFINITY, INFINITY };
+        if (std::isfinite (icp.R.sum ()) && std::isfinite (icp.t.sum ()))
+        {
+            result.rotError = 180.0 / M_PI * Eigen::AngleAxisf (icp.R * R.transpose ()).angle ();
+            result.transError = (icp.t - t).norm ();
+        }
+
+        return result;
+    }
+}
+
+
+/*! \details The benchmark runs on a separate (not GL-shared) OpenCL environment 
+ *           on the first device, so it can be done before the pipeline is created. 
+ *           The landmarks are sampled from a synthetic smooth surface, and the 
+ *           moving set is displaced by a known transformation.
+ *
+ *  \param[in] repeats number of timed registrations for each configuration.
+ *  \return The results for all configurations.
+ */
+std::vector<ICPBenchmarkResult> benchmarkICP (unsigned int repeats)
+{
+    const unsigned int side = 128, m = side * side;
+
+    clutils::CLEnv env;
+    env.addContext (0);
+    env.addQueue (0, 0);
+    oclslam::ProgramCache cache;
+    oclslam::addPrograms (env, 0, { { kernel_files_rbc, "" }, { kernel_files_icp, "" } }, 
+                          cache, kernel_file_placeholder);
+
+    // Known transformation
+    Eigen::Matrix3f R = Eigen::AngleAxisf (2.f * M_PI / 180.f, 
+        Eigen::Vector3f (1.f, 2.f, 3.f).normalized ()).toRotationMatrix ();
+    Eigen::Vector3f t (20.f, -15.f, 30.f);
+
+    // Landmarks on a smooth colored surface (in mm)
+    std::vector<cl_float8> F, M;
+    generateLandmarks (side, R, t, F, M);
+
+    std::vector<ICPBenchmarkResult> results;
+    results.push_back (benchmarkICPConfig<ICP::ICPStepConfigT::EIGEN, ICP::ICPStepConfigW::REGULAR> (
+        env, F, M, R, t, repeats));
+    results.push_back (benchmarkICPConfig<ICP::ICPStepConfigT::EIGEN, ICP::ICPStepConfigW::WEIGHTED> (
+        env, F, M, R, t, repeats));
+    results.push_back (benchmarkICPConfig<ICP::ICPStepConfigT::POWER_METHOD, ICP::ICPStepConfigW::REGULAR> (
+        env, F, M, R, t, repeats));
+    results.push_back (benchmarkICPConfig<ICP::ICPStepConfigT::POWER_METHOD, ICP::ICPStepConfigW::WEIGHTED> (
+        env, F, M, R, t, repeats));
+
+    return results;
+}
+
+
+/*! \details It runs on the same synthetic landmarks as `benchmarkICP`, on all the 
+ *           hardware threads, and, as there, the construction of the `RBC` isn't 
+ *           timed. The `CPU` registration solves for the rotation in closed form 
+ *           and weighs all pairs equally, so the result is reported as `eigen-regular`.
+ *
+ *  \param[in] repeats number of timed registrations.
+ *  \return The results of the benchmark.
+ */
+ICPBenchmarkResult benchmarkCPUICP (unsigned int repeats)
+{
+    const unsigned int side = 128, m = side * side;
+
+    // Known transformation
+    Eigen::Matrix3f R = Eigen::AngleAxisf (2.f * M_PI / 180.f, 
+        Eigen::Vector3f (1.f, 2.f, 3.f).normalized ()).toRotationMatrix ();
+    Eigen::Vector3f t (20.f, -15.f, 30.f);
+
+    // Landmarks on a smooth colored surface (in mm)
+    std::vector<cl_float8> F, M;
+    generateLandmarks (side, R, t, F, M);
+
+    oclslam::cpu::ThreadPool pool;
+    oclslam::cpu::ICP icp (pool);
+    icp.init (m, 256, 2e2f, 40, 0.001, 0.01);
+    icp.buildRBC ((const float *) F.data ());
+    icp.run ((const float *) M.data ());  // Warm up
+
+    clutils::CPUTimer<double, std::milli> timer;
+    double total = 0.0;
+    for (unsigned int i = 0; i < repeats; ++i)
+    {
+        timer.start ();
+        icp.run ((const float *) M.data ());
+        total += timer.stop ();
+    }
+
+    ICPBenchmarkResult result = { ICP::ICPStepConfigT::EIGEN, ICP::ICPStepConfigW::REGULAR, 
+                                  total / repeats, INFINITY, INFINITY };
+    if (std::isfinite (icp.R.sum ()) && std::isfinite (icp.t.sum ()))
+    {
+        result.rotError = 180.0 / M_PI * Eigen::AngleAxisf (icp.R * R.transpose ()).angle ();
+        result.transError = (icp.t - t).norm ();
+    }
+
+    return result;
+}
+
+
+/*! \param[out] CR method of rotation computation of the selected configuration.
+ *  \param[out] CW regular or weighted computation of the selected configuration.
+ *  \param[in] maxRotError maximum rotation error (in degrees).
+ *  \param[in] maxTransError maximum translation error (in mm).
+ *  \param[in] repeats number of timed registrations for each configuration.
+ *  \return `false` if no configuration meets the accuracy threshold. 
+ *          In that case, `CR` and `CW` are left untouched.
+ */
+bool selectICPConfig (ICP::ICPStepConfigT &CR, ICP::ICPStepConfigW &CW, 
+                      double maxRotError, double maxTransError, unsigned int repeats)
+{
+    std::vector<ICPBenchmarkResult> results = benchmarkICP (repeats);
+
+    const ICPBenchmarkResult *best = nullptr;
+    for (const ICPBenchmarkResult &res : results)
+    {
+        bool accurate = res.rotError <= maxRotError && res.transError <= maxTransError;
+        std::cout << "    " << std::left << std::setw (16) << getICPConfigName (res.CR, res.CW) << std::right
+                  << " :    " << res.latency << " [ms], errors " << res.rotError << " [degrees], " 
+                  << res.transError << " [mm]" << (accurate ? "" : " (rejected)") << std::endl;
+
+        if (accurate && (best == nullptr || res.latency < best->latency))
+            best = &res;
+    }
+
+    // The native registration, for reference
+    ICPBenchmarkResult cpu = benchmarkCPUICP (repeats);
+    std::cout << "    " << std::left << std::setw (16) << "cpu (baseline)" << std::right
+              << " :    " << cpu.latency << " [ms], errors " << cpu.rotError << " [degrees], " 
+              << cpu.transError << " [mm]" << std::endl;
+
+    if (best == nullptr) return false;
+
+    CR = best->CR;
+    CW = best->CW;
+    return true;
+}
@@ -26,6 +26,11 @@
  *  THE SOFTWARE.
  */
 
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
 #include <thread>
 #include <mutex>
 #include <chrono>
@@ -46,30 +51,180 @@ const std::vector<std::string> kernel_files_gf = { "kernels/GF/imageSupport_kern
                                                    "kernels/GF/math_kernels.cl", 
                                                    "kernels/GF/guidedFilter_kernels.cl" };
 
-const std::vector<std::string> kernel_files_rbc = { "kernels/RBC/reduce_kernels.cl", 
-                                                    "kernels/RBC/scan_kernels.cl", 
-                                                    "kernels/RBC/rbc_kernels.cl" };
+const std::vector<std::string> kernel_files_slam = { "kernels/oclslam/slam_kernels.cl" };
 
-const std::vector<std::string> kernel_files_icp = { "kernels/ICP/reduce_kernels.cl", 
-                                                    "kernels/ICP/icp_kernels.cl" };
 
-const std::vector<std::string> kernel_files_slam = { "kernels/oclslam/slam_kernels.cl" };
+/*! \param[in] spec placement description, e.g. `pre=1:0,icp=gl`. 
+ *                  A stage that isn't mentioned stays on the GL device.
+ *  \param[out] placement parsed placement.
+ *  \return A flag to indicate whether the description is valid.
+ */
+bool parseStagePlacement (const std::string &spec, StagePlacement &placement)
+{
+    StagePlacement parsed;
+    std::istringstream ss (spec);
+    std::string item;
+    while (std::getline (ss, item, ','))
+    {
+        size_t eq = item.find ('=');
+        if (eq == std::string::npos) return false;
+        std::string stage = item.substr (0, eq), device = item.substr (eq + 1);
+
+        StageDevice dev;
+        if (device != "gl")
+        {
+            int p; unsigned int d; char sep, rest;
+            std::istringstream ds (device);
+            if (!(ds >> p >> sep >> d) || sep != ':' || p < 0 || (ds >> rest)) return false;
+            dev = StageDevice (p, d);
+        }
+
+        if (stage == "pre") parsed.pre = dev;
+        else if (stage == "icp") parsed.icp = dev;
+        else return false;
+    }
+
+    placement = parsed;
+    return true;
+}
 
 
 /*! \param[in] width width (in pixels) of the associated point clouds.
  *  \param[in] height height (in pixels) of the associated point clouds.
  *  \param[in] numPC maximum number of point clouds that the OpenGL buffers will hold.
+ *  \param[in] placement devices for the preprocessing and ICP stages.
+ *  \param[in] profiling flag to enable profiling on the queues.
  */
-CLEnvGL::CLEnvGL (int width, int height, int numPC) : 
-    CLEnv (), width (width), height (height), numPC (numPC)
+CLEnvGL::CLEnvGL (int width, int height, int numPC, const StagePlacement &placement, bool profiling) : 
+    CLEnv (), width (width), height (height), numPC (numPC), 
+    queueProps (profiling ? CL_QUEUE_PROFILING_ENABLE : 0), variants (*this)
 {
-    addContext (0, true);
-    addQueueGL (0);
-    addQueueGL (0);
-    addProgram (0, kernel_files_gf);
-    addProgram (0, kernel_files_rbc);
-    addProgram (0, kernel_files_icp);
-    addProgram (0, kernel_files_slam);
+    // The programs are loaded from the binary cache, and the missing ones are built in parallel
+    oclslam::ProgramCache cache;
+
+    stageLoc[(int) Stage::POST] = addDevice (StageDevice (), cache);
+    stageLoc[(int) Stage::PRE] = addDevice (placement.pre, cache);
+    stageLoc[(int) Stage::ICP] = addDevice (placement.icp, cache);
+
+    std::cout << "OpenCL programs: " << cache.getHits () << " cached, " 
+              << cache.getMisses () << " built" << std::endl;
+
+    if (locations.size () > 1)
+    {
+        const char *names[] = { "Preprocessing", "ICP", "Postprocessing" };
+        for (int s = 0; s < 3; ++s)
+        {
+            Location &loc = getLocation ((Stage) s);
+            cl::Device device = getContext (loc.ctx).getInfo<CL_CONTEXT_DEVICES> ()[loc.dev];
+            std::cout << names[s] << " on " << device.getInfo<CL_DEVICE_NAME> () << std::endl;
+        }
+    }
+}
+
+
+/*! \details The GL device is added first, and gets context `0`. Any other device 
+ *           gets a context that holds all the devices of its platform, so that stages 
+ *           on the same platform can exchange buffers without going through the host.
+ *
+ *  \param[in] device device to add.
+ *  \param[in] cache cache for building the programs.
+ *  \return The index of the device's location.
+ */
+unsigned int CLEnvGL::addDevice (const StageDevice &device, oclslam::ProgramCache &cache)
+{
+    for (unsigned int i = 0; i < locations.size (); ++i)
+        if (locations[i].first == device) return i;
+
+    Location loc;
+    if (device.isGL ())
+    {
+        loc.ctx = 0; loc.dev = 0;
+        addContext (0, true);
+        ctxPlatforms.push_back (-1);
+        ctxQueues.push_back (0);
+        pools.emplace_back (new oclslam::BufferPool (getContext (loc.ctx)));
+    }
+    else
+    {
+        std::vector<cl::Platform> platforms;
+        cl::Platform::get (&platforms);
+        std::vector<cl::Device> devices;
+        if ((size_t) device.platform < platforms.size ())
+            platforms[device.platform].getDevices (CL_DEVICE_TYPE_ALL, &devices);
+        if (device.device >= devices.size ())
+        {
+            std::cerr << "Error[CLEnvGL]: There is no device " << device.device 
+                      << " on platform " << device.platform << std::endl;
+            exit (EXIT_FAILURE);
+        }
+
+        auto it = std::find (ctxPlatforms.begin (), ctxPlatforms.end (), device.platform);
+        loc.ctx = it - ctxPlatforms.begin ();
+        loc.dev = device.device;
+        if (it == ctxPlatforms.end ())
+        {
+            addContext (device.platform);
+            ctxPlatforms.push_back (device.platform);
+            ctxQueues.push_back (0);
+            pools.emplace_back (new oclslam::BufferPool (getContext (loc.ctx)));
+        }
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (device.isGL ()) addQueueGL (loc.ctx, queueProps); else addQueue (loc.ctx, loc.dev, queueProps);
+        loc.q[i] = ctxQueues[loc.ctx]++;
+    }
+
+    loc.pg = locations.size () * NUM_PROGRAMS;
+    oclslam::addPrograms (*this, loc.ctx, { { kernel_files_gf, "" }, { kernel_files_rbc, "" }, 
+                                            { kernel_files_icp, "" }, { kernel_files_slam, "" } }, 
+                          cache, kernel_file_placeholder, loc.dev);
+    variants.add (loc.pg + PROGRAM_SLAM, loc.ctx, { kernel_files_slam, "" }, loc.dev);
+
+    locations.emplace_back (device, loc);
+    return locations.size () - 1;
+}
+
+
+CLEnvGL::Location& CLEnvGL::getLocation (Stage stage)
+{
+    return locations[stageLoc[(int) stage]].second;
+}
+
+
+/*! \details The info points at the stage's context and its two queues. 
+ *           The classes of the pipeline take the first context index as 
+ *           the context, and the second as the queue group.
+ *
+ *  \param[in] stage stage of the pipeline.
+ *  \param[in] program program that provides the kernels.
+ *  \param[in] qFirst index of the stage queue (`0` or `1`) to list first. 
+ *                    The classes enqueue their kernels on the first queue.
+ *  \return The environment info.
+ */
+clutils::CLEnvInfo<2> CLEnvGL::getStageInfo (Stage stage, Program program, unsigned int qFirst)
+{
+    Location &loc = getLocation (stage);
+    return clutils::CLEnvInfo<2> (loc.ctx, loc.ctx, loc.dev, 
+        { loc.q[qFirst], loc.q[1 - qFirst] }, loc.pg + program);
+}
+
+
+/*! \param[in] stage stage of the pipeline.
+ *  \param[in] qIdx index of the queue (`0` or `1`).
+ *  \return The command queue.
+ */
+cl::CommandQueue& CLEnvGL::getStageQueue (Stage stage, unsigned int qIdx)
+{
+    Location &loc = getLocation (stage);
+    return getQueue (loc.ctx, loc.q[qIdx]);
+}
+
+
+bool CLEnvGL::shareQueues (Stage a, Stage b)
+{
+    return stageLoc[(int) a] == stageLoc[(int) b];
 }
 
 
@@ -90,33 +245,97 @@ void CLEnvGL::initGLMemObjects ()
 
 /*! \details Initializes the OpenCL environment, the OpenGL buffers, 
  *           and the classes for the `SLAM` pipeline.
+ *  \note When the preprocessing runs on a device other than the ICP 
+ *        or the postprocessing, the landmarks and the point cloud get 
+ *        explicitly transferred between the devices at every time step.
  *  
  *  \param[in] kinect initialized Kinect device.
  *  \param[in] map OctoMap structure for building the map.
+ *  \param[in] placement devices for the stages of the pipeline.
+ *  \param[in] profiling flag to create the queues with profiling enabled, 
+ *                       which is required for `startTrace`.
+ *  \param[in] _decimation factor by which the sensor frames get downsampled on the 
+ *                         device, before any processing. It's either 1 or 2, and any 
+ *                         other value is treated as 1. The point clouds, and the 
+ *                         number of landmarks and representatives, follow the 
+ *                         resolution of the frames.
  */
 template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
-OCLSLAM<CR, CW>::OCLSLAM (Kinect *kinect, octomap::OcTree &map) : 
-    timeStep (0), map (map), gfRGBRadius (5), gfRGBEps (0.02f), gfDRadius (10), 
+OCLSLAM<CR, CW>::OCLSLAM (Kinect *kinect, octomap::OcTree &map, const StagePlacement &placement, 
+                          bool profiling, unsigned int _decimation) : 
+    timeStep (0), frameCount (0), map (map), gfRGBRadius (5), gfRGBEps (0.02f), gfDRadius (10), 
     gfDEps (0.01f), gfDScaling (1e-3f), focalLength (595.f), a (2e2f), c (1e-6f), 
     max_iterations (40), angle_threshold (0.001), translation_threshold (0.01), 
     slamStatus (false), gfRGBStatus (true), gfDStatus (true), rgbNorm (1), 
-    maxPCGL (200), width (640), height (480), n (640 * 480), m (16384), r (256), 
-    env (width, height, maxPCGL), infoGF (0, 0, 0, { 0, 1 }, 0), infoRBC (0, 0, 0, { 0 }, 1), 
-    infoICP (0, 0, 0, { 0 }, 2), infoSLAM (0, 0, 0, { 0 }, 3), context (env.getContext (0)), 
-    queue0 (env.getQueue (0, 0)), queue1 (env.getQueue (0, 1)), kinect (kinect), 
-    gfRGB (env, infoGF), gfD (env, infoGF), sepRGB (env, infoGF.getCLEnvInfo (0)), 
-    convD (env, infoGF.getCLEnvInfo (0)), to8D (env, infoGF.getCLEnvInfo (0)), lm (env, infoICP), 
-    icp (env, infoRBC, infoICP), transform (env, infoICP), sp8D (env, infoGF.getCLEnvInfo (1)), 
-    sp8DMap (env, infoSLAM.getCLEnvInfo (0)), waitListGL (1), lICP (0), pc (n) //, cc (n)
+    loopClosureStatus (true), deviceICPStatus (false), kfDistance (300.f), kfAngle (15.f), 
+    inlierDistance (50.f), minInlierRatio (0.5f), maxResidual (20.f), maxJumpDistance (200.f), maxJumpAngle (20.f), maxJumpScale (0.1f), maxPCGL (200), 
+    decimation (_decimation == 2 ? 2 : 1), width (kinect->getWidth () / decimation), 
+    height (kinect->getHeight () / decimation), n (width * height), 
+    lmSide (oclslam::ICPLMsGrid::getSide (width, height)), m (lmSide * lmSide), r (2 * lmSide), 
+    env (width, height, maxPCGL, placement, profiling), 
+    infoGF (env.getStageInfo (CLEnvGL::Stage::PRE, CLEnvGL::PROGRAM_GF)), 
+    infoGFD (env.getStageInfo (CLEnvGL::Stage::PRE, CLEnvGL::PROGRAM_GF, 1)), 
+    infoRBC (env.getStageInfo (CLEnvGL::Stage::ICP, CLEnvGL::PROGRAM_RBC).getCLEnvInfo (0)), 
+    infoICP (env.getStageInfo (CLEnvGL::Stage::ICP, CLEnvGL::PROGRAM_ICP).getCLEnvInfo (0)), 
+    infoSLAM (env.getStageInfo (CLEnvGL::Stage::ICP, CLEnvGL::PROGRAM_SLAM).getCLEnvInfo (0)), 
+    infoLM (env.getStageInfo (CLEnvGL::Stage::PRE, CLEnvGL::PROGRAM_SLAM).getCLEnvInfo (0)), 
+    infoTransform (env.getStageInfo (CLEnvGL::Stage::POST, CLEnvGL::PROGRAM_ICP).getCLEnvInfo (0)), 
+    infoGL (env.getStageInfo (CLEnvGL::Stage::POST, CLEnvGL::PROGRAM_GF).getCLEnvInfo (1)), 
+    infoMap (env.getStageInfo (CLEnvGL::Stage::POST, CLEnvGL::PROGRAM_SLAM).getCLEnvInfo (0)), 
+    context (env.getStageContext (CLEnvGL::Stage::POST)), 
+    contextPre (env.getStageContext (CLEnvGL::Stage::PRE)), 
+    contextICP (env.getStageContext (CLEnvGL::Stage::ICP)), 
+    queue0 (env.getStageQueue (CLEnvGL::Stage::POST, 0)), queue1 (env.getStageQueue (CLEnvGL::Stage::POST, 1)), 
+    queuePre (env.getStageQueue (CLEnvGL::Stage::PRE)), queueICP (env.getStageQueue (CLEnvGL::Stage::ICP)), 
+    kinect (kinect), gfRGB (env, infoGF), gfD (env, infoGFD), sepRGB (env, infoGF.getCLEnvInfo (0)), 
+    convD (env, infoGFD.getCLEnvInfo (0)), to8D (env, infoGF.getCLEnvInfo (0)), 
+    down (env, infoLM, &env.getStagePool (CLEnvGL::Stage::PRE), &env.getVariants ()), 
+    lm (env, infoLM, &env.getStagePool (CLEnvGL::Stage::PRE), &env.getVariants ()), 
+    icp (env, infoRBC, infoICP), transform (env, infoTransform), sp8D (env, infoGL), 
+    sp8DMap (env, infoMap, &env.getStagePool (CLEnvGL::Stage::POST), &env.getTuner (), &env.getVariants ()), 
+    residuals (env, infoSLAM.getCLEnvInfo (0), &env.getStagePool (CLEnvGL::Stage::ICP), &env.getTuner ()), 
+    devICP (env, infoSLAM.getCLEnvInfo (0), &env.getStagePool (CLEnvGL::Stage::ICP), &env.getTuner ()), 
+    R_icp (Eigen::Matrix3f::Identity ()), t_icp (Eigen::Vector3f::Zero ()), 
+    s_icp (1.f), k_icp (0), lICP (0), lPre (0), latency (0), 
+    hostTimestamp (0.0), sensorTimestamp (0), pc (n), //, cc (n)
+    tiles (map.getResolution ()), kfFrame (0), kfPending (false), trackingLost (false), lostFrames (0), inlierRatio (1.f), rmsResidual (0.f), 
+    maxKFLMs (32), kfStored (0), relocCandidates (3), kfLMsPoses (maxKFLMs)
 {
+    oclslam::BufferPool &poolPre = env.getStagePool (CLEnvGL::Stage::PRE);
+    oclslam::BufferPool &poolICP = env.getStagePool (CLEnvGL::Stage::ICP);
+    oclslam::BufferPool &poolPost = env.getStagePool (CLEnvGL::Stage::POST);
+    bool sharedPost = env.shareQueues (CLEnvGL::Stage::PRE, CLEnvGL::Stage::POST);
+
+    // The buffers of a time step that are never live at the same time share device memory. 
+    // The steps are: 0 frame delivery, 1 filtering, 2 8-D point cloud, 3 landmarks, 
+    // 4 transformation, 5 splitting. The transformed point cloud takes part only 
+    // when it's computed on the same queue. The sensor frames, when downsampled, 
+    // are done with by the end of the delivery.
+    const unsigned int nS = kinect->getWidth () * kinect->getHeight ();
+    unsigned int bRGBS = (decimation > 1) ? framePlan.add (nS * 3 * sizeof (cl_uchar), 0, 0) : 0;
+    unsigned int bDS = (decimation > 1) ? framePlan.add (nS * sizeof (cl_ushort), 0, 0) : 0;
+    unsigned int bRGB = framePlan.add (n * 3 * sizeof (cl_uchar), 0, 1);
+    unsigned int bD = framePlan.add (n * sizeof (cl_ushort), 0, 1);
+    unsigned int bFD = framePlan.add (n * sizeof (cl_float), 1, 2);
+    unsigned int bFR = framePlan.add (n * sizeof (cl_float), 1, 2);
+    unsigned int bFG = framePlan.add (n * sizeof (cl_float), 1, 2);
+    unsigned int bFB = framePlan.add (n * sizeof (cl_float), 1, 2);
+    unsigned int bPC = framePlan.add (n * sizeof (cl_float8), 2, 4);
+    unsigned int bPCT = sharedPost ? framePlan.add (n * sizeof (cl_float8), 4, 5) : 0;
+    framePlan.plan (poolPre);
+    std::cout << "Frame buffers: " << (framePlan.getRequestedSize () >> 10) << " KB requested, " 
+              << (framePlan.getPlannedSize () >> 10) << " KB planned" << std::endl;
+
     // Create input buffers (they will be receiving the Kinect frames)
-    hBufferRGB = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, n * 3 * sizeof (cl_uchar));
-    hBufferD = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, n * sizeof (cl_ushort));
-    dBufferRGB = cl::Buffer (context, CL_MEM_READ_ONLY, n * 3 * sizeof (cl_uchar));
-    dBufferD = cl::Buffer (context, CL_MEM_READ_ONLY, n * sizeof (cl_ushort));
+    hBufferRGB = cl::Buffer (contextPre, CL_MEM_ALLOC_HOST_PTR, nS * 3 * sizeof (cl_uchar));
+    hBufferD = cl::Buffer (contextPre, CL_MEM_ALLOC_HOST_PTR, nS * sizeof (cl_ushort));
+    dBufferRGB = framePlan.get (bRGB);
+    dBufferD = framePlan.get (bD);
+    dBufferRGBS = (decimation > 1) ? framePlan.get (bRGBS) : dBufferRGB;
+    dBufferDS = (decimation > 1) ? framePlan.get (bDS) : dBufferD;
 
     // Set the buffers in which Kinect will be dropping off its frames
-    kinect->setBuffers (queue0, hBufferRGB, hBufferD);
+    kinect->setBuffers (queuePre, hBufferRGB, hBufferD);
 
     // Create the host buffer that will hold the global coordinates and orientation
     hBufferTg = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, 2 * sizeof (cl_float4));
@@ -131,12 +350,21 @@ OCLSLAM<CR, CW>::OCLSLAM (Kinect *kinect, octomap::OcTree &map) :
 
     // Initialize the preprocessing pipeline ==================================
 
-    to8D.get (GF::RGBDTo8D::Memory::D_IN_D) = cl::Buffer (context, CL_MEM_READ_WRITE, n * sizeof (cl_float));
-    to8D.get (GF::RGBDTo8D::Memory::D_IN_R) = cl::Buffer (context, CL_MEM_READ_WRITE, n * sizeof (cl_float));
-    to8D.get (GF::RGBDTo8D::Memory::D_IN_G) = cl::Buffer (context, CL_MEM_READ_WRITE, n * sizeof (cl_float));
-    to8D.get (GF::RGBDTo8D::Memory::D_IN_B) = cl::Buffer (context, CL_MEM_READ_WRITE, n * sizeof (cl_float));
-    to8D.get (GF::RGBDTo8D::Memory::D_OUT) = cl::Buffer (context, CL_MEM_READ_WRITE, n * sizeof (cl_float8));
-    to8D.init (width, height, focalLength, 1.f, rgbNorm, GF::Staging::NONE);
+    if (decimation > 1)
+    {
+        down.get (oclslam::DownsampleRGBD::Memory::D_IN_RGB) = dBufferRGBS;
+        down.get (oclslam::DownsampleRGBD::Memory::D_IN_D) = dBufferDS;
+        down.get (oclslam::DownsampleRGBD::Memory::D_OUT_RGB) = dBufferRGB;
+        down.get (oclslam::DownsampleRGBD::Memory::D_OUT_D) = dBufferD;
+        down.init (kinect->getWidth (), kinect->getHeight (), oclslam::Staging::NONE);
+    }
+
+    to8D.get (GF::RGBDTo8D::Memory::D_IN_D) = framePlan.get (bFD);
+    to8D.get (GF::RGBDTo8D::Memory::D_IN_R) = framePlan.get (bFR);
+    to8D.get (GF::RGBDTo8D::Memory::D_IN_G) = framePlan.get (bFG);
+    to8D.get (GF::RGBDTo8D::Memory::D_IN_B) = framePlan.get (bFB);
+    to8D.get (GF::RGBDTo8D::Memory::D_OUT) = framePlan.get (bPC);
+    to8D.init (width, height, focalLength / decimation, 1.f, rgbNorm, GF::Staging::NONE);
 
     // with Guided Image Filtering ========================
 
@@ -170,26 +398,60 @@ OCLSLAM<CR, CW>::OCLSLAM (Kinect *kinect, octomap::OcTree &map) :
 
     // ====================================================
 
-    lm.get (ICP::ICPLMs::Memory::D_IN) = to8D.get (GF::RGBDTo8D::Memory::D_OUT);
-    lm.get (ICP::ICPLMs::Memory::D_OUT) = cl::Buffer (context, CL_MEM_READ_WRITE, m * sizeof (cl_float8));
-    lm.init (ICP::Staging::NONE);
+    lm.get (oclslam::ICPLMsGrid::Memory::D_IN) = to8D.get (GF::RGBDTo8D::Memory::D_OUT);
+    lm.get (oclslam::ICPLMsGrid::Memory::D_OUT) = poolPre.acquire (m * sizeof (cl_float8));
+    lm.init (width, height, lmSide, oclslam::Staging::NONE);
 
     // ========================================================================
     // ------------------------------------------------------------------------
     // Initialize the ICP pipeline ============================================
 
-    icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F) = cl::Buffer (context, CL_MEM_READ_WRITE, m * sizeof (cl_float8));
-    icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M) = lm.get (ICP::ICPLMs::Memory::D_OUT);
+    icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F) = poolICP.acquire (m * sizeof (cl_float8));
+    if (env.shareQueues (CLEnvGL::Stage::PRE, CLEnvGL::Stage::ICP))
+        icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M) = lm.get (oclslam::ICPLMsGrid::Memory::D_OUT);
+    else
+    {
+        // The landmarks get transferred from the preprocessing device
+        icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M) = poolICP.acquire (m * sizeof (cl_float8));
+        lmTransfer.init (contextPre, queuePre, (cl::Buffer &) lm.get (oclslam::ICPLMsGrid::Memory::D_OUT), 
+                         contextICP, queueICP, (cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M), 
+                         m * sizeof (cl_float8));
+    }
     icp.init (m, r, a, c, max_iterations, angle_threshold, translation_threshold, ICP::Staging::NONE);
 
+    residuals.get (oclslam::ICPResiduals::Memory::D_IN_F) = icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F);
+    residuals.get (oclslam::ICPResiduals::Memory::D_IN_M) = icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M);
+    residuals.init (m, 1024, oclslam::hasUnifiedMemory (queueICP.getInfo<CL_QUEUE_DEVICE> ()) ? 
+                                 oclslam::Staging::ZC : oclslam::Staging::O);
+
+    // The landmarks lie on a square grid
+    devICP.get (oclslam::DeviceICP::Memory::D_IN_F) = icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F);
+    devICP.get (oclslam::DeviceICP::Memory::D_IN_M) = icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M);
+    devICP.init (lmSide, lmSide, max_iterations, angle_threshold, translation_threshold, 
+                 4, 100.f, oclslam::Staging::O);
+
+    // Landmarks kept around for recovering from tracking failures
+    dBufferLMsGood = poolICP.acquire (m * sizeof (cl_float8));
+    dBufferLMsKF = poolICP.acquire (maxKFLMs * m * sizeof (cl_float8));
+
     // ========================================================================
     // ------------------------------------------------------------------------
     // Initialize the postprocessing pipeline =================================
 
-    transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_IN_M) = 
-        to8D.get (GF::RGBDTo8D::Memory::D_OUT);
+    if (sharedPost)
+        transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_IN_M) = 
+            to8D.get (GF::RGBDTo8D::Memory::D_OUT);
+    else
+    {
+        // The point cloud gets transferred from the preprocessing device
+        transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_IN_M) = 
+            poolPost.acquire (n * sizeof (cl_float8));
+        pcTransfer.init (contextPre, queuePre, (cl::Buffer &) to8D.get (GF::RGBDTo8D::Memory::D_OUT), context, queue0, 
+            (cl::Buffer &) transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_IN_M), 
+            n * sizeof (cl_float8));
+    }
     transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_OUT) = 
-        cl::Buffer (context, CL_MEM_READ_WRITE, n * sizeof (cl_float8));
+        sharedPost ? framePlan.get (bPCT) : poolPost.acquire (n * sizeof (cl_float8));
     transform.init (n, ICP::Staging::NONE);
 
     sp8D.get (GF::SplitPC8D::Memory::D_IN) = 
@@ -200,7 +462,83 @@ OCLSLAM<CR, CW>::OCLSLAM (Kinect *kinect, octomap::OcTree &map) :
 
     sp8DMap.get (oclslam::SplitPC8D::Memory::D_IN) = 
         transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_OUT);
-    sp8DMap.init (n, oclslam::Staging::O);
+    // On devices with unified memory, the point cloud gets mapped instead of copied
+    sp8DMap.init (n, oclslam::hasUnifiedMemory (queue0.getInfo<CL_QUEUE_DEVICE> ()) ? 
+                     oclslam::Staging::ZC : oclslam::Staging::O);
+
+    // ========================================================================
+    // ------------------------------------------------------------------------
+    // Set up the stage graph =================================================
+
+    // The depth path runs on the second preprocessing queue, 
+    // concurrently with the RGB path
+    typedef std::vector<cl::Event> Events;
+    cl::CommandQueue &queuePreD = env.getStageQueue (CLEnvGL::Stage::PRE, 1);
+    cl::Memory &dBufferPC = to8D.get (GF::RGBDTo8D::Memory::D_OUT);
+    cl::Memory &dBufferLMsM = lm.get (oclslam::ICPLMsGrid::Memory::D_OUT);
+    cl::Memory &dBufferPCIn = transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_IN_M);
+    cl::Memory &dBufferPCT = transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_OUT);
+    std::vector<cl::Memory> dBuffersRGB { to8D.get (GF::RGBDTo8D::Memory::D_IN_R), 
+        to8D.get (GF::RGBDTo8D::Memory::D_IN_G), to8D.get (GF::RGBDTo8D::Memory::D_IN_B) };
+    std::vector<cl::Memory> dBuffers8D (dBuffersRGB);
+    dBuffers8D.push_back (to8D.get (GF::RGBDTo8D::Memory::D_IN_D));
+
+    sDeliver = stages.add ("deliver", queuePre, oclslam::StageGraph::fence (queuePre, [this] {
+            this->kinect->deliverFrames (queuePre, dBufferRGBS, dBufferDS, &sensorTimestamp);
+            hostTimestamp = std::chrono::duration<double> (
+                std::chrono::system_clock::now ().time_since_epoch ()).count ();
+        }), {}, { dBufferRGBS, dBufferDS });
+    sDownsample = stages.add ("downsample", queuePre, [this] (const Events *e, cl::Event *ev) { down.run (e, ev); }, 
+                              { dBufferRGBS, dBufferDS }, { dBufferRGB, dBufferD });
+    stages.setEnabled (sDownsample, decimation > 1);
+    sGFRGB = stages.add ("gfRGB", queuePre, [this] (const Events *e, cl::Event *ev) { gfRGB.run (e, ev); }, 
+                         { dBufferRGB }, dBuffersRGB);
+    sSepRGB = stages.add ("sepRGB", queuePre, [this] (const Events *e, cl::Event *ev) { sepRGB.run (e, ev); }, 
+                          { dBufferRGB }, dBuffersRGB);
+    sGFD = stages.add ("gfD", queuePreD, [this] (const Events *e, cl::Event *ev) { gfD.run (e, ev); }, 
+                       { dBufferD }, { dBuffers8D[3] });
+    sConvD = stages.add ("convD", queuePreD, [this] (const Events *e, cl::Event *ev) { convD.run (e, ev); }, 
+                         { dBufferD }, { dBuffers8D[3] });
+    sTo8D = stages.add ("to8D", queuePre, [this] (const Events *e, cl::Event *ev) { to8D.run (e, ev); }, 
+                        dBuffers8D, { dBufferPC });
+    // After a tracking failure, keep registering against the last good landmarks
+    sLMsF = stages.add ("lmsF", queueICP, [this] (const Events *e, cl::Event *ev) {
+            queueICP.enqueueCopyBuffer (trackingLost ? dBufferLMsGood : 
+                (cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M), 
+                (cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F), 0, 0, m * sizeof (cl_float8), e, ev);
+        }, { icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M), dBufferLMsGood }, 
+           { icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F) });
+    sLMs = stages.add ("lms", queuePre, [this] (const Events *e, cl::Event *ev) { lm.run (e, ev); }, 
+                       { dBufferPC }, { dBufferLMsM });
+
+    sTransform = stages.add ("transform", queue0, [this] (const Events *e, cl::Event *ev) { transform.run (e, ev); }, 
+        { dBufferPCIn, transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_IN_T) }, 
+        { dBufferPCT });
+    sCopyPC = stages.add ("copyPC", queue0, [this] (const Events *e, cl::Event *ev) {
+            queue0.enqueueCopyBuffer ((cl::Buffer &) transform.get (
+                ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_IN_M), 
+                (cl::Buffer &) transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_OUT), 
+                0, 0, n * sizeof (cl_float8), e, ev);
+        }, { dBufferPCIn }, { dBufferPCT });
+    sSplitMap = stages.add ("splitMap", queue0, [this] (const Events *e, cl::Event *ev) {
+            sp8DMap.run (e, ev);
+            sp8DMap.read (oclslam::SplitPC8D::Memory::H_OUT_PC3D, CL_FALSE);
+            // sp8DMap.read (oclslam::SplitPC8D::Memory::H_OUT_RGB, CL_FALSE);
+        }, { dBufferPCT }, { sp8DMap.get (oclslam::SplitPC8D::Memory::D_OUT_PC3D), 
+                             sp8DMap.get (oclslam::SplitPC8D::Memory::D_OUT_RGB) });
+    sSplitGL = stages.add ("splitGL", queue1, [this] (const Events *e, cl::Event *ev) { sp8D.run (e, ev); }, 
+                           { dBufferPCT }, { dBufferGL[0], dBufferGL[1] });
+
+    // Queues shared by several stages end up with the name of the last one
+    tracer.addQueue (queuePre, "pre");
+    tracer.addQueue (queuePreD, "preD");
+    tracer.addQueue (queueICP, "icp");
+    tracer.addQueue (queue0, "queue0");
+    tracer.addQueue (queue1, "queue1");
+    stages.setTracer (&tracer);
+
+    queuePre.finish ();
+    queueICP.finish ();
     queue0.finish ();
     queue1.finish ();
     // ========================================================================
@@ -218,6 +556,9 @@ OCLSLAM<CR, CW>::OCLSLAM (Kinect *kinect, octomap::OcTree &map) :
     // Initialize the SLAM function wrapper
     slam = [this] { std::thread ([this] { init (); }).detach (); };
     slamFuncHashCode = slam.target_type ().hash_code ();
+
+    // The inner nodes of the map are refreshed in the background
+    maintenance.start (map, mapMtx);
 }
 
 
@@ -226,6 +567,8 @@ OCLSLAM<CR, CW>::~OCLSLAM ()
 {
     kinect->stopVideo ();
     kinect->stopDepth ();
+    maintenance.stop ();
+    waitForWrite ();
 }
 
 
@@ -237,34 +580,34 @@ void OCLSLAM<CR, CW>::init ()
 {
     if (slam.target_type ().hash_code () != slamFuncHashCode) return;
 
+    oclslam::Tracer::Span span (tracer, "init");
+
     // Host-Device Transfer ===============================================
 
-    kinect->deliverFrames (queue0, dBufferRGB, dBufferD);
-    // queue0.enqueueFillBuffer<cl_uchar> (dBufferRGB, (cl_uchar) 255, 0, 3 * n * sizeof (cl_uchar));
-    // queue0.enqueueFillBuffer<cl_ushort> (dBufferD, (cl_ushort) 2000, 0, n * sizeof (cl_ushort));
+    timerPre.start ();
+    stages.dispatch (sDeliver);
+    // queuePre.enqueueFillBuffer<cl_uchar> (dBufferRGB, (cl_uchar) 255, 0, 3 * n * sizeof (cl_uchar));
+    // queuePre.enqueueFillBuffer<cl_ushort> (dBufferD, (cl_ushort) 2000, 0, n * sizeof (cl_ushort));
 
     // ====================================================================
     // --------------------------------------------------------------------
     // Preprocessing ======================================================
 
-    if (gfRGBStatus) gfRGB.run (); else sepRGB.run ();
-    if (gfDStatus) gfD.run (); else convD.run ();
-    to8D.run ();
-    lm.run ();
+    _setFilterStages ();
+    stages.run (sDownsample, sTo8D);
+    stages.dispatch (sLMs);
+    lmTransfer.run ();
+    pcTransfer.run ();
+    lPre = timerPre.stop ();
 
-    queue0.enqueueCopyBuffer ((cl::Buffer &) to8D.get (GF::RGBDTo8D::Memory::D_OUT), 
-        (cl::Buffer &) transform.get (ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_OUT), 
-        0, 0, n * sizeof (cl_float8), nullptr, &eventGL); waitListGL[0] = eventGL;
+    stages.dispatch (sCopyPC);
 
     // ====================================================================
     // --------------------------------------------------------------------
     // Postprocessing =====================================================
 
-    sp8DMap.run ();
-    sp8DMap.read (oclslam::SplitPC8D::Memory::H_OUT_PC3D, CL_FALSE);
-    // sp8DMap.read (oclslam::SplitPC8D::Memory::H_OUT_RGB, CL_FALSE);
-
-    queue0.flush ();
+    stages.dispatch (sSplitMap);
+    stages.flush ();
 
     // ====================================================================
     // --------------------------------------------------------------------
@@ -272,18 +615,24 @@ void OCLSLAM<CR, CW>::init ()
 
     if (timeStep < maxPCGL)
     {
+        oclslam::Tracer::Span span (tracer, "render");
         glMtx.lock ();  // Prevent the OpenGL renderer from reading the buffers
 
         glFinish ();  // Wait for OpenGL pending operations on the buffers to finish
 
         // Take ownership of the OpenGL buffers
-        queue1.enqueueAcquireGLObjects ((std::vector<cl::Memory> *) &dBufferGL);
+        cl::Event evAcquire, evRelease;
+        queue1.enqueueAcquireGLObjects ((std::vector<cl::Memory> *) &dBufferGL, 
+                                        nullptr, tracer.isOpen () ? &evAcquire : nullptr);
+        tracer.record (queue1, "acquireGL", evAcquire);
 
         sp8D.setOffset (0);
-        sp8D.run (&waitListGL);
+        stages.dispatch (sSplitGL);
 
         // Give up ownership of the OpenGL buffers
-        queue1.enqueueReleaseGLObjects ((std::vector<cl::Memory> *) &dBufferGL);
+        queue1.enqueueReleaseGLObjects ((std::vector<cl::Memory> *) &dBufferGL, 
+                                        nullptr, tracer.isOpen () ? &evRelease : nullptr);
+        tracer.record (queue1, "releaseGL", evRelease);
 
         queue1.finish ();
 
@@ -294,14 +643,24 @@ void OCLSLAM<CR, CW>::init ()
 
     // ====================================================================
 
+    frameCount++;  // Count the current point cloud, whether it's rendered or not
     display ();
+    _logPose ();
 
     // --------------------------------------------------------------------
     // Mapping ============================================================
 
     queue0.finish ();
 
+    // The point cloud is copied before the next frame reuses the staging memory
+    std::copy (sp8DMap.hPtrOutPC3D, sp8DMap.hPtrOutPC3D + 3 * n, (cl_float *) pc.data ());
+    // std::copy (sp8DMap.hPtrOutRGB, sp8DMap.hPtrOutRGB + 3 * n, (cl_uchar *) cc.data ());
+
     global_pos = octomap::point3d (0.0, 0.0, 0.0);
+    kfLastPose = kfPose = oclslam::Pose (R_g, t_g, s_g);
+    kfFrame = frameCount;
+    kfPending = true;
+    _storeKeyframe ();
     std::thread ([this] { _mapping (); }).detach ();
 
     // ====================================================================
@@ -322,60 +681,75 @@ void OCLSLAM<CR, CW>::init ()
 template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
 void OCLSLAM<CR, CW>::registerPointCloud ()
 {
+    oclslam::Tracer::Span span (tracer, "timeStep");
+
     // Host-Device Transfer ===============================================
 
-    kinect->deliverFrames (queue0, dBufferRGB, dBufferD);
-    // queue0.enqueueFillBuffer<cl_uchar> (dBufferRGB, (cl_uchar) 100, 0, 3 * n * sizeof (cl_uchar));
-    // queue0.enqueueFillBuffer<cl_ushort> (dBufferD, (cl_ushort) 1700, 0, n * sizeof (cl_ushort));
+    timerPre.start ();
+    stages.dispatch (sDeliver);
+    // queuePre.enqueueFillBuffer<cl_uchar> (dBufferRGB, (cl_uchar) 100, 0, 3 * n * sizeof (cl_uchar));
+    // queuePre.enqueueFillBuffer<cl_ushort> (dBufferD, (cl_ushort) 1700, 0, n * sizeof (cl_ushort));
     
     // ====================================================================
     // --------------------------------------------------------------------
     // Preprocessing ======================================================
 
-    if (gfRGBStatus) gfRGB.run (); else sepRGB.run ();
-    if (gfDStatus) gfD.run (); else convD.run ();
-    to8D.run ();
-    queue0.enqueueCopyBuffer ((cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M), 
-        (cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F), 0, 0, m * sizeof (cl_float8));
-    lm.run ();
-    icp.buildRBC ();
+    _setFilterStages ();
+    stages.run (sDownsample, sLMs);
+    pcTransfer.begin ();  // The point cloud travels to the GL device while the ICP runs
+    lmTransfer.run ();
+    if (!deviceICPStatus) icp.buildRBC ();
+    lPre = timerPre.stop ();
 
     // ====================================================================
     // --------------------------------------------------------------------
     // ICP ================================================================
 
     timerICP.start ();
-    icp.run ();
-    lICP = timerICP.stop ();
+    _runICP ();
 
     // Update global coordinates and orientation ===========
 
-    R_g = icp.R * R_g;
+    bool tracked = _checkResiduals () && _checkMotion (maxJumpDistance, maxJumpAngle);
+    if (tracked)
+        oclslam::applyRegistration (R_icp, t_icp, s_icp, R_g, t_g, s_g);
+    else
+        tracked = _relocalize ();
+
+    lICP = timerICP.stop ();
+
+    // Suspend the integration until the tracking recovers
+    if (!tracked)
+    {
+        display ();
+        return;
+    }
+    trackingLost = false;
+    lostFrames = 0;
+
     q_g = Eigen::Quaternionf (R_g);
-    t_g = icp.s * icp.R * t_g + icp.t;
-    s_g = icp.s * s_g;
     
     Eigen::Map<Eigen::Vector4f> (hPtrTg, 4) = q_g.coeffs ();  // Quaternion
     Eigen::Map<Eigen::Vector4f> (hPtrTg + 4, 4) = t_g.homogeneous ();  // Translation
     hPtrTg[7] = s_g;  // Scale
 
+    cl::Event evTg;
     queue0.enqueueWriteBuffer ((cl::Buffer &) transform.get (
         ICP::ICPTransform<ICP::ICPTransformConfig::QUATERNION>::Memory::D_IN_T), 
-        CL_FALSE, 0, 2 * sizeof (cl_float4), hPtrTg);
+        CL_FALSE, 0, 2 * sizeof (cl_float4), hPtrTg, nullptr, tracer.isOpen () ? &evTg : nullptr);
+    tracer.record (queue0, "writeTg", evTg);
 
     // ======================================================
     
-    transform.run (nullptr, &eventGL); waitListGL[0] = eventGL;
+    pcTransfer.end ();
+    stages.dispatch (sTransform);
 
     // ====================================================================
     // --------------------------------------------------------------------
     // Postprocessing =====================================================
 
-    sp8DMap.run ();
-    sp8DMap.read (oclslam::SplitPC8D::Memory::H_OUT_PC3D, CL_FALSE);
-    // sp8DMap.read (oclslam::SplitPC8D::Memory::H_OUT_RGB, CL_FALSE);
-
-    queue0.flush ();
+    stages.dispatch (sSplitMap);
+    stages.flush ();
 
     // ====================================================================
     // --------------------------------------------------------------------
@@ -383,18 +757,24 @@ void OCLSLAM<CR, CW>::registerPointCloud ()
 
     if (timeStep < maxPCGL)
     {
+        oclslam::Tracer::Span span (tracer, "render");
         glMtx.lock ();  // Prevent the OpenGL renderer from reading the buffers
 
         glFinish ();  // Wait for OpenGL pending operations on the buffers to finish
 
         // Take ownership of the OpenGL buffers
-        queue1.enqueueAcquireGLObjects ((std::vector<cl::Memory> *) &dBufferGL);
+        cl::Event evAcquire, evRelease;
+        queue1.enqueueAcquireGLObjects ((std::vector<cl::Memory> *) &dBufferGL, 
+                                        nullptr, tracer.isOpen () ? &evAcquire : nullptr);
+        tracer.record (queue1, "acquireGL", evAcquire);
 
         sp8D.setOffset (timeStep * n);
-        sp8D.run (&waitListGL);
+        stages.dispatch (sSplitGL);
 
         // Give up ownership of the OpenGL buffers
-        queue1.enqueueReleaseGLObjects ((std::vector<cl::Memory> *) &dBufferGL);
+        queue1.enqueueReleaseGLObjects ((std::vector<cl::Memory> *) &dBufferGL, 
+                                        nullptr, tracer.isOpen () ? &evRelease : nullptr);
+        tracer.record (queue1, "releaseGL", evRelease);
 
         queue1.finish ();
 
@@ -405,7 +785,9 @@ void OCLSLAM<CR, CW>::registerPointCloud ()
 
     // ====================================================================
 
+    frameCount++;  // Count the current point cloud, whether it's rendered or not
     display ();
+    _logPose ();
 
     // --------------------------------------------------------------------
     // Mapping ============================================================
@@ -416,7 +798,12 @@ void OCLSLAM<CR, CW>::registerPointCloud ()
     // the next point cloud, but prevents it from going further ahead
     std::lock_guard<std::mutex> lock (mapMtx);
 
+    // The point cloud is copied before the next frame reuses the staging memory
+    std::copy (sp8DMap.hPtrOutPC3D, sp8DMap.hPtrOutPC3D + 3 * n, (cl_float *) pc.data ());
+    // std::copy (sp8DMap.hPtrOutRGB, sp8DMap.hPtrOutRGB + 3 * n, (cl_uchar *) cc.data ());
+
     global_pos = octomap::point3d (t_g[0] * 0.001, t_g[1] * 0.001, t_g[2] * 0.001);
+    _checkKeyframe ();
     std::thread ([this] { _mapping (); }).detach ();
 
     // ====================================================================
@@ -427,16 +814,61 @@ void OCLSLAM<CR, CW>::registerPointCloud ()
 template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
 void OCLSLAM<CR, CW>::_mapping ()
 {
-    std::lock_guard<std::mutex> lock (mapMtx);
+    std::unique_lock<std::mutex> lock (mapMtx);
+    oclslam::Tracer::Span span (tracer, "mapping");
 
     /*! \todo Remove invalid points at the beginning of the pipeline, 
      *        and resize `pc` to the resulting size. */
     // pc.resize (<n>);
-
-    std::copy (sp8DMap.hPtrOutPC3D, sp8DMap.hPtrOutPC3D + 3 * n, (cl_float *) pc.data ());
-    // std::copy (sp8DMap.hPtrOutRGB, sp8DMap.hPtrOutRGB + 3 * n, (cl_uchar *) cc.data ());
     
-    map.insertPointCloud (pc, global_pos, -1, false, true);
+    if (tiles.isOpen ())
+    {
+        // The tiles around the sensor are kept resident
+        tiles.insertPointCloud (pc, global_pos);
+        tiles.update (global_pos, 0.5 * tiles.getTileSize ());
+    }
+    else
+    {
+        // Only the leaves are updated here, the rest is left to the maintenance
+        if (batch.getFrames () > 1 || batch.isReady ())
+        {
+            batch.add (map, pc, global_pos);
+            if (batch.isReady ()) _applyBatch ();
+        }
+        else
+        {
+            map.insertPointCloud (pc, global_pos, -1, true, true);
+            octomap::point3d lo, hi;
+            oclslam::computeBounds (pc, global_pos, -1.0, lo, hi);
+            maintenance.touch (map, lo, hi);
+            grid.touch (lo, hi);
+        }
+        grid.update (map);
+        // The server, the frontiers, the bricks, and the field read the changed cells, so 
+        // they go before the window deletes any, and the cells are cleared after all of them
+        mapServer.record (map);
+        frontiers.update (map);
+        bricks.update (map);
+        distanceField.update (map);
+        if (map.isChangeDetectionEnabled ()) map.resetChangeDetection ();
+        std::vector<std::pair<octomap::OcTreeKey, unsigned int>> evicted;
+        window.update (map, global_pos, false, &evicted);
+        mapServer.erase (evicted);
+    }
+
+    // Hand the keyframe over to the loop closure detection
+    if (kfPending && loopClosureStatus)
+    {
+        const cl_float *pc3d = (const cl_float *) pc.data ();
+        loopClosure.addKeyframe (kfFrame, kfPose, 
+            oclslam::computeDescriptor (pc3d, width, height, kfPose), 
+            oclslam::sampleCloud (pc3d, width, height, kfPose));
+    }
+    kfPending = false;
+
+    // The snapshot is made from the recorded changes, so it doesn't need the map
+    lock.unlock ();
+    mapServer.publish ();
     // map.insertPointCloud (pc, global_pos, -1, true, true); 
     // for (int i = 0; i < n; ++i)
     // {
@@ -448,23 +880,365 @@ void OCLSLAM<CR, CW>::_mapping ()
 }
 
 
-/*! \param[in] filename name for the map file `[.ot]`. */
+/*! \brief Applies the point clouds accumulated in the batch to the map.
+ *  \note It's called while holding the lock on the map.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::_applyBatch ()
+{
+    octomap::point3d lo, hi;
+    if (!batch.getBounds (map, lo, hi)) return;
+
+    batch.apply (map, true);
+    maintenance.touch (map, lo, hi);
+    grid.touch (lo, hi);
+}
+
+
+/*! \brief Writes back the modified tiles, when the tiled map is in use.
+ *  \details The tiles take the place of the map file, since the map is empty.
+ *
+ *  \param[in] filename name of the map file that was asked for.
+ *  \return `true` if the tiled map is in use.
+ */
 template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
-void OCLSLAM<CR, CW>::write (std::string filename)
+bool OCLSLAM<CR, CW>::_flushTiles (const std::string &filename)
 {
+    if (!tiles.isOpen ()) return false;
+
     std::lock_guard<std::mutex> lock (mapMtx);
-    std::thread ([&] { map.write (filename.c_str ()); }).detach ();
-    std::cout << "Map saved in file " << filename << std::endl;
+    tiles.flush ();
+    std::cout << "Map saved in tiles in " << tiles.getDirectory () << " (" << tiles.getStats ().stored 
+              << " tiles), instead of in file " << filename << std::endl;
+    return true;
+}
+
+
+/*! \brief Enables the filtering stages selected by the user. */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::_setFilterStages ()
+{
+    stages.setEnabled (sGFRGB, gfRGBStatus);
+    stages.setEnabled (sSepRGB, !gfRGBStatus);
+    stages.setEnabled (sGFD, gfDStatus);
+    stages.setEnabled (sConvD, !gfDStatus);
+}
+
+
+/*! \details A new keyframe is created when the sensor has moved or rotated 
+ *           enough since the latest keyframe.
+ *  \note It's called while holding the lock on the map, before `_mapping` is launched.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::_checkKeyframe ()
+{
+    oclslam::Pose pose (R_g, t_g, s_g);
+    oclslam::Pose rel = kfLastPose.inverse () * pose;
+    double angle = 180.0 / M_PI * oclslam::logRotation (rel.R).norm ();  // in degrees
+
+    if (rel.t.norm () > kfDistance || angle > kfAngle)
+    {
+        kfLastPose = kfPose = pose;
+        kfFrame = frameCount;
+        kfPending = true;
+        _storeKeyframe ();
+    }
 }
 
 
-/*! \param[in] filename name for the map file `[.bt]`. */
+/*! \details Runs the `ICP` registration, either with the RBC based `ICP` (the data 
+ *           structure has to be built beforehand), or with the iteration loop resident 
+ *           on the device. The latter reads back only the final transformation and the 
+ *           iteration count. The result is stored in `R_icp`, `t_icp`, `s_icp`, and `k_icp`.
+ *  \note While tracing, the commands of the registration are recorded as a 
+ *        single entry, between two markers on the ICP queue.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::_runICP ()
+{
+    oclslam::Tracer::Span span (tracer, "icp");
+    bool trace = tracer.isOpen ();
+    cl::Event first, last;
+    if (trace) queueICP.enqueueMarkerWithWaitList (nullptr, &first);
+
+    if (deviceICPStatus)
+    {
+        devICP.run ();
+        devICP.read (oclslam::DeviceICP::Memory::H_OUT, CL_TRUE);
+        R_icp = devICP.R; t_icp = devICP.t; s_icp = devICP.s; k_icp = devICP.k;
+    }
+    else
+    {
+        icp.run ();
+        R_icp = icp.R; t_icp = icp.t; s_icp = icp.s; k_icp = icp.k;
+    }
+
+    if (trace)
+    {
+        queueICP.enqueueMarkerWithWaitList (nullptr, &last);
+        tracer.record (queueICP, "icp", last, first);
+    }
+}
+
+
+/*! \details Evaluates the residuals of the latest `ICP` registration. A sample of the 
+ *           moving landmarks is transformed and matched against the fixed landmarks. 
+ *           The registration is accepted if enough of them find a close match (inlier 
+ *           ratio), and if the matches are tight (RMS residual of the inliers).
+ *
+ *  \return A flag to indicate whether the registration is accepted.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+bool OCLSLAM<CR, CW>::_checkResiduals ()
+{
+    oclslam::Tracer::Span span (tracer, "checkRegistration");
+
+    if (!std::isfinite (R_icp.sum ()) || !std::isfinite (t_icp.sum ()) || !std::isfinite (s_icp))
+    {
+        inlierRatio = 0.f;
+        return false;
+    }
+
+    residuals.setTransformation (Eigen::Quaternionf (R_icp), t_icp, s_icp);
+    residuals.run ();
+    cl_float *res = (cl_float *) residuals.read (oclslam::ICPResiduals::Memory::H_OUT, CL_TRUE);
+
+    oclslam::RegistrationStats stats = 
+        oclslam::computeRegistrationStats (res, residuals.getSamples (), inlierDistance);
+    inlierRatio = stats.inlierRatio;
+    rmsResidual = stats.rmsResidual;
+
+    return inlierRatio >= minInlierRatio && rmsResidual <= maxResidual;
+}
+
+
+/*! \details Checks whether the motion of the latest `ICP` registration is plausible. 
+ *           Between two frames, it's bounded by `maxJumpDistance` and `maxJumpAngle`, 
+ *           but against a keyframe, it can be as large as the keyframe spacing too. 
+ *           The scale change is bounded by `maxJumpScale` in either case.
+ *
+ *  \param[in] maxDistance maximum translation (in mm).
+ *  \param[in] maxAngle maximum rotation (in degrees).
+ *  \return A flag to indicate whether the motion is plausible.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+bool OCLSLAM<CR, CW>::_checkMotion (float maxDistance, float maxAngle)
+{
+    return oclslam::checkMotion (R_icp, t_icp, s_icp, maxDistance, maxAngle, maxJumpScale);
+}
+
+
+/*! \details On the first failure, the landmarks of the last good point cloud are 
+ *           preserved, so that the next point clouds get registered against them. 
+ *           Additionally, at every time step, a few of the stored keyframes, the 
+ *           ones closest to the last known position first, are tried as references. 
+ *           A successful registration against keyframe \f$ k \f$ sets the pose 
+ *           to \f$ T_{icp} \circ T_k \f$. The motion bounds are widened by the 
+ *           keyframe spacing (`kfDistance`, `kfAngle`) for these registrations.
+ *
+ *  \return A flag to indicate whether the pose was recovered.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+bool OCLSLAM<CR, CW>::_relocalize ()
+{
+    oclslam::Tracer::Span span (tracer, "relocalize");
+
+    cl::Buffer &dBufferF = (cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_F);
+
+    if (!trackingLost)
+    {
+        queueICP.enqueueCopyBuffer (dBufferF, dBufferLMsGood, 0, 0, m * sizeof (cl_float8));
+        trackingLost = true;
+        lostFrames = 0;
+    }
+    lostFrames++;
+
+    unsigned int slots = std::min (kfStored, maxKFLMs);
+    if (slots == 0) return false;
+
+    // Order the keyframes by their distance from the last known position
+    std::vector<unsigned int> order (slots);
+    for (unsigned int k = 0; k < slots; ++k) order[k] = k;
+    Eigen::Vector3d pos = t_g.cast<double> ();
+    std::sort (order.begin (), order.end (), [&] (unsigned int a, unsigned int b) {
+        return (kfLMsPoses[a].t - pos).norm () < (kfLMsPoses[b].t - pos).norm ();
+    });
+
+    // Spread the candidates over successive time steps
+    unsigned int first = ((lostFrames - 1) * relocCandidates) % slots;
+    for (unsigned int c = 0; c < std::min (relocCandidates, slots); ++c)
+    {
+        unsigned int slot = order[(first + c) % slots];
+        queueICP.enqueueCopyBuffer (dBufferLMsKF, dBufferF, 
+            slot * m * sizeof (cl_float8), 0, m * sizeof (cl_float8));
+        if (!deviceICPStatus) icp.buildRBC ();
+        _runICP ();
+
+        // The offset from a keyframe adds up to a keyframe spacing to the motion
+        if (!_checkResiduals () || 
+            !_checkMotion (maxJumpDistance + kfDistance, maxJumpAngle + kfAngle)) continue;
+
+        const oclslam::Pose &T_k = kfLMsPoses[slot];
+        R_g = T_k.R.cast<float> ();
+        t_g = T_k.t.cast<float> ();
+        s_g = T_k.s;
+        oclslam::applyRegistration (R_icp, t_icp, s_icp, R_g, t_g, s_g);
+
+        std::cout << "Relocalized after " << lostFrames << " time steps" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+
+/*! \details Keeps a copy of the current landmarks on the device, in a ring of 
+ *           `maxKFLMs` slots, to serve as references for relocalization.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::_storeKeyframe ()
+{
+    unsigned int slot = kfStored % maxKFLMs;
+    queueICP.enqueueCopyBuffer ((cl::Buffer &) icp.get (ICP::ICP<CR, CW>::Memory::D_IN_M), 
+        dBufferLMsKF, 0, slot * m * sizeof (cl_float8), m * sizeof (cl_float8));
+    kfLMsPoses[slot] = oclslam::Pose (R_g, t_g, s_g);
+    kfStored++;
+}
+
+
+/*! \brief Appends the pose of the current time step to the trajectory log. */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::_logPose ()
+{
+    if (!trajLog.isOpen ()) return;
+
+    oclslam::TrajectoryRecord rec;
+    rec.timestamp = hostTimestamp;
+    rec.t = t_g;
+    rec.q = q_g;
+    rec.s = s_g;
+    rec.sensorTimestamp = sensorTimestamp;
+    rec.timeStep = frameCount;
+    rec.icpIterations = k_icp;
+    rec.latency = latency;
+    rec.preLatency = lPre;
+    rec.icpLatency = lICP;
+
+    trajLog.append (rec);
+}
+
+
+/*! \details Every registered point cloud appends a record to the file, with the 
+ *           pose and the statistics of the time step. The file can be evaluated 
+ *           with the `evaluate_trajectory` tool.
+ *
+ *  \param[in] filename name for the trajectory file.
+ *  \return `false` if the file failed to open.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+bool OCLSLAM<CR, CW>::startTrajectoryLog (std::string filename)
+{
+    if (!trajLog.open (filename)) return false;
+    std::cout << "Trajectory logged in file " << filename << std::endl;
+    return true;
+}
+
+
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::stopTrajectoryLog ()
+{
+    trajLog.close ();
+}
+
+
+/*! \details Records the commands of the stages, and the host steps, of the time 
+ *           steps that follow. The file is in the Chrome trace-event format, and 
+ *           can be loaded in `chrome://tracing` or in Perfetto.
+ *  \note The pipeline has to be created with profiling enabled.
+ *
+ *  \param[in] filename name for the trace file.
+ *  \return `false` if profiling is not enabled, or the file failed to open.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+bool OCLSLAM<CR, CW>::startTrace (std::string filename)
+{
+    if (!oclslam::Tracer::isProfiling (queue0))
+    {
+        std::cerr << "Error[OCLSLAM]: Tracing requires the queues to be created with profiling" << std::endl;
+        return false;
+    }
+
+    if (!tracer.open (filename)) return false;
+    std::cout << "Trace recorded in file " << filename << std::endl;
+    return true;
+}
+
+
+/*! \details It waits for the recorded commands to complete. */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::stopTrace ()
+{
+    tracer.close ();
+    if (tracer.getDropped () > 0)
+        std::cout << "Trace dropped " << tracer.getDropped () << " entries" << std::endl;
+}
+
+
+/*! \details The map is held only while its pending maintenance is completed 
+ *           and its changes are recorded. Then, a snapshot of it is published, 
+ *           and written on a separate thread. The thread is joined by the next save, and on 
+ *           destruction, so the file is complete before the engine is gone.
+ *
+ *  \param[in] filename name for the map file `[.ot]`.
+ */
+template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
+void OCLSLAM<CR, CW>::write (std::string filename)
+{
+    if (_flushTiles (filename)) return;
+    {
+        std::lock_guard<std::mutex> lock (mapMtx);
+        _applyBatch ();
+        maintenance.run (map);
+        mapServer.record (map);
+    }
+    mapServer.publish (true);
+    oclslam::MapServer::Snapshot snap = mapServer.getSnapshot ();
+    waitForWrite ();  // A previous save may still be writing
+    mapWriter = std::thread ([snap, filename] {
+        if (snap.map->write (filename.c_str ()))
+            std::cout << "Map saved in file " << filename << std::endl;
+        else
+            std::cerr << "Failed to save the map in file " << filename << std::endl;
+    });
+}
+
+
+/*! \details The map is held only while its pending maintenance is completed 
+ *           and its changes are recorded. Then, a snapshot of it is published, 
+ *           and written on a separate thread. The thread is joined by the next save, and on 
+ *           destruction, so the file is complete before the engine is gone.
+ *
+ *  \param[in] filename name for the map file `[.bt]`.
+ */
 template <ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW>
 void OCLSLAM<CR, CW>::writeBinary (std::string filename)
 {
-    std::lock_guard<std::mutex> lock (mapMtx);
-    std::thread ([&] { map.writeBinary (filename.c_str ()); }).detach ();
-    std::cout << "Map saved in file " << filename << std::endl;
+    if (_flushTiles (filename)) return;
+    {
+        std::lock_guard<std::mutex> lock (mapMtx);
+        _applyBatch ();
+        maintenance.run (map);
+        mapServer.record (map);
+    }
+    mapServer.publish (true);
+    oclslam::MapServer::Snapshot snap = mapServer.getSnapshot ();
+    waitForWrite ();  // A previous save may still be writing
+    mapWriter = std::thread ([snap, filename] {
+        if (snap.map->writeBinaryConst (filename.c_str ()))
+            std::cout << "Map saved in file " << filename << std::endl;
+        else
+            std::cerr << "Failed to save the map in file " << filename << std::endl;
+    });
 }
 
 
@@ -474,9 +1248,55 @@ void OCLSLAM<CR, CW>::display ()
     double angle = 180.0 / M_PI * 2.0 * std::atan2 (q_g.vec ().norm (), q_g.w ());  // in degrees
     Eigen::Vector3f axis = ((angle == 0.0) ? Eigen::Vector3f::Zero () : q_g.vec ().normalized ());
     std::cout << "    Time step             :    " << timeStep << std::endl;
-    std::cout << "    Latency               :    " << timer.stop () << " [ms]" << std::endl;
-    std::cout << "    ICP iterations        :    " << icp.k << std::endl;
+    latency = timer.stop ();
+    std::cout << "    Latency               :    " << latency << " [ms]" << std::endl;
+    std::cout << "    ICP iterations        :    " << k_icp << (deviceICPStatus ? " (on device)" : "") << std::endl;
     std::cout << "    ICP latency           :    " << lICP << " [ms]" << std::endl;
+    std::cout << "    Tracking              :    " << (trackingLost ? "LOST" : "OK") 
+              << " (inliers " << 100.f * inlierRatio << "%, residual " << rmsResidual << " [mm])" << std::endl;
+    std::cout << "    Keyframes             :    " << loopClosure.getNumKeyframes () 
+              << " (" << loopClosure.getNumLoops () << " loop closures)" << std::endl;
+    if (tiles.isOpen ())
+    {
+        oclslam::TiledMap::Stats stats = tiles.getStats ();
+        std::cout << "    Map tiles             :    " << stats.resident << " resident (" << stats.nodes 
+                  << " nodes), " << stats.stored << " stored" << std::endl;
+    }
+    else if (window.getRadius () > 0.0)
+    {
+        oclslam::SlidingWindow::Stats stats = window.getStats ();
+        std::cout << "    Map                   :    " << stats.nodes << " nodes, " 
+                  << (stats.memory >> 20) << " [MB] (" << stats.evicted << " leaves evicted)" << std::endl;
+    }
+    else
+    {
+        oclslam::MapMaintenance::Stats stats = maintenance.getStats ();
+        std::cout << "    Map                   :    " << stats.nodes << " nodes, " 
+                  << (stats.memory >> 20) << " [MB] (" << stats.pruned << " nodes pruned)" << std::endl;
+    }
+    if (grid.isEnabled ())
+    {
+        oclslam::OccupancyGrid2D::Stats stats = grid.getStats ();
+        std::cout << "    Map grid              :    " << stats.tiles << " tiles (" 
+                  << stats.columns << " columns updated)" << std::endl;
+    }
+    if (frontiers.isEnabled ())
+    {
+        oclslam::FrontierSet::Stats stats = frontiers.getStats ();
+        std::cout << "    Frontiers             :    " << stats.cells << " cells" << std::endl;
+    }
+    if (bricks.isEnabled ())
+    {
+        oclslam::BrickMap::Stats stats = bricks.getStats ();
+        std::cout << "    Map bricks            :    " << stats.bricks << " (" 
+                  << stats.cells << " occupied cells)" << std::endl;
+    }
+    if (batch.getFrames () > 1)
+    {
+        oclslam::BatchedUpdate::Stats stats = batch.getStats ();
+        std::cout << "    Map batches           :    " << stats.batches << " (" << stats.treeUpdates 
+                  << " cell updates, out of " << stats.cellUpdates << ")" << std::endl;
+    }
     std::cout << "    Localization               " << std::endl;
     std::cout << "    - Translation vector  :    " << t_g.transpose () << " [mm]" << std::endl;
     std::cout << "    - Rotation axis       :    " << axis.transpose () << std::endl;
@@ -514,3 +1334,96 @@ template class OCLSLAM<ICP::ICPStepConfigT::EIGEN, ICP::ICPStepConfigW::WEIGHTED
 template class OCLSLAM<ICP::ICPStepConfigT::POWER_METHOD, ICP::ICPStepConfigW::REGULAR>;
 /*! \brief Instantiation that uses the Power Method to estimate the rotation, and considers weighted residual errors. */
 template class OCLSLAM<ICP::ICPStepConfigT::POWER_METHOD, ICP::ICPStepConfigW::WEIGHTED>;
+
+
+/*! \details The sweep runs on a separate (not GL-shared) OpenCL environment on 
+ *           the first device, like `benchmarkICP`, on a synthetic point cloud and 
+ *           synthetic landmarks. The problem sizes follow the frames as the pipeline 
+ *           sees them, after the downsampling. The winners are stored per device and 
+ *           problem size, and the pipeline picks them up when it runs on the same 
+ *           device with the same frames.
+ *
+ *  \param[in] width width of the sensor frames.
+ *  \param[in] height height of the sensor frames.
+ *  \param[in] decimation factor by which the sensor frames get downsampled (1 or 2).
+ *  \param[in] repeats number of timed runs for each configuration.
+ */
+void tuneKernels (unsigned int width, unsigned int height, unsigned int decimation, unsigned int repeats)
+{
+    if (decimation != 2) decimation = 1;
+    width /= decimation; height /= decimation;
+    const unsigned int n = width * height;
+    const unsigned int side = oclslam::ICPLMsGrid::getSide (width, height), m = side * side;
+
+    clutils::CLEnv env;
+    env.addContext (0);
+    env.addQueue (0, 0);
+    oclslam::ProgramCache cache;
+    oclslam::addPrograms (env, 0, { { kernel_files_slam, "" } }, cache, kernel_file_placeholder);
+    oclslam::LaunchTuner tuner (cache.getDirectory ());
+    clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+
+    auto print = [] (const std::string &kernel, const oclslam::LaunchConfig &config)
+    {
+        std::cout << "    " << std::left << std::setw (18) << kernel << std::right << " :    local ";
+        if (config.local == 0) std::cout << "auto"; else std::cout << config.local;
+        std::cout << ", " << config.ppw << " point(s) per work-item" << std::endl;
+    };
+
+    oclslam::SplitPC8D sp8D (env, info);
+    sp8D.init (n, oclslam::Staging::NONE);
+    print ("splitPC8D_octomap", sp8D.tune (tuner, repeats));
+
+    // A small known motion, as between consecutive frames
+    Eigen::Matrix3f R = Eigen::AngleAxisf (1.f * M_PI / 180.f, 
+        Eigen::Vector3f (1.f, 2.f, 3.f).normalized ()).toRotationMatrix ();
+    Eigen::Vector3f t (10.f, -5.f, 15.f);
+    std::vector<cl_float8> F, M;
+    generateLandmarks (side, R, t, F, M);
+
+    oclslam::ICPResiduals residuals (env, info);
+    residuals.init (m, 1024, oclslam::Staging::I);
+    residuals.write (oclslam::ICPResiduals::Memory::D_IN_F, F.data ());
+    residuals.write (oclslam::ICPResiduals::Memory::D_IN_M, M.data (), CL_TRUE);
+    residuals.setTransformation (Eigen::Quaternionf (R), t, 1.f);
+    print ("icpResiduals", residuals.tune (tuner, repeats));
+
+    oclslam::DeviceICP devICP (env, info);
+    devICP.get (oclslam::DeviceICP::Memory::D_IN_F) = residuals.get (oclslam::ICPResiduals::Memory::D_IN_F);
+    devICP.get (oclslam::DeviceICP::Memory::D_IN_M) = residuals.get (oclslam::ICPResiduals::Memory::D_IN_M);
+    devICP.init (side, side, 40, 0.001f, 0.01f, 4, 100.f, oclslam::Staging::NONE);
+    print ("icpAssociate", devICP.tune (tuner, repeats));
+}
+
+
+/*! \note The OpenCL environment of the pipeline is GL-shared, so the 
+ *        OpenGL environment must have been initialized before the call.
+ *
+ *  \param[in] CR method of rotation computation.
+ *  \param[in] CW regular or weighted computation.
+ *  \param[in] kinect initialized Kinect device.
+ *  \param[in] map OctoMap structure for building the map.
+ *  \param[in] placement devices for the stages of the pipeline.
+ *  \param[in] profiling flag to create the queues with profiling enabled, for tracing.
+ *  \param[in] decimation factor by which the sensor frames get downsampled (1 or 2).
+ *  \return A pointer to the new pipeline, owned by the caller.
+ */
+OCLSLAMBase* createOCLSLAM (ICP::ICPStepConfigT CR, ICP::ICPStepConfigW CW, Kinect *kinect, 
+                            octomap::OcTree &map, const StagePlacement &placement, bool profiling, 
+                            unsigned int decimation)
+{
+    if (CR == ICP::ICPStepConfigT::EIGEN)
+    {
+        if (CW == ICP::ICPStepConfigW::REGULAR)
+            return new OCLSLAM<ICP::ICPStepConfigT::EIGEN, ICP::ICPStepConfigW::REGULAR> (kinect, map, placement, profiling, decimation);
+        else
+            return new OCLSLAM<ICP::ICPStepConfigT::EIGEN, ICP::ICPStepConfigW::WEIGHTED> (kinect, map, placement, profiling, decimation);
+    }
+    else
+    {
+        if (CW == ICP::ICPStepConfigW::REGULAR)
+            return new OCLSLAM<ICP::ICPStepConfigT::POWER_METHOD, ICP::ICPStepConfigW::REGULAR> (kinect, map, placement, profiling, decimation);
+        else
+            return new OCLSLAM<ICP::ICPStepConfigT::POWER_METHOD, ICP::ICPStepConfigW::WEIGHTED> (kinect, map, placement, profiling, decimation);
+    }
+}
@@ -32,6 +32,7 @@
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
 #include <CLUtils.hpp>
 #include <oclslam/algorithms.hpp>
 
@@ -49,12 +50,20 @@ namespace oclslam
 
     /*! \param[in] _env opencl environment.
      *  \param[in] _info opencl configuration. Specifies the context, queue, etc, to be used.
+     *  \param[in] _pool pool from which to draw the device buffers. If `nullptr`, 
+     *                   the buffers are allocated directly on the context.
+     *  \param[in] _tuner tuner from which to look up the launch configuration at `init`. 
+     *                    If `nullptr`, the defaults are used.
+     *  \param[in] _variants variants of the program, from which to get a specialized kernel. 
+     *                       If `nullptr`, the kernel of the program in `_env` is used.
      */
-    SplitPC8D::SplitPC8D (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info) : 
+    SplitPC8D::SplitPC8D (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool, 
+                          LaunchTuner *_tuner, ProgramVariants *_variants) : 
         env (_env), info (_info), 
         context (env.getContext (info.pIdx)), 
         queue (env.getQueue (info.ctxIdx, info.qIdx[0])), 
-        kernel (env.getProgram (info.pgIdx), "splitPC8D_octomap")
+        kernel (env.getProgram (info.pgIdx), "splitPC8D_octomap"), pooled (_pool), 
+        mappedPC3D (false), mappedRGB (false), tuner (_tuner), variants (_variants), config ({ 0, 1 })
     {
     }
 
@@ -87,7 +96,8 @@ namespace oclslam
     /*! \details Sets up memory objects as necessary, and defines the kernel workspaces.
      *  \note If you have assigned a memory object to one member variable of the class 
      *        before the call to `init`, then that memory will be maintained. Otherwise, 
-     *        a new memory object will be created.
+     *        a new memory object will be created (or drawn from the pool), and on a 
+     *        subsequent call, it will be replaced only if it's too small.
      *        
      *  \param[in] _n number of points in the point cloud.
      *  \param[in] _staging flag to indicate whether or not to instantiate the staging buffers.
@@ -111,14 +121,25 @@ namespace oclslam
             exit (EXIT_FAILURE);
         }
 
-        // Set workspace
-        global = cl::NDRange (n);
+        // Specialize the kernel for the point cloud
+        if (variants != nullptr)
+            kernel = cl::Kernel (variants->get (info.pgIdx, defineOption ("NUM_POINTS", n)), "splitPC8D_octomap");
+
+        // Set workspaces
+        LaunchConfig _config = { 0, 1 };
+        if (tuner != nullptr) tuner->lookup (queue.getInfo<CL_QUEUE_DEVICE> (), "splitPC8D_octomap", n, _config);
+        setConfig (_config);
+
+        unmap ();
+        if (staging == Staging::ZC && !hasUnifiedMemory (queue.getInfo<CL_QUEUE_DEVICE> ()))
+            staging = Staging::IO;
 
         // Create staging buffers
         bool io = false;
         switch (staging)
         {
             case Staging::NONE:
+            case Staging::ZC:
                 hPtrIn = nullptr;
                 hPtrOutPC3D = nullptr;
                 hPtrOutRGB = nullptr;
@@ -161,27 +182,36 @@ namespace oclslam
                 break;
         }
         
-        // Create device buffers
-        if (dBufferIn () == nullptr)
-            dBufferIn = cl::Buffer (context, CL_MEM_READ_ONLY, bufferInSize);
-        if (dBufferOutPC3D () == nullptr)
-            dBufferOutPC3D = cl::Buffer (context, CL_MEM_WRITE_ONLY, bufferOutPC3DSize);
-        if (dBufferOutRGB () == nullptr)
-            dBufferOutRGB = cl::Buffer (context, CL_MEM_WRITE_ONLY, bufferOutRGBSize);
+        // Create device buffers (host-visible for zero-copy)
+        cl_mem_flags zc = (staging == Staging::ZC) ? CL_MEM_ALLOC_HOST_PTR : 0;
+        pooled.ensure (dBufferIn, context, CL_MEM_READ_ONLY | zc, bufferInSize);
+        pooled.ensure (dBufferOutPC3D, context, CL_MEM_WRITE_ONLY | zc, bufferOutPC3DSize);
+        pooled.ensure (dBufferOutRGB, context, CL_MEM_WRITE_ONLY | zc, bufferOutRGBSize);
+
+        // With zero-copy, the device buffers are the staging buffers
+        if (staging == Staging::ZC)
+        {
+            hBufferIn = dBufferIn;
+            hBufferOutPC3D = dBufferOutPC3D;
+            hBufferOutRGB = dBufferOutRGB;
+        }
 
         // Set kernel arguments
         kernel.setArg (0, dBufferIn);
         kernel.setArg (1, dBufferOutPC3D);
         kernel.setArg (2, dBufferOutRGB);
+        kernel.setArg (3, n);
     }
 
 
     /*! \details The transfer happens from a staging buffer on the host to the 
-     *           associated (specified) device buffer.
+     *           associated (specified) device buffer. With zero-copy, the data 
+     *           from `ptr` are copied straight into the mapped device buffer.
      *  
      *  \param[in] mem enumeration value specifying an input device buffer.
      *  \param[in] ptr a pointer to an array holding input data. If not NULL, the 
      *                 data from `ptr` will be copied to the associated staging buffer.
+     *                 With zero-copy, it's required.
      *  \param[in] block a flag to indicate whether to perform a blocking 
      *                   or a non-blocking operation.
      *  \param[in] events a wait-list of events.
@@ -190,7 +220,17 @@ namespace oclslam
     void SplitPC8D::write (SplitPC8D::Memory mem, void *ptr, bool block, 
                            const std::vector<cl::Event> *events, cl::Event *event)
     {
-        if (staging == Staging::I || staging == Staging::IO)
+        if (staging == Staging::ZC && mem == SplitPC8D::Memory::D_IN && ptr != nullptr)
+        {
+            cl::Event unmapEvent;
+            cl_float8 *hPtr = (cl_float8 *) queue.enqueueMapBuffer (
+                dBufferIn, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, bufferInSize, events);
+            std::copy ((cl_float8 *) ptr, (cl_float8 *) ptr + n, hPtr);
+            queue.enqueueUnmapMemObject (dBufferIn, hPtr, nullptr, &unmapEvent);
+            if (event != nullptr) *event = unmapEvent;
+            if (block) unmapEvent.wait ();
+        }
+        else if (staging == Staging::I || staging == Staging::IO)
         {
             switch (mem)
             {
@@ -207,7 +247,8 @@ namespace oclslam
 
 
     /*! \details The transfer happens from a device buffer to the associated 
-     *           (specified) staging buffer on the host.
+     *           (specified) staging buffer on the host. With zero-copy, the device 
+     *           buffer gets mapped instead, and it stays mapped until the next `run`.
      *  
      *  \param[in] mem enumeration value specifying an output staging buffer.
      *  \param[in] block a flag to indicate whether to perform a blocking 
@@ -218,7 +259,27 @@ namespace oclslam
     void* SplitPC8D::read (SplitPC8D::Memory mem, bool block, 
                            const std::vector<cl::Event> *events, cl::Event *event)
     {
-        if (staging == Staging::O || staging == Staging::IO)
+        if (staging == Staging::ZC)
+        {
+            switch (mem)
+            {
+                case SplitPC8D::Memory::H_OUT_PC3D:
+                    if (!mappedPC3D)
+                        hPtrOutPC3D = (cl_float *) queue.enqueueMapBuffer (
+                            dBufferOutPC3D, block, CL_MAP_READ, 0, bufferOutPC3DSize, events, event);
+                    mappedPC3D = true;
+                    return hPtrOutPC3D;
+                case SplitPC8D::Memory::H_OUT_RGB:
+                    if (!mappedRGB)
+                        hPtrOutRGB = (cl_uchar *) queue.enqueueMapBuffer (
+                            dBufferOutRGB, block, CL_MAP_READ, 0, bufferOutRGBSize, events, event);
+                    mappedRGB = true;
+                    return hPtrOutRGB;
+                default:
+                    return nullptr;
+            }
+        }
+        else if (staging == Staging::O || staging == Staging::IO)
         {
             switch (mem)
             {
@@ -242,6 +303,1681 @@ namespace oclslam
      *  \param[out] event event associated with the last kernel execution.
      */
     void SplitPC8D::run (const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        unmap ();
+        queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, local, events, event);
+    }
+
+
+    /*! \details Sweeps the local sizes, including the driver's choice, 
+     *           together with 1, 2, 4, and 8 points per work-item. 
+     *           It has to be called after `init`.
+     *
+     *  \param[in] tuner tuner in which to store the fastest configuration.
+     *  \param[in] repeats number of timed runs for each configuration.
+     *  \return The fastest configuration, which is left applied.
+     */
+    LaunchConfig SplitPC8D::tune (LaunchTuner &tuner, unsigned int repeats)
+    {
+        cl::Device device = queue.getInfo<CL_QUEUE_DEVICE> ();
+        std::vector<unsigned int> sizes = LaunchTuner::getLocalSizes (kernel, device);
+
+        std::vector<LaunchConfig> candidates;
+        for (unsigned int ppw = 1; ppw <= 8; ppw <<= 1)
+        {
+            candidates.push_back ({ 0, ppw });
+            for (unsigned int size : sizes) candidates.push_back ({ size, ppw });
+        }
+
+        LaunchConfig best = LaunchTuner::sweep (queue, candidates, 
+            [this] (const LaunchConfig &c) { setConfig (c); }, [this] { run (); }, repeats);
+        tuner.store (device, "splitPC8D_octomap", n, best);
+
+        return best;
+    }
+
+
+    /*! \details With \f$ ppw \f$ points per work-item, there are \f$ \lceil n / ppw \rceil \f$ 
+     *           work-items, rounded up to a multiple of the local size.
+     *
+     *  \param[in] _config launch configuration.
+     */
+    void SplitPC8D::setConfig (const LaunchConfig &_config)
+    {
+        config = _config;
+        unsigned int items = (n + config.ppw - 1) / config.ppw;
+
+        if (config.local == 0)
+        {
+            global = cl::NDRange (items);
+            local = cl::NullRange;
+        }
+        else
+        {
+            global = cl::NDRange ((items + config.local - 1) / config.local * config.local);
+            local = cl::NDRange (config.local);
+        }
+    }
+
+
+    /*! \note The pointers to the mapped outputs become invalid. */
+    void SplitPC8D::unmap ()
+    {
+        if (mappedPC3D)
+        {
+            queue.enqueueUnmapMemObject (dBufferOutPC3D, hPtrOutPC3D);
+            hPtrOutPC3D = nullptr;
+            mappedPC3D = false;
+        }
+        if (mappedRGB)
+        {
+            queue.enqueueUnmapMemObject (dBufferOutRGB, hPtrOutRGB);
+            hPtrOutRGB = nullptr;
+            mappedRGB = false;
+        }
+    }
+
+
+    /*! \param[in] _env opencl environment.
+     *  \param[in] _info opencl configuration. Specifies the context, queue, etc, to be used.
+     *  \param[in] _pool pool from which to draw the device buffers. If `nullptr`, 
+     *                   the buffers are allocated directly on the context.
+     *  \param[in] _tuner tuner from which to look up the launch configuration at `init`. 
+     *                    If `nullptr`, the defaults are used.
+     */
+    ICPResiduals::ICPResiduals (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool, 
+                                LaunchTuner *_tuner) : 
+        env (_env), info (_info), 
+        context (env.getContext (info.pIdx)), 
+        queue (env.getQueue (info.ctxIdx, info.qIdx[0])), 
+        kernel (env.getProgram (info.pgIdx), "icpResiduals"), pooled (_pool), mappedOut (false), 
+        tuner (_tuner), config ({ 256, 1 })
+    {
+    }
+
+
+    /*! \details This interface exists to allow CL memory sharing between different kernels.
+     *
+     *  \param[in] mem enumeration value specifying the requested memory object.
+     *  \return A reference to the requested memory object.
+     */
+    cl::Memory& ICPResiduals::get (ICPResiduals::Memory mem)
+    {
+        switch (mem)
+        {
+            case ICPResiduals::Memory::H_IN_F:
+                return hBufferInF;
+            case ICPResiduals::Memory::H_IN_M:
+                return hBufferInM;
+            case ICPResiduals::Memory::H_OUT:
+                return hBufferOut;
+            case ICPResiduals::Memory::D_IN_F:
+                return dBufferInF;
+            case ICPResiduals::Memory::D_IN_M:
+                return dBufferInM;
+            case ICPResiduals::Memory::D_OUT:
+                return dBufferOut;
+        }
+    }
+
+
+    /*! \details Sets up memory objects as necessary, and defines the kernel workspaces.
+     *  \note If you have assigned a memory object to one member variable of the class 
+     *        before the call to `init`, then that memory will be maintained. Otherwise, 
+     *        a new memory object will be created (or drawn from the pool), and on a 
+     *        subsequent call, it will be replaced only if it's too small.
+     *        
+     *  \param[in] _m number of landmarks in each set.
+     *  \param[in] _samples number of moving landmarks to evaluate. It should be a multiple 
+     *                      of 256, and the samples are spread uniformly over the set.
+     *  \param[in] _staging flag to indicate whether or not to instantiate the staging buffers.
+     */
+    void ICPResiduals::init (unsigned int _m, unsigned int _samples, Staging _staging)
+    {
+        m = _m;
+        samples = _samples;
+        bufferInSize = m * sizeof (cl_float8);
+        bufferOutSize = samples * sizeof (cl_float);
+        staging = _staging;
+
+        try
+        {
+            if (m == 0)
+                throw "The landmark sets cannot be empty";
+
+            if (samples == 0 || samples % 256 != 0)
+                throw "The number of samples must be a (non-zero) multiple of 256";
+
+            if (samples > m)
+                throw "The number of samples cannot exceed the number of landmarks";
+        }
+        catch (const char *error)
+        {
+            std::cerr << "Error[ICPResiduals]: " << error << std::endl;
+            exit (EXIT_FAILURE);
+        }
+
+        // Set workspaces
+        global = cl::NDRange (samples);
+        LaunchConfig _config = { 256, 1 };
+        if (tuner != nullptr) tuner->lookup (queue.getInfo<CL_QUEUE_DEVICE> (), "icpResiduals", m, _config);
+        setConfig (_config);
+
+        unmap ();
+        if (staging == Staging::ZC && !hasUnifiedMemory (queue.getInfo<CL_QUEUE_DEVICE> ()))
+            staging = Staging::IO;
+
+        // Create staging buffers
+        bool io = false;
+        switch (staging)
+        {
+            case Staging::NONE:
+            case Staging::ZC:
+                hPtrInF = nullptr;
+                hPtrInM = nullptr;
+                hPtrOut = nullptr;
+                break;
+
+            case Staging::IO:
+                io = true;
+
+            case Staging::I:
+                if (hBufferInF () == nullptr)
+                    hBufferInF = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferInSize);
+                if (hBufferInM () == nullptr)
+                    hBufferInM = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferInSize);
+
+                hPtrInF = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferInF, CL_FALSE, CL_MAP_WRITE, 0, bufferInSize);
+                hPtrInM = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferInM, CL_FALSE, CL_MAP_WRITE, 0, bufferInSize);
+                queue.enqueueUnmapMemObject (hBufferInF, hPtrInF);
+                queue.enqueueUnmapMemObject (hBufferInM, hPtrInM);
+
+                if (!io)
+                {
+                    queue.finish ();
+                    hPtrOut = nullptr;
+                    break;
+                }
+
+            case Staging::O:
+                if (hBufferOut () == nullptr)
+                    hBufferOut = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferOutSize);
+
+                hPtrOut = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferOut, CL_FALSE, CL_MAP_READ, 0, bufferOutSize);
+                queue.enqueueUnmapMemObject (hBufferOut, hPtrOut);
+                queue.finish ();
+
+                if (!io)
+                {
+                    hPtrInF = nullptr;
+                    hPtrInM = nullptr;
+                }
+                break;
+        }
+        
+        // Create device buffers (host-visible for zero-copy)
+        cl_mem_flags zc = (staging == Staging::ZC) ? CL_MEM_ALLOC_HOST_PTR : 0;
+        pooled.ensure (dBufferInF, context, CL_MEM_READ_ONLY | zc, bufferInSize);
+        pooled.ensure (dBufferInM, context, CL_MEM_READ_ONLY | zc, bufferInSize);
+        pooled.ensure (dBufferOut, context, CL_MEM_WRITE_ONLY | zc, bufferOutSize);
+
+        // With zero-copy, the device buffers are the staging buffers
+        if (staging == Staging::ZC)
+        {
+            hBufferInF = dBufferInF;
+            hBufferInM = dBufferInM;
+            hBufferOut = dBufferOut;
+        }
+
+        // Set kernel arguments
+        kernel.setArg (0, dBufferInF);
+        kernel.setArg (1, dBufferInM);
+        kernel.setArg (3, dBufferOut);
+        kernel.setArg (5, m);
+        kernel.setArg (6, m / samples);
+        setTransformation (Eigen::Quaternionf::Identity (), Eigen::Vector3f::Zero (), 1.f);
+    }
+
+
+    /*! \details The transfer happens from a staging buffer on the host to the 
+     *           associated (specified) device buffer. With zero-copy, the data 
+     *           from `ptr` are copied straight into the mapped device buffer.
+     *  
+     *  \param[in] mem enumeration value specifying an input device buffer.
+     *  \param[in] ptr a pointer to an array holding input data. If not NULL, the 
+     *                 data from `ptr` will be copied to the associated staging buffer.
+     *                 With zero-copy, it's required.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the write operation to the device buffer.
+     */
+    void ICPResiduals::write (ICPResiduals::Memory mem, void *ptr, bool block, 
+                              const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if (staging == Staging::ZC && ptr != nullptr)
+        {
+            switch (mem)
+            {
+                case ICPResiduals::Memory::D_IN_F:
+                    writeMapped (dBufferInF, ptr, block, events, event);
+                    break;
+                case ICPResiduals::Memory::D_IN_M:
+                    writeMapped (dBufferInM, ptr, block, events, event);
+                    break;
+                default:
+                    break;
+            }
+        }
+        else if (staging == Staging::I || staging == Staging::IO)
+        {
+            switch (mem)
+            {
+                case ICPResiduals::Memory::D_IN_F:
+                    if (ptr != nullptr)
+                        std::copy ((cl_float8 *) ptr, (cl_float8 *) ptr + m, (cl_float8 *) hPtrInF);
+                    queue.enqueueWriteBuffer (dBufferInF, block, 0, bufferInSize, hPtrInF, events, event);
+                    break;
+                case ICPResiduals::Memory::D_IN_M:
+                    if (ptr != nullptr)
+                        std::copy ((cl_float8 *) ptr, (cl_float8 *) ptr + m, (cl_float8 *) hPtrInM);
+                    queue.enqueueWriteBuffer (dBufferInM, block, 0, bufferInSize, hPtrInM, events, event);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+
+    /*! \details The transfer happens from a device buffer to the associated 
+     *           (specified) staging buffer on the host. With zero-copy, the device 
+     *           buffer gets mapped instead, and it stays mapped until the next `run`.
+     *  
+     *  \param[in] mem enumeration value specifying an output staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the read operation to the staging buffer.
+     */
+    void* ICPResiduals::read (ICPResiduals::Memory mem, bool block, 
+                              const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if (staging == Staging::ZC)
+        {
+            if (mem != ICPResiduals::Memory::H_OUT)
+                return nullptr;
+            if (!mappedOut)
+                hPtrOut = (cl_float *) queue.enqueueMapBuffer (
+                    dBufferOut, block, CL_MAP_READ, 0, bufferOutSize, events, event);
+            mappedOut = true;
+            return hPtrOut;
+        }
+        else if (staging == Staging::O || staging == Staging::IO)
+        {
+            switch (mem)
+            {
+                case ICPResiduals::Memory::H_OUT:
+                    queue.enqueueReadBuffer (dBufferOut, block, 0, bufferOutSize, hPtrOut, events, event);
+                    return hPtrOut;
+                default:
+                    return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+
+    /*! \details The function call is non-blocking.
+     *
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the last kernel execution.
+     */
+    void ICPResiduals::run (const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        unmap ();
+        queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, local, events, event);
+    }
+
+
+    /*! \details Sweeps the power-of-2 local sizes. It has to be called after `init`.
+     *
+     *  \param[in] tuner tuner in which to store the fastest configuration.
+     *  \param[in] repeats number of timed runs for each configuration.
+     *  \return The fastest configuration, which is left applied.
+     */
+    LaunchConfig ICPResiduals::tune (LaunchTuner &tuner, unsigned int repeats)
+    {
+        cl::Device device = queue.getInfo<CL_QUEUE_DEVICE> ();
+
+        std::vector<LaunchConfig> candidates;
+        for (unsigned int size : LaunchTuner::getLocalSizes (kernel, device))
+            candidates.push_back ({ size, 1 });
+        if (candidates.empty ()) return config;
+
+        LaunchConfig best = LaunchTuner::sweep (queue, candidates, 
+            [this] (const LaunchConfig &c) { setConfig (c); }, [this] { run (); }, repeats);
+        tuner.store (device, "icpResiduals", m, best);
+
+        return best;
+    }
+
+
+    /*! \details The local size has to divide the number of samples, 
+     *           otherwise the default (256) is used. Every work-group 
+     *           stages a tile of as many fixed landmarks in local memory.
+     *
+     *  \param[in] _config launch configuration.
+     */
+    void ICPResiduals::setConfig (const LaunchConfig &_config)
+    {
+        config = { _config.local, 1 };
+        if (config.local == 0 || samples % config.local != 0) config.local = 256;
+
+        local = cl::NDRange (config.local);
+        kernel.setArg (2, cl::Local (config.local * sizeof (cl_float4)));
+    }
+
+
+    /*! \note The pointer to the mapped output becomes invalid. */
+    void ICPResiduals::unmap ()
+    {
+        if (mappedOut)
+        {
+            queue.enqueueUnmapMemObject (dBufferOut, hPtrOut);
+            hPtrOut = nullptr;
+            mappedOut = false;
+        }
+    }
+
+
+    /*! \details The buffer is mapped (blocking) with its previous contents invalidated, 
+     *           the landmarks are copied in, and the buffer gets unmapped.
+     *
+     *  \param[in] buffer zero-copy device buffer.
+     *  \param[in] ptr a pointer to an array holding the input landmarks.
+     *  \param[in] block a flag to indicate whether to wait for the unmap operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the unmap operation.
+     */
+    void ICPResiduals::writeMapped (cl::Buffer &buffer, void *ptr, bool block, 
+                                    const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        cl::Event unmapEvent;
+        cl_float8 *hPtr = (cl_float8 *) queue.enqueueMapBuffer (
+            buffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, bufferInSize, events);
+        std::copy ((cl_float8 *) ptr, (cl_float8 *) ptr + m, hPtr);
+        queue.enqueueUnmapMemObject (buffer, hPtr, nullptr, &unmapEvent);
+        if (event != nullptr) *event = unmapEvent;
+        if (block) unmapEvent.wait ();
+    }
+
+
+    /*! \details The transformation maps the moving landmarks onto the fixed ones, 
+     *           \f$ p_F = sR(q)p_M + t \f$. It's the one estimated by `ICP`.
+     *
+     *  \param[in] q rotation in quaternion representation.
+     *  \param[in] t translation (in mm).
+     *  \param[in] s scale.
+     */
+    void ICPResiduals::setTransformation (const Eigen::Quaternionf &q, const Eigen::Vector3f &t, float s)
+    {
+        cl_float8 T = { q.x (), q.y (), q.z (), q.w (), t[0], t[1], t[2], s };
+        kernel.setArg (4, T);
+    }
+
+
+
+    /*! \param[in] _env opencl environment.
+     *  \param[in] _info opencl configuration. Specifies the context, queue, etc, to be used.
+     *  \param[in] _pool pool from which to draw the device buffers. If `nullptr`, 
+     *                   the buffers are allocated directly on the context.
+     *  \param[in] _tuner tuner from which to look up the launch configuration at `init`. 
+     *                    If `nullptr`, the defaults are used.
+     */
+    DeviceICP::DeviceICP (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool, 
+                          LaunchTuner *_tuner) : 
+        env (_env), info (_info), 
+        context (env.getContext (info.pIdx)), 
+        queue (env.getQueue (info.ctxIdx, info.qIdx[0])), 
+        associateKernel (env.getProgram (info.pgIdx), "icpAssociate"), 
+        solveKernel (env.getProgram (info.pgIdx), "icpSolve"), 
+        R (Eigen::Matrix3f::Identity ()), t (Eigen::Vector3f::Zero ()), s (1.f), k (0), converged (false), 
+        pooled (_pool), tuner (_tuner), config ({ 256, 1 })
+    {
+    }
+
+
+    /*! \details This interface exists to allow CL memory sharing between different kernels.
+     *
+     *  \param[in] mem enumeration value specifying the requested memory object.
+     *  \return A reference to the requested memory object.
+     */
+    cl::Memory& DeviceICP::get (DeviceICP::Memory mem)
+    {
+        switch (mem)
+        {
+            case DeviceICP::Memory::H_IN_F:
+                return hBufferInF;
+            case DeviceICP::Memory::H_IN_M:
+                return hBufferInM;
+            case DeviceICP::Memory::H_OUT:
+                return hBufferOut;
+            case DeviceICP::Memory::D_IN_F:
+                return dBufferInF;
+            case DeviceICP::Memory::D_IN_M:
+                return dBufferInM;
+            case DeviceICP::Memory::D_OUT:
+                return dBufferOut;
+        }
+    }
+
+
+    /*! \details Sets up memory objects as necessary, and defines the kernel workspaces.
+     *  \note If you have assigned a memory object to one member variable of the class 
+     *        before the call to `init`, then that memory will be maintained. Otherwise, 
+     *        a new memory object will be created (or drawn from the pool), and on a 
+     *        subsequent call, it will be replaced only if it's too small.
+     *  \note The results (`R`, `t`, `s`, `k`) are only available with output staging.
+     *        
+     *  \param[in] _gw width of the landmark grid.
+     *  \param[in] _gh height of the landmark grid. The number of landmarks, 
+     *                 \f$ m = gw * gh \f$, should be a multiple of 256.
+     *  \param[in] _maxIterations maximum number of iterations.
+     *  \param[in] _angleThreshold angle threshold (in degrees) for the convergence check.
+     *  \param[in] _translationThreshold translation threshold (in mm) for the convergence check.
+     *  \param[in] _radius radius of the search window on the landmark grid.
+     *  \param[in] _maxDistance maximum distance (in mm) between two associated landmarks.
+     *  \param[in] _staging flag to indicate whether or not to instantiate the staging buffers.
+     */
+    void DeviceICP::init (unsigned int _gw, unsigned int _gh, unsigned int _maxIterations, 
+                          float _angleThreshold, float _translationThreshold, 
+                          int _radius, float _maxDistance, Staging _staging)
+    {
+        gw = _gw; gh = _gh;
+        m = gw * gh;
+        maxIterations = _maxIterations;
+        angleThreshold = _angleThreshold;
+        translationThreshold = _translationThreshold;
+        radius = _radius;
+        maxDistance = _maxDistance;
+        bufferInSize = m * sizeof (cl_float8);
+        bufferOutSize = sizeof (cl_float8) + sizeof (cl_uint4);
+        staging = _staging;
+
+        try
+        {
+            if (m == 0 || m % 256 != 0)
+                throw "The number of landmarks must be a (non-zero) multiple of 256";
+
+            if (radius < 0)
+                throw "The radius of the search window cannot be negative";
+        }
+        catch (const char *error)
+        {
+            std::cerr << "Error[DeviceICP]: " << error << std::endl;
+            exit (EXIT_FAILURE);
+        }
+
+        // Set workspaces
+        global = cl::NDRange (m);
+
+        // Zero-copy has nothing to save here. The inputs are the device buffers 
+        // of the landmark stages, and the output is 48 bytes, gathered by `read` 
+        // from two device buffers (the transformation and the loop state) into 
+        // one staging buffer, which a mapping of either buffer can't give. The 
+        // staging switch below has no ZC case either, so without the fallback 
+        // no staging buffers would be created and `read` would return nothing
+        if (staging == Staging::ZC)
+            staging = Staging::IO;
+
+        // Create staging buffers
+        bool io = false;
+        switch (staging)
+        {
+            case Staging::NONE:
+                hPtrInF = nullptr;
+                hPtrInM = nullptr;
+                hPtrOut = nullptr;
+                break;
+
+            case Staging::IO:
+                io = true;
+
+            case Staging::I:
+                if (hBufferInF () == nullptr)
+                    hBufferInF = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferInSize);
+                if (hBufferInM () == nullptr)
+                    hBufferInM = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferInSize);
+
+                hPtrInF = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferInF, CL_FALSE, CL_MAP_WRITE, 0, bufferInSize);
+                hPtrInM = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferInM, CL_FALSE, CL_MAP_WRITE, 0, bufferInSize);
+                queue.enqueueUnmapMemObject (hBufferInF, hPtrInF);
+                queue.enqueueUnmapMemObject (hBufferInM, hPtrInM);
+
+                if (!io)
+                {
+                    queue.finish ();
+                    hPtrOut = nullptr;
+                    break;
+                }
+
+            case Staging::O:
+                if (hBufferOut () == nullptr)
+                    hBufferOut = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferOutSize);
+
+                hPtrOut = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferOut, CL_FALSE, CL_MAP_READ, 0, bufferOutSize);
+                queue.enqueueUnmapMemObject (hBufferOut, hPtrOut);
+                queue.finish ();
+
+                if (!io)
+                {
+                    hPtrInF = nullptr;
+                    hPtrInM = nullptr;
+                }
+                break;
+        }
+        
+        // Create device buffers
+        pooled.ensure (dBufferInF, context, CL_MEM_READ_ONLY, bufferInSize);
+        pooled.ensure (dBufferInM, context, CL_MEM_READ_ONLY, bufferInSize);
+        pooled.ensure (dBufferOut, context, CL_MEM_READ_WRITE, sizeof (cl_float8));
+        pooled.ensure (dBufferState, context, CL_MEM_READ_WRITE, sizeof (cl_uint4));
+
+        // The work-groups, and so the statistics buffer, follow the local size
+        LaunchConfig _config = { 256, 1 };
+        if (tuner != nullptr) tuner->lookup (queue.getInfo<CL_QUEUE_DEVICE> (), "icpAssociate", m, _config);
+        setConfig (_config);
+
+        // Initial transformation
+        std::fill (T0.s, T0.s + 8, 0.f);
+        T0.s[3] = T0.s[7] = 1.f;
+
+        // Set kernel arguments
+        associateKernel.setArg (0, dBufferInF);
+        associateKernel.setArg (1, dBufferInM);
+        associateKernel.setArg (2, dBufferOut);
+        associateKernel.setArg (3, dBufferState);
+        associateKernel.setArg (6, gw);
+        associateKernel.setArg (7, gh);
+        associateKernel.setArg (8, radius);
+        associateKernel.setArg (9, maxDistance);
+
+        solveKernel.setArg (2, dBufferOut);
+        solveKernel.setArg (3, dBufferState);
+        solveKernel.setArg (4, angleThreshold);
+        solveKernel.setArg (5, translationThreshold);
+    }
+
+
+    /*! \details The transfer happens from a staging buffer on the host to the 
+     *           associated (specified) device buffer.
+     *  
+     *  \param[in] mem enumeration value specifying an input device buffer.
+     *  \param[in] ptr a pointer to an array holding input data. If not NULL, the 
+     *                 data from `ptr` will be copied to the associated staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the write operation to the device buffer.
+     */
+    void DeviceICP::write (DeviceICP::Memory mem, void *ptr, bool block, 
+                           const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if (staging == Staging::I || staging == Staging::IO)
+        {
+            switch (mem)
+            {
+                case DeviceICP::Memory::D_IN_F:
+                    if (ptr != nullptr)
+                        std::copy ((cl_float8 *) ptr, (cl_float8 *) ptr + m, (cl_float8 *) hPtrInF);
+                    queue.enqueueWriteBuffer (dBufferInF, block, 0, bufferInSize, hPtrInF, events, event);
+                    break;
+                case DeviceICP::Memory::D_IN_M:
+                    if (ptr != nullptr)
+                        std::copy ((cl_float8 *) ptr, (cl_float8 *) ptr + m, (cl_float8 *) hPtrInM);
+                    queue.enqueueWriteBuffer (dBufferInM, block, 0, bufferInSize, hPtrInM, events, event);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+
+    /*! \details The transfer happens from a device buffer to the associated 
+     *           (specified) staging buffer on the host. The staging buffer receives 
+     *           the transformation (8 floats), followed by the convergence flag, 
+     *           the iteration count, and the failure flag (3 uints). On a blocking 
+     *           call, the results are also decoded into `R`, `t`, `s`, `k`, and `converged`.
+     *  
+     *  \param[in] mem enumeration value specifying an output staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the read operation to the staging buffer.
+     */
+    void* DeviceICP::read (DeviceICP::Memory mem, bool block, 
+                           const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if (staging == Staging::O || staging == Staging::IO)
+        {
+            switch (mem)
+            {
+                case DeviceICP::Memory::H_OUT:
+                {
+                    queue.enqueueReadBuffer (dBufferOut, CL_FALSE, 0, sizeof (cl_float8), hPtrOut, events);
+                    queue.enqueueReadBuffer (dBufferState, block, 0, sizeof (cl_uint4), hPtrOut + 8, nullptr, event);
+
+                    if (block)
+                    {
+                        cl_uint *state = (cl_uint *) (hPtrOut + 8);
+                        R = Eigen::Quaternionf (hPtrOut[3], hPtrOut[0], hPtrOut[1], hPtrOut[2]).toRotationMatrix ();
+                        t = Eigen::Map<Eigen::Vector3f> (hPtrOut + 4);
+                        s = hPtrOut[7];
+                        k = state[1];
+                        converged = state[0] && !state[2];
+                    }
+                    return hPtrOut;
+                }
+                default:
+                    return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+
+    /*! \details Resets the transformation to the identity, and enqueues `maxIterations` 
+     *           iterations. The kernels after convergence exit immediately. The function 
+     *           call is non-blocking. Call `read` to get the results.
+     *
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the last kernel execution.
+     */
+    void DeviceICP::run (const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        queue.enqueueWriteBuffer (dBufferOut, CL_FALSE, 0, sizeof (cl_float8), &T0, events);
+        queue.enqueueFillBuffer<cl_uint> (dBufferState, 0, 0, sizeof (cl_uint4));
+
+        for (unsigned int i = 0; i < maxIterations; ++i)
+        {
+            queue.enqueueNDRangeKernel (associateKernel, cl::NullRange, global, local);
+            queue.enqueueNDRangeKernel (solveKernel, cl::NullRange, cl::NDRange (1), cl::NDRange (1), 
+                                        nullptr, (i == maxIterations - 1) ? event : nullptr);
+        }
+    }
+
+
+    /*! \details Sweeps the power-of-2 local sizes of `icpAssociate`, timing whole 
+     *           registrations, since the number of work-groups also sets the work 
+     *           of `icpSolve`. It has to be called after `init`, with landmarks 
+     *           in the input buffers, as the iterations stop at convergence.
+     *
+     *  \param[in] tuner tuner in which to store the fastest configuration.
+     *  \param[in] repeats number of timed registrations for each configuration.
+     *  \return The fastest configuration, which is left applied.
+     */
+    LaunchConfig DeviceICP::tune (LaunchTuner &tuner, unsigned int repeats)
+    {
+        cl::Device device = queue.getInfo<CL_QUEUE_DEVICE> ();
+
+        std::vector<LaunchConfig> candidates;
+        for (unsigned int size : LaunchTuner::getLocalSizes (associateKernel, device))
+            candidates.push_back ({ size, 1 });
+        if (candidates.empty ()) return config;
+
+        LaunchConfig best = LaunchTuner::sweep (queue, candidates, 
+            [this] (const LaunchConfig &c) { setConfig (c); }, [this] { run (); }, repeats);
+        tuner.store (device, "icpAssociate", m, best);
+
+        return best;
+    }
+
+
+    /*! \details The local size has to divide the number of landmarks, otherwise 
+     *           the default (256) is used. There is a set of statistics for 
+     *           every work-group, and the statistics buffer grows as needed.
+     *
+     *  \param[in] _config launch configuration.
+     */
+    void DeviceICP::setConfig (const LaunchConfig &_config)
+    {
+        config = { _config.local, 1 };
+        if (config.local == 0 || m % config.local != 0) config.local = 256;
+
+        groups = m / config.local;
+        local = cl::NDRange (config.local);
+        pooled.ensure (dBufferSums, context, CL_MEM_READ_WRITE, 18 * groups * sizeof (cl_float));
+
+        associateKernel.setArg (4, cl::Local (config.local * sizeof (cl_float)));
+        associateKernel.setArg (5, dBufferSums);
+        solveKernel.setArg (0, dBufferSums);
+        solveKernel.setArg (1, groups);
+    }
+
+
+    /*! \param[in] _env opencl environment.
+     *  \param[in] _info opencl configuration. Specifies the context, queue, etc, to be used.
+     *  \param[in] _pool pool from which to draw the device buffers. If `nullptr`, 
+     *                   the buffers are allocated directly on the context.
+     *  \param[in] _variants variants of the program, from which to get a specialized kernel. 
+     *                       If `nullptr`, the kernel of the program in `_env` is used.
+     */
+    DownsampleRGBD::DownsampleRGBD (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool, 
+                                    ProgramVariants *_variants) : 
+        env (_env), info (_info), 
+        context (env.getContext (info.pIdx)), 
+        queue (env.getQueue (info.ctxIdx, info.qIdx[0])), 
+        kernel (env.getProgram (info.pgIdx), "downsampleRGBD"), pooled (_pool), variants (_variants)
+    {
+    }
+
+
+    /*! \details This interface exists to allow CL memory sharing between different kernels.
+     *
+     *  \param[in] mem enumeration value specifying the requested memory object.
+     *  \return A reference to the requested memory object.
+     */
+    cl::Memory& DownsampleRGBD::get (DownsampleRGBD::Memory mem)
+    {
+        switch (mem)
+        {
+            case DownsampleRGBD::Memory::H_IN_RGB:
+                return hBufferInRGB;
+            case DownsampleRGBD::Memory::H_IN_D:
+                return hBufferInD;
+            case DownsampleRGBD::Memory::H_OUT_RGB:
+                return hBufferOutRGB;
+            case DownsampleRGBD::Memory::H_OUT_D:
+                return hBufferOutD;
+            case DownsampleRGBD::Memory::D_IN_RGB:
+                return dBufferInRGB;
+            case DownsampleRGBD::Memory::D_IN_D:
+                return dBufferInD;
+            case DownsampleRGBD::Memory::D_OUT_RGB:
+                return dBufferOutRGB;
+            case DownsampleRGBD::Memory::D_OUT_D:
+                return dBufferOutD;
+        }
+    }
+
+
+    /*! \details Sets up memory objects as necessary, and defines the kernel workspaces.
+     *  \note If you have assigned a memory object to one member variable of the class 
+     *        before the call to `init`, then that memory will be maintained. Otherwise, 
+     *        a new memory object will be created (or drawn from the pool), and on a 
+     *        subsequent call, it will be replaced only if it's too small.
+     *        
+     *  \param[in] _width width of the input frames. It should be even.
+     *  \param[in] _height height of the input frames. It should be even.
+     *  \param[in] _staging flag to indicate whether or not to instantiate the staging buffers.
+     */
+    void DownsampleRGBD::init (unsigned int _width, unsigned int _height, Staging _staging)
+    {
+        width = _width;
+        height = _height;
+        bufferInRGBSize = width * height * 3 * sizeof (cl_uchar);
+        bufferInDSize = width * height * sizeof (cl_ushort);
+        bufferOutRGBSize = bufferInRGBSize / 4;
+        bufferOutDSize = bufferInDSize / 4;
+        staging = (_staging == Staging::ZC) ? Staging::IO : _staging;
+
+        try
+        {
+            if (width == 0 || height == 0)
+                throw "The frames cannot be empty";
+
+            if (width % 2 != 0 || height % 2 != 0)
+                throw "The dimensions of the frames must be even";
+        }
+        catch (const char *error)
+        {
+            std::cerr << "Error[DownsampleRGBD]: " << error << std::endl;
+            exit (EXIT_FAILURE);
+        }
+
+        // Specialize the kernel for the frames
+        if (variants != nullptr)
+            kernel = cl::Kernel (variants->get (info.pgIdx, defineOption ("FRAME_WIDTH", width)), "downsampleRGBD");
+
+        // Set workspaces
+        global = cl::NDRange (width / 2, height / 2);
+
+        // Create staging buffers
+        bool io = false;
+        switch (staging)
+        {
+            case Staging::NONE:
+            case Staging::ZC:
+                hPtrInRGB = nullptr;
+                hPtrInD = nullptr;
+                hPtrOutRGB = nullptr;
+                hPtrOutD = nullptr;
+                break;
+
+            case Staging::IO:
+                io = true;
+
+            case Staging::I:
+                if (hBufferInRGB () == nullptr)
+                    hBufferInRGB = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferInRGBSize);
+                if (hBufferInD () == nullptr)
+                    hBufferInD = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferInDSize);
+
+                hPtrInRGB = (cl_uchar *) queue.enqueueMapBuffer (
+                    hBufferInRGB, CL_FALSE, CL_MAP_WRITE, 0, bufferInRGBSize);
+                hPtrInD = (cl_ushort *) queue.enqueueMapBuffer (
+                    hBufferInD, CL_FALSE, CL_MAP_WRITE, 0, bufferInDSize);
+                queue.enqueueUnmapMemObject (hBufferInRGB, hPtrInRGB);
+                queue.enqueueUnmapMemObject (hBufferInD, hPtrInD);
+
+                if (!io)
+                {
+                    queue.finish ();
+                    hPtrOutRGB = nullptr;
+                    hPtrOutD = nullptr;
+                    break;
+                }
+
+            case Staging::O:
+                if (hBufferOutRGB () == nullptr)
+                    hBufferOutRGB = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferOutRGBSize);
+                if (hBufferOutD () == nullptr)
+                    hBufferOutD = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferOutDSize);
+
+                hPtrOutRGB = (cl_uchar *) queue.enqueueMapBuffer (
+                    hBufferOutRGB, CL_FALSE, CL_MAP_READ, 0, bufferOutRGBSize);
+                hPtrOutD = (cl_ushort *) queue.enqueueMapBuffer (
+                    hBufferOutD, CL_FALSE, CL_MAP_READ, 0, bufferOutDSize);
+                queue.enqueueUnmapMemObject (hBufferOutRGB, hPtrOutRGB);
+                queue.enqueueUnmapMemObject (hBufferOutD, hPtrOutD);
+                queue.finish ();
+
+                if (!io)
+                {
+                    hPtrInRGB = nullptr;
+                    hPtrInD = nullptr;
+                }
+                break;
+        }
+        
+        // Create device buffers
+        pooled.ensure (dBufferInRGB, context, CL_MEM_READ_ONLY, bufferInRGBSize);
+        pooled.ensure (dBufferInD, context, CL_MEM_READ_ONLY, bufferInDSize);
+        pooled.ensure (dBufferOutRGB, context, CL_MEM_WRITE_ONLY, bufferOutRGBSize);
+        pooled.ensure (dBufferOutD, context, CL_MEM_WRITE_ONLY, bufferOutDSize);
+
+        // Set kernel arguments
+        kernel.setArg (0, dBufferInRGB);
+        kernel.setArg (1, dBufferInD);
+        kernel.setArg (2, dBufferOutRGB);
+        kernel.setArg (3, dBufferOutD);
+        kernel.setArg (4, width);
+    }
+
+
+    /*! \details The transfer happens from a staging buffer on the host to the 
+     *           associated (specified) device buffer.
+     *  
+     *  \param[in] mem enumeration value specifying an input device buffer.
+     *  \param[in] ptr a pointer to an array holding input data. If not NULL, the 
+     *                 data from `ptr` will be copied to the associated staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the write operation to the device buffer.
+     */
+    void DownsampleRGBD::write (DownsampleRGBD::Memory mem, void *ptr, bool block, 
+                                const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if (staging == Staging::I || staging == Staging::IO)
+        {
+            switch (mem)
+            {
+                case DownsampleRGBD::Memory::D_IN_RGB:
+                    if (ptr != nullptr)
+                        std::copy ((cl_uchar *) ptr, (cl_uchar *) ptr + 3 * width * height, hPtrInRGB);
+                    queue.enqueueWriteBuffer (dBufferInRGB, block, 0, bufferInRGBSize, hPtrInRGB, events, event);
+                    break;
+                case DownsampleRGBD::Memory::D_IN_D:
+                    if (ptr != nullptr)
+                        std::copy ((cl_ushort *) ptr, (cl_ushort *) ptr + width * height, hPtrInD);
+                    queue.enqueueWriteBuffer (dBufferInD, block, 0, bufferInDSize, hPtrInD, events, event);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+
+    /*! \details The transfer happens from a device buffer to the associated 
+     *           (specified) staging buffer on the host.
+     *  
+     *  \param[in] mem enumeration value specifying an output staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the read operation to the staging buffer.
+     */
+    void* DownsampleRGBD::read (DownsampleRGBD::Memory mem, bool block, 
+                                const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if (staging == Staging::O || staging == Staging::IO)
+        {
+            switch (mem)
+            {
+                case DownsampleRGBD::Memory::H_OUT_RGB:
+                    queue.enqueueReadBuffer (dBufferOutRGB, block, 0, bufferOutRGBSize, hPtrOutRGB, events, event);
+                    return hPtrOutRGB;
+                case DownsampleRGBD::Memory::H_OUT_D:
+                    queue.enqueueReadBuffer (dBufferOutD, block, 0, bufferOutDSize, hPtrOutD, events, event);
+                    return hPtrOutD;
+                default:
+                    return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+
+    /*! \details The function call is non-blocking.
+     *
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the kernel execution.
+     */
+    void DownsampleRGBD::run (const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, cl::NullRange, events, event);
+    }
+
+
+    /*! \param[in] _env opencl environment.
+     *  \param[in] _info opencl configuration. Specifies the context, queue, etc, to be used.
+     *  \param[in] _pool pool from which to draw the device buffers. If `nullptr`, 
+     *                   the buffers are allocated directly on the context.
+     *  \param[in] _variants variants of the program, from which to get a specialized kernel. 
+     *                       If `nullptr`, the kernel of the program in `_env` is used.
+     */
+    ICPLMsGrid::ICPLMsGrid (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool, 
+                            ProgramVariants *_variants) : 
+        env (_env), info (_info), 
+        context (env.getContext (info.pIdx)), 
+        queue (env.getQueue (info.ctxIdx, info.qIdx[0])), 
+        kernel (env.getProgram (info.pgIdx), "icpLMs_grid"), pooled (_pool), variants (_variants)
+    {
+    }
+
+
+    /*! \details This interface exists to allow CL memory sharing between different kernels.
+     *
+     *  \param[in] mem enumeration value specifying the requested memory object.
+     *  \return A reference to the requested memory object.
+     */
+    cl::Memory& ICPLMsGrid::get (ICPLMsGrid::Memory mem)
+    {
+        switch (mem)
+        {
+            case ICPLMsGrid::Memory::H_IN:
+                return hBufferIn;
+            case ICPLMsGrid::Memory::H_OUT:
+                return hBufferOut;
+            case ICPLMsGrid::Memory::D_IN:
+                return dBufferIn;
+            case ICPLMsGrid::Memory::D_OUT:
+                return dBufferOut;
+        }
+    }
+
+
+    /*! \details Sets up memory objects as necessary, and defines the kernel workspaces.
+     *  \note If you have assigned a memory object to one member variable of the class 
+     *        before the call to `init`, then that memory will be maintained. Otherwise, 
+     *        a new memory object will be created (or drawn from the pool), and on a 
+     *        subsequent call, it will be replaced only if it's too small.
+     *        
+     *  \param[in] _width width of the point cloud.
+     *  \param[in] _height height of the point cloud.
+     *  \param[in] _side side of the landmark grid. It cannot exceed the dimensions 
+     *                   of the point cloud.
+     *  \param[in] _staging flag to indicate whether or not to instantiate the staging buffers.
+     */
+    void ICPLMsGrid::init (unsigned int _width, unsigned int _height, unsigned int _side, Staging _staging)
+    {
+        width = _width;
+        height = _height;
+        side = _side;
+        bufferInSize = width * height * sizeof (cl_float8);
+        bufferOutSize = side * side * sizeof (cl_float8);
+        staging = (_staging == Staging::ZC) ? Staging::IO : _staging;
+
+        try
+        {
+            if (side == 0)
+                throw "The landmark grid cannot be empty";
+
+            if (side > width || side > height)
+                throw "The landmark grid cannot be denser than the point cloud";
+        }
+        catch (const char *error)
+        {
+            std::cerr << "Error[ICPLMsGrid]: " << error << std::endl;
+            exit (EXIT_FAILURE);
+        }
+
+        // Specialize the kernel for the point cloud
+        if (variants != nullptr)
+            kernel = cl::Kernel (variants->get (info.pgIdx, defineOption ("FRAME_WIDTH", width) + 
+                                                            defineOption ("FRAME_HEIGHT", height)), "icpLMs_grid");
+
+        // Set workspaces
+        global = cl::NDRange (side, side);
+
+        // Create staging buffers
+        bool io = false;
+        switch (staging)
+        {
+            case Staging::NONE:
+            case Staging::ZC:
+                hPtrIn = nullptr;
+                hPtrOut = nullptr;
+                break;
+
+            case Staging::IO:
+                io = true;
+
+            case Staging::I:
+                if (hBufferIn () == nullptr)
+                    hBufferIn = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferInSize);
+
+                hPtrIn = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferIn, CL_FALSE, CL_MAP_WRITE, 0, bufferInSize);
+                queue.enqueueUnmapMemObject (hBufferIn, hPtrIn);
+
+                if (!io)
+                {
+                    queue.finish ();
+                    hPtrOut = nullptr;
+                    break;
+                }
+
+            case Staging::O:
+                if (hBufferOut () == nullptr)
+                    hBufferOut = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferOutSize);
+
+                hPtrOut = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferOut, CL_FALSE, CL_MAP_READ, 0, bufferOutSize);
+                queue.enqueueUnmapMemObject (hBufferOut, hPtrOut);
+                queue.finish ();
+
+                if (!io) hPtrIn = nullptr;
+                break;
+        }
+        
+        // Create device buffers
+        pooled.ensure (dBufferIn, context, CL_MEM_READ_ONLY, bufferInSize);
+        pooled.ensure (dBufferOut, context, CL_MEM_WRITE_ONLY, bufferOutSize);
+
+        // Set kernel arguments
+        kernel.setArg (0, dBufferIn);
+        kernel.setArg (1, dBufferOut);
+        kernel.setArg (2, width);
+        kernel.setArg (3, height);
+    }
+
+
+    /*! \details The transfer happens from a staging buffer on the host to the 
+     *           associated (specified) device buffer.
+     *  
+     *  \param[in] mem enumeration value specifying an input device buffer.
+     *  \param[in] ptr a pointer to an array holding input data. If not NULL, the 
+     *                 data from `ptr` will be copied to the associated staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the write operation to the device buffer.
+     */
+    void ICPLMsGrid::write (ICPLMsGrid::Memory mem, void *ptr, bool block, 
+                            const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if ((staging == Staging::I || staging == Staging::IO) && mem == ICPLMsGrid::Memory::D_IN)
+        {
+            if (ptr != nullptr)
+                std::copy ((cl_float8 *) ptr, (cl_float8 *) ptr + width * height, (cl_float8 *) hPtrIn);
+            queue.enqueueWriteBuffer (dBufferIn, block, 0, bufferInSize, hPtrIn, events, event);
+        }
+    }
+
+
+    /*! \details The transfer happens from a device buffer to the associated 
+     *           (specified) staging buffer on the host.
+     *  
+     *  \param[in] mem enumeration value specifying an output staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the read operation to the staging buffer.
+     */
+    void* ICPLMsGrid::read (ICPLMsGrid::Memory mem, bool block, 
+                            const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if ((staging == Staging::O || staging == Staging::IO) && mem == ICPLMsGrid::Memory::H_OUT)
+        {
+            queue.enqueueReadBuffer (dBufferOut, block, 0, bufferOutSize, hPtrOut, events, event);
+            return hPtrOut;
+        }
+        return nullptr;
+    }
+
+
+    /*! \details The function call is non-blocking.
+     *
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the kernel execution.
+     */
+    void ICPLMsGrid::run (const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, cl::NullRange, events, event);
+    }
+
+
+    /*! \details The grid keeps the density of the `ICP` library's landmarks, a 128x128 
+     *           grid on a 640x480 frame, and it's halved for every halving of the frame. 
+     *           It's a power of 2, no smaller than 32, so the landmarks suit the 
+     *           work-group sizes of the `ICP` kernels.
+     *
+     *  \param[in] width width of the point cloud.
+     *  \param[in] height height of the point cloud.
+     *  \return The side of the landmark grid.
+     */
+    unsigned int ICPLMsGrid::getSide (unsigned int width, unsigned int height)
+    {
+        unsigned int side = 128;
+        while (side > 32 && (5 * side > width || 15 * side > 4 * height)) side >>= 1;
+        return side;
+    }
+
+
+    /*! \param[in] _env opencl environment.
+     *  \param[in] _info opencl configuration. Specifies the context, queue, etc, to be used.
+     *  \param[in] _pool pool from which to draw the device buffers. If `nullptr`, 
+     *                   the buffers are allocated directly on the context.
+     */
+    LinearOctreeQuery::LinearOctreeQuery (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool) : 
+        env (_env), info (_info), 
+        context (env.getContext (info.pIdx)), 
+        queue (env.getQueue (info.ctxIdx, info.qIdx[0])), 
+        kernel (env.getProgram (info.pgIdx), "linearOctreeQuery"), leaves (0), pooled (_pool)
+    {
+    }
+
+
+    /*! \details This interface exists to allow CL memory sharing between different kernels.
+     *
+     *  \param[in] mem enumeration value specifying the requested memory object.
+     *  \return A reference to the requested memory object.
+     */
+    cl::Memory& LinearOctreeQuery::get (LinearOctreeQuery::Memory mem)
+    {
+        switch (mem)
+        {
+            case LinearOctreeQuery::Memory::H_IN:
+                return hBufferIn;
+            case LinearOctreeQuery::Memory::H_OUT:
+                return hBufferOut;
+            case LinearOctreeQuery::Memory::D_CODES:
+                return dBufferCodes;
+            case LinearOctreeQuery::Memory::D_LEVELS:
+                return dBufferLevels;
+            case LinearOctreeQuery::Memory::D_VALUES:
+                return dBufferValues;
+            case LinearOctreeQuery::Memory::D_IN:
+                return dBufferIn;
+            case LinearOctreeQuery::Memory::D_OUT:
+                return dBufferOut;
+        }
+    }
+
+
+    /*! \details Sets up memory objects as necessary, and defines the kernel workspaces.
+     *  \note If you have assigned a memory object to one member variable of the class 
+     *        before the call to `init`, then that memory will be maintained. Otherwise, 
+     *        a new memory object will be created (or drawn from the pool), and on a 
+     *        subsequent call, it will be replaced only if it's too small.
+     *        
+     *  \param[in] _n number of points in a batch.
+     *  \param[in] _staging flag to indicate whether or not to instantiate the staging buffers.
+     */
+    void LinearOctreeQuery::init (unsigned int _n, Staging _staging)
+    {
+        n = _n;
+        bufferInSize = n * sizeof (cl_float4);
+        bufferOutSize = n * sizeof (cl_float);
+        staging = (_staging == Staging::ZC) ? Staging::IO : _staging;
+
+        try
+        {
+            if (n == 0)
+                throw "The batch of points cannot be empty";
+        }
+        catch (const char *error)
+        {
+            std::cerr << "Error[LinearOctreeQuery]: " << error << std::endl;
+            exit (EXIT_FAILURE);
+        }
+
+        // Set workspaces
+        global = cl::NDRange (n);
+
+        // Create staging buffers
+        bool io = false;
+        switch (staging)
+        {
+            case Staging::NONE:
+            case Staging::ZC:
+                hPtrIn = nullptr;
+                hPtrOut = nullptr;
+                break;
+
+            case Staging::IO:
+                io = true;
+
+            case Staging::I:
+                if (hBufferIn () == nullptr)
+                    hBufferIn = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferInSize);
+
+                hPtrIn = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferIn, CL_FALSE, CL_MAP_WRITE, 0, bufferInSize);
+                queue.enqueueUnmapMemObject (hBufferIn, hPtrIn);
+
+                if (!io)
+                {
+                    queue.finish ();
+                    hPtrOut = nullptr;
+                    break;
+                }
+
+            case Staging::O:
+                if (hBufferOut () == nullptr)
+                    hBufferOut = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferOutSize);
+
+                hPtrOut = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferOut, CL_FALSE, CL_MAP_READ, 0, bufferOutSize);
+                queue.enqueueUnmapMemObject (hBufferOut, hPtrOut);
+                queue.finish ();
+
+                if (!io) hPtrIn = nullptr;
+                break;
+        }
+        
+        // Create device buffers
+        pooled.ensure (dBufferIn, context, CL_MEM_READ_ONLY, bufferInSize);
+        pooled.ensure (dBufferOut, context, CL_MEM_WRITE_ONLY, bufferOutSize);
+
+        // Set kernel arguments
+        kernel.setArg (4, dBufferIn);
+        kernel.setArg (5, dBufferOut);
+    }
+
+
+    /*! \details The arrays of the octree are written to the device as they are. 
+     *           The buffers of the octree are replaced only if they are too small.
+     *  \note In a non-blocking call, the octree has to stay unchanged 
+     *        until the transfers are complete.
+     *
+     *  \param[in] tree the octree.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the last write operation.
+     */
+    void LinearOctreeQuery::upload (const LinearOctree &tree, bool block, 
+                                    const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        leaves = tree.size ();
+        unsigned int size = std::max (leaves, 1u);  // Keep the buffers valid for an empty octree
+
+        pooled.ensure (dBufferCodes, context, CL_MEM_READ_ONLY, size * sizeof (cl_ulong));
+        pooled.ensure (dBufferLevels, context, CL_MEM_READ_ONLY, size * sizeof (cl_uchar));
+        pooled.ensure (dBufferValues, context, CL_MEM_READ_ONLY, size * sizeof (cl_float));
+
+        if (leaves > 0)
+        {
+            queue.enqueueWriteBuffer (dBufferCodes, CL_FALSE, 0, leaves * sizeof (cl_ulong), 
+                                      tree.getCodes ().data (), events);
+            queue.enqueueWriteBuffer (dBufferLevels, CL_FALSE, 0, leaves * sizeof (cl_uchar), 
+                                      tree.getLevels ().data (), events);
+            queue.enqueueWriteBuffer (dBufferValues, block, 0, leaves * sizeof (cl_float), 
+                                      tree.getValues ().data (), events, event);
+        }
+
+        kernel.setArg (0, dBufferCodes);
+        kernel.setArg (1, dBufferLevels);
+        kernel.setArg (2, dBufferValues);
+        kernel.setArg (3, leaves);
+        kernel.setArg (6, (cl_float) (1.0 / tree.getResolution ()));
+        kernel.setArg (7, (cl_int) tree.getKeyOffset ());
+    }
+
+
+    /*! \details The transfer happens from a staging buffer on the host to the 
+     *           associated (specified) device buffer.
+     *  
+     *  \param[in] mem enumeration value specifying an input device buffer.
+     *  \param[in] ptr a pointer to an array holding input data. If not NULL, the 
+     *                 data from `ptr` will be copied to the associated staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the write operation to the device buffer.
+     */
+    void LinearOctreeQuery::write (LinearOctreeQuery::Memory mem, void *ptr, bool block, 
+                                   const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if ((staging == Staging::I || staging == Staging::IO) && mem == LinearOctreeQuery::Memory::D_IN)
+        {
+            if (ptr != nullptr)
+                std::copy ((cl_float4 *) ptr, (cl_float4 *) ptr + n, (cl_float4 *) hPtrIn);
+            queue.enqueueWriteBuffer (dBufferIn, block, 0, bufferInSize, hPtrIn, events, event);
+        }
+    }
+
+
+    /*! \details The transfer happens from a device buffer to the associated 
+     *           (specified) staging buffer on the host.
+     *  
+     *  \param[in] mem enumeration value specifying an output staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the read operation to the staging buffer.
+     */
+    void* LinearOctreeQuery::read (LinearOctreeQuery::Memory mem, bool block, 
+                                   const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if ((staging == Staging::O || staging == Staging::IO) && mem == LinearOctreeQuery::Memory::H_OUT)
+        {
+            queue.enqueueReadBuffer (dBufferOut, block, 0, bufferOutSize, hPtrOut, events, event);
+            return hPtrOut;
+        }
+        return nullptr;
+    }
+
+
+    /*! \details The function call is non-blocking.
+     *
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the kernel execution.
+     */
+    void LinearOctreeQuery::run (const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, cl::NullRange, events, event);
+    }
+
+
+    /*! \param[in] _env opencl environment.
+     *  \param[in] _info opencl configuration. Specifies the context, queue, etc, to be used.
+     *  \param[in] _pool pool from which to draw the device buffers. If `nullptr`, 
+     *                   the buffers are allocated directly on the context.
+     */
+    RayCastService::RayCastService (clutils::CLEnv &_env, clutils::CLEnvInfo<1> _info, BufferPool *_pool) : 
+        env (_env), info (_info), 
+        context (env.getContext (info.pIdx)), 
+        queue (env.getQueue (info.ctxIdx, info.qIdx[0])), 
+        kernel (env.getProgram (info.pgIdx), "rayCastBricks"), brickCapacity (0), pooled (_pool)
+    {
+    }
+
+
+    /*! \details This interface exists to allow CL memory sharing between different kernels.
+     *
+     *  \param[in] mem enumeration value specifying the requested memory object.
+     *  \return A reference to the requested memory object.
+     */
+    cl::Memory& RayCastService::get (RayCastService::Memory mem)
+    {
+        switch (mem)
+        {
+            case RayCastService::Memory::H_IN_O:
+                return hBufferInO;
+            case RayCastService::Memory::H_IN_D:
+                return hBufferInD;
+            case RayCastService::Memory::H_OUT:
+                return hBufferOut;
+            case RayCastService::Memory::D_SLOT_CODES:
+                return dBufferSlotCodes;
+            case RayCastService::Memory::D_SLOT_BRICKS:
+                return dBufferSlotBricks;
+            case RayCastService::Memory::D_BRICKS:
+                return dBufferBricks;
+            case RayCastService::Memory::D_IN_O:
+                return dBufferInO;
+            case RayCastService::Memory::D_IN_D:
+                return dBufferInD;
+            case RayCastService::Memory::D_OUT:
+                return dBufferOut;
+        }
+    }
+
+
+    /*! \details Sets up memory objects as necessary, and defines the kernel workspaces.
+     *  \note If you have assigned a memory object to one member variable of the class 
+     *        before the call to `init`, then that memory will be maintained. Otherwise, 
+     *        a new memory object will be created (or drawn from the pool), and on a 
+     *        subsequent call, it will be replaced only if it's too small.
+     *        
+     *  \param[in] _n number of rays in a batch.
+     *  \param[in] _maxRange maximum range (in meters) of the rays that don't specify one.
+     *  \param[in] _staging flag to indicate whether or not to instantiate the staging buffers.
+     */
+    void RayCastService::init (unsigned int _n, float _maxRange, Staging _staging)
+    {
+        n = _n;
+        maxRange = _maxRange;
+        bufferSize = n * sizeof (cl_float4);
+        staging = (_staging == Staging::ZC) ? Staging::IO : _staging;
+
+        try
+        {
+            if (n == 0)
+                throw "The batch of rays cannot be empty";
+        }
+        catch (const char *error)
+        {
+            std::cerr << "Error[RayCastService]: " << error << std::endl;
+            exit (EXIT_FAILURE);
+        }
+
+        // Set workspaces
+        global = cl::NDRange (n);
+
+        // Create staging buffers
+        bool io = false;
+        switch (staging)
+        {
+            case Staging::NONE:
+            case Staging::ZC:
+                hPtrInO = nullptr;
+                hPtrInD = nullptr;
+                hPtrOut = nullptr;
+                break;
+
+            case Staging::IO:
+                io = true;
+
+            case Staging::I:
+                if (hBufferInO () == nullptr)
+                    hBufferInO = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferSize);
+                if (hBufferInD () == nullptr)
+                    hBufferInD = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferSize);
+
+                hPtrInO = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferInO, CL_FALSE, CL_MAP_WRITE, 0, bufferSize);
+                hPtrInD = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferInD, CL_FALSE, CL_MAP_WRITE, 0, bufferSize);
+                queue.enqueueUnmapMemObject (hBufferInO, hPtrInO);
+                queue.enqueueUnmapMemObject (hBufferInD, hPtrInD);
+
+                if (!io)
+                {
+                    queue.finish ();
+                    hPtrOut = nullptr;
+                    break;
+                }
+
+            case Staging::O:
+                if (hBufferOut () == nullptr)
+                    hBufferOut = cl::Buffer (context, CL_MEM_ALLOC_HOST_PTR, bufferSize);
+
+                hPtrOut = (cl_float *) queue.enqueueMapBuffer (
+                    hBufferOut, CL_FALSE, CL_MAP_READ, 0, bufferSize);
+                queue.enqueueUnmapMemObject (hBufferOut, hPtrOut);
+                queue.finish ();
+
+                if (!io)
+                {
+                    hPtrInO = nullptr;
+                    hPtrInD = nullptr;
+                }
+                break;
+        }
+        
+        // Create device buffers
+        pooled.ensure (dBufferInO, context, CL_MEM_READ_ONLY, bufferSize);
+        pooled.ensure (dBufferInD, context, CL_MEM_READ_ONLY, bufferSize);
+        pooled.ensure (dBufferOut, context, CL_MEM_WRITE_ONLY, bufferSize);
+
+        // Set kernel arguments
+        kernel.setArg (4, dBufferInO);
+        kernel.setArg (5, dBufferInD);
+        kernel.setArg (6, dBufferOut);
+        kernel.setArg (9, maxRange);
+    }
+
+
+    /*! \details Only the bricks that changed are transferred, in one transfer per 
+     *           run of consecutive bricks, and the table, when it grew. When the 
+     *           bricks outgrow their buffer, the buffer is doubled and the whole 
+     *           set is transferred.
+     *  \note The call is blocking. The `BrickMap` is held only 
+     *        while its changes are copied out.
+     *
+     *  \param[in] bricks the set of bricks.
+     *  \return The number of bricks transferred.
+     */
+    size_t RayCastService::update (BrickMap &bricks)
+    {
+        const size_t brickSize = BrickMap::brickWords * sizeof (cl_uint);
+
+        bricks.takeDelta (delta);
+        if (brickCapacity == 0 || delta.bricks > brickCapacity)
+        {
+            bricks.takeDelta (delta, true);
+            brickCapacity = std::max (2 * delta.bricks, (size_t) 64);
+            pooled.ensure (dBufferBricks, context, CL_MEM_READ_ONLY, brickCapacity * brickSize);
+            kernel.setArg (3, dBufferBricks);
+            kernel.setArg (7, (cl_float) bricks.getResolution ());
+            kernel.setArg (8, (cl_int) bricks.getKeyOffset ());
+        }
+
+        if (delta.table)
+        {
+            size_t slots = delta.slotCodes.size ();
+            pooled.ensure (dBufferSlotCodes, context, CL_MEM_READ_ONLY, slots * sizeof (cl_ulong));
+            pooled.ensure (dBufferSlotBricks, context, CL_MEM_READ_ONLY, slots * sizeof (cl_uint));
+            queue.enqueueWriteBuffer (dBufferSlotCodes, CL_FALSE, 0, slots * sizeof (cl_ulong), delta.slotCodes.data ());
+            queue.enqueueWriteBuffer (dBufferSlotBricks, CL_FALSE, 0, slots * sizeof (cl_uint), delta.slotBricks.data ());
+
+            kernel.setArg (0, dBufferSlotCodes);
+            kernel.setArg (1, dBufferSlotBricks);
+            kernel.setArg (2, (cl_uint) delta.tableBits);
+            kernel.setArg (7, (cl_float) bricks.getResolution ());
+            kernel.setArg (8, (cl_int) bricks.getKeyOffset ());
+        }
+
+        for (size_t i = 0; i < delta.indices.size (); )
+        {
+            size_t j = i + 1;
+            while (j < delta.indices.size () && delta.indices[j] == delta.indices[j - 1] + 1) ++j;
+            queue.enqueueWriteBuffer (dBufferBricks, CL_FALSE, delta.indices[i] * brickSize, (j - i) * brickSize, 
+                                      delta.words.data () + i * BrickMap::brickWords);
+            i = j;
+        }
+        queue.finish ();  // The delta gets reused
+
+        return delta.indices.size ();
+    }
+
+
+    /*! \details The transfer happens from a staging buffer on the host to the 
+     *           associated (specified) device buffer.
+     *  
+     *  \param[in] mem enumeration value specifying an input device buffer.
+     *  \param[in] ptr a pointer to an array holding input data. If not NULL, the 
+     *                 data from `ptr` will be copied to the associated staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the write operation to the device buffer.
+     */
+    void RayCastService::write (RayCastService::Memory mem, void *ptr, bool block, 
+                                const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if (staging == Staging::I || staging == Staging::IO)
+        {
+            switch (mem)
+            {
+                case RayCastService::Memory::D_IN_O:
+                    if (ptr != nullptr)
+                        std::copy ((cl_float4 *) ptr, (cl_float4 *) ptr + n, (cl_float4 *) hPtrInO);
+                    queue.enqueueWriteBuffer (dBufferInO, block, 0, bufferSize, hPtrInO, events, event);
+                    break;
+                case RayCastService::Memory::D_IN_D:
+                    if (ptr != nullptr)
+                        std::copy ((cl_float4 *) ptr, (cl_float4 *) ptr + n, (cl_float4 *) hPtrInD);
+                    queue.enqueueWriteBuffer (dBufferInD, block, 0, bufferSize, hPtrInD, events, event);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+
+    /*! \details The transfer happens from a device buffer to the associated 
+     *           (specified) staging buffer on the host.
+     *  
+     *  \param[in] mem enumeration value specifying an output staging buffer.
+     *  \param[in] block a flag to indicate whether to perform a blocking 
+     *                   or a non-blocking operation.
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the read operation to the staging buffer.
+     */
+    void* RayCastService::read (RayCastService::Memory mem, bool block, 
+                                const std::vector<cl::Event> *events, cl::Event *event)
+    {
+        if ((staging == Staging::O || staging == Staging::IO) && mem == RayCastService::Memory::H_OUT)
+        {
+            queue.enqueueReadBuffer (dBufferOut, block, 0, bufferSize, hPtrOut, events, event);
+            return hPtrOut;
+        }
+        return nullptr;
+    }
+
+
+    /*! \details The function call is non-blocking.
+     *
+     *  \param[in] events a wait-list of events.
+     *  \param[out] event event associated with the kernel execution.
+     */
+    void RayCastService::run (const std::vector<cl::Event> *events, cl::Event *event)
     {
         queue.enqueueNDRangeKernel (kernel, cl::NullRange, global, cl::NullRange, events, event);
     }
@@ -0,0 +1,186 @@
+/*! \file batched_update.cpp
+ *  \brief Defines an accumulator that merges the occupancy updates of several point clouds.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <oclslam/batched_update.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    namespace
+    {
+        /*! \brief Largest batch, so that the counts of a cell can't wrap around. */
+        const size_t maxFrames = std::numeric_limits<uint16_t>::max ();
+    }
+
+
+    /*! \param[in] _frames number of point clouds in a batch. With `1`, 
+     *                     every point cloud gets applied on its own. 
+     *                     It's clamped to 65535.
+     */
+    BatchedUpdate::BatchedUpdate (size_t _frames) : 
+        frames (std::min (std::max (_frames, (size_t) 1), maxFrames)), pending (0), stats ({ 0, 0, 0, 0 })
+    {
+    }
+
+
+    /*! \details A smaller number than the point clouds already 
+     *           added completes the current batch. A cell is counted 
+     *           once per point cloud, in 16 bits, so the number is 
+     *           clamped to 65535.
+     */
+    void BatchedUpdate::setFrames (size_t _frames)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        frames = std::min (std::max (_frames, (size_t) 1), maxFrames);
+    }
+
+
+    size_t BatchedUpdate::getFrames () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return frames;
+    }
+
+
+    /*! \details The cells are determined as in `OcTree::insertPointCloud`. 
+     *           Within a point cloud, a cell that is occupied isn't free.
+     *  \note It has to be called while holding the map, which 
+     *        is used only to trace the rays, and isn't modified.
+     *
+     *  \param[in] map the map the point cloud is destined for.
+     *  \param[in] pc point cloud.
+     *  \param[in] origin position (in meters) of the sensor.
+     *  \param[in] maxRange range (in meters) to truncate the rays at, or `-1` for none.
+     *  \param[in] discretize flag to merge the endpoints that fall in the same cell first.
+     */
+    void BatchedUpdate::add (octomap::OcTree &map, const octomap::Pointcloud &pc, 
+                             const octomap::point3d &origin, double maxRange, bool discretize)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        freeCells.clear ();
+        occupiedCells.clear ();
+        if (discretize)
+            map.computeDiscreteUpdate (pc, origin, freeCells, occupiedCells, maxRange);
+        else
+            map.computeUpdate (pc, origin, freeCells, occupiedCells, maxRange);
+
+        if (counts.empty ())
+        {
+            keyMin = octomap::OcTreeKey (0xFFFF, 0xFFFF, 0xFFFF);
+            keyMax = octomap::OcTreeKey (0, 0, 0);
+        }
+        for (const octomap::OcTreeKey &key : freeCells)
+        {
+            Count &c = counts[key];
+            if (c.free < maxFrames) ++c.free;  // Saturates, if the batch isn't applied when ready
+            for (unsigned int i = 0; i < 3; ++i)
+            {
+                keyMin[i] = std::min (keyMin[i], key[i]);
+                keyMax[i] = std::max (keyMax[i], key[i]);
+            }
+        }
+        for (const octomap::OcTreeKey &key : occupiedCells)
+        {
+            Count &c = counts[key];
+            if (c.occupied < maxFrames) ++c.occupied;
+            for (unsigned int i = 0; i < 3; ++i)
+            {
+                keyMin[i] = std::min (keyMin[i], key[i]);
+                keyMax[i] = std::max (keyMax[i], key[i]);
+            }
+        }
+
+        ++pending;
+        ++stats.frames;
+        stats.cellUpdates += freeCells.size () + occupiedCells.size ();
+    }
+
+
+    bool BatchedUpdate::isReady () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return pending >= frames;
+    }
+
+
+    /*! \param[in] map the map the point clouds are destined for.
+     *  \param[out] min minimum corner (in meters) of the cells.
+     *  \param[out] max maximum corner (in meters) of the cells.
+     *  \return `false` if there are no cells counted.
+     */
+    bool BatchedUpdate::getBounds (const octomap::OcTree &map, octomap::point3d &min, octomap::point3d &max) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (counts.empty ()) return false;
+
+        min = map.keyToCoord (keyMin);
+        max = map.keyToCoord (keyMax);
+        return true;
+    }
+
+
+    /*! \details Every cell gets \f$ n_{occupied} \cdot l_{hit} + n_{free} \cdot l_{miss} \f$ 
+     *           added to its log-odds, which then gets clamped as usual.
+     *  \note It has to be called while holding the map.
+     *
+     *  \param[in,out] map the map.
+     *  \param[in] lazy flag to leave the inner nodes of the map stale (see `MapMaintenance`).
+     *  \return The number of cells updated.
+     */
+    size_t BatchedUpdate::apply (octomap::OcTree &map, bool lazy)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        const float hit = map.getProbHitLog ();
+        const float miss = map.getProbMissLog ();
+        for (const auto &c : counts)
+            map.updateNode (c.first, c.second.occupied * hit + c.second.free * miss, lazy);
+
+        size_t updated = counts.size ();
+        if (pending > 0) ++stats.batches;
+        stats.treeUpdates += updated;
+        counts.clear ();
+        pending = 0;
+        return updated;
+    }
+
+
+    BatchedUpdate::Stats BatchedUpdate::getStats () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return stats;
+    }
+
+}
+}
@@ -0,0 +1,342 @@
+/*! \file brick_map.cpp
+ *  \brief Defines a sparse set of bricks with the occupied cells of the map.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <oclslam/brick_map.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    const unsigned int BrickMap::brickWords;
+    const uint64_t BrickMap::emptySlot;
+
+
+    BrickMap::BrickMap () : 
+        enabled (false), built (false), resolution (0.0), keyOffset (0), 
+        tableBits (10), slotsUsed (0), 
+        slotCodes (size_t (1) << tableBits, emptySlot), slotBricks (size_t (1) << tableBits, 0), 
+        tableDirty (true), stats ({ 0, 0, 0, 0 })
+    {
+    }
+
+
+    /*! \details Enabling the set has it rebuilt on the next update.
+     *
+     *  \param[in] flag flag to enable the set.
+     */
+    void BrickMap::setEnabled (bool flag)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        enabled = flag;
+        built = false;
+        tableBits = 10;
+        slotsUsed = 0;
+        slotCodes.assign (size_t (1) << tableBits, emptySlot);
+        slotBricks.assign (size_t (1) << tableBits, 0);
+        words.clear ();
+        dirty.clear ();
+        dirtyBricks.clear ();
+        tableDirty = true;
+        stats.bricks = stats.cells = 0;
+    }
+
+
+    bool BrickMap::isEnabled () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return enabled;
+    }
+
+
+    /*! \details The first update turns on the change detection of the map, and 
+     *           sets the cells of the occupied leaves. The rest update the cells 
+     *           that changed since the change detection was last reset.
+     *  \note It has to be called while holding the map, before any 
+     *        of its changed cells is deleted.
+     *
+     *  \param[in,out] map the map.
+     *  \return The number of cells that changed state.
+     */
+    size_t BrickMap::update (octomap::OcTree &map)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!enabled) return 0;
+
+        size_t changes = 0;
+        if (!built)
+        {
+            map.enableChangeDetection (true);
+            resolution = map.getResolution ();
+            keyOffset = 1 << (map.getTreeDepth () - 1);
+
+            // A pruned leaf is set cell by cell
+            for (auto it = map.begin_leafs (), end = map.end_leafs (); it != end; ++it)
+            {
+                if (!map.isNodeOccupied (*it)) continue;
+                const int span = 1 << (map.getTreeDepth () - it.getDepth ());
+                const octomap::OcTreeKey base = it.getIndexKey ();
+                for (int x = 0; x < span; ++x)
+                    for (int y = 0; y < span; ++y)
+                        for (int z = 0; z < span; ++z)
+                            changes += set (octomap::OcTreeKey (base[0] + x, base[1] + y, base[2] + z), true);
+            }
+            built = true;
+        }
+        else
+        {
+            for (auto it = map.changedKeysBegin (), end = map.changedKeysEnd (); it != end; ++it)
+            {
+                octomap::OcTreeNode *node = map.search (it->first);
+                changes += set (it->first, node != nullptr && map.isNodeOccupied (node));
+            }
+        }
+
+        ++stats.updates;
+        stats.changes += changes;
+        return changes;
+    }
+
+
+    /*! \param[in] p point (in meters).
+     *  \return `true` if the cell is occupied.
+     */
+    bool BrickMap::isOccupied (const octomap::point3d &p) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!built) return false;
+
+        octomap::OcTreeKey key;
+        for (int i = 0; i < 3; ++i)
+        {
+            int k = (int) std::floor (p (i) / resolution) + keyOffset;
+            if (k < 0 || k >= 2 * keyOffset) return false;
+            key[i] = (octomap::key_type) k;
+        }
+
+        int64_t brick = find (blockCode (key));
+        if (brick < 0) return false;
+
+        unsigned int bit = ((key[2] & 7) * 8 + (key[1] & 7)) * 8 + (key[0] & 7);
+        return (words[brick * brickWords + (bit >> 5)] >> (bit & 31)) & 1;
+    }
+
+
+    double BrickMap::getResolution () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return resolution;
+    }
+
+
+    int BrickMap::getKeyOffset () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return keyOffset;
+    }
+
+
+    /*! \details The changes are copied out, so the set can go on 
+     *           being updated while they are transferred.
+     *  \note The changes are taken by one consumer. 
+     *
+     *  \param[out] delta the changes.
+     *  \param[in] all flag to take the whole set, e.g. for a new mirror.
+     */
+    void BrickMap::takeDelta (Delta &delta, bool all)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        delta.table = tableDirty || all;
+        delta.tableBits = tableBits;
+        if (delta.table)
+        {
+            delta.slotCodes = slotCodes;
+            delta.slotBricks = slotBricks;
+        }
+        else
+        {
+            delta.slotCodes.clear ();
+            delta.slotBricks.clear ();
+        }
+
+        size_t n = dirty.size ();
+        delta.bricks = n;
+        delta.indices.clear ();
+        if (all)
+        {
+            delta.indices.resize (n);
+            for (size_t i = 0; i < n; ++i) delta.indices[i] = (uint32_t) i;
+            delta.words = words;
+        }
+        else
+        {
+            delta.indices.swap (dirtyBricks);
+            std::sort (delta.indices.begin (), delta.indices.end ());
+            delta.words.resize (delta.indices.size () * brickWords);
+            for (size_t i = 0; i < delta.indices.size (); ++i)
+                std::copy (words.begin () + delta.indices[i] * brickWords, 
+                           words.begin () + (delta.indices[i] + 1) * brickWords, 
+                           delta.words.begin () + i * brickWords);
+        }
+
+        std::fill (dirty.begin (), dirty.end (), 0);
+        dirtyBricks.clear ();
+        tableDirty = false;
+    }
+
+
+    BrickMap::Stats BrickMap::getStats () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return stats;
+    }
+
+
+    /*! \param[in] key key of a cell.
+     *  \return The code of the block of the cell, 13 bits per dimension.
+     */
+    uint64_t BrickMap::blockCode (const octomap::OcTreeKey &key)
+    {
+        return uint64_t (key[0] >> 3) | (uint64_t (key[1] >> 3) << 13) | (uint64_t (key[2] >> 3) << 26);
+    }
+
+
+    /*! \details Fibonacci hashing, the top `bits` of the product with the golden ratio. 
+     *           The `rayCastBricks` kernel computes the same.
+     *
+     *  \param[in] code code of a block.
+     *  \param[in] bits log2 of the number of slots.
+     *  \return The index of the slot.
+     */
+    uint32_t BrickMap::hash (uint64_t code, unsigned int bits)
+    {
+        return (bits == 0) ? 0 : (uint32_t) ((code * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+    }
+
+
+    /*! \param[in] key key of the cell.
+     *  \param[in] occupied state of the cell.
+     *  \return Whether the state of the cell changed.
+     */
+    bool BrickMap::set (const octomap::OcTreeKey &key, bool occupied)
+    {
+        uint64_t code = blockCode (key);
+        int64_t brick = find (code);
+        if (brick < 0)
+        {
+            if (!occupied) return false;
+            brick = insert (code);
+        }
+
+        unsigned int bit = ((key[2] & 7) * 8 + (key[1] & 7)) * 8 + (key[0] & 7);
+        uint32_t &word = words[brick * brickWords + (bit >> 5)];
+        uint32_t mask = uint32_t (1) << (bit & 31);
+        if (((word & mask) != 0) == occupied) return false;
+
+        word ^= mask;
+        if (occupied) ++stats.cells;
+        else --stats.cells;
+        if (!dirty[brick])
+        {
+            dirty[brick] = 1;
+            dirtyBricks.push_back ((uint32_t) brick);
+        }
+        return true;
+    }
+
+
+    /*! \param[in] code code of a block.
+     *  \return The index of the brick of the block, or -1.
+     */
+    int64_t BrickMap::find (uint64_t code) const
+    {
+        const uint32_t mask = (uint32_t (1) << tableBits) - 1;
+        for (uint32_t h = hash (code, tableBits); ; h = (h + 1) & mask)
+        {
+            if (slotCodes[h] == code) return slotBricks[h];
+            if (slotCodes[h] == emptySlot) return -1;
+        }
+    }
+
+
+    /*! \param[in] code code of a block without a brick.
+     *  \return The index of the new brick.
+     */
+    uint32_t BrickMap::insert (uint64_t code)
+    {
+        // Keep the table at most half full, so that the probe sequences stay short
+        if (2 * (slotsUsed + 1) > (size_t (1) << tableBits)) grow ();
+
+        uint32_t brick = (uint32_t) dirty.size ();
+        words.resize (words.size () + brickWords, 0);
+        dirty.push_back (1);
+        dirtyBricks.push_back (brick);
+        ++stats.bricks;
+
+        const uint32_t mask = (uint32_t (1) << tableBits) - 1;
+        uint32_t h = hash (code, tableBits);
+        while (slotCodes[h] != emptySlot) h = (h + 1) & mask;
+        slotCodes[h] = code;
+        slotBricks[h] = brick;
+        ++slotsUsed;
+        tableDirty = true;
+
+        return brick;
+    }
+
+
+    /*! \details Doubles the table, and places the blocks anew. */
+    void BrickMap::grow ()
+    {
+        std::vector<uint64_t> codes;
+        std::vector<uint32_t> bricks;
+        codes.swap (slotCodes);
+        bricks.swap (slotBricks);
+
+        ++tableBits;
+        slotCodes.assign (size_t (1) << tableBits, emptySlot);
+        slotBricks.assign (size_t (1) << tableBits, 0);
+
+        const uint32_t mask = (uint32_t (1) << tableBits) - 1;
+        for (size_t i = 0; i < codes.size (); ++i)
+        {
+            if (codes[i] == emptySlot) continue;
+            uint32_t h = hash (codes[i], tableBits);
+            while (slotCodes[h] != emptySlot) h = (h + 1) & mask;
+            slotCodes[h] = codes[i];
+            slotBricks[h] = bricks[i];
+        }
+        tableDirty = true;
+    }
+
+}
+}
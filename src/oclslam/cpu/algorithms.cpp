@@ -0,0 +1,783 @@
+/*! \file algorithms.cpp
+ *  \brief Defines the classes of the native `CPU` backend of the `%OCLSLAM` pipeline.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <oclslam/cpu/algorithms.hpp>
+#include "simd.hpp"
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+namespace cpu
+{
+
+    namespace
+    {
+        using simd::Float;
+        using simd::Scalar;
+
+        const size_t grainPoints = 16384;  // Points in a chunk of the point-wise loops
+        const float padding = 1e18f;       // Coordinate of the padding points of the RBC
+
+        /*! \brief Converts a block of depth values. */
+        template <typename V>
+        inline void depthBlock (const uint16_t *in, float *out, float scaling)
+        {
+            (V::loadU16 (in) * V (scaling)).store (out);
+        }
+
+        /*! \brief Back-projects a block of pixels on a row. */
+        template <typename V>
+        inline void to8DBlock (const float *D, const float *R, const float *G, const float *B, float *out, 
+                               float u, float y, float invF, float scaling, int rgbNorm)
+        {
+            V c[8];
+            V d = V::load (D) * V (scaling);
+            V k = d * V (invF);
+            c[0] = (V::iota () + V (u)) * k;
+            c[1] = V (y) * k;
+            c[2] = d;
+            c[3] = V (1.f);
+            c[4] = V::load (R);
+            c[5] = V::load (G);
+            c[6] = V::load (B);
+            c[7] = V (1.f);
+
+            if (rgbNorm)
+            {
+                V sum = c[4] + c[5] + c[6];
+                V inv = simd::select (sum > V (0.f), V (1.f) / sum, V (0.f));
+                for (unsigned int j = 4; j < 7; ++j) c[j] = c[j] * inv;
+            }
+
+            simd::store8 (out, c);
+        }
+
+        /*! \brief Transforms a block of points, \f$ p' = Ap + t \f$, with \f$ A = sR \f$. */
+        template <typename V>
+        inline void transformBlock (const float *in, float *out, const float *A, const float *t)
+        {
+            V c[8], o[3];
+            simd::load8 (in, c);
+            for (unsigned int i = 0; i < 3; ++i)
+                o[i] = simd::fmadd (V (A[3 * i]), c[0], simd::fmadd (V (A[3 * i + 1]), c[1], 
+                           simd::fmadd (V (A[3 * i + 2]), c[2], V (t[i]))));
+
+            // Invalid points stay at the origin
+            for (unsigned int i = 0; i < 3; ++i) c[i] = simd::select (c[2] != V (0.f), o[i], V (0.f));
+
+            simd::store8 (out, c);
+        }
+
+        /*! \brief Computes the distance of every point, in a padded planar xyzrgb set, to an 8-D point. */
+        template <typename Op>
+        inline void scanDistances (const float *X, size_t stride, size_t begin, size_t end, 
+                                   const float *q, float a, Op op)
+        {
+            const Float qx (q[0]), qy (q[1]), qz (q[2]), qr (q[4]), qg (q[5]), qb (q[6]), va (a);
+
+            for (size_t i = begin; i < end; i += Float::width)
+            {
+                const float *x = X + i;
+                Float d0 = Float::load (x) - qx;
+                Float d1 = Float::load (x + stride) - qy;
+                Float d2 = Float::load (x + 2 * stride) - qz;
+                Float d3 = Float::load (x + 3 * stride) - qr;
+                Float d4 = Float::load (x + 4 * stride) - qg;
+                Float d5 = Float::load (x + 5 * stride) - qb;
+                Float dc = simd::fmadd (d3, d3, simd::fmadd (d4, d4, d5 * d5));
+                op (i, simd::fmadd (d0, d0, simd::fmadd (d1, d1, simd::fmadd (d2, d2, va * dc))));
+            }
+        }
+
+        /*! \brief Finds the point, in a padded planar xyzrgb set, nearest to an 8-D point.
+         *
+         *  \param[in] X planar set, with channel \f$ j \f$ at `X + j * stride`.
+         *  \param[in] stride distance between the channels.
+         *  \param[in] begin first point of the search (a multiple of the vector width).
+         *  \param[in] end end of the search (a multiple of the vector width).
+         *  \param[in] q query point.
+         *  \param[in] a weight of the color distance.
+         *  \param[in,out] dist distance to the nearest point. Only a point closer 
+         *                  than the initial value gets reported.
+         *  \param[in,out] pos position of the nearest point in the set.
+         */
+        void findNearest (const float *X, size_t stride, size_t begin, size_t end, 
+                          const float *q, float a, float &dist, size_t &pos)
+        {
+            const unsigned int w = Float::width;
+            Float best (dist), bestIdx ((float) pos);
+
+            scanDistances (X, stride, begin, end, q, a, [&] (size_t i, Float d)
+            {
+                simd::Mask closer = d < best;
+                best = simd::select (closer, d, best);
+                bestIdx = simd::select (closer, Float::iota () + Float ((float) i), bestIdx);
+            });
+
+            float b[w], bi[w];
+            best.store (b);
+            bestIdx.store (bi);
+            for (unsigned int j = 0; j < w; ++j)
+            {
+                if (b[j] < dist)
+                {
+                    dist = b[j];
+                    pos = (size_t) bi[j];
+                }
+            }
+        }
+
+        /*! \brief Rounds up to a multiple of the vector width. */
+        inline size_t padToWidth (size_t n)
+        {
+            const size_t w = Float::width;
+            return (n + w - 1) / w * w;
+        }
+
+        /*! \brief Holds the statistics of the associations of an `ICP` iteration. */
+        struct ICPSums
+        {
+            double n, sM[3], sF[3], sMF[9], sMM, sFF;
+
+            void clear () { std::fill (&n, &sFF + 1, 0.0); }
+            ICPSums& operator+= (const ICPSums &o)
+            {
+                const double *src = &o.n;
+                for (double *dst = &n; dst != &sFF + 1; ++dst, ++src) *dst += *src;
+                return *this;
+            }
+        };
+
+        typedef std::chrono::steady_clock Clock;
+
+        inline double elapsed (Clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli> (Clock::now () - start).count ();
+        }
+    }
+
+
+    /*! \details The instruction set is fixed at compile time, so the name comes from 
+     *           this translation unit, and not from the one of the caller.
+     */
+    const char* getInstructionSet ()
+    {
+        return simd::getName ();
+    }
+
+
+    Depth::Depth (ThreadPool &pool) : pool (pool), n (0), scaling (1.f)
+    {
+    }
+
+
+    /*! \param[in] _n number of pixels in the frame.
+     *  \param[in] _scaling factor applied to the depth values.
+     */
+    void Depth::init (unsigned int _n, float _scaling)
+    {
+        n = _n;
+        scaling = _scaling;
+    }
+
+
+    /*! \param[in] in depth frame.
+     *  \param[out] out converted frame.
+     */
+    void Depth::run (const uint16_t *in, float *out)
+    {
+        pool.parallelFor (n, grainPoints, [&] (size_t begin, size_t end)
+        {
+            size_t k = begin;
+            for (; k + Float::width <= end; k += Float::width) depthBlock<Float> (in + k, out + k, scaling);
+            for (; k < end; ++k) depthBlock<Scalar> (in + k, out + k, scaling);
+        });
+    }
+
+
+    SeparateRGB::SeparateRGB (ThreadPool &pool) : pool (pool), n (0)
+    {
+    }
+
+
+    /*! \param[in] _n number of pixels in the frame. */
+    void SeparateRGB::init (unsigned int _n)
+    {
+        n = _n;
+    }
+
+
+    /*! \details The stage is bound by memory, so it's left to the compiler to vectorize.
+     *
+     *  \param[in] in interleaved RGB frame.
+     *  \param[out] outR red channel.
+     *  \param[out] outG green channel.
+     *  \param[out] outB blue channel.
+     */
+    void SeparateRGB::run (const uint8_t *in, float *outR, float *outG, float *outB)
+    {
+        pool.parallelFor (n, grainPoints, [&] (size_t begin, size_t end)
+        {
+            const float s = 1.f / 255.f;
+            for (size_t k = begin; k < end; ++k)
+            {
+                outR[k] = s * in[3 * k];
+                outG[k] = s * in[3 * k + 1];
+                outB[k] = s * in[3 * k + 2];
+            }
+        });
+    }
+
+
+    RGBDTo8D::RGBDTo8D (ThreadPool &pool) : 
+        pool (pool), width (0), height (0), f (595.f), scaling (1.f), rgbNorm (1)
+    {
+    }
+
+
+    /*! \param[in] _width width of the frames.
+     *  \param[in] _height height of the frames.
+     *  \param[in] _f focal length (in pixels).
+     *  \param[in] _scaling factor applied to the depth values.
+     *  \param[in] _rgbNorm flag for the RGB normalization.
+     */
+    void RGBDTo8D::init (unsigned int _width, unsigned int _height, float _f, float _scaling, int _rgbNorm)
+    {
+        width = _width;
+        height = _height;
+        f = _f;
+        scaling = _scaling;
+        rgbNorm = _rgbNorm;
+    }
+
+
+    /*! \param[in] inD depth frame.
+     *  \param[in] inR red channel.
+     *  \param[in] inG green channel.
+     *  \param[in] inB blue channel.
+     *  \param[out] out 8-D point cloud.
+     */
+    void RGBDTo8D::run (const float *inD, const float *inR, const float *inG, const float *inB, float *out)
+    {
+        const float cx = 0.5f * (width - 1), cy = 0.5f * (height - 1), invF = 1.f / f;
+
+        pool.parallelFor (height, std::max (grainPoints / width, (size_t) 1), [&] (size_t begin, size_t end)
+        {
+            for (size_t row = begin; row < end; ++row)
+            {
+                size_t k = row * width, rowEnd = k + width;
+                float y = row - cy;
+                for (; k + Float::width <= rowEnd; k += Float::width)
+                    to8DBlock<Float> (inD + k, inR + k, inG + k, inB + k, out + 8 * k, 
+                                      (k - row * width) - cx, y, invF, scaling, rgbNorm);
+                for (; k < rowEnd; ++k)
+                    to8DBlock<Scalar> (inD + k, inR + k, inG + k, inB + k, out + 8 * k, 
+                                       (k - row * width) - cx, y, invF, scaling, rgbNorm);
+            }
+        });
+    }
+
+
+    ICPLMs::ICPLMs (ThreadPool &pool) : pool (pool), width (0), height (0), side (128)
+    {
+    }
+
+
+    /*! \param[in] _width width of the frames.
+     *  \param[in] _height height of the frames.
+     *  \param[in] _side side of the landmark grid.
+     */
+    void ICPLMs::init (unsigned int _width, unsigned int _height, unsigned int _side)
+    {
+        width = _width;
+        height = _height;
+        side = _side;
+    }
+
+
+    /*! \param[in] in 8-D point cloud.
+     *  \param[out] out 8-D landmarks, on a `side` x `side` grid.
+     */
+    void ICPLMs::run (const float *in, float *out)
+    {
+        pool.parallelFor (side, 16, [&] (size_t begin, size_t end)
+        {
+            for (size_t gy = begin; gy < end; ++gy)
+            {
+                size_t row = (2 * gy + 1) * height / (2 * side);
+                for (size_t gx = 0; gx < side; ++gx)
+                {
+                    size_t col = (2 * gx + 1) * width / (2 * side);
+                    const float *p = in + 8 * (row * width + col);
+                    std::copy (p, p + 8, out + 8 * (gy * side + gx));
+                }
+            }
+        });
+    }
+
+
+    const unsigned int RBC::none;
+
+
+    RBC::RBC (ThreadPool &pool) : pool (pool), r (0), rStride (0), lStride (0), a (0.f)
+    {
+    }
+
+
+    /*! \details The representatives are drawn at random from the valid points 
+     *           (those with a non-zero depth). The invalid points are left out.
+     *
+     *  \param[in] X database, array of 8-D points.
+     *  \param[in] m number of points in the database.
+     *  \param[in] _r number of representatives.
+     *  \param[in] _a weight of the color distance, \f$ \alpha \f$.
+     */
+    void RBC::build (const float *X, unsigned int m, unsigned int _r, float _a)
+    {
+        const unsigned int channels[6] = { 0, 1, 2, 4, 5, 6 };
+        a = _a;
+
+        std::vector<uint32_t> valid;
+        valid.reserve (m);
+        for (unsigned int i = 0; i < m; ++i)
+            if (X[8 * i + 2] != 0.f) valid.push_back (i);
+
+        // Draw the representatives (with a fixed seed, for reproducible results)
+        r = std::min (_r, (unsigned int) valid.size ());
+        std::vector<uint32_t> drawn (valid);
+        std::mt19937 gen (r);
+        for (unsigned int k = 0; k < r; ++k)
+            std::swap (drawn[k], drawn[k + gen () % (drawn.size () - k)]);
+
+        rStride = padToWidth (r);
+        reps.assign (6 * rStride, padding);
+        for (unsigned int k = 0; k < r; ++k)
+        {
+            const float *p = X + 8 * drawn[k];
+            for (unsigned int j = 0; j < 6; ++j) reps[j * rStride + k] = p[channels[j]];
+        }
+
+        // Assign the points to their nearest representatives
+        std::vector<uint32_t> owner (valid.size ());
+        std::vector<float> ownerDist (valid.size ());
+        if (r > 0)
+        {
+            pool.parallelFor (valid.size (), 1024, [&] (size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    float dist = std::numeric_limits<float>::infinity ();
+                    size_t rep = 0;
+                    findNearest (reps.data (), rStride, 0, rStride, X + 8 * valid[i], a, dist, rep);
+                    owner[i] = rep;
+                    ownerDist[i] = std::sqrt (dist);
+                }
+            });
+        }
+
+        // Lay the lists out one after the other, each padded to the vector width
+        std::vector<size_t> counts (r, 0);
+        radii.assign (rStride, 0.f);
+        for (size_t i = 0; i < valid.size (); ++i)
+        {
+            ++counts[owner[i]];
+            radii[owner[i]] = std::max (radii[owner[i]], ownerDist[i]);
+        }
+        offsets.assign (r + 1, 0);
+        for (unsigned int k = 0; k < r; ++k) offsets[k + 1] = offsets[k] + padToWidth (counts[k]);
+        lStride = offsets[r];
+
+        lists.assign (6 * lStride, padding);
+        listIdx.assign (lStride, none);
+        std::vector<size_t> fill (offsets.begin (), offsets.end () - 1);
+        for (size_t i = 0; i < valid.size (); ++i)
+        {
+            size_t pos = fill[owner[i]]++;
+            const float *p = X + 8 * valid[i];
+            for (unsigned int j = 0; j < 6; ++j) lists[j * lStride + pos] = p[channels[j]];
+            listIdx[pos] = valid[i];
+        }
+    }
+
+
+    /*! \details The list of the nearest representative is searched first. Then, the 
+     *           list of every other representative gets searched only if it might hold 
+     *           a closer point, i.e. if \f$ d(q,r) - \psi_r < d(q,p) \f$, where \f$ \psi_r \f$ 
+     *           is the radius of the list, and \f$ p \f$ the nearest point so far.
+     *
+     *  \param[in] q query, 8-D point.
+     *  \param[out] dist distance to the neighbor.
+     *  \return The index of the neighbor in the database, or `RBC::none` for an empty database.
+     */
+    unsigned int RBC::query (const float *q, float &dist) const
+    {
+        dist = std::numeric_limits<float>::infinity ();
+        if (r == 0) return none;
+
+        // Distances to the representatives, and lower bounds of the distances to their lists
+        thread_local std::vector<float> bounds;
+        bounds.resize (rStride);
+        float dNearest = std::numeric_limits<float>::infinity ();
+        size_t nearest = 0, pos = 0;
+        findNearest (reps.data (), rStride, 0, rStride, q, a, dNearest, nearest);
+        scanDistances (reps.data (), rStride, 0, rStride, q, a, [&] (size_t i, Float d)
+        {
+            (simd::sqrt (d) - Float::load (&radii[i])).store (&bounds[i]);
+        });
+
+        findNearest (lists.data (), lStride, offsets[nearest], offsets[nearest + 1], q, a, dist, pos);
+
+        float dMin = std::sqrt (dist);
+        for (unsigned int k = 0; k < r; ++k)
+        {
+            if (k == nearest || bounds[k] >= dMin) continue;
+            findNearest (lists.data (), lStride, offsets[k], offsets[k + 1], q, a, dist, pos);
+            dMin = std::sqrt (dist);
+        }
+
+        return listIdx[pos];
+    }
+
+
+    /*! \param[in] Q queries, array of 8-D points.
+     *  \param[in] n number of queries.
+     *  \param[out] idx indices of the neighbors in the database.
+     *  \param[out] dist distances to the neighbors.
+     */
+    void RBC::query (const float *Q, unsigned int n, unsigned int *idx, float *dist)
+    {
+        pool.parallelFor (n, 256, [&] (size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                idx[i] = query (Q + 8 * i, dist[i]);
+        });
+    }
+
+
+    ICP::ICP (ThreadPool &pool) : 
+        R (Eigen::Matrix3f::Identity ()), t (Eigen::Vector3f::Zero ()), s (1.f), 
+        pool (pool), rbc (pool), F (nullptr), m (0), r (0), a (2e2f), 
+        maxIterations (40), angleThreshold (0.001), translationThreshold (0.01)
+    {
+    }
+
+
+    /*! \param[in] _m number of landmarks in each set.
+     *  \param[in] _r number of representatives of the `RBC`.
+     *  \param[in] _a weight of the color distance of the `RBC`, \f$ \alpha \f$.
+     *  \param[in] _maxIterations maximum number of iterations.
+     *  \param[in] _angleThreshold angle threshold (in degrees) for the convergence check.
+     *  \param[in] _translationThreshold translation threshold (in mm) for the convergence check.
+     */
+    void ICP::init (unsigned int _m, unsigned int _r, float _a, unsigned int _maxIterations, 
+                    double _angleThreshold, double _translationThreshold)
+    {
+        m = _m;
+        r = _r;
+        a = _a;
+        maxIterations = _maxIterations;
+        angleThreshold = _angleThreshold;
+        translationThreshold = _translationThreshold;
+    }
+
+
+    /*! \note The landmarks are referenced by `run`, so they have to outlive the registration.
+     *
+     *  \param[in] _F fixed landmarks, array of 8-D points.
+     */
+    void ICP::buildRBC (const float *_F)
+    {
+        F = _F;
+        rbc.build (F, m, r, a);
+    }
+
+
+    /*! \details It starts from the identity transformation. Every iteration 
+     *           transforms the valid moving landmarks by the current estimate, 
+     *           finds their neighbors among the fixed ones, and composes the 
+     *           estimate with the increment that best aligns the pairs. 
+     *           The loop stops on convergence, or when fewer than 3 pairs are left.
+     *
+     *  \param[in] M moving landmarks, array of 8-D points.
+     *  \return The number of iterations performed.
+     */
+    unsigned int ICP::run (const float *M)
+    {
+        const size_t grain = 256;
+        std::vector<ICPSums> partial (ThreadPool::getChunks (m, grain));
+
+        R.setIdentity ();
+        t.setZero ();
+        s = 1.f;
+
+        for (unsigned int iter = 0; iter < maxIterations; ++iter)
+        {
+            // Association ===================================================
+
+            const Eigen::Matrix3f A = s * R;
+            pool.parallelFor (m, grain, [&] (size_t begin, size_t end)
+            {
+                ICPSums &v = partial[begin / grain];
+                v.clear ();
+
+                float q[8];
+                for (size_t k = begin; k < end; ++k)
+                {
+                    const float *p = M + 8 * k;
+                    if (p[2] == 0.f) continue;
+
+                    Eigen::Vector3f pT = A * Eigen::Map<const Eigen::Vector3f> (p) + t;
+                    std::copy (pT.data (), pT.data () + 3, q);
+                    std::copy (p + 3, p + 8, q + 3);
+
+                    float dist;
+                    unsigned int idx = rbc.query (q, dist);
+                    if (idx == RBC::none) continue;
+                    const float *f = F + 8 * idx;
+
+                    v.n += 1.0;
+                    for (unsigned int i = 0; i < 3; ++i)
+                    {
+                        v.sM[i] += q[i];
+                        v.sF[i] += f[i];
+                        v.sMM += (double) q[i] * q[i];
+                        v.sFF += (double) f[i] * f[i];
+                        for (unsigned int j = 0; j < 3; ++j)
+                            v.sMF[3 * i + j] += (double) q[i] * f[j];
+                    }
+                }
+            });
+
+            ICPSums v;
+            v.clear ();
+            for (const ICPSums &p : partial) v += p;
+            if (v.n < 3) return iter + 1;
+
+            // Solution ======================================================
+
+            Eigen::Vector3d mM (v.sM[0] / v.n, v.sM[1] / v.n, v.sM[2] / v.n);
+            Eigen::Vector3d mF (v.sF[0] / v.n, v.sF[1] / v.n, v.sF[2] / v.n);
+            Eigen::Matrix3d S = Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> (v.sMF) / v.n - mM * mF.transpose ();
+            double varM = v.sMM / v.n - mM.squaredNorm ();
+            double varF = v.sFF / v.n - mF.squaredNorm ();
+
+            Eigen::Matrix4d N;
+            N << S(0,0) + S(1,1) + S(2,2), S(1,2) - S(2,1), S(2,0) - S(0,2), S(0,1) - S(1,0), 
+                 S(1,2) - S(2,1), S(0,0) - S(1,1) - S(2,2), S(0,1) + S(1,0), S(2,0) + S(0,2), 
+                 S(2,0) - S(0,2), S(0,1) + S(1,0), -S(0,0) + S(1,1) - S(2,2), S(1,2) + S(2,1), 
+                 S(0,1) - S(1,0), S(2,0) + S(0,2), S(1,2) + S(2,1), -S(0,0) - S(1,1) + S(2,2);
+
+            // The eigenvector of the largest eigenvalue is the rotation, (w, x, y, z)
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> solver (N);
+            Eigen::Vector4d e = solver.eigenvectors ().col (3);
+            if (e[0] < 0) e = -e;
+
+            Eigen::Matrix3d dR = Eigen::Quaterniond (e[0], e[1], e[2], e[3]).normalized ().toRotationMatrix ();
+            double ds = (varM > 0) ? std::sqrt (varF / varM) : 1.0;
+            Eigen::Vector3d dt = mF - ds * dR * mM;
+
+            // Composition, T = dT o T
+            R = (dR.cast<float> () * R).eval ();
+            t = (ds * dR * t.cast<double> () + dt).cast<float> ();
+            s *= ds;
+
+            // Convergence check
+            double angle = 2.0 * std::asin (std::min (e.tail<3> ().norm (), 1.0)) * 180.0 / M_PI;
+            if (angle < angleThreshold && dt.norm () < translationThreshold)
+                return iter + 1;
+        }
+
+        return maxIterations;
+    }
+
+
+    ICPTransform::ICPTransform (ThreadPool &pool) : 
+        pool (pool), n (0), R (Eigen::Matrix3f::Identity ()), t (Eigen::Vector3f::Zero ()), s (1.f)
+    {
+    }
+
+
+    /*! \param[in] _n number of points in the point cloud. */
+    void ICPTransform::init (unsigned int _n)
+    {
+        n = _n;
+    }
+
+
+    /*! \param[in] q rotation.
+     *  \param[in] _t translation (in mm).
+     *  \param[in] _s scale.
+     */
+    void ICPTransform::setTransformation (const Eigen::Quaternionf &q, const Eigen::Vector3f &_t, float _s)
+    {
+        R = q.normalized ().toRotationMatrix ();
+        t = _t;
+        s = _s;
+    }
+
+
+    /*! \details Invalid points stay invalid, at the origin.
+     *
+     *  \param[in] in 8-D point cloud.
+     *  \param[out] out transformed 8-D point cloud.
+     */
+    void ICPTransform::run (const float *in, float *out)
+    {
+        Eigen::Matrix<float, 3, 3, Eigen::RowMajor> A = s * R;
+
+        pool.parallelFor (n, grainPoints, [&] (size_t begin, size_t end)
+        {
+            size_t k = begin;
+            for (; k + Float::width <= end; k += Float::width)
+                transformBlock<Float> (in + 8 * k, out + 8 * k, A.data (), t.data ());
+            for (; k < end; ++k)
+                transformBlock<Scalar> (in + 8 * k, out + 8 * k, A.data (), t.data ());
+        });
+    }
+
+
+    SplitPC8D::SplitPC8D (ThreadPool &pool) : pool (pool), n (0)
+    {
+    }
+
+
+    /*! \param[in] _n number of points in the point cloud. */
+    void SplitPC8D::init (unsigned int _n)
+    {
+        n = _n;
+    }
+
+
+    /*! \details The stage is bound by memory, so it's left to the compiler to vectorize.
+     *
+     *  \param[in] in 8-D point cloud.
+     *  \param[out] outPC3D array with 3-D coordinates (in meters).
+     *  \param[out] outRGB array with 8-bit RGB values.
+     */
+    void SplitPC8D::run (const float *in, float *outPC3D, uint8_t *outRGB)
+    {
+        pool.parallelFor (n, grainPoints, [&] (size_t begin, size_t end)
+        {
+            for (size_t k = begin; k < end; ++k)
+            {
+                const float *p = in + 8 * k;
+                for (unsigned int j = 0; j < 3; ++j)
+                {
+                    outPC3D[3 * k + j] = p[j] * 0.001f;
+                    outRGB[3 * k + j] = (uint8_t) (p[4 + j] * 255);
+                }
+            }
+        });
+    }
+
+
+    /*! \param[in] _width width of the frames.
+     *  \param[in] _height height of the frames.
+     *  \param[in] threads number of threads. `0` picks the number of hardware threads.
+     */
+    Pipeline::Pipeline (unsigned int _width, unsigned int _height, unsigned int threads) : 
+        R_g (Eigen::Matrix3f::Identity ()), t_g (Eigen::Vector3f::Zero ()), s_g (1.f), 
+        timeStep (0), lPre (0), lICP (0), latency (0), 
+        pool (threads), convD (pool), sepRGB (pool), to8D (pool), lm (pool), 
+        icp (pool), transform (pool), sp8D (pool), 
+        width (_width), height (_height), n (_width * _height), m (128 * 128), 
+        bufferD (n), bufferR (n), bufferG (n), bufferB (n), 
+        pc (8 * n), pcT (8 * n), lmsF (8 * m), lmsM (8 * m), pc3D (3 * n), rgb3D (3 * n)
+    {
+        // The parameters are the defaults of the OpenCL pipeline
+        convD.init (n, 1.f);
+        sepRGB.init (n);
+        to8D.init (width, height, 595.f, 1.f, 1);
+        lm.init (width, height, 128);
+        icp.init (m, 256, 2e2f, 40, 0.001, 0.01);
+        transform.init (n);
+        sp8D.init (n);
+    }
+
+
+    void Pipeline::reset ()
+    {
+        R_g.setIdentity ();
+        t_g.setZero ();
+        s_g = 1.f;
+        timeStep = 0;
+    }
+
+
+    /*! \details The first frame sets the global coordinate frame. Every other frame 
+     *           is registered against the previous one, and the global pose gets 
+     *           composed with the result, \f$ T_g = T_g \circ T_{icp} \f$.
+     *
+     *  \param[in] rgb interleaved 8-bit RGB frame.
+     *  \param[in] depth depth frame (in mm).
+     *  \return The number of ICP iterations (`0` for the first frame).
+     */
+    unsigned int Pipeline::process (const uint8_t *rgb, const uint16_t *depth)
+    {
+        Clock::time_point start = Clock::now ();
+
+        convD.run (depth, bufferD.data ());
+        sepRGB.run (rgb, bufferR.data (), bufferG.data (), bufferB.data ());
+        to8D.run (bufferD.data (), bufferR.data (), bufferG.data (), bufferB.data (), pc.data ());
+        lm.run (pc.data (), lmsM.data ());
+        lPre = elapsed (start);
+
+        Clock::time_point startICP = Clock::now ();
+        unsigned int iterations = 0;
+        if (timeStep > 0)
+        {
+            icp.buildRBC (lmsF.data ());
+            iterations = icp.run (lmsM.data ());
+
+            t_g = s_g * R_g * icp.t + t_g;
+            R_g = (R_g * icp.R).eval ();
+            s_g *= icp.s;
+        }
+        lICP = elapsed (startICP);
+
+        transform.setTransformation (Eigen::Quaternionf (R_g), t_g, s_g);
+        transform.run (pc.data (), pcT.data ());
+        sp8D.run (pcT.data (), pc3D.data (), rgb3D.data ());
+
+        std::swap (lmsF, lmsM);
+        ++timeStep;
+        latency = elapsed (start);
+
+        return iterations;
+    }
+
+}
+}
+}
@@ -0,0 +1,344 @@
+/*! \file simd.hpp
+ *  \brief Declares the vector types the `CPU` backend is written with.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#ifndef OCLSLAM_CPU_SIMD_HPP
+#define OCLSLAM_CPU_SIMD_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#define OCLSLAM_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OCLSLAM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+namespace cpu
+{
+
+/*! \brief Offers the vector types of the `CPU` backend.
+ *  \details `Float` is the widest vector of floats the target supports, `AVX2` 
+ *           (8 lanes), `NEON` (4 lanes), or a plain float (1 lane) anywhere else, 
+ *           and `Mask` is the result of comparing two of them. `Scalar` has the 
+ *           same interface, with 1 lane, and it's used for the tails of the loops, 
+ *           so every routine is written once, as a template on the vector type.
+ *  \note The instruction set is picked at compile time, e.g. with `-march=native`. 
+ *        The header is private to `oclslamCPU`, so no other translation unit sees 
+ *        the vector types; the instruction set in use is reported by 
+ *        `cpu::getInstructionSet`.
+ */
+namespace simd
+{
+
+    /*! \brief Vector of 1 float. */
+    struct Scalar
+    {
+        static const unsigned int width = 1;
+
+        Scalar () {}
+        Scalar (float s) : v (s) {}
+        /*! \brief Loads a float. */
+        static Scalar load (const float *p) { return *p; }
+        /*! \brief Loads and converts an unsigned short. */
+        static Scalar loadU16 (const uint16_t *p) { return (float) *p; }
+        /*! \brief Returns the lane indices. */
+        static Scalar iota () { return 0.f; }
+        /*! \brief Stores a float. */
+        void store (float *p) const { *p = v; }
+
+        float v;
+    };
+
+    /*! \brief Mask of 1 lane. */
+    struct ScalarMask
+    {
+        bool v;
+    };
+
+    inline Scalar operator+ (Scalar a, Scalar b) { return a.v + b.v; }
+    inline Scalar operator- (Scalar a, Scalar b) { return a.v - b.v; }
+    inline Scalar operator* (Scalar a, Scalar b) { return a.v * b.v; }
+    inline Scalar operator/ (Scalar a, Scalar b) { return a.v / b.v; }
+    /*! \brief Computes \f$ a b + c \f$. */
+    inline Scalar fmadd (Scalar a, Scalar b, Scalar c) { return a.v * b.v + c.v; }
+    inline Scalar min (Scalar a, Scalar b) { return std::min (a.v, b.v); }
+    inline Scalar max (Scalar a, Scalar b) { return std::max (a.v, b.v); }
+    inline Scalar sqrt (Scalar a) { return std::sqrt (a.v); }
+    inline ScalarMask operator< (Scalar a, Scalar b) { return { a.v < b.v }; }
+    inline ScalarMask operator> (Scalar a, Scalar b) { return { a.v > b.v }; }
+    inline ScalarMask operator!= (Scalar a, Scalar b) { return { a.v != b.v }; }
+    inline ScalarMask operator& (ScalarMask a, ScalarMask b) { return { a.v && b.v }; }
+    /*! \brief Picks `a` where the mask is set, and `b` elsewhere. */
+    inline Scalar select (ScalarMask m, Scalar a, Scalar b) { return m.v ? a : b; }
+    /*! \brief Indicates whether any lane of the mask is set. */
+    inline bool any (ScalarMask m) { return m.v; }
+    /*! \brief Sums the lanes. */
+    inline float hsum (Scalar a) { return a.v; }
+
+    /*! \brief Loads 1 8-D point, as 8 channels. */
+    inline void load8 (const float *p, Scalar c[8])
+    {
+        for (unsigned int j = 0; j < 8; ++j) c[j] = p[j];
+    }
+
+    /*! \brief Stores 8 channels, as 1 8-D point. */
+    inline void store8 (float *p, const Scalar c[8])
+    {
+        for (unsigned int j = 0; j < 8; ++j) p[j] = c[j].v;
+    }
+
+
+#if defined(OCLSLAM_SIMD_AVX2)
+
+    /*! \brief Vector of 8 floats. */
+    struct Float
+    {
+        static const unsigned int width = 8;
+
+        Float () {}
+        Float (__m256 v) : v (v) {}
+        Float (float s) : v (_mm256_set1_ps (s)) {}
+        static Float load (const float *p) { return _mm256_loadu_ps (p); }
+        static Float loadU16 (const uint16_t *p) 
+        { return _mm256_cvtepi32_ps (_mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i *) p))); }
+        static Float iota () { return _mm256_setr_ps (0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+        void store (float *p) const { _mm256_storeu_ps (p, v); }
+
+        __m256 v;
+    };
+
+    /*! \brief Mask of 8 lanes. */
+    struct Mask
+    {
+        __m256 v;
+    };
+
+    inline Float operator+ (Float a, Float b) { return _mm256_add_ps (a.v, b.v); }
+    inline Float operator- (Float a, Float b) { return _mm256_sub_ps (a.v, b.v); }
+    inline Float operator* (Float a, Float b) { return _mm256_mul_ps (a.v, b.v); }
+    inline Float operator/ (Float a, Float b) { return _mm256_div_ps (a.v, b.v); }
+    inline Float fmadd (Float a, Float b, Float c) { return _mm256_fmadd_ps (a.v, b.v, c.v); }
+    inline Float min (Float a, Float b) { return _mm256_min_ps (a.v, b.v); }
+    inline Float max (Float a, Float b) { return _mm256_max_ps (a.v, b.v); }
+    inline Float sqrt (Float a) { return _mm256_sqrt_ps (a.v); }
+    inline Mask operator< (Float a, Float b) { return { _mm256_cmp_ps (a.v, b.v, _CMP_LT_OQ) }; }
+    inline Mask operator> (Float a, Float b) { return { _mm256_cmp_ps (a.v, b.v, _CMP_GT_OQ) }; }
+    inline Mask operator!= (Float a, Float b) { return { _mm256_cmp_ps (a.v, b.v, _CMP_NEQ_OQ) }; }
+    inline Mask operator& (Mask a, Mask b) { return { _mm256_and_ps (a.v, b.v) }; }
+    inline Float select (Mask m, Float a, Float b) { return _mm256_blendv_ps (b.v, a.v, m.v); }
+    inline bool any (Mask m) { return _mm256_movemask_ps (m.v) != 0; }
+
+    inline float hsum (Float a)
+    {
+        __m128 s = _mm_add_ps (_mm256_castps256_ps128 (a.v), _mm256_extractf128_ps (a.v, 1));
+        s = _mm_add_ps (s, _mm_movehl_ps (s, s));
+        s = _mm_add_ss (s, _mm_movehdup_ps (s));
+        return _mm_cvtss_f32 (s);
+    }
+
+    /*! \brief Transposes an 8x8 block. */
+    inline void transpose8 (__m256 r[8])
+    {
+        __m256 t[8], u[8];
+        for (unsigned int i = 0; i < 8; i += 2)
+        {
+            t[i] = _mm256_unpacklo_ps (r[i], r[i + 1]);
+            t[i + 1] = _mm256_unpackhi_ps (r[i], r[i + 1]);
+        }
+        for (unsigned int i = 0; i < 8; i += 4)
+        {
+            u[i] = _mm256_shuffle_ps (t[i], t[i + 2], _MM_SHUFFLE (1, 0, 1, 0));
+            u[i + 1] = _mm256_shuffle_ps (t[i], t[i + 2], _MM_SHUFFLE (3, 2, 3, 2));
+            u[i + 2] = _mm256_shuffle_ps (t[i + 1], t[i + 3], _MM_SHUFFLE (1, 0, 1, 0));
+            u[i + 3] = _mm256_shuffle_ps (t[i + 1], t[i + 3], _MM_SHUFFLE (3, 2, 3, 2));
+        }
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            r[i] = _mm256_permute2f128_ps (u[i], u[i + 4], 0x20);
+            r[i + 4] = _mm256_permute2f128_ps (u[i], u[i + 4], 0x31);
+        }
+    }
+
+    /*! \brief Loads 8 8-D points, as 8 channels. */
+    inline void load8 (const float *p, Float c[8])
+    {
+        __m256 r[8];
+        for (unsigned int i = 0; i < 8; ++i) r[i] = _mm256_loadu_ps (p + 8 * i);
+        transpose8 (r);
+        for (unsigned int j = 0; j < 8; ++j) c[j] = r[j];
+    }
+
+    /*! \brief Stores 8 channels, as 8 8-D points. */
+    inline void store8 (float *p, const Float c[8])
+    {
+        __m256 r[8];
+        for (unsigned int j = 0; j < 8; ++j) r[j] = c[j].v;
+        transpose8 (r);
+        for (unsigned int i = 0; i < 8; ++i) _mm256_storeu_ps (p + 8 * i, r[i]);
+    }
+
+    /*! \brief Name of the instruction set. */
+    inline const char* getName () { return "AVX2"; }
+
+#elif defined(OCLSLAM_SIMD_NEON)
+
+    /*! \brief Vector of 4 floats. */
+    struct Float
+    {
+        static const unsigned int width = 4;
+
+        Float () {}
+        Float (float32x4_t v) : v (v) {}
+        Float (float s) : v (vdupq_n_f32 (s)) {}
+        static Float load (const float *p) { return vld1q_f32 (p); }
+        static Float loadU16 (const uint16_t *p) { return vcvtq_f32_u32 (vmovl_u16 (vld1_u16 (p))); }
+        static Float iota () { const float i[4] = { 0.f, 1.f, 2.f, 3.f }; return vld1q_f32 (i); }
+        void store (float *p) const { vst1q_f32 (p, v); }
+
+        float32x4_t v;
+    };
+
+    /*! \brief Mask of 4 lanes. */
+    struct Mask
+    {
+        uint32x4_t v;
+    };
+
+    inline Float operator+ (Float a, Float b) { return vaddq_f32 (a.v, b.v); }
+    inline Float operator- (Float a, Float b) { return vsubq_f32 (a.v, b.v); }
+    inline Float operator* (Float a, Float b) { return vmulq_f32 (a.v, b.v); }
+    inline Float min (Float a, Float b) { return vminq_f32 (a.v, b.v); }
+    inline Float max (Float a, Float b) { return vmaxq_f32 (a.v, b.v); }
+    inline Mask operator< (Float a, Float b) { return { vcltq_f32 (a.v, b.v) }; }
+    inline Mask operator> (Float a, Float b) { return { vcgtq_f32 (a.v, b.v) }; }
+    inline Mask operator!= (Float a, Float b) { return { vmvnq_u32 (vceqq_f32 (a.v, b.v)) }; }
+    inline Mask operator& (Mask a, Mask b) { return { vandq_u32 (a.v, b.v) }; }
+    inline Float select (Mask m, Float a, Float b) { return vbslq_f32 (m.v, a.v, b.v); }
+
+#if defined(__aarch64__)
+    inline Float operator/ (Float a, Float b) { return vdivq_f32 (a.v, b.v); }
+    inline Float fmadd (Float a, Float b, Float c) { return vfmaq_f32 (c.v, a.v, b.v); }
+    inline Float sqrt (Float a) { return vsqrtq_f32 (a.v); }
+    inline bool any (Mask m) { return vmaxvq_u32 (m.v) != 0; }
+    inline float hsum (Float a) { return vaddvq_f32 (a.v); }
+#else
+    // ARMv7 has neither division nor square root, so they are refined estimates
+    inline Float operator/ (Float a, Float b)
+    {
+        float32x4_t x = vrecpeq_f32 (b.v);
+        x = vmulq_f32 (x, vrecpsq_f32 (b.v, x));
+        x = vmulq_f32 (x, vrecpsq_f32 (b.v, x));
+        return vmulq_f32 (a.v, x);
+    }
+    inline Float fmadd (Float a, Float b, Float c) { return vmlaq_f32 (c.v, a.v, b.v); }
+    inline Float sqrt (Float a)
+    {
+        float32x4_t x = vrsqrteq_f32 (a.v);
+        x = vmulq_f32 (x, vrsqrtsq_f32 (vmulq_f32 (a.v, x), x));
+        x = vmulq_f32 (x, vrsqrtsq_f32 (vmulq_f32 (a.v, x), x));
+        return vbslq_f32 (vceqq_f32 (a.v, vdupq_n_f32 (0.f)), a.v, vmulq_f32 (a.v, x));
+    }
+    inline bool any (Mask m)
+    {
+        uint32x2_t r = vorr_u32 (vget_low_u32 (m.v), vget_high_u32 (m.v));
+        return (vget_lane_u32 (r, 0) | vget_lane_u32 (r, 1)) != 0;
+    }
+    inline float hsum (Float a)
+    {
+        float32x2_t r = vadd_f32 (vget_low_f32 (a.v), vget_high_f32 (a.v));
+        return vget_lane_f32 (vpadd_f32 (r, r), 0);
+    }
+#endif
+
+    /*! \brief Transposes a 4x4 block. */
+    inline void transpose4 (float32x4_t &a, float32x4_t &b, float32x4_t &c, float32x4_t &d)
+    {
+        float32x4x2_t ab = vtrnq_f32 (a, b);
+        float32x4x2_t cd = vtrnq_f32 (c, d);
+        a = vcombine_f32 (vget_low_f32 (ab.val[0]), vget_low_f32 (cd.val[0]));
+        b = vcombine_f32 (vget_low_f32 (ab.val[1]), vget_low_f32 (cd.val[1]));
+        c = vcombine_f32 (vget_high_f32 (ab.val[0]), vget_high_f32 (cd.val[0]));
+        d = vcombine_f32 (vget_high_f32 (ab.val[1]), vget_high_f32 (cd.val[1]));
+    }
+
+    /*! \brief Loads 4 8-D points, as 8 channels. */
+    inline void load8 (const float *p, Float c[8])
+    {
+        float32x4_t r[8];
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            r[i] = vld1q_f32 (p + 8 * i);
+            r[4 + i] = vld1q_f32 (p + 8 * i + 4);
+        }
+        transpose4 (r[0], r[1], r[2], r[3]);
+        transpose4 (r[4], r[5], r[6], r[7]);
+        for (unsigned int j = 0; j < 8; ++j) c[j] = r[j];
+    }
+
+    /*! \brief Stores 8 channels, as 4 8-D points. */
+    inline void store8 (float *p, const Float c[8])
+    {
+        float32x4_t r[8];
+        for (unsigned int j = 0; j < 8; ++j) r[j] = c[j].v;
+        transpose4 (r[0], r[1], r[2], r[3]);
+        transpose4 (r[4], r[5], r[6], r[7]);
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            vst1q_f32 (p + 8 * i, r[i]);
+            vst1q_f32 (p + 8 * i + 4, r[4 + i]);
+        }
+    }
+
+    /*! \brief Name of the instruction set. */
+    inline const char* getName () { return "NEON"; }
+
+#else
+
+    typedef Scalar Float;
+    typedef ScalarMask Mask;
+
+    /*! \brief Name of the instruction set. */
+    inline const char* getName () { return "scalar"; }
+
+#endif
+
+}
+
+}
+}
+}
+
+#endif  // OCLSLAM_CPU_SIMD_HPP
@@ -0,0 +1,154 @@
+/*! \file thread_pool.cpp
+ *  \brief Defines a pool of worker threads for the `CPU` backend.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <oclslam/cpu/thread_pool.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+namespace cpu
+{
+
+    /*! \param[in] threads number of threads that take part in a loop, including 
+     *                     the calling one. `0` picks the number of hardware threads.
+     */
+    ThreadPool::ThreadPool (unsigned int threads) : 
+        job (nullptr), jobSize (0), jobGrain (1), next (0), active (0), generation (0), quit (false)
+    {
+        if (threads == 0) threads = std::max (std::thread::hardware_concurrency (), 1u);
+
+        for (unsigned int i = 1; i < threads; ++i)
+            workers.emplace_back ([this] { work (); });
+    }
+
+
+    ThreadPool::~ThreadPool ()
+    {
+        {
+            std::lock_guard<std::mutex> lock (mtx);
+            quit = true;
+        }
+        cvWork.notify_all ();
+
+        for (std::thread &worker : workers)
+            worker.join ();
+    }
+
+
+    /*! \details The calling thread works on the loop too. If `func` throws, 
+     *           the remaining chunks are skipped, and the first exception 
+     *           is rethrown on the calling thread.
+     *
+     *  \param[in] n number of iterations.
+     *  \param[in] grain number of iterations in a chunk.
+     *  \param[in] func function that runs the iterations `[begin, end)` of a chunk.
+     */
+    void ThreadPool::parallelFor (size_t n, size_t grain, const std::function<void (size_t, size_t)> &func)
+    {
+        if (n == 0) return;
+        grain = std::max (grain, (size_t) 1);
+
+        if (workers.empty () || n <= grain)
+        {
+            for (size_t begin = 0; begin < n; begin += grain)
+                func (begin, std::min (begin + grain, n));
+            return;
+        }
+
+        std::lock_guard<std::mutex> call (callMtx);
+
+        {
+            std::lock_guard<std::mutex> lock (mtx);
+            job = &func;
+            jobSize = n;
+            jobGrain = grain;
+            next = 0;
+            active = workers.size ();
+            error = nullptr;
+            ++generation;
+        }
+        cvWork.notify_all ();
+
+        runChunks ();
+
+        std::unique_lock<std::mutex> lock (mtx);
+        cvDone.wait (lock, [this] { return active == 0; });
+        job = nullptr;
+
+        if (error) std::rethrow_exception (error);
+    }
+
+
+    /*! \brief Waits for loops, and works on them. */
+    void ThreadPool::work ()
+    {
+        uint64_t seen = 0;
+
+        while (true)
+        {
+            std::unique_lock<std::mutex> lock (mtx);
+            cvWork.wait (lock, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+            lock.unlock ();
+
+            runChunks ();
+
+            lock.lock ();
+            if (--active == 0) cvDone.notify_one ();
+        }
+    }
+
+
+    /*! \brief Pulls chunks of the current loop until none is left. */
+    void ThreadPool::runChunks ()
+    {
+        while (true)
+        {
+            size_t begin = jobGrain * next++;
+            if (begin >= jobSize) return;
+
+            try
+            {
+                (*job) (begin, std::min (begin + jobGrain, jobSize));
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock (mtx);
+                if (!error) error = std::current_exception ();
+                next = getChunks (jobSize, jobGrain);  // Skip the rest of the loop
+            }
+        }
+    }
+
+}
+}
+}
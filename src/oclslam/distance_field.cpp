@@ -0,0 +1,186 @@
+/*! \file distance_field.cpp
+ *  \brief Defines a Euclidean distance field that follows the changes of the map.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <oclslam/distance_field.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    const float DistanceField::unknown = DynamicEDTOctomap::distanceValue_Error;
+
+
+    /*! \param[in] _maxDist distance (in meters) beyond which the field saturates. 
+     *                      The cost of an update grows with it.
+     */
+    DistanceField::DistanceField (float _maxDist) : 
+        maxDist (_maxDist), unknownAsOccupied (false), configured (false), 
+        resolution (0.0), source (nullptr), stats ({ 0, 0 })
+    {
+    }
+
+
+    /*! \details The field is rebuilt on the next update. The memory it 
+     *           takes grows with the volume of the box, in cells.
+     *
+     *  \param[in] _min minimum corner (in meters) of the box.
+     *  \param[in] _max maximum corner (in meters) of the box.
+     *  \param[in] _unknownAsOccupied flag to treat the unobserved cells as obstacles.
+     */
+    void DistanceField::setBounds (const octomap::point3d &_min, const octomap::point3d &_max, bool _unknownAsOccupied)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        bbxMin = _min;
+        bbxMax = _max;
+        unknownAsOccupied = _unknownAsOccupied;
+        configured = true;
+        edt.reset ();
+    }
+
+
+    bool DistanceField::isEnabled () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return configured;
+    }
+
+
+    /*! \details The first update builds the field from the leaves in the box, 
+     *           and turns on the change detection of the map. The rest process 
+     *           only the cells that changed state since the previous update.
+     *  \note It has to be called while holding the map, before any of its 
+     *        changed cells is deleted.
+     *
+     *  \param[in,out] map the map. The change detection gets reset.
+     */
+    void DistanceField::update (octomap::OcTree &map)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!configured) return;
+
+        if (!edt || source != &map)
+        {
+            map.enableChangeDetection (true);
+            map.resetChangeDetection ();
+            edt.reset (new DynamicEDTOctomap (maxDist, &map, bbxMin, bbxMax, unknownAsOccupied));
+            source = &map;
+            resolution = map.getResolution ();
+        }
+        else
+            stats.changes += map.numChangesDetected ();
+
+        edt->update ();
+        ++stats.updates;
+    }
+
+
+    /*! \param[in] p point (in meters).
+     *  \return The distance, saturated at the maximum distance, or 
+     *          `DistanceField::unknown` if the point is out of the field.
+     */
+    float DistanceField::getDistance (const octomap::point3d &p) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return lookup (p);
+    }
+
+
+    /*! \param[in] p point (in meters).
+     *  \param[out] obstacle center (in meters) of the nearest obstacle cell.
+     *  \return The distance, saturated at the maximum distance, or 
+     *          `DistanceField::unknown` if the point is out of the field.
+     */
+    float DistanceField::getDistance (const octomap::point3d &p, octomap::point3d &obstacle) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!edt) return unknown;
+
+        float distance;
+        edt->getDistanceAndClosestObstacle (p, distance, obstacle);
+        return distance;
+    }
+
+
+    /*! \details The whole set is answered on the same state of the field.
+     *
+     *  \param[in] points points (in meters).
+     *  \param[out] distances the distances, as in `getDistance`.
+     */
+    void DistanceField::getDistances (const std::vector<octomap::point3d> &points, std::vector<float> &distances) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        distances.resize (points.size ());
+        for (size_t i = 0; i < points.size (); ++i)
+            distances[i] = lookup (points[i]);
+    }
+
+
+    /*! \details The gradient is computed with central differences, one cell 
+     *           apart. It points away from the nearest obstacle, and vanishes 
+     *           where the field saturates.
+     *
+     *  \param[in] p point (in meters).
+     *  \param[out] gradient the gradient (in meters per meter).
+     *  \return `true` if the point and its neighbors are in the field.
+     */
+    bool DistanceField::getGradient (const octomap::point3d &p, octomap::point3d &gradient) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!edt) return false;
+
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            octomap::point3d step;
+            step (i) = (float) resolution;
+            float forward = lookup (p + step);
+            float backward = lookup (p - step);
+            if (forward == unknown || backward == unknown) return false;
+            gradient (i) = (float) ((forward - backward) / (2.0 * resolution));
+        }
+
+        return true;
+    }
+
+
+    DistanceField::Stats DistanceField::getStats () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return stats;
+    }
+
+
+    /*! \note It has to be called while holding `mtx`. */
+    float DistanceField::lookup (const octomap::point3d &p) const
+    {
+        return edt ? edt->getDistance (p) : unknown;
+    }
+
+}
+}
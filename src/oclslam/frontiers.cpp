@@ -0,0 +1,291 @@
+/*! \file frontiers.cpp
+ *  \brief Defines a set of frontier cells that follows the changes of the map.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <oclslam/frontiers.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    FrontierSet::FrontierSet () : 
+        enabled (false), built (false), resolution (0.0), keyOffset (0), 
+        clustered (false), stats ({ 0, 0, 0 })
+    {
+    }
+
+
+    /*! \details Enabling the set has it rebuilt on the next update.
+     *
+     *  \param[in] flag flag to enable the set.
+     */
+    void FrontierSet::setEnabled (bool flag)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        enabled = flag;
+        built = false;
+        cells.clear ();
+        regions.clear ();
+        clustered = false;
+    }
+
+
+    bool FrontierSet::isEnabled () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return enabled;
+    }
+
+
+    /*! \details The first update turns on the change detection of the map, and 
+     *           examines every cell of the free leaves. The rest examine the 
+     *           cells that changed since the change detection was last reset, 
+     *           and their neighbors.
+     *  \note It has to be called while holding the map, before any 
+     *        of its changed cells is deleted.
+     *
+     *  \param[in,out] map the map.
+     *  \return The number of cells examined.
+     */
+    size_t FrontierSet::update (octomap::OcTree &map)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!enabled) return 0;
+
+        size_t checked = 0;
+        if (!built)
+        {
+            map.enableChangeDetection (true);
+            resolution = map.getResolution ();
+            keyOffset = 1 << (map.getTreeDepth () - 1);
+            cells.clear ();
+
+            // A pruned leaf is examined cell by cell
+            for (auto it = map.begin_leafs (), end = map.end_leafs (); it != end; ++it)
+            {
+                if (map.isNodeOccupied (*it)) continue;
+                const int span = 1 << (map.getTreeDepth () - it.getDepth ());
+                const octomap::OcTreeKey base = it.getIndexKey ();
+                for (int x = 0; x < span; ++x)
+                    for (int y = 0; y < span; ++y)
+                        for (int z = 0; z < span; ++z)
+                        {
+                            octomap::OcTreeKey key (base[0] + x, base[1] + y, base[2] + z);
+                            if (check (map, key)) cells.insert (key);
+                            ++checked;
+                        }
+            }
+            built = true;
+        }
+        else
+        {
+            octomap::KeySet candidates;
+            for (auto it = map.changedKeysBegin (), end = map.changedKeysEnd (); it != end; ++it)
+            {
+                const octomap::OcTreeKey &key = it->first;
+                candidates.insert (key);
+                for (unsigned int i = 0; i < 3; ++i)
+                {
+                    octomap::OcTreeKey neighbor = key;
+                    --neighbor[i];
+                    candidates.insert (neighbor);
+                    neighbor[i] += 2;
+                    candidates.insert (neighbor);
+                }
+            }
+
+            for (const octomap::OcTreeKey &key : candidates)
+            {
+                if (check (map, key)) cells.insert (key);
+                else cells.erase (key);
+            }
+            checked = candidates.size ();
+        }
+
+        if (checked > 0) clustered = false;
+        ++stats.updates;
+        stats.checked += checked;
+        return checked;
+    }
+
+
+    /*! \param[in] p point (in meters).
+     *  \return `true` if the cell is in the set.
+     */
+    bool FrontierSet::isFrontier (const octomap::point3d &p) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (resolution == 0.0) return false;
+
+        octomap::OcTreeKey key;
+        for (unsigned int i = 0; i < 3; ++i)
+            key[i] = (octomap::key_type) ((int) std::floor (p (i) / resolution) + keyOffset);
+        return cells.count (key) > 0;
+    }
+
+
+    /*! \param[out] centers the centers (in meters) of the cells. */
+    void FrontierSet::getCells (std::vector<octomap::point3d> &centers) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        centers.clear ();
+        centers.reserve (cells.size ());
+        for (const octomap::OcTreeKey &key : cells)
+            centers.push_back (toCoord (key));
+    }
+
+
+    /*! \param[out] regions the regions.
+     *  \param[in] minSize minimum number of cells in a region.
+     */
+    void FrontierSet::getRegions (std::vector<Region> &regions, size_t minSize) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        cluster ();
+        regions.clear ();
+        for (const Region &r : this->regions)
+            if (r.size >= minSize) regions.push_back (r);
+    }
+
+
+    /*! \param[in] p point (in meters), e.g. the position of the sensor.
+     *  \param[out] region the region.
+     *  \param[in] minSize minimum number of cells in a region.
+     *  \return `false` if there is no region of that size.
+     */
+    bool FrontierSet::getNearestRegion (const octomap::point3d &p, Region &region, size_t minSize) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        cluster ();
+        double best = -1.0;
+        for (const Region &r : regions)
+        {
+            if (r.size < minSize) continue;
+            double d = (r.centroid - p).norm ();
+            if (best < 0.0 || d < best)
+            {
+                best = d;
+                region = r;
+            }
+        }
+        return best >= 0.0;
+    }
+
+
+    FrontierSet::Stats FrontierSet::getStats () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        Stats s = stats;
+        s.cells = cells.size ();
+        return s;
+    }
+
+
+    /*! \brief Examines whether a cell is free and has an unknown 6-neighbor. */
+    bool FrontierSet::check (const octomap::OcTree &map, const octomap::OcTreeKey &key) const
+    {
+        octomap::OcTreeNode *node = map.search (key);
+        if (!node || map.isNodeOccupied (node)) return false;
+
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            octomap::OcTreeKey neighbor = key;
+            --neighbor[i];
+            if (!map.search (neighbor)) return true;
+            neighbor[i] += 2;
+            if (!map.search (neighbor)) return true;
+        }
+        return false;
+    }
+
+
+    /*! \brief Gets the center (in meters) of a cell. */
+    octomap::point3d FrontierSet::toCoord (const octomap::OcTreeKey &key) const
+    {
+        return octomap::point3d ((float) (((int) key[0] - keyOffset + 0.5) * resolution), 
+                                 (float) (((int) key[1] - keyOffset + 0.5) * resolution), 
+                                 (float) (((int) key[2] - keyOffset + 0.5) * resolution));
+    }
+
+
+    /*! \brief Groups the cells into 26-connected regions, if they changed since the last time.
+     *  \note It has to be called while holding `mtx`.
+     */
+    void FrontierSet::cluster () const
+    {
+        if (clustered) return;
+
+        regions.clear ();
+        octomap::KeySet visited;
+        std::vector<octomap::OcTreeKey> stack;
+        for (const octomap::OcTreeKey &seed : cells)
+        {
+            if (!visited.insert (seed).second) continue;
+
+            Region r;
+            r.min = r.max = toCoord (seed);
+            r.size = 0;
+            octomap::point3d sum;
+            stack.push_back (seed);
+            while (!stack.empty ())
+            {
+                octomap::OcTreeKey key = stack.back ();
+                stack.pop_back ();
+
+                octomap::point3d p = toCoord (key);
+                sum = sum + p;
+                for (unsigned int i = 0; i < 3; ++i)
+                {
+                    r.min (i) = std::min (r.min (i), p (i));
+                    r.max (i) = std::max (r.max (i), p (i));
+                }
+                ++r.size;
+
+                for (int dx = -1; dx <= 1; ++dx)
+                    for (int dy = -1; dy <= 1; ++dy)
+                        for (int dz = -1; dz <= 1; ++dz)
+                        {
+                            octomap::OcTreeKey n (key[0] + dx, key[1] + dy, key[2] + dz);
+                            if (cells.count (n) && visited.insert (n).second) stack.push_back (n);
+                        }
+            }
+
+            r.centroid = sum * (1.f / r.size);
+            regions.push_back (r);
+        }
+
+        std::sort (regions.begin (), regions.end (), 
+                   [] (const Region &a, const Region &b) { return a.size > b.size; });
+        clustered = true;
+    }
+
+}
+}
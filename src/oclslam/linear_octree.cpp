@@ -0,0 +1,515 @@
+/*! \file linear_octree.cpp
+ *  \brief Defines a pointerless, Morton-ordered copy of the map for bulk queries.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <limits>
+#include <fstream>
+#include <algorithm>
+#include <oclslam/linear_octree.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    namespace
+    {
+
+        const size_t npos = std::numeric_limits<size_t>::max ();
+        const char magic[8] = "OCLLOCT";
+
+
+        /*! \brief Spreads the lower 16 bits of a value, 2 zero bits apart. */
+        inline uint64_t spread (uint64_t v)
+        {
+            v &= 0xFFFF;
+            v = (v | (v << 16)) & 0x0000FF0000FFull;
+            v = (v | (v <<  8)) & 0x00F00F00F00Full;
+            v = (v | (v <<  4)) & 0x0C30C30C30C3ull;
+            v = (v | (v <<  2)) & 0x249249249249ull;
+            return v;
+        }
+
+
+        /*! \brief Gathers every 3rd bit of a value, the inverse of `spread`. */
+        inline uint64_t compact (uint64_t v)
+        {
+            v &= 0x249249249249ull;
+            v = (v | (v >>  2)) & 0x0C30C30C30C3ull;
+            v = (v | (v >>  4)) & 0x00F00F00F00Full;
+            v = (v | (v >>  8)) & 0x0000FF0000FFull;
+            v = (v | (v >> 16)) & 0xFFFF;
+            return v;
+        }
+
+    }
+
+
+    LinearOctree::LinearOctree (unsigned int _blockLevel) : 
+        blockLevel (std::max (std::min (_blockLevel, 15u), 1u)), 
+        resolution (0.0), thresLog (0.f), keyOffset (0)
+    {
+    }
+
+
+    /*! \details The leaves are visited in the order of the map, which is 
+     *           already the Morton order, so the arrays come out sorted.
+     *
+     *  \param[in] map the map. It has to be held for the duration of the call.
+     */
+    void LinearOctree::build (const octomap::OcTree &map)
+    {
+        resolution = map.getResolution ();
+        thresLog = map.getOccupancyThresLog ();
+        keyOffset = 1 << (map.getTreeDepth () - 1);
+
+        size_t n = map.getNumLeafNodes ();
+        codes.clear (); codes.reserve (n);
+        levels.clear (); levels.reserve (n);
+        values.clear (); values.reserve (n);
+
+        for (auto it = map.begin_leafs (), end = map.end_leafs (); it != end; ++it)
+        {
+            codes.push_back (encode (it.getIndexKey ()));
+            levels.push_back ((uint8_t) (map.getTreeDepth () - it.getDepth ()));
+            values.push_back (it->getLogOdds ());
+        }
+
+        // Guard against an iteration order that differs from the Morton order
+        if (!std::is_sorted (codes.begin (), codes.end ()))
+        {
+            std::vector<size_t> order (codes.size ());
+            for (size_t i = 0; i < order.size (); ++i) order[i] = i;
+            std::sort (order.begin (), order.end (), 
+                       [this] (size_t a, size_t b) { return codes[a] < codes[b]; });
+
+            std::vector<uint64_t> c (codes.size ());
+            std::vector<uint8_t> l (levels.size ());
+            std::vector<float> v (values.size ());
+            for (size_t i = 0; i < order.size (); ++i)
+            {
+                c[i] = codes[order[i]];
+                l[i] = levels[order[i]];
+                v[i] = values[order[i]];
+            }
+            codes.swap (c); levels.swap (l); values.swap (v);
+        }
+
+        summarize ();
+    }
+
+
+    size_t LinearOctree::memoryUsage () const
+    {
+        return codes.size () * (sizeof (uint64_t) + sizeof (uint8_t) + sizeof (float)) + 
+               blocks.size () * sizeof (Block);
+    }
+
+
+    /*! \param[in] key key of the cell.
+     *  \param[out] logOdds log-odds of the leaf that contains the cell.
+     *  \return Whether the cell is known.
+     */
+    bool LinearOctree::search (const octomap::OcTreeKey &key, float &logOdds) const
+    {
+        size_t i = find (encode (key));
+        if (i == npos) return false;
+
+        logOdds = values[i];
+        return true;
+    }
+
+
+    /*! \param[in] p point (in meters).
+     *  \param[out] logOdds log-odds of the leaf that contains the point.
+     *  \return Whether the point is known.
+     */
+    bool LinearOctree::search (const octomap::point3d &p, float &logOdds) const
+    {
+        octomap::OcTreeKey key;
+        for (int i = 0; i < 3; ++i)
+        {
+            int k = (int) std::floor (p (i) / resolution) + keyOffset;
+            if (k < 0 || k >= 2 * keyOffset) return false;
+            key[i] = (octomap::key_type) k;
+        }
+
+        return search (key, logOdds);
+    }
+
+
+    /*! \details The points are looked up in the order of their codes, so that 
+     *           every search starts from the leaf that answered the last one, 
+     *           and walks over the arrays once for the whole batch.
+     *
+     *  \param[in] points points (in meters).
+     *  \param[out] logOdds log-odds of every point, or `NAN` for the unknown ones.
+     */
+    void LinearOctree::query (const std::vector<octomap::point3d> &points, std::vector<float> &logOdds) const
+    {
+        logOdds.assign (points.size (), NAN);
+        if (codes.empty ()) return;
+
+        std::vector<std::pair<uint64_t, size_t>> order;
+        order.reserve (points.size ());
+        for (size_t i = 0; i < points.size (); ++i)
+        {
+            octomap::OcTreeKey key;
+            bool inside = true;
+            for (int j = 0; j < 3 && inside; ++j)
+            {
+                int k = (int) std::floor (points[i] (j) / resolution) + keyOffset;
+                inside = (k >= 0 && k < 2 * keyOffset);
+                key[j] = (octomap::key_type) k;
+            }
+            if (inside) order.emplace_back (encode (key), i);
+        }
+        std::sort (order.begin (), order.end ());
+
+        size_t lo = 0;
+        for (const auto &q : order)
+        {
+            size_t i = find (q.first, lo);
+            if (i == npos) continue;
+            logOdds[q.second] = values[i];
+            lo = i;
+        }
+    }
+
+
+    /*! \details The ray is marched cell by cell, as by `OcTree::castRay`, but a 
+     *           block that can't stop it (free, and fully known or with the unknown 
+     *           cells ignored) is crossed in one step.
+     *  \note With no maximum range, a ray that ignores the unknown cells ends 
+     *        where it leaves the bounding box of the leaves.
+     *
+     *  \param[in] origin origin of the ray (in meters).
+     *  \param[in] direction direction of the ray. It doesn't need to be normalized.
+     *  \param[out] end center of the occupied cell that was hit, or of the unknown 
+     *                  cell that stopped the ray, or else the end of the ray.
+     *  \param[in] ignoreUnknown flag to let the ray go through unknown cells.
+     *  \param[in] maxRange maximum length (in meters) of the ray. If negative, 
+     *                      the ray goes on up to the bounds of the map.
+     *  \return Whether an occupied cell was hit.
+     */
+    bool LinearOctree::castRay (const octomap::point3d &origin, const octomap::point3d &direction, 
+                                octomap::point3d &end, bool ignoreUnknown, double maxRange) const
+    {
+        end = origin;
+        if (codes.empty () || direction.norm () == 0.f) return false;
+
+        const double inf = std::numeric_limits<double>::infinity ();
+        const int side = 1 << blockLevel;
+        octomap::point3d dir = direction.normalized ();
+
+        // Everything is in cells, with the origin of the map at keyOffset
+        double o[3], d[3], tMax[3], tDelta[3];
+        int cell[3], step[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            o[i] = origin (i) / resolution + keyOffset;
+            d[i] = dir (i);
+            step[i] = (d[i] > 0.0) ? 1 : ((d[i] < 0.0) ? -1 : 0);
+            tDelta[i] = (step[i] != 0) ? 1.0 / std::fabs (d[i]) : inf;
+        }
+
+        // Length of the ray
+        double tEnd = inf;
+        if (maxRange > 0.0)
+            tEnd = maxRange / resolution;
+        else if (ignoreUnknown)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                if (step[i] > 0) tEnd = std::min (tEnd, (keyMax[i] + 1 - o[i]) / d[i]);
+                else if (step[i] < 0) tEnd = std::min (tEnd, (keyMin[i] - o[i]) / d[i]);
+                else if (o[i] < keyMin[i] || o[i] >= keyMax[i] + 1) tEnd = 0.0;
+            }
+        }
+        auto miss = [&] () -> bool
+        {
+            if (tEnd < inf) end = origin + dir * (float) (tEnd * resolution);
+            return false;
+        };
+        auto center = [&] () -> octomap::point3d
+        {
+            return octomap::point3d ((float) ((cell[0] - keyOffset + 0.5) * resolution), 
+                                     (float) ((cell[1] - keyOffset + 0.5) * resolution), 
+                                     (float) ((cell[2] - keyOffset + 0.5) * resolution));
+        };
+        // Places the ray at a distance t from the origin
+        auto seek = [&] (double t)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                cell[i] = (int) std::floor (o[i] + d[i] * t);
+                tMax[i] = (step[i] != 0) ? (cell[i] + (step[i] > 0) - o[i]) / d[i] : inf;
+            }
+        };
+
+        seek (0.0);
+        uint64_t lastBlock = std::numeric_limits<uint64_t>::max ();
+        while (true)
+        {
+            octomap::OcTreeKey key;
+            for (int i = 0; i < 3; ++i)
+            {
+                if (cell[i] < 0 || cell[i] >= 2 * keyOffset) return miss ();
+                key[i] = (octomap::key_type) cell[i];
+            }
+            uint64_t code = encode (key);
+
+            // Decide once per block whether it can be stepped over
+            uint64_t block = code >> (3 * blockLevel);
+            if (block != lastBlock)
+            {
+                lastBlock = block;
+                bool skip;
+                const Block *b = findBlock (block);
+                if (b != nullptr)
+                    skip = b->maxLogOdds < thresLog && 
+                           (ignoreUnknown || b->cells == (1u << (3 * blockLevel)));
+                else
+                {
+                    // No smaller leaves, so the block is a part of one leaf, or unknown
+                    size_t i = find (block << (3 * blockLevel));
+                    skip = (i == npos) ? ignoreUnknown : values[i] < thresLog;
+                }
+
+                if (skip)
+                {
+                    double tExit = inf;
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        int lo = cell[i] & ~(side - 1);
+                        if (step[i] > 0) tExit = std::min (tExit, (lo + side - o[i]) / d[i]);
+                        else if (step[i] < 0) tExit = std::min (tExit, (lo - o[i]) / d[i]);
+                    }
+                    if (tExit >= tEnd) return miss ();
+                    seek (tExit + 1e-6);
+                    continue;
+                }
+            }
+
+            size_t i = find (code);
+            if (i == npos)
+            {
+                if (!ignoreUnknown)
+                {
+                    end = center ();
+                    return false;
+                }
+            }
+            else if (values[i] >= thresLog)
+            {
+                end = center ();
+                return true;
+            }
+
+            // Step to the next cell, breaking ties like OcTree::castRay
+            int dim = (tMax[0] < tMax[1]) ? ((tMax[0] < tMax[2]) ? 0 : 2) 
+                                          : ((tMax[1] < tMax[2]) ? 1 : 2);
+            if (tMax[dim] >= tEnd) return miss ();
+            cell[dim] += step[dim];
+            tMax[dim] += tDelta[dim];
+        }
+    }
+
+
+    /*! \param[in] origins origins of the rays (in meters).
+     *  \param[in] directions directions of the rays. They don't need to be normalized.
+     *  \param[out] hits result of every ray.
+     *  \param[in] maxRange maximum length (in meters) of the rays. If negative, 
+     *                      the rays go on up to the bounds of the map.
+     *  \param[in] ignoreUnknown flag to let the rays go through unknown cells. 
+     *                           Otherwise, they stop at the first unknown cell.
+     */
+    void LinearOctree::castRays (const std::vector<octomap::point3d> &origins, 
+                                 const std::vector<octomap::point3d> &directions, 
+                                 std::vector<RayHit> &hits, double maxRange, bool ignoreUnknown) const
+    {
+        hits.assign (origins.size (), RayHit { false, octomap::point3d () });
+        for (size_t i = 0; i < origins.size () && i < directions.size (); ++i)
+            hits[i].hit = castRay (origins[i], directions[i], hits[i].end, ignoreUnknown, maxRange);
+    }
+
+
+    /*! \details The block summaries are rebuilt when the octree is read.
+     *
+     *  \param[in] filename path of the file.
+     *  \return Whether the octree was written.
+     */
+    bool LinearOctree::write (const std::string &filename) const
+    {
+        std::ofstream file (filename, std::ios::binary);
+        if (!file) return false;
+
+        uint64_t n = codes.size ();
+        int32_t offset = keyOffset;
+        file.write (magic, sizeof (magic));
+        file.write ((const char *) &resolution, sizeof (resolution));
+        file.write ((const char *) &thresLog, sizeof (thresLog));
+        file.write ((const char *) &offset, sizeof (offset));
+        file.write ((const char *) &n, sizeof (n));
+        file.write ((const char *) codes.data (), n * sizeof (uint64_t));
+        file.write ((const char *) levels.data (), n * sizeof (uint8_t));
+        file.write ((const char *) values.data (), n * sizeof (float));
+
+        return (bool) file;
+    }
+
+
+    /*! \param[in] filename path of a file written by `write`.
+     *  \return Whether the octree was read. Otherwise, it's left unchanged.
+     */
+    bool LinearOctree::read (const std::string &filename)
+    {
+        std::ifstream file (filename, std::ios::binary);
+        char m[sizeof (magic)];
+        if (!file.read (m, sizeof (m)) || !std::equal (m, m + sizeof (m), magic)) return false;
+
+        double res;
+        float thres;
+        int32_t offset;
+        uint64_t n;
+        file.read ((char *) &res, sizeof (res));
+        file.read ((char *) &thres, sizeof (thres));
+        file.read ((char *) &offset, sizeof (offset));
+        if (!file.read ((char *) &n, sizeof (n))) return false;
+
+        std::vector<uint64_t> c (n);
+        std::vector<uint8_t> l (n);
+        std::vector<float> v (n);
+        file.read ((char *) c.data (), n * sizeof (uint64_t));
+        file.read ((char *) l.data (), n * sizeof (uint8_t));
+        if (!file.read ((char *) v.data (), n * sizeof (float))) return false;
+
+        resolution = res;
+        thresLog = thres;
+        keyOffset = offset;
+        codes.swap (c); levels.swap (l); values.swap (v);
+        summarize ();
+
+        return true;
+    }
+
+
+    /*! \param[in] key key of a cell.
+     *  \return The Morton code of the cell, with `x` in the lowest bit.
+     */
+    uint64_t LinearOctree::encode (const octomap::OcTreeKey &key)
+    {
+        return spread (key[0]) | (spread (key[1]) << 1) | (spread (key[2]) << 2);
+    }
+
+
+    /*! \param[in] code Morton code of a cell.
+     *  \return The key of the cell.
+     */
+    octomap::OcTreeKey LinearOctree::decode (uint64_t code)
+    {
+        return octomap::OcTreeKey ((octomap::key_type) compact (code), 
+                                   (octomap::key_type) compact (code >> 1), 
+                                   (octomap::key_type) compact (code >> 2));
+    }
+
+
+    /*! \details The range is narrowed by a couple of interpolation steps, since 
+     *           the codes of a map spread fairly evenly, and then by binary search.
+     *
+     *  \param[in] code Morton code of a cell.
+     *  \param[in] lo index of a leaf with a code no greater than `code`, to start from.
+     *  \return The index of the leaf that contains the cell, or `npos`.
+     */
+    size_t LinearOctree::find (uint64_t code, size_t lo) const
+    {
+        size_t hi = codes.size ();
+        if (lo >= hi || code < codes[lo]) return npos;
+
+        for (int probe = 0; probe < 2 && hi - lo > 64; ++probe)
+        {
+            uint64_t a = codes[lo], b = codes[hi - 1];
+            if (code >= b)
+            {
+                lo = hi - 1;
+                break;
+            }
+            size_t mid = lo + (size_t) ((double) (code - a) / (double) (b - a) * (hi - 1 - lo));
+            if (codes[mid] <= code) lo = mid;
+            else hi = mid;
+        }
+
+        // The last leaf that starts at or before the cell
+        size_t i = std::upper_bound (codes.begin () + lo, codes.begin () + hi, code) - codes.begin () - 1;
+        return (code - codes[i] < (uint64_t (1) << (3 * levels[i]))) ? i : npos;
+    }
+
+
+    /*! \param[in] code Morton code of a block (shifted by `3*blockLevel`).
+     *  \return The summary of the block, or `nullptr` if it has no leaves below `blockLevel`.
+     */
+    const LinearOctree::Block* LinearOctree::findBlock (uint64_t code) const
+    {
+        auto it = std::lower_bound (blocks.begin (), blocks.end (), code, 
+                                    [] (const Block &b, uint64_t c) { return b.code < c; });
+        return (it != blocks.end () && it->code == code) ? &*it : nullptr;
+    }
+
+
+    /*! \details Computes the bounding box of the leaves, and the summaries of 
+     *           the blocks that hold leaves smaller than a block.
+     */
+    void LinearOctree::summarize ()
+    {
+        blocks.clear ();
+        keyMin = octomap::OcTreeKey (0, 0, 0);
+        keyMax = octomap::OcTreeKey (0, 0, 0);
+        if (codes.empty ()) return;
+
+        keyMin = octomap::OcTreeKey (0xFFFF, 0xFFFF, 0xFFFF);
+        for (size_t i = 0; i < codes.size (); ++i)
+        {
+            octomap::OcTreeKey key = decode (codes[i]);
+            for (int j = 0; j < 3; ++j)
+            {
+                keyMin[j] = std::min (keyMin[j], key[j]);
+                keyMax[j] = std::max (keyMax[j], (octomap::key_type) (key[j] + (1 << levels[i]) - 1));
+            }
+
+            if (levels[i] >= blockLevel) continue;
+            uint64_t block = codes[i] >> (3 * blockLevel);
+            if (blocks.empty () || blocks.back ().code != block)
+                blocks.push_back (Block { block, (uint32_t) i, 0, -std::numeric_limits<float>::infinity () });
+            blocks.back ().cells += 1u << (3 * levels[i]);
+            blocks.back ().maxLogOdds = std::max (blocks.back ().maxLogOdds, values[i]);
+        }
+    }
+
+}
+}
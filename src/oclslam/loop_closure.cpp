@@ -0,0 +1,391 @@
+/*! \file loop_closure.cpp
+ *  \brief Defines classes for detecting loop closures and correcting the trajectory.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <eigen3/Eigen/Geometry>
+#include <oclslam/loop_closure.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    namespace
+    {
+        /*! \brief Brings a point (in meters) of a point cloud in the global
+         *         coordinate frame back to the sensor coordinate frame (in mm).
+         *  \return `false` if the point is invalid, i.e. it had no depth.
+         */
+        inline bool toSensorFrame (const float *p, const Pose &invPose, Eigen::Vector3f &out)
+        {
+            Eigen::Vector3d q = invPose * Eigen::Vector3d (1e3 * p[0], 1e3 * p[1], 1e3 * p[2]);
+            out = q.cast<float> ();
+            return std::abs (out[2]) > 10.f;  // Invalid points land on the sensor origin
+        }
+
+        /*! \brief Hashes the cell of a uniform grid that contains a point. */
+        inline int64_t cellKey (int x, int y, int z)
+        {
+            return ((int64_t) (x & 0x1FFFFF) << 42) | ((int64_t) (y & 0x1FFFFF) << 21) | (int64_t) (z & 0x1FFFFF);
+        }
+    }
+
+
+    /*! \param[in] pc3d organized point cloud with 3-D coordinates (in meters) in the global coordinate frame.
+     *  \param[in] width width of the point cloud.
+     *  \param[in] height height of the point cloud.
+     *  \param[in] pose pose with which the point cloud was transformed to the global coordinate frame.
+     *  \param[in] block size (in pixels) of the square blocks averaged into one element of the descriptor.
+     *  \return The descriptor of the point cloud.
+     */
+    std::vector<float> computeDescriptor (const float *pc3d, unsigned int width, unsigned int height,
+                                          const Pose &pose, unsigned int block)
+    {
+        const unsigned int dw = width / block, dh = height / block;
+        std::vector<float> descriptor (dw * dh, 0.f);
+        std::vector<unsigned int> count (dw * dh, 0);
+        Pose invPose = pose.inverse ();
+
+        for (unsigned int y = 0; y < dh * block; ++y)
+        {
+            for (unsigned int x = 0; x < dw * block; ++x)
+            {
+                Eigen::Vector3f p;
+                if (!toSensorFrame (pc3d + 3 * (y * width + x), invPose, p)) continue;
+
+                unsigned int idx = (y / block) * dw + x / block;
+                descriptor[idx] += p[2];
+                count[idx]++;
+            }
+        }
+
+        // Normalize to zero mean and unit length (over the valid blocks)
+        float mean = 0.f; unsigned int valid = 0;
+        for (unsigned int k = 0; k < descriptor.size (); ++k)
+        {
+            if (count[k] == 0) continue;
+            descriptor[k] /= count[k];
+            mean += descriptor[k];
+            valid++;
+        }
+        if (valid == 0) return descriptor;
+        mean /= valid;
+
+        float norm = 0.f;
+        for (unsigned int k = 0; k < descriptor.size (); ++k)
+        {
+            descriptor[k] = (count[k] == 0) ? 0.f : descriptor[k] - mean;
+            norm += descriptor[k] * descriptor[k];
+        }
+        norm = std::sqrt (norm);
+        if (norm > 0.f)
+            for (float &d : descriptor) d /= norm;
+
+        return descriptor;
+    }
+
+
+    /*! \param[in] pc3d organized point cloud with 3-D coordinates (in meters) in the global coordinate frame.
+     *  \param[in] width width of the point cloud.
+     *  \param[in] height height of the point cloud.
+     *  \param[in] pose pose with which the point cloud was transformed to the global coordinate frame.
+     *  \param[in] stride sampling step (in pixels) in both dimensions.
+     *  \return The valid points of the sampled grid, in the sensor coordinate frame (in mm).
+     */
+    std::vector<Eigen::Vector3f> sampleCloud (const float *pc3d, unsigned int width, unsigned int height,
+                                              const Pose &pose, unsigned int stride)
+    {
+        std::vector<Eigen::Vector3f> cloud;
+        cloud.reserve ((width / stride) * (height / stride));
+        Pose invPose = pose.inverse ();
+
+        for (unsigned int y = stride / 2; y < height; y += stride)
+        {
+            for (unsigned int x = stride / 2; x < width; x += stride)
+            {
+                Eigen::Vector3f p;
+                if (toSensorFrame (pc3d + 3 * (y * width + x), invPose, p))
+                    cloud.push_back (p);
+            }
+        }
+
+        return cloud;
+    }
+
+
+    /*! \details Correspondences are found with a nearest neighbor search on a uniform
+     *           grid with cell size equal to the maximum correspondence distance.
+     *
+     *  \param[in] fixed point cloud that stays fixed.
+     *  \param[in] moving point cloud that gets aligned to the fixed one.
+     *  \param[in,out] T initial estimate of the transformation that maps the moving
+     *                   onto the fixed point cloud. It receives the final estimate.
+     *  \param[in] maxDistance maximum distance (in mm) between two corresponding points.
+     *  \param[in] maxIterations maximum number of iterations.
+     *  \param[out] rms root mean square distance (in mm) of the corresponding points.
+     *  \param[out] inlierRatio ratio of moving points that found a correspondence.
+     *  \return `false` if the alignment failed due to lack of correspondences.
+     */
+    bool alignPointClouds (const std::vector<Eigen::Vector3f> &fixed, const std::vector<Eigen::Vector3f> &moving,
+                           Pose &T, float maxDistance, unsigned int maxIterations, float &rms, float &inlierRatio)
+    {
+        rms = std::numeric_limits<float>::max (); inlierRatio = 0.f;
+        if (fixed.size () < 3 || moving.size () < 3) return false;
+
+        const float invCell = 1.f / maxDistance;
+        const float maxDist2 = maxDistance * maxDistance;
+        std::unordered_map<int64_t, std::vector<unsigned int>> grid;
+        for (unsigned int i = 0; i < fixed.size (); ++i)
+        {
+            Eigen::Vector3f c = (fixed[i] * invCell).array ().floor ();
+            grid[cellKey ((int) c[0], (int) c[1], (int) c[2])].push_back (i);
+        }
+
+        Eigen::Matrix3Xd src (3, moving.size ()), dst (3, moving.size ());
+        unsigned int pairs = 0;
+        double sqErr = 0.0;
+
+        for (unsigned int iter = 0; iter <= maxIterations; ++iter)
+        {
+            pairs = 0; sqErr = 0.0;
+
+            for (const Eigen::Vector3f &p : moving)
+            {
+                Eigen::Vector3f q = (T * p.cast<double> ()).cast<float> ();
+                Eigen::Vector3f c = (q * invCell).array ().floor ();
+
+                float best = maxDist2; int bestIdx = -1;
+                for (int dz = -1; dz <= 1; ++dz)
+                    for (int dy = -1; dy <= 1; ++dy)
+                        for (int dx = -1; dx <= 1; ++dx)
+                        {
+                            auto cell = grid.find (cellKey ((int) c[0] + dx, (int) c[1] + dy, (int) c[2] + dz));
+                            if (cell == grid.end ()) continue;
+                            for (unsigned int i : cell->second)
+                            {
+                                float d = (fixed[i] - q).squaredNorm ();
+                                if (d < best) { best = d; bestIdx = i; }
+                            }
+                        }
+
+                if (bestIdx < 0) continue;
+                src.col (pairs) = q.cast<double> ();
+                dst.col (pairs) = fixed[bestIdx].cast<double> ();
+                sqErr += best;
+                pairs++;
+            }
+
+            if (pairs < 3) return false;
+            if (iter == maxIterations) break;
+
+            // Closed-form rigid alignment of the corresponding points
+            Eigen::Matrix4d D = Eigen::umeyama (src.leftCols (pairs), dst.leftCols (pairs), false);
+            Pose dT (D.topLeftCorner<3, 3> (), D.topRightCorner<3, 1> (), 1.0);
+            T = dT * T;
+
+            if (logRotation (dT.R).norm () < 1e-5 && dT.t.norm () < 1e-2) break;
+        }
+
+        rms = std::sqrt (sqErr / pairs);
+        inlierRatio = pairs / (float) moving.size ();
+
+        return true;
+    }
+
+
+    LoopClosure::LoopClosure () :
+        numLoops (0), minSeparation (30), minSimilarity (0.9f),
+        searchRadius (5000.f), maxRMS (25.f), minInlierRatio (0.5f), running (true),
+        worker ([this] { _detect (); })
+    {
+    }
+
+
+    LoopClosure::~LoopClosure ()
+    {
+        {
+            std::lock_guard<std::mutex> lock (kfMtx);
+            running = false;
+        }
+        cv.notify_one ();
+        worker.join ();
+    }
+
+
+    /*! \note The function returns immediately. The keyframe is processed on the detection thread.
+     *
+     *  \param[in] timeStep number of point clouds registered, up to the keyframe.
+     *  \param[in] pose pose estimated by the odometry.
+     *  \param[in] descriptor appearance descriptor (see `computeDescriptor`).
+     *  \param[in] cloud sparse point cloud in the sensor coordinate frame (see `sampleCloud`).
+     *  \return The index of the keyframe.
+     */
+    unsigned int LoopClosure::addKeyframe (unsigned int timeStep, const Pose &pose,
+                                           std::vector<float> &&descriptor, std::vector<Eigen::Vector3f> &&cloud)
+    {
+        unsigned int id;
+        {
+            std::lock_guard<std::mutex> lock (kfMtx);
+            id = keyframes.size ();
+            keyframes.push_back ({ id, timeStep, pose, std::move (descriptor), std::move (cloud) });
+            pending.push_back (id);
+        }
+        cv.notify_one ();
+
+        return id;
+    }
+
+
+    /*! \details The correction is the transformation that takes the latest processed
+     *           keyframe from its odometry pose to its optimized pose.
+     *
+     *  \param[in] pose pose estimated by the odometry.
+     *  \return The corrected pose.
+     */
+    Pose LoopClosure::correct (const Pose &pose)
+    {
+        std::lock_guard<std::mutex> lock (poseMtx);
+        if (corrected.empty ()) return pose;
+
+        return corrected.back () * lastPose.inverse () * pose;
+    }
+
+
+    /*! \return The optimized poses of the processed keyframes. */
+    std::vector<Pose> LoopClosure::getCorrectedPoses ()
+    {
+        std::lock_guard<std::mutex> lock (poseMtx);
+        return corrected;
+    }
+
+
+    size_t LoopClosure::getNumKeyframes ()
+    {
+        std::lock_guard<std::mutex> lock (kfMtx);
+        return keyframes.size ();
+    }
+
+
+    /*! \brief Waits for keyframes and processes them. */
+    void LoopClosure::_detect ()
+    {
+        while (true)
+        {
+            const Keyframe *kf;
+            {
+                std::unique_lock<std::mutex> lock (kfMtx);
+                cv.wait (lock, [this] { return !running || !pending.empty (); });
+                if (!running) return;
+                kf = &keyframes[pending.front ()];
+                pending.pop_front ();
+            }
+
+            _process (*kf);
+        }
+    }
+
+
+    /*! \brief Inserts a keyframe in the pose graph, and looks for a loop closure.
+     *
+     *  \param[in] kf keyframe.
+     */
+    void LoopClosure::_process (const Keyframe &kf)
+    {
+        const unsigned int idx = kf.id;
+        processed.push_back (&kf);
+
+        // Extend the graph with the odometry measurement
+        if (idx == 0)
+        {
+            graph.addNode (kf.pose);
+        }
+        else
+        {
+            const Keyframe &prev = *processed[idx - 1];
+            Pose Z = prev.pose.inverse () * kf.pose;
+            graph.addNode (graph.getPose (idx - 1) * Z);
+            graph.addEdge (idx - 1, idx, Z);
+        }
+
+        // Rank the past keyframes by similarity
+        std::vector<std::pair<float, unsigned int>> candidates;
+        Pose current = graph.getPose (idx);
+        for (unsigned int k = 0; k + minSeparation < idx; ++k)
+        {
+            const Keyframe &other = *processed[k];
+            if (other.descriptor.size () != kf.descriptor.size ()) continue;
+            if (searchRadius > 0.f && (graph.getPose (k).t - current.t).norm () > searchRadius) continue;
+
+            float sim = 0.f;
+            for (unsigned int i = 0; i < kf.descriptor.size (); ++i)
+                sim += kf.descriptor[i] * other.descriptor[i];
+
+            if (sim >= minSimilarity)
+                candidates.emplace_back (sim, k);
+        }
+        std::sort (candidates.begin (), candidates.end (),
+            [] (const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b)
+            { return a.first > b.first; });
+
+        // Verify the best candidates geometrically
+        bool loop = false;
+        for (unsigned int c = 0; c < std::min<size_t> (3, candidates.size ()) && !loop; ++c)
+        {
+            const Keyframe &other = *processed[candidates[c].second];
+
+            Pose Z;  // Similar views start from the identity
+            float rms, inlierRatio;
+            if (!alignPointClouds (other.cloud, kf.cloud, Z, 4.f * maxRMS, 30, rms, inlierRatio)) continue;
+            if (rms > maxRMS || inlierRatio < minInlierRatio) continue;
+
+            graph.addEdge (other.id, idx, Z, inlierRatio);
+            loop = true;
+            numLoops++;
+
+            std::cout << "Loop closure: keyframe " << idx << " -> " << other.id
+                      << " (rms: " << rms << " mm, inliers: " << inlierRatio << ")" << std::endl;
+        }
+
+        if (loop) graph.optimize ();
+
+        // Publish the corrected poses
+        std::lock_guard<std::mutex> lock (poseMtx);
+        corrected.resize (graph.size ());
+        for (unsigned int k = 0; k < graph.size (); ++k)
+            corrected[k] = graph.getPose (k);
+        lastPose = kf.pose;
+    }
+
+}
+}
@@ -0,0 +1,253 @@
+/*! \file map_maintenance.cpp
+ *  \brief Defines a worker that keeps a lazily updated map consistent and compact.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <chrono>
+#include <algorithm>
+#include <oclslam/map_maintenance.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \details The rays lie in the bounding box of the points and the origin.
+     *
+     *  \param[in] pc point cloud.
+     *  \param[in] origin position (in meters) of the sensor.
+     *  \param[in] maxRange range (in meters) the rays are truncated at, or `-1` for none.
+     *  \param[out] min minimum corner (in meters) of the box.
+     *  \param[out] max maximum corner (in meters) of the box.
+     */
+    void computeBounds (const octomap::Pointcloud &pc, const octomap::point3d &origin, double maxRange, 
+                        octomap::point3d &min, octomap::point3d &max)
+    {
+        min = max = origin;
+        for (size_t i = 0; i < pc.size (); ++i)
+        {
+            octomap::point3d p = pc[i];
+            if (maxRange > 0.0 && (p - origin).norm () > maxRange)
+                p = origin + (p - origin).normalized () * (float) maxRange;
+            for (int j = 0; j < 3; ++j)
+            {
+                min (j) = std::min (min (j), p (j));
+                max (j) = std::max (max (j), p (j));
+            }
+        }
+    }
+
+
+    /*! \param[in] _subtreeDepth depth of the subtrees that get recorded and refreshed. 
+     *                           At depth `10`, they are 64 cells on a side.
+     *  \param[in] _budget maximum number of subtrees the worker refreshes in a pass.
+     */
+    MapMaintenance::MapMaintenance (unsigned int _subtreeDepth, size_t _budget) : 
+        subtreeDepth (std::max (_subtreeDepth, 1u)), budget (std::max (_budget, (size_t) 1)), 
+        stats ({ 0, 0, 0, 0, 0 }), map (nullptr), mapMtx (nullptr), running (false)
+    {
+    }
+
+
+    MapMaintenance::~MapMaintenance ()
+    {
+        stop ();
+    }
+
+
+    /*! \param[in] _map the map to maintain. It has to outlive the worker.
+     *  \param[in] _mapMtx mutex that guards the map.
+     *  \param[in] period time (in seconds) between two passes.
+     */
+    void MapMaintenance::start (octomap::OcTree &_map, std::mutex &_mapMtx, double period)
+    {
+        stop ();
+        std::lock_guard<std::mutex> lock (mtx);
+        map = &_map;
+        mapMtx = &_mapMtx;
+        running = true;
+        worker = std::thread (&MapMaintenance::work, this, period);
+    }
+
+
+    void MapMaintenance::stop ()
+    {
+        {
+            std::lock_guard<std::mutex> lock (mtx);
+            running = false;
+        }
+        cv.notify_all ();
+        if (worker.joinable ()) worker.join ();
+    }
+
+
+    /*! \details All the subtrees in the bounding box of the rays get recorded.
+     *  \note It has to be called while holding the map.
+     *
+     *  \param[in] map the map the point cloud was inserted in.
+     *  \param[in] pc point cloud.
+     *  \param[in] origin position (in meters) of the sensor.
+     *  \param[in] maxRange range (in meters) the rays were truncated at, or `-1` for none.
+     */
+    void MapMaintenance::touch (const octomap::OcTree &map, const octomap::Pointcloud &pc, 
+                                const octomap::point3d &origin, double maxRange)
+    {
+        octomap::point3d lo, hi;
+        computeBounds (pc, origin, maxRange, lo, hi);
+        touch (map, lo, hi);
+    }
+
+
+    /*! \note It has to be called while holding the map.
+     *
+     *  \param[in] map the map that was updated.
+     *  \param[in] min minimum corner (in meters) of the box.
+     *  \param[in] max maximum corner (in meters) of the box.
+     */
+    void MapMaintenance::touch (const octomap::OcTree &map, const octomap::point3d &min, const octomap::point3d &max)
+    {
+        octomap::OcTreeKey kLo, kHi;
+        if (!map.coordToKeyChecked (min, kLo) || !map.coordToKeyChecked (max, kHi)) return;
+        kLo = map.adjustKeyAtDepth (kLo, subtreeDepth);
+        kHi = map.adjustKeyAtDepth (kHi, subtreeDepth);
+        unsigned int side = 1 << (map.getTreeDepth () - subtreeDepth);
+
+        std::lock_guard<std::mutex> lock (mtx);
+        for (unsigned int x = kLo[0]; x <= kHi[0]; x += side)
+            for (unsigned int y = kLo[1]; y <= kHi[1]; y += side)
+                for (unsigned int z = kLo[2]; z <= kHi[2]; z += side)
+                    pending.insert (octomap::OcTreeKey (x, y, z));
+    }
+
+
+    /*! \details Every subtree gets its inner occupancy recomputed bottom-up, 
+     *           and its collapsible nodes pruned, and then the same happens 
+     *           for their ancestors, level by level, up to the root.
+     *  \note It has to be called while holding the map.
+     *
+     *  \param[in,out] map the map to refresh.
+     *  \param[in] _budget maximum number of subtrees to refresh, or `0` for all of them.
+     *  \return The number of subtrees refreshed.
+     */
+    size_t MapMaintenance::run (octomap::OcTree &map, size_t _budget)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        std::vector<octomap::OcTreeKey> keys;
+        for (auto it = pending.begin (); it != pending.end () && (_budget == 0 || keys.size () < _budget); )
+        {
+            keys.push_back (*it);
+            it = pending.erase (it);
+        }
+
+        size_t pruned = 0;
+        std::vector<octomap::KeySet> ancestors (subtreeDepth);
+        for (const octomap::OcTreeKey &key : keys)
+        {
+            octomap::OcTreeNode *node = map.search (key, subtreeDepth);
+            if (node) pruned += refresh (map, node);
+            for (unsigned int d = 0; d < subtreeDepth; ++d)
+                ancestors[d].insert (map.adjustKeyAtDepth (key, d));
+        }
+
+        for (int d = subtreeDepth - 1; d >= 0; --d)
+            for (const octomap::OcTreeKey &key : ancestors[d])
+            {
+                // A search stops early at a leaf, which needs no refresh
+                octomap::OcTreeNode *node = (d > 0) ? map.search (key, d) : map.getRoot ();
+                if (!node || !map.nodeHasChildren (node)) continue;
+                node->updateOccupancyChildren ();
+                if (map.pruneNode (node)) ++pruned;
+            }
+
+        ++stats.passes;
+        stats.subtrees += keys.size ();
+        stats.pruned += pruned;
+        stats.nodes = map.size ();
+        stats.memory = map.size () * map.memoryUsageNode ();
+        return keys.size ();
+    }
+
+
+    size_t MapMaintenance::getPending () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return pending.size ();
+    }
+
+
+    MapMaintenance::Stats MapMaintenance::getStats () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return stats;
+    }
+
+
+    /*! \param[in,out] map the map the node belongs to.
+     *  \param[in,out] node root of the subtree.
+     *  \return The number of nodes collapsed.
+     */
+    size_t MapMaintenance::refresh (octomap::OcTree &map, octomap::OcTreeNode *node)
+    {
+        if (!map.nodeHasChildren (node)) return 0;
+
+        size_t pruned = 0;
+        for (unsigned int i = 0; i < 8; ++i)
+            if (map.nodeChildExists (node, i))
+                pruned += refresh (map, map.getNodeChild (node, i));
+
+        node->updateOccupancyChildren ();
+        if (map.pruneNode (node)) ++pruned;
+
+        return pruned;
+    }
+
+
+    /*! \details The map is taken only if it's free. Otherwise, the pass 
+     *           is postponed until the next period.
+     *
+     *  \param[in] period time (in seconds) between two passes.
+     */
+    void MapMaintenance::work (double period)
+    {
+        auto interval = std::chrono::microseconds ((long long) (period * 1e6));
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock (mtx);
+                cv.wait_for (lock, interval, [this] { return !running; });
+                if (!running) return;
+                if (pending.empty ()) continue;
+            }
+
+            std::unique_lock<std::mutex> mapLock (*mapMtx, std::try_to_lock);
+            if (mapLock.owns_lock ()) run (*map, budget);
+        }
+    }
+
+}
+}
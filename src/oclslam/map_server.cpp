@@ -0,0 +1,239 @@
+/*! \file map_server.cpp
+ *  \brief Defines a server that publishes snapshots of the map for concurrent queries.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <oclslam/map_server.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \param[in] period minimum time (in seconds) between two snapshots.
+     */
+    MapServer::MapServer (double period) : 
+        latest ({ nullptr, 0 }), recording (false), period (period)
+    {
+    }
+
+
+    /*! \details The first call turns on the change detection of the map, and 
+     *           copies it, which is the only time the whole map is copied while 
+     *           held. The rest read the occupancy of the cells that changed since 
+     *           the change detection was last reset. The change detection isn't 
+     *           reset here, and a cell that's recorded twice does no harm.
+     *  \note It has to be called while holding the map, before any of its 
+     *        changed cells is deleted, and before any consumer resets the change 
+     *        detection. The nodes that get deleted have to be given to `erase`.
+     *
+     *  \param[in,out] map the live map.
+     */
+    void MapServer::record (octomap::OcTree &map)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        if (!recording)
+        {
+            map.enableChangeDetection (true);
+            spare.reset (new octomap::OcTree (map));
+            recording = true;
+            return;
+        }
+
+        pending.reserve (pending.size () + map.numChangesDetected ());
+        for (auto it = map.changedKeysBegin (), end = map.changedKeysEnd (); it != end; ++it)
+        {
+            const octomap::OcTreeNode *node = map.search (it->first);
+            if (node != nullptr)
+                pending.push_back ({ it->first, 0, node->getLogOdds (), false });
+            else
+                pending.push_back ({ it->first, 0, 0.f, true });
+        }
+    }
+
+
+    /*! \param[in] nodes keys and depths of the deleted nodes.
+     */
+    void MapServer::erase (const std::vector<std::pair<octomap::OcTreeKey, unsigned int>> &nodes)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!recording) return;
+
+        for (const auto &node : nodes)
+            pending.push_back ({ node.first, node.second, 0.f, true });
+    }
+
+
+    /*! \details The recorded changes are applied to the previous snapshot, if no 
+     *           reader holds it anymore, or to a copy of the latest one, and the 
+     *           result replaces the latest snapshot for any new readers, while 
+     *           the readers that hold the previous one keep using it. It doesn't 
+     *           need the map, so it's called after the map has been released.
+     *
+     *  \param[in] force flag to publish regardless of the period.
+     *  \return `true` if a snapshot was published.
+     */
+    bool MapServer::publish (bool force)
+    {
+        std::lock_guard<std::mutex> publishLock (publishMtx);
+
+        Clock::time_point now = Clock::now ();
+        std::vector<Change> changes;
+        {
+            std::lock_guard<std::mutex> lock (mtx);
+            if (!recording) return false;
+            if (!force && latest.map && now - lastPublished < period) return false;
+            changes.swap (pending);
+        }
+
+        // Only the publications touch `current`, `spare`, and `lag`
+        std::shared_ptr<octomap::OcTree> tree;
+        if (spare && spare.use_count () == 1)
+        {
+            tree.swap (spare);
+            apply (*tree, lag);
+        }
+        else
+            tree.reset (new octomap::OcTree (*current));
+        apply (*tree, changes);
+
+        std::lock_guard<std::mutex> lock (mtx);
+        spare = current;
+        current = tree;
+        lag.swap (changes);
+        latest = { current, latest.epoch + 1 };
+        lastPublished = now;
+        return true;
+    }
+
+
+    MapServer::Snapshot MapServer::getSnapshot () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return latest;
+    }
+
+
+    /*! \param[in] _period minimum time (in seconds) between two snapshots.
+     */
+    void MapServer::setPeriod (double _period)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        period = std::chrono::duration<double> (_period);
+    }
+
+
+    /*! \param[in] points points to look up (in meters).
+     *  \param[out] states occupancy at every point. Points outside 
+     *                     the map, or before the first snapshot, are unknown.
+     *  \return The epoch of the snapshot that was queried.
+     */
+    uint64_t MapServer::queryOccupancy (const std::vector<octomap::point3d> &points, 
+                                        std::vector<Occupancy> &states) const
+    {
+        Snapshot snap = getSnapshot ();
+        states.assign (points.size (), Occupancy::UNKNOWN);
+        if (!snap.map) return snap.epoch;
+
+        for (size_t i = 0; i < points.size (); ++i)
+        {
+            const octomap::OcTreeNode *node = snap.map->search (points[i]);
+            if (node != nullptr)
+                states[i] = snap.map->isNodeOccupied (node) ? Occupancy::OCCUPIED : Occupancy::FREE;
+        }
+
+        return snap.epoch;
+    }
+
+
+    /*! \param[in] origins origins of the rays (in meters).
+     *  \param[in] directions directions of the rays. They don't need to be normalized.
+     *  \param[out] hits result of every ray.
+     *  \param[in] maxRange maximum length (in meters) of the rays. If negative, 
+     *                      the rays go on up to the bounds of the map.
+     *  \param[in] ignoreUnknown flag to let the rays go through unknown cells. 
+     *                           Otherwise, they stop at the first unknown cell.
+     *  \return The epoch of the snapshot that was queried.
+     */
+    uint64_t MapServer::castRays (const std::vector<octomap::point3d> &origins, 
+                                  const std::vector<octomap::point3d> &directions, 
+                                  std::vector<RayHit> &hits, double maxRange, bool ignoreUnknown) const
+    {
+        Snapshot snap = getSnapshot ();
+        hits.assign (origins.size (), RayHit { false, octomap::point3d () });
+        if (!snap.map) return snap.epoch;
+
+        for (size_t i = 0; i < origins.size () && i < directions.size (); ++i)
+            hits[i].hit = snap.map->castRay (origins[i], directions[i], hits[i].end, ignoreUnknown, maxRange);
+
+        return snap.epoch;
+    }
+
+
+    /*! \param[in] min minimum corner of the box (in meters).
+     *  \param[in] max maximum corner of the box (in meters).
+     *  \param[out] leaves leaves within the box.
+     *  \param[in] occupiedOnly flag to collect only the occupied leaves.
+     *  \return The epoch of the snapshot that was queried.
+     */
+    uint64_t MapServer::queryBox (const octomap::point3d &min, const octomap::point3d &max, 
+                                  std::vector<Leaf> &leaves, bool occupiedOnly) const
+    {
+        Snapshot snap = getSnapshot ();
+        leaves.clear ();
+        if (!snap.map) return snap.epoch;
+
+        for (auto it = snap.map->begin_leafs_bbx (min, max), end = snap.map->end_leafs_bbx (); it != end; ++it)
+        {
+            if (occupiedOnly && !snap.map->isNodeOccupied (*it)) continue;
+            leaves.push_back ({ it.getCoordinate (), it.getSize (), it->getLogOdds () });
+        }
+
+        return snap.epoch;
+    }
+
+
+    /*! \details The ancestors of every node that's set get updated, and pruned 
+     *           if possible, so the cost follows the number of changes.
+     *
+     *  \param[in,out] tree the tree to change.
+     *  \param[in] changes the changes, in the order they happened.
+     */
+    void MapServer::apply (octomap::OcTree &tree, const std::vector<Change> &changes)
+    {
+        for (const Change &change : changes)
+        {
+            if (change.erased)
+                tree.deleteNode (change.key, change.depth);
+            else
+                tree.setNodeValue (change.key, change.logOdds);
+        }
+    }
+
+}
+}
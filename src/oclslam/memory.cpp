@@ -0,0 +1,291 @@
+/*! \file memory.cpp
+ *  \brief Defines classes for managing the device memory of the pipeline.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <oclslam/memory.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \param[in] _context context on which the buffers get allocated.
+     *  \param[in] _flags flags with which the buffers get allocated.
+     */
+    BufferPool::BufferPool (const cl::Context &_context, cl_mem_flags _flags) : 
+        context (_context), flags (_flags), allocated (0), inUse (0), allocations (0)
+    {
+    }
+
+
+    /*! \details Sizes up to 4 KB form a single class. Above that, every 
+     *           interval \f$ [2^k, 2^{k+1}) \f$ is split into four classes.
+     *
+     *  \param[in] size requested size in bytes.
+     *  \return The size class.
+     */
+    size_t BufferPool::getSizeClass (size_t size)
+    {
+        const size_t minClass = 4096;
+        if (size <= minClass) return minClass;
+
+        size_t p = minClass;
+        while (p <= size / 2) p *= 2;  // Highest power of 2 that is not greater than size
+        size_t step = p / 4;
+
+        return (size + step - 1) / step * step;
+    }
+
+
+    /*! \param[in] size requested size in bytes.
+     *  \return A buffer of the size class of `size`.
+     */
+    cl::Buffer BufferPool::acquire (size_t size)
+    {
+        size_t sc = getSizeClass (size);
+        std::lock_guard<std::mutex> lock (mtx);
+
+        cl::Buffer buffer;
+        std::vector<cl::Buffer> &bin = freeBuffers[sc];
+        if (bin.empty ())
+        {
+            buffer = cl::Buffer (context, flags, sc);
+            allocated += sc;
+            allocations++;
+        }
+        else
+        {
+            buffer = bin.back ();
+            bin.pop_back ();
+        }
+
+        usedBuffers[buffer ()] = sc;
+        inUse += sc;
+
+        return buffer;
+    }
+
+
+    /*! \note Releasing a buffer that didn't come from the pool has no effect.
+     *
+     *  \param[in] buffer buffer to return to the pool.
+     */
+    void BufferPool::release (const cl::Buffer &buffer)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        auto it = usedBuffers.find (buffer ());
+        if (it == usedBuffers.end ()) return;
+
+        freeBuffers[it->second].push_back (buffer);
+        inUse -= it->second;
+        usedBuffers.erase (it);
+    }
+
+
+    void BufferPool::trim ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        for (auto &bin : freeBuffers)
+            allocated -= bin.first * bin.second.size ();
+        freeBuffers.clear ();
+    }
+
+
+    size_t BufferPool::getAllocatedSize ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return allocated;
+    }
+
+
+    size_t BufferPool::getInUseSize ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return inUse;
+    }
+
+
+    unsigned int BufferPool::getAllocations ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return allocations;
+    }
+
+
+    /*! \details A buffer that was assigned by the user is left as is. 
+     *           So is a buffer created earlier, if it's large enough.
+     *  \note Host-visible buffers (`CL_MEM_ALLOC_HOST_PTR`) don't come from the pool.
+     *
+     *  \param[in,out] buffer buffer to check, and (re)assign if necessary.
+     *  \param[in] context context on which to allocate, when there is no pool.
+     *  \param[in] flags flags with which to allocate, when there is no pool.
+     *  \param[in] size requested size in bytes.
+     */
+    void PooledBuffers::ensure (cl::Buffer &buffer, const cl::Context &context, cl_mem_flags flags, size_t size)
+    {
+        auto it = std::find_if (owned.begin (), owned.end (), 
+            [&] (const std::pair<cl::Buffer, size_t> &o) { return o.first () == buffer (); });
+
+        if (it == owned.end ())
+        {
+            if (buffer () != nullptr) return;
+        }
+        else
+        {
+            if (it->second >= size) return;
+            if (pool != nullptr) pool->release (it->first);
+            owned.erase (it);
+        }
+
+        if (pool == nullptr || (flags & CL_MEM_ALLOC_HOST_PTR))
+        {
+            buffer = cl::Buffer (context, flags, size);
+            owned.emplace_back (buffer, size);
+        }
+        else
+        {
+            buffer = pool->acquire (size);
+            owned.emplace_back (buffer, BufferPool::getSizeClass (size));
+        }
+    }
+
+
+    void PooledBuffers::releaseAll ()
+    {
+        if (pool != nullptr)
+            for (auto &o : owned)
+                pool->release (o.first);
+        owned.clear ();
+    }
+
+
+    /*! \param[in] size size of the buffer in bytes.
+     *  \param[in] first step that writes the buffer.
+     *  \param[in] last last step that reads the buffer.
+     *  \return The id of the buffer, to be used with `get` after the call to `plan`.
+     */
+    unsigned int BufferPlanner::add (size_t size, unsigned int first, unsigned int last)
+    {
+        buffers.push_back ({ size, first, std::max (first, last) });
+        return buffers.size () - 1;
+    }
+
+
+    /*! \param[in] pool pool from which to acquire the slots.
+     */
+    void BufferPlanner::plan (BufferPool &pool)
+    {
+        assignment = assignSlots (buffers, slotSizes);
+
+        slots.clear ();
+        for (size_t size : slotSizes)
+            slots.push_back (pool.acquire (size));
+    }
+
+
+    /*! \param[in] pool pool to which to return the slots.
+     */
+    void BufferPlanner::release (BufferPool &pool)
+    {
+        for (cl::Buffer &slot : slots)
+            pool.release (slot);
+
+        buffers.clear ();
+        assignment.clear ();
+        slotSizes.clear ();
+        slots.clear ();
+    }
+
+
+    size_t BufferPlanner::getRequestedSize ()
+    {
+        size_t size = 0;
+        for (const Interval &b : buffers) size += b.size;
+        return size;
+    }
+
+
+    size_t BufferPlanner::getPlannedSize ()
+    {
+        return std::accumulate (slotSizes.begin (), slotSizes.end (), (size_t) 0);
+    }
+
+
+    /*! \details The buffers are placed in decreasing order of size. Every buffer goes 
+     *           to the smallest slot whose buffers are all dead during its interval, 
+     *           or to a new slot if there isn't one. Since the larger buffers are placed 
+     *           first, a slot never has to grow.
+     *
+     *  \param[in] buffers sizes and intervals of the buffers.
+     *  \param[out] slotSizes size of every slot.
+     *  \return The slot of every buffer.
+     */
+    std::vector<unsigned int> BufferPlanner::assignSlots (const std::vector<Interval> &buffers, 
+                                                          std::vector<size_t> &slotSizes)
+    {
+        std::vector<unsigned int> order (buffers.size ());
+        std::iota (order.begin (), order.end (), 0);
+        std::stable_sort (order.begin (), order.end (), [&] (unsigned int a, unsigned int b) {
+            return buffers[a].size > buffers[b].size;
+        });
+
+        std::vector<unsigned int> assignment (buffers.size ());
+        std::vector<std::vector<unsigned int>> members;
+        slotSizes.clear ();
+
+        for (unsigned int b : order)
+        {
+            const Interval &ib = buffers[b];
+            int best = -1;
+            for (unsigned int s = 0; s < members.size (); ++s)
+            {
+                bool disjoint = std::all_of (members[s].begin (), members[s].end (), [&] (unsigned int o) {
+                    return buffers[o].last < ib.first || ib.last < buffers[o].first;
+                });
+                if (disjoint && (best < 0 || slotSizes[s] < slotSizes[best])) best = s;
+            }
+
+            if (best < 0)
+            {
+                best = members.size ();
+                members.emplace_back ();
+                slotSizes.push_back (ib.size);
+            }
+            members[best].push_back (b);
+            assignment[b] = best;
+        }
+
+        return assignment;
+    }
+
+}
+}
@@ -0,0 +1,266 @@
+/*! \file occupancy_grid.cpp
+ *  \brief Defines a 2-D occupancy grid that follows a height band of the map.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <oclslam/occupancy_grid.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \param[in] _tileSize side (in cells) of the tiles. */
+    OccupancyGrid2D::OccupancyGrid2D (unsigned int _tileSize) : 
+        tileSize (std::max (_tileSize, 1u)), axis (2), bandMin (0.0), bandMax (0.0), 
+        enabled (false), resolution (0.0), keyOffset (0), stats ({ 0, 0, 0 })
+    {
+    }
+
+
+    /*! \details The grid gets cleared. Only the columns 
+     *           touched from then on get computed.
+     *
+     *  \param[in] _min lower end (in meters) of the band.
+     *  \param[in] _max upper end (in meters) of the band.
+     *  \param[in] _axis axis (`0`, `1`, or `2`) along which the band is measured.
+     */
+    void OccupancyGrid2D::setBand (double _min, double _max, unsigned int _axis)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        bandMin = _min;
+        bandMax = _max;
+        axis = _axis % 3;
+        enabled = bandMax > bandMin;
+        pending.clear ();
+        tiles.clear ();
+        dirty.clear ();
+    }
+
+
+    bool OccupancyGrid2D::isEnabled () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return enabled;
+    }
+
+
+    /*! \details Only the extent of the box across the band matters.
+     *
+     *  \param[in] min minimum corner (in meters) of the box.
+     *  \param[in] max maximum corner (in meters) of the box.
+     */
+    void OccupancyGrid2D::touch (const octomap::point3d &min, const octomap::point3d &max)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (enabled) pending.push_back (std::make_pair (min, max));
+    }
+
+
+    /*! \details The leaves of the map within the band and the recorded boxes 
+     *           are visited once. A pruned leaf sets all the columns it covers.
+     *  \note It has to be called while holding the map.
+     *
+     *  \param[in] map the map.
+     *  \return The number of columns recomputed.
+     */
+    size_t OccupancyGrid2D::update (const octomap::OcTree &map)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!enabled || pending.empty ()) return 0;
+
+        resolution = map.getResolution ();
+        keyOffset = 1 << (map.getTreeDepth () - 1);
+        const unsigned int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        const int T = tileSize;
+
+        size_t columns = 0;
+        std::vector<int8_t> state;
+        for (const auto &box : pending)
+        {
+            octomap::point3d lo = box.first, hi = box.second;
+            lo (axis) = (float) bandMin;
+            hi (axis) = (float) bandMax;
+            octomap::OcTreeKey kLo, kHi;
+            if (!map.coordToKeyChecked (lo, kLo) || !map.coordToKeyChecked (hi, kHi)) continue;
+
+            const int nu = kHi[u] - kLo[u] + 1, nv = kHi[v] - kLo[v] + 1;
+            state.assign (nu * nv, UNKNOWN);
+            for (auto it = map.begin_leafs_bbx (kLo, kHi), end = map.end_leafs_bbx (); it != end; ++it)
+            {
+                const int span = 1 << (map.getTreeDepth () - it.getDepth ());
+                const octomap::OcTreeKey base = it.getIndexKey ();
+                const int8_t value = map.isNodeOccupied (*it) ? OCCUPIED : FREE;
+                const int u0 = std::max ((int) base[u], (int) kLo[u]), u1 = std::min ((int) base[u] + span - 1, (int) kHi[u]);
+                const int v0 = std::max ((int) base[v], (int) kLo[v]), v1 = std::min ((int) base[v] + span - 1, (int) kHi[v]);
+                for (int j = v0; j <= v1; ++j)
+                    for (int i = u0; i <= u1; ++i)
+                    {
+                        int8_t &c = state[(j - kLo[v]) * nu + (i - kLo[u])];
+                        if (value == OCCUPIED || c == UNKNOWN) c = value;
+                    }
+            }
+
+            for (int j = 0; j < nv; ++j)
+                for (int i = 0; i < nu; ++i)
+                {
+                    const int8_t s = state[j * nu + i];
+                    const int cu = kLo[u] + i - keyOffset, cv = kLo[v] + j - keyOffset;
+                    TileIndex idx = getTileIndex (cu, cv);
+                    auto t = tiles.find (idx);
+                    if (t == tiles.end ())
+                    {
+                        if (s == UNKNOWN) continue;
+                        t = tiles.insert (std::make_pair (idx, std::vector<int8_t> (T * T, UNKNOWN))).first;
+                    }
+                    int8_t &cell = t->second[(cv - idx.second * T) * T + (cu - idx.first * T)];
+                    if (cell == s) continue;
+                    cell = s;
+                    dirty.insert (idx);
+                }
+            columns += nu * nv;
+        }
+
+        pending.clear ();
+        ++stats.updates;
+        stats.columns += columns;
+        return columns;
+    }
+
+
+    /*! \param[in] p point (in meters). Its coordinate along the axis of the band is ignored.
+     *  \return The value of the column.
+     */
+    OccupancyGrid2D::Cell OccupancyGrid2D::getCell (const octomap::point3d &p) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (resolution == 0.0) return UNKNOWN;
+
+        const unsigned int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        const int T = tileSize;
+        const int cu = (int) std::floor (p (u) / resolution), cv = (int) std::floor (p (v) / resolution);
+        TileIndex idx = getTileIndex (cu, cv);
+        auto t = tiles.find (idx);
+        if (t == tiles.end ()) return UNKNOWN;
+        return (Cell) t->second[(cv - idx.second * T) * T + (cu - idx.first * T)];
+    }
+
+
+    /*! \details The array covers all the tiles of the grid, and 
+     *           the columns that were never computed are unknown.
+     *
+     *  \param[out] cells the columns, row by row, along the second axis of the grid.
+     *  \param[out] width number of columns in a row.
+     *  \param[out] height number of rows.
+     *  \param[out] originU position (in meters) of the first column, along the first axis of the grid.
+     *  \param[out] originV position (in meters) of the first column, along the second axis of the grid.
+     *  \return `false` if the grid is empty.
+     */
+    bool OccupancyGrid2D::getGrid (std::vector<int8_t> &cells, unsigned int &width, unsigned int &height, 
+                                   double &originU, double &originV) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (tiles.empty ()) return false;
+
+        int tuMin = tiles.begin ()->first.first, tuMax = tuMin;
+        int tvMin = tiles.begin ()->first.second, tvMax = tvMin;
+        for (const auto &t : tiles)
+        {
+            tuMin = std::min (tuMin, t.first.first);
+            tuMax = std::max (tuMax, t.first.first);
+            tvMin = std::min (tvMin, t.first.second);
+            tvMax = std::max (tvMax, t.first.second);
+        }
+
+        const int T = tileSize;
+        width = (tuMax - tuMin + 1) * T;
+        height = (tvMax - tvMin + 1) * T;
+        originU = tuMin * T * resolution;
+        originV = tvMin * T * resolution;
+        cells.assign (width * height, UNKNOWN);
+        for (const auto &t : tiles)
+        {
+            const int x = (t.first.first - tuMin) * T, y = (t.first.second - tvMin) * T;
+            for (int j = 0; j < T; ++j)
+                std::copy (t.second.begin () + j * T, t.second.begin () + (j + 1) * T, 
+                           cells.begin () + (y + j) * width + x);
+        }
+
+        return true;
+    }
+
+
+    /*! \param[in] idx index of the tile.
+     *  \param[out] cells the columns of the tile, row by row, along the second axis of the grid.
+     *  \param[out] originU position (in meters) of the first column, along the first axis of the grid.
+     *  \param[out] originV position (in meters) of the first column, along the second axis of the grid.
+     *  \return `false` if the tile doesn't exist.
+     */
+    bool OccupancyGrid2D::getTile (const TileIndex &idx, std::vector<int8_t> &cells, 
+                                   double &originU, double &originV) const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        auto t = tiles.find (idx);
+        if (t == tiles.end ()) return false;
+
+        cells = t->second;
+        originU = idx.first * (int) tileSize * resolution;
+        originV = idx.second * (int) tileSize * resolution;
+        return true;
+    }
+
+
+    std::vector<OccupancyGrid2D::TileIndex> OccupancyGrid2D::takeDirtyTiles ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        std::vector<TileIndex> indices (dirty.begin (), dirty.end ());
+        dirty.clear ();
+        return indices;
+    }
+
+
+    OccupancyGrid2D::Stats OccupancyGrid2D::getStats () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        Stats s = stats;
+        s.tiles = tiles.size ();
+        return s;
+    }
+
+
+    /*! \brief Gets the index of the tile that contains a column. */
+    OccupancyGrid2D::TileIndex OccupancyGrid2D::getTileIndex (int u, int v) const
+    {
+        const int T = tileSize;
+        return TileIndex ((u >= 0) ? u / T : -((-u - 1) / T) - 1, 
+                          (v >= 0) ? v / T : -((-v - 1) / T) - 1);
+    }
+
+}
+}
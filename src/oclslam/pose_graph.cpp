@@ -0,0 +1,251 @@
+/*! \file pose_graph.cpp
+ *  \brief Defines classes for representing and optimizing a graph of poses.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <eigen3/Eigen/Sparse>
+#include <oclslam/pose_graph.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \param[in] T pose.
+     *  \param[in] delta increment. The rotation, \f$ \omega \f$, is given in axis-angle
+     *                   representation and is applied on the left. The translation,
+     *                   \f$ \nu \f$, is added to the translation vector. The scale is
+     *                   multiplied by \f$ e^{\sigma} \f$.
+     *  \return The perturbed pose.
+     */
+    Pose perturb (const Pose &T, const Eigen::Matrix<double, 7, 1> &delta)
+    {
+        Eigen::Vector3d w = delta.head<3> ();
+        double angle = w.norm ();
+
+        Pose P (T);
+        if (angle > 0.0)
+            P.R = Eigen::AngleAxisd (angle, w / angle).toRotationMatrix () * T.R;
+        P.t = T.t + delta.segment<3> (3);
+        P.s = T.s * std::exp (delta[6]);
+
+        return P;
+    }
+
+
+    /*! \param[in] R rotation matrix.
+     *  \return The rotation axis scaled by the rotation angle (in radians).
+     */
+    Eigen::Vector3d logRotation (const Eigen::Matrix3d &R)
+    {
+        Eigen::AngleAxisd aa (R);
+        return aa.angle () * aa.axis ();
+    }
+
+
+    /*! \param[in] wR information assigned to the rotation component of a residual (in \f$ rad^{-2} \f$).
+     *  \param[in] wT information assigned to the translation component of a residual (in \f$ mm^{-2} \f$).
+     *  \param[in] wS information assigned to the (logarithmic) scale component of a residual.
+     */
+    PoseGraph::PoseGraph (double wR, double wT, double wS)
+    {
+        info << wR, wR, wR, wT, wT, wT, wS;
+    }
+
+
+    /*! \param[in] pose initial estimate of the absolute pose of the node.
+     *  \return The index of the new node.
+     */
+    unsigned int PoseGraph::addNode (const Pose &pose)
+    {
+        nodes.push_back (pose);
+        return nodes.size () - 1;
+    }
+
+
+    /*! \param[in] i index of the first node.
+     *  \param[in] j index of the second node.
+     *  \param[in] Z measurement of the relative pose, \f$ Z_{ij} = T_i^{-1} \circ T_j \f$.
+     *  \param[in] weight scaling of the information of the measurement.
+     */
+    void PoseGraph::addEdge (unsigned int i, unsigned int j, const Pose &Z, double weight)
+    {
+        if (i >= nodes.size () || j >= nodes.size () || i == j)
+            return;
+
+        edges.push_back ({ i, j, Z, weight });
+    }
+
+
+    /*! \details The residual is the 7-D error of \f$ Z_{ij}^{-1} \circ T_i^{-1} \circ T_j \f$.
+     *
+     *  \param[in] edge relative pose measurement.
+     *  \param[in] Ti pose of node \f$ i \f$.
+     *  \param[in] Tj pose of node \f$ j \f$.
+     *  \return The residual of the edge.
+     */
+    PoseGraph::Vector7d PoseGraph::residual (const Edge &edge, const Pose &Ti, const Pose &Tj) const
+    {
+        Pose E = edge.Z.inverse () * Ti.inverse () * Tj;
+
+        Vector7d r;
+        r.head<3> () = logRotation (E.R);
+        r.segment<3> (3) = E.t;
+        r[6] = std::log (E.s);
+
+        return r;
+    }
+
+
+    /*! \return The sum of the weighted squared residuals of all the edges. */
+    double PoseGraph::error () const
+    {
+        double err = 0.0;
+        for (const Edge &edge : edges)
+        {
+            Vector7d r = residual (edge, nodes[edge.i], nodes[edge.j]);
+            err += edge.weight * r.dot (info.cwiseProduct (r));
+        }
+
+        return err;
+    }
+
+
+    /*! \details The Jacobians of the residuals are evaluated numerically.
+     *           The normal equations are sparse and are solved with a
+     *           Cholesky (LDLT) factorization.
+     *
+     *  \param[in] maxIterations maximum number of Levenberg-Marquardt iterations.
+     *  \return The final error of the graph.
+     */
+    double PoseGraph::optimize (unsigned int maxIterations)
+    {
+        if (nodes.size () < 2 || edges.empty ())
+            return error ();
+
+        const unsigned int N = 7 * (nodes.size () - 1);  // Node 0 is fixed
+        const double eps = 1e-6;
+        double lambda = 1e-4;
+        double err = error ();
+
+        for (unsigned int iter = 0; iter < maxIterations; ++iter)
+        {
+            std::vector<Eigen::Triplet<double>> triplets;
+            triplets.reserve (4 * 49 * edges.size () + N);
+            Eigen::VectorXd b = Eigen::VectorXd::Zero (N);
+
+            for (unsigned int k = 0; k < N; ++k)
+                triplets.emplace_back (k, k, 1e-9);
+
+            for (const Edge &edge : edges)
+            {
+                const Pose &Ti = nodes[edge.i];
+                const Pose &Tj = nodes[edge.j];
+                Vector7d r = residual (edge, Ti, Tj);
+
+                Eigen::Matrix<double, 7, 7> Ji, Jj;
+                for (int k = 0; k < 7; ++k)
+                {
+                    Vector7d d = Vector7d::Zero (); d[k] = eps;
+                    Ji.col (k) = (residual (edge, perturb (Ti, d), Tj) -
+                                  residual (edge, perturb (Ti, -d), Tj)) / (2.0 * eps);
+                    Jj.col (k) = (residual (edge, Ti, perturb (Tj, d)) -
+                                  residual (edge, Ti, perturb (Tj, -d))) / (2.0 * eps);
+                }
+
+                Vector7d W = edge.weight * info;
+                const Eigen::Matrix<double, 7, 7> *J[2] = { &Ji, &Jj };
+                const unsigned int idx[2] = { edge.i, edge.j };
+
+                for (int a = 0; a < 2; ++a)
+                {
+                    if (idx[a] == 0) continue;
+                    unsigned int oa = 7 * (idx[a] - 1);
+                    b.segment<7> (oa) += J[a]->transpose () * W.cwiseProduct (r);
+
+                    for (int c = 0; c < 2; ++c)
+                    {
+                        if (idx[c] == 0) continue;
+                        unsigned int oc = 7 * (idx[c] - 1);
+                        Eigen::Matrix<double, 7, 7> Hac = J[a]->transpose () * W.asDiagonal () * (*J[c]);
+                        for (int u = 0; u < 7; ++u)
+                            for (int v = 0; v < 7; ++v)
+                                triplets.emplace_back (oa + u, oc + v, Hac (u, v));
+                    }
+                }
+            }
+
+            Eigen::SparseMatrix<double> H (N, N);
+            H.setFromTriplets (triplets.begin (), triplets.end ());
+
+            // Try increments with increasing damping until the error decreases
+            bool accepted = false;
+            while (!accepted && lambda < 1e8)
+            {
+                Eigen::SparseMatrix<double> Hd (H);
+                for (unsigned int k = 0; k < N; ++k)
+                    Hd.coeffRef (k, k) *= (1.0 + lambda);
+
+                Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver (Hd);
+                if (solver.info () != Eigen::Success)
+                {
+                    lambda *= 10.0;
+                    continue;
+                }
+                Eigen::VectorXd dx = solver.solve (-b);
+
+                std::vector<Pose> backup (nodes);
+                for (unsigned int k = 1; k < nodes.size (); ++k)
+                    nodes[k] = perturb (nodes[k], dx.segment<7> (7 * (k - 1)));
+
+                double newErr = error ();
+                if (newErr < err)
+                {
+                    accepted = true;
+                    lambda = std::max (lambda / 10.0, 1e-9);
+
+                    bool converged = (err - newErr) < 1e-9 * err || dx.norm () < 1e-9;
+                    err = newErr;
+                    if (converged) return err;
+                }
+                else
+                {
+                    nodes.swap (backup);
+                    lambda *= 10.0;
+                }
+            }
+
+            if (!accepted) break;
+        }
+
+        return err;
+    }
+
+}
+}
@@ -0,0 +1,390 @@
+/*! \file program_cache.cpp
+ *  \brief Defines a persistent cache of OpenCL program binaries.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#include <exception>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <oclslam/program_cache.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    namespace
+    {
+        const std::string magic ("OCLSLAM-PROGRAM-BINARY-1");
+
+        /*! \brief Creates a directory, along with any missing parents. */
+        bool makeDirectory (const std::string &path)
+        {
+            for (size_t pos = path.find ('/', 1); ; pos = path.find ('/', pos + 1))
+            {
+                std::string sub = path.substr (0, pos);
+                if (mkdir (sub.c_str (), 0755) != 0)
+                {
+                    struct stat st;
+                    if (stat (sub.c_str (), &st) != 0 || !S_ISDIR (st.st_mode)) return false;
+                }
+                if (pos == std::string::npos) return true;
+            }
+        }
+
+        /*! \brief Reads and concatenates the source files of a program. */
+        std::string readSources (const ProgramSpec &spec)
+        {
+            std::string source;
+            for (const std::string &filename : spec.files)
+            {
+                std::ifstream file (filename.c_str ());
+                if (!file.is_open ())
+                {
+                    std::cerr << "Error[ProgramCache]: Failed to open " << filename << std::endl;
+                    exit (EXIT_FAILURE);
+                }
+                std::stringstream ss;
+                ss << file.rdbuf ();
+                source += ss.str () + "\n";
+            }
+            return source;
+        }
+    }
+
+
+    /*! \param[in] device OpenCL device.
+     *  \return The hash.
+     */
+    uint64_t hashDevice (const cl::Device &device)
+    {
+        uint64_t hash = fnv1a (device.getInfo<CL_DEVICE_NAME> ());
+        hash = fnv1a (std::string (1, '\0') + device.getInfo<CL_DEVICE_VENDOR> (), hash);
+        hash = fnv1a (std::string (1, '\0') + device.getInfo<CL_DEVICE_VERSION> (), hash);
+        return fnv1a (std::string (1, '\0') + device.getInfo<CL_DRIVER_VERSION> (), hash);
+    }
+
+
+    /*! \param[in] _dir directory of the cache. It's created if it doesn't exist. 
+     *                  An empty string disables the cache.
+     */
+    ProgramCache::ProgramCache (const std::string &_dir) : dir (_dir), hits (0), misses (0)
+    {
+        if (!dir.empty () && !makeDirectory (dir))
+        {
+            std::cerr << "Warning[ProgramCache]: Failed to create " << dir 
+                      << ". The programs will be built from source" << std::endl;
+            dir.clear ();
+        }
+    }
+
+
+    /*! \return `$OCLSLAM_CACHE_DIR` if it's set, otherwise `$HOME/.cache/oclslam`.
+     */
+    std::string ProgramCache::getDefaultDirectory ()
+    {
+        const char *env = std::getenv ("OCLSLAM_CACHE_DIR");
+        if (env != nullptr) return std::string (env);
+
+        const char *home = std::getenv ("HOME");
+        if (home == nullptr) return std::string ();
+
+        return std::string (home) + "/.cache/oclslam";
+    }
+
+
+    /*! \details On a cache miss, the program is built from source, 
+     *           and its binary is stored in the cache.
+     *  \note Only the listed source files are hashed, not any files they `#include`.
+     *
+     *  \param[in] context context of the program.
+     *  \param[in] device device for which to build the program.
+     *  \param[in] spec source files and build options.
+     *  \return The built program.
+     */
+    cl::Program ProgramCache::build (const cl::Context &context, const cl::Device &device, const ProgramSpec &spec)
+    {
+        std::string source = readSources (spec);
+        std::string key = getKey (device, spec, source);
+
+        cl::Program program;
+        if (!dir.empty () && load (context, device, key, program))
+        {
+            hits++;
+            return program;
+        }
+        misses++;
+
+        cl::Program::Sources sources (1, std::make_pair (source.c_str (), source.size ()));
+        program = cl::Program (context, sources);
+        try
+        {
+            program.build ({ device }, spec.options.c_str ());
+        }
+        catch (const cl::Error &error)
+        {
+            std::cerr << "Error[ProgramCache]: Failed to build " << spec.files.front () << "\n" 
+                      << program.getBuildInfo<CL_PROGRAM_BUILD_LOG> (device) << std::endl;
+            throw;
+        }
+
+        if (!dir.empty ()) store (device, key, program);
+
+        return program;
+    }
+
+
+    /*! \details Every program is handled on a separate thread, so the programs 
+     *           that are missing from the cache get built concurrently.
+     *
+     *  \param[in] context context of the programs.
+     *  \param[in] device device for which to build the programs.
+     *  \param[in] specs source files and build options of every program.
+     *  \return The built programs, in the order of `specs`.
+     */
+    std::vector<cl::Program> ProgramCache::build (const cl::Context &context, const cl::Device &device, 
+                                                  const std::vector<ProgramSpec> &specs)
+    {
+        std::vector<cl::Program> programs (specs.size ());
+        std::vector<std::exception_ptr> errors (specs.size ());
+
+        std::vector<std::thread> threads;
+        for (unsigned int i = 0; i < specs.size (); ++i)
+        {
+            threads.emplace_back ([&, i] {
+                try
+                {
+                    programs[i] = build (context, device, specs[i]);
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception ();
+                }
+            });
+        }
+        for (std::thread &t : threads) t.join ();
+
+        for (std::exception_ptr &error : errors)
+            if (error) std::rethrow_exception (error);
+
+        return programs;
+    }
+
+
+    /*! \details The key is a hash of the device name and vendor, the device and 
+     *           driver versions, the build options, and the sources.
+     */
+    std::string ProgramCache::getKey (const cl::Device &device, const ProgramSpec &spec, const std::string &source)
+    {
+        uint64_t hash = hashDevice (device);
+        hash = fnv1a (std::string (1, '\0') + spec.options, hash);
+        hash = fnv1a (std::string (1, '\0') + source, hash);
+
+        std::ostringstream oss;
+        oss << std::hex << std::setw (16) << std::setfill ('0') << hash;
+        return oss.str ();
+    }
+
+
+    /*! \details The file holds a header, the size of the binary, the binary, and 
+     *           a checksum of the binary. Files that fail any check are ignored.
+     *
+     *  \return `true` on success.
+     */
+    bool ProgramCache::load (const cl::Context &context, const cl::Device &device, 
+                             const std::string &key, cl::Program &program)
+    {
+        std::ifstream file ((dir + "/" + key + ".bin").c_str (), std::ios::binary);
+        if (!file.is_open ()) return false;
+
+        std::string header (magic.size (), '\0');
+        uint64_t size = 0, checksum = 0;
+        file.read (&header[0], header.size ());
+        file.read ((char *) &size, sizeof (size));
+        if (!file || header != magic || size == 0 || size > (1ULL << 30)) return false;
+
+        std::string binary (size, '\0');
+        file.read (&binary[0], size);
+        file.read ((char *) &checksum, sizeof (checksum));
+        if (!file || checksum != fnv1a (binary)) return false;
+
+        try
+        {
+            cl::Program::Binaries binaries (1, std::make_pair ((const void *) binary.data (), binary.size ()));
+            program = cl::Program (context, { device }, binaries);
+            program.build ({ device });
+        }
+        catch (const cl::Error &error)
+        {
+            std::cerr << "Warning[ProgramCache]: Discarding the cached binary " << key << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /*! \details The binary is written to a temporary file, which is then renamed, 
+     *           so concurrent processes never see a partial file. Failures are ignored.
+     */
+    void ProgramCache::store (const cl::Device &device, const std::string &key, const cl::Program &program)
+    {
+        std::vector<size_t> sizes = program.getInfo<CL_PROGRAM_BINARY_SIZES> ();
+        if (sizes.size () != 1 || sizes[0] == 0) return;
+
+        std::string binary (sizes[0], '\0');
+        unsigned char *ptr = (unsigned char *) &binary[0];
+        if (clGetProgramInfo (program (), CL_PROGRAM_BINARIES, sizeof (ptr), &ptr, nullptr) != CL_SUCCESS) return;
+
+        uint64_t size = binary.size (), checksum = fnv1a (binary);
+        std::string path = dir + "/" + key + ".bin";
+        std::string tmpPath = path + ".tmp" + std::to_string (getpid ());
+        {
+            std::ofstream file (tmpPath.c_str (), std::ios::binary | std::ios::trunc);
+            if (!file.is_open ()) return;
+            file.write (magic.data (), magic.size ());
+            file.write ((const char *) &size, sizeof (size));
+            file.write (binary.data (), binary.size ());
+            file.write ((const char *) &checksum, sizeof (checksum));
+            if (!file) { file.close (); std::remove (tmpPath.c_str ()); return; }
+        }
+        if (std::rename (tmpPath.c_str (), path.c_str ()) != 0) std::remove (tmpPath.c_str ());
+    }
+
+
+    /*! \details The programs are loaded or built with `cache`. `clutils::CLEnv` 
+     *           keeps its programs private and only builds them from source, so every 
+     *           program slot is reserved with a trivial program, and then replaced.
+     *
+     *  \param[in] env OpenCL environment.
+     *  \param[in] ctxIdx index of the context.
+     *  \param[in] specs source files and build options of every program.
+     *  \param[in] cache cache through which to build the programs.
+     *  \param[in] placeholder source file of a trivial program used for reserving a slot.
+     *  \param[in] devIdx index of the device, within the context, the programs are built for.
+     */
+    void addPrograms (clutils::CLEnv &env, unsigned int ctxIdx, const std::vector<ProgramSpec> &specs, 
+                      ProgramCache &cache, const std::string &placeholder, unsigned int devIdx)
+    {
+        cl::Context &context = env.getContext (ctxIdx);
+        cl::Device device = context.getInfo<CL_CONTEXT_DEVICES> ()[devIdx];
+
+        std::vector<cl::Program> programs = cache.build (context, device, specs);
+        for (cl::Program &program : programs)
+            env.addProgram (ctxIdx, placeholder) = program;
+    }
+
+
+    /*! \param[in] name name of the macro.
+     *  \param[in] value value of the macro.
+     *  \return The option, e.g. ` -D FRAME_WIDTH=640`.
+     */
+    std::string defineOption (const std::string &name, unsigned int value)
+    {
+        return " -D " + name + "=" + std::to_string (value) + "u";
+    }
+
+
+    /*! \details The value is written in scientific notation, with enough digits 
+     *           to get back the same float, and as a float literal.
+     *
+     *  \param[in] name name of the macro.
+     *  \param[in] value value of the macro.
+     *  \return The option, e.g. ` -D PC_SCALE=1.00000005e-03f`.
+     */
+    std::string defineOption (const std::string &name, float value)
+    {
+        std::ostringstream oss;
+        oss << " -D " << name << "=" << std::scientific << std::setprecision (8) << value << "f";
+        return oss.str ();
+    }
+
+
+    /*! \param[in] _env OpenCL environment.
+     *  \param[in] cacheDir directory of the cache for the binaries of the variants.
+     */
+    ProgramVariants::ProgramVariants (clutils::CLEnv &_env, const std::string &cacheDir) : 
+        env (_env), cache (cacheDir)
+    {
+    }
+
+
+    /*! \param[in] pgIdx index of the unspecialized program in the environment.
+     *  \param[in] ctxIdx index of the context of the program.
+     *  \param[in] spec source files and build options of the program.
+     *  \param[in] devIdx index of the device, within the context, the program is built for.
+     */
+    void ProgramVariants::add (unsigned int pgIdx, unsigned int ctxIdx, const ProgramSpec &spec, unsigned int devIdx)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        bases[pgIdx] = { ctxIdx, devIdx, spec };
+    }
+
+
+    /*! \details The definitions are appended to the build options of the program. 
+     *           A program that hasn't been registered is returned as is, 
+     *           so callers don't have to tell the two cases apart.
+     *
+     *  \param[in] pgIdx index of the unspecialized program in the environment.
+     *  \param[in] defines build options with the definitions, as made by `defineOption`.
+     *  \return The specialized program.
+     */
+    cl::Program& ProgramVariants::get (unsigned int pgIdx, const std::string &defines)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        auto base = bases.find (pgIdx);
+        if (base == bases.end () || defines.empty ()) return env.getProgram (pgIdx);
+
+        auto key = std::make_pair (pgIdx, defines);
+        auto it = variants.find (key);
+        if (it != variants.end ()) return it->second;
+
+        cl::Context &context = env.getContext (base->second.ctxIdx);
+        cl::Device device = context.getInfo<CL_CONTEXT_DEVICES> ()[base->second.devIdx];
+        ProgramSpec spec = base->second.spec;
+        spec.options += defines;
+
+        return variants[key] = cache.build (context, device, spec);
+    }
+
+
+    unsigned int ProgramVariants::getCount ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return variants.size ();
+    }
+
+}
+}
@@ -0,0 +1,109 @@
+/*! \file registration.cpp
+ *  \brief Defines functions for evaluating and applying `ICP` registrations.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <oclslam/registration.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \details A sample is an inlier if its residual is under the inlier distance. 
+     *           The ratio is taken over the valid samples, and the RMS residual 
+     *           over the inliers.
+     *
+     *  \param[in] res squared distances (in mm^2) of the samples to their nearest 
+     *                 neighbors, as computed by `ICPResiduals`. A negative value 
+     *                 marks an invalid sample.
+     *  \param[in] samples number of samples.
+     *  \param[in] inlierDistance distance (in mm) under which a sample is an inlier.
+     *  \return The statistics. Without valid samples, the ratio is `0`, and 
+     *          without inliers, the RMS residual is `INFINITY`.
+     */
+    RegistrationStats computeRegistrationStats (const float *res, unsigned int samples, 
+                                                float inlierDistance)
+    {
+        unsigned int valid = 0, inliers = 0;
+        double sum = 0.0;
+        float maxSqDist = inlierDistance * inlierDistance;
+        for (unsigned int k = 0; k < samples; ++k)
+        {
+            if (res[k] < 0.f) continue;  // Invalid landmark
+            valid++;
+            if (res[k] < maxSqDist) { inliers++; sum += res[k]; }
+        }
+
+        RegistrationStats stats;
+        stats.inlierRatio = (valid == 0) ? 0.f : (float) inliers / valid;
+        stats.rmsResidual = (inliers == 0) ? INFINITY : std::sqrt (sum / inliers);
+
+        return stats;
+    }
+
+
+    /*! \param[in] R rotation of the motion.
+     *  \param[in] t translation (in mm) of the motion.
+     *  \param[in] s scale of the motion.
+     *  \param[in] maxDistance maximum translation (in mm).
+     *  \param[in] maxAngle maximum rotation (in degrees).
+     *  \param[in] maxScale maximum scale change, as \f$ |\ln s| \f$.
+     *  \return A flag to indicate whether the motion is within the bounds.
+     */
+    bool checkMotion (const Eigen::Matrix3f &R, const Eigen::Vector3f &t, float s, 
+                      float maxDistance, float maxAngle, float maxScale)
+    {
+        float angle = 180.f / M_PI * Eigen::AngleAxisf (R).angle ();  // in degrees
+
+        return t.norm () <= maxDistance && angle <= maxAngle && std::abs (std::log (s)) <= maxScale;
+    }
+
+
+    /*! \details The registration maps the current point cloud onto a reference one, 
+     *           so with \f$ T \f$ the pose of the reference, the pose of the current 
+     *           point cloud is \f$ T_{icp} \circ T \f$, i.e. \f$ R = R_{icp} R \f$, 
+     *           \f$ t = s_{icp} R_{icp} t + t_{icp} \f$, and \f$ s = s_{icp} s \f$.
+     *
+     *  \param[in] R_icp rotation of the registration.
+     *  \param[in] t_icp translation (in mm) of the registration.
+     *  \param[in] s_icp scale of the registration.
+     *  \param[in,out] R rotation of the pose.
+     *  \param[in,out] t translation (in mm) of the pose.
+     *  \param[in,out] s scale of the pose.
+     */
+    void applyRegistration (const Eigen::Matrix3f &R_icp, const Eigen::Vector3f &t_icp, float s_icp, 
+                            Eigen::Matrix3f &R, Eigen::Vector3f &t, float &s)
+    {
+        t = s_icp * R_icp * t + t_icp;
+        R = (R_icp * R).eval ();
+        s = s_icp * s;
+    }
+
+}
+}
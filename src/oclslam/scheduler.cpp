@@ -0,0 +1,234 @@
+/*! \file scheduler.cpp
+ *  \brief Defines a scheduler that orders the stages of the pipeline by the buffers they access.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <oclslam/scheduler.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \details The stage is enabled. The buffers have to be 
+     *           the ones the stage accesses on every dispatch.
+     *
+     *  \param[in] name name of the stage.
+     *  \param[in] queue command queue on which the task enqueues its work.
+     *  \param[in] task function that enqueues the work of the stage.
+     *  \param[in] inputs buffers that the stage reads.
+     *  \param[in] outputs buffers that the stage writes.
+     *  \return The index of the stage.
+     */
+    unsigned int StageGraph::add (const std::string &name, cl::CommandQueue &queue, Task task, 
+                                  const std::vector<cl::Memory> &inputs, const std::vector<cl::Memory> &outputs)
+    {
+        Stage stage;
+        stage.name = name;
+        stage.queue = addQueue (queue);
+        stage.task = task;
+        for (const cl::Memory &mem : inputs) stage.inputs.push_back (mem ());
+        for (const cl::Memory &mem : outputs) stage.outputs.push_back (mem ());
+        stage.enabled = true;
+
+        stages.push_back (stage);
+        return stages.size () - 1;
+    }
+
+
+    /*! \details The task enqueues a barrier on the wait-list, lets `work` enqueue 
+     *           its commands, and returns the event of a marker that follows them.
+     *
+     *  \param[in] queue command queue on which `work` enqueues its commands.
+     *  \param[in] work function that enqueues the commands.
+     *  \return The task.
+     */
+    StageGraph::Task StageGraph::fence (cl::CommandQueue &queue, std::function<void ()> work)
+    {
+        cl::CommandQueue q = queue;
+        return [q, work] (const std::vector<cl::Event> *events, cl::Event *event) mutable
+        {
+            if (events != nullptr) q.enqueueBarrierWithWaitList (events);
+            work ();
+            q.enqueueMarkerWithWaitList (nullptr, event);
+        };
+    }
+
+
+    /*! \details A disabled stage is skipped by `run` and `dispatch`, 
+     *           and so it takes no part in the dependencies.
+     *
+     *  \param[in] stage index of the stage.
+     *  \param[in] flag `true` to enable the stage, `false` to disable it.
+     */
+    void StageGraph::setEnabled (unsigned int stage, bool flag)
+    {
+        stages[stage].enabled = flag;
+    }
+
+
+    /*! \details Queues that hold work the stage waits on get flushed, 
+     *           so that the commands of the stage can make progress.
+     *
+     *  \param[in] stage index of the stage.
+     */
+    void StageGraph::dispatch (unsigned int stage)
+    {
+        Stage &s = stages[stage];
+        if (!s.enabled) return;
+
+        // Collect the dependencies
+        s.dependencies.clear ();
+        for (cl_mem mem : s.inputs)
+        {
+            auto it = buffers.find (mem);
+            if (it != buffers.end () && it->second.writer >= 0)
+                depend (stage, it->second.writer);
+        }
+        for (cl_mem mem : s.outputs)
+        {
+            auto it = buffers.find (mem);
+            if (it == buffers.end ()) continue;
+            if (it->second.writer >= 0) depend (stage, it->second.writer);
+            for (unsigned int reader : it->second.readers) depend (stage, reader);
+        }
+
+        std::vector<cl::Event> waitList;
+        for (unsigned int other : s.dependencies)
+        {
+            Queue &q = queues[stages[other].queue];
+            if (q.pending)
+            {
+                q.queue.flush ();
+                q.pending = false;
+            }
+            waitList.push_back (stages[other].event);
+        }
+
+        Queue &q = queues[s.queue];
+        bool trace = tracer != nullptr && tracer->isOpen ();
+        cl::Event first;
+        if (trace && q.inOrder) q.queue.enqueueMarkerWithWaitList (nullptr, &first);
+
+        s.task (waitList.empty () ? nullptr : &waitList, &s.event);
+        q.pending = true;
+
+        if (trace) tracer->record (q.queue, s.name, s.event, first);
+
+        // Record the accesses
+        for (cl_mem mem : s.inputs)
+        {
+            Accesses &acc = buffers.emplace (mem, Accesses { -1, {} }).first->second;
+            if (std::find (acc.readers.begin (), acc.readers.end (), stage) == acc.readers.end ())
+                acc.readers.push_back (stage);
+        }
+        for (cl_mem mem : s.outputs)
+        {
+            Accesses &acc = buffers.emplace (mem, Accesses { -1, {} }).first->second;
+            acc.writer = stage;
+            acc.readers.clear ();
+        }
+    }
+
+
+    /*! \param[in] first index of the first stage.
+     *  \param[in] last index of the last stage.
+     */
+    void StageGraph::run (unsigned int first, unsigned int last)
+    {
+        for (unsigned int stage = first; stage <= last; ++stage)
+            dispatch (stage);
+    }
+
+
+    void StageGraph::flush ()
+    {
+        for (Queue &q : queues)
+        {
+            if (!q.pending) continue;
+            q.queue.flush ();
+            q.pending = false;
+        }
+    }
+
+
+    void StageGraph::finish ()
+    {
+        for (Queue &q : queues)
+        {
+            q.queue.finish ();
+            q.pending = false;
+        }
+    }
+
+
+    /*! \details Call it after `finish`, when the buffers get reassigned.
+     */
+    void StageGraph::reset ()
+    {
+        buffers.clear ();
+        for (Stage &s : stages)
+        {
+            s.event = cl::Event ();
+            s.dependencies.clear ();
+        }
+    }
+
+
+    /*! \param[in] queue command queue.
+     *  \return The index of the queue.
+     */
+    unsigned int StageGraph::addQueue (cl::CommandQueue &queue)
+    {
+        for (unsigned int i = 0; i < queues.size (); ++i)
+            if (queues[i].queue () == queue ()) return i;
+
+        cl_command_queue_properties props = queue.getInfo<CL_QUEUE_PROPERTIES> ();
+        queues.push_back ({ queue, !(props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE), false });
+        return queues.size () - 1;
+    }
+
+
+    /*! \details A stage on the same in-order queue has already been ordered 
+     *           by the queue itself, and a stage is never waited on twice.
+     *
+     *  \param[in] stage index of the dependent stage.
+     *  \param[in] other index of the stage it depends on.
+     */
+    void StageGraph::depend (unsigned int stage, unsigned int other)
+    {
+        if (stages[other].event () == nullptr) return;
+        if (stages[other].queue == stages[stage].queue && queues[stages[stage].queue].inOrder) return;
+
+        std::vector<unsigned int> &deps = stages[stage].dependencies;
+        if (std::find (deps.begin (), deps.end (), other) == deps.end ())
+            deps.push_back (other);
+    }
+
+}
+}
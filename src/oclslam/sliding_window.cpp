@@ -0,0 +1,235 @@
+/*! \file sliding_window.cpp
+ *  \brief Defines a sliding window that bounds the live map around the sensor.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <oclslam/sliding_window.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    namespace
+    {
+        /*! \brief A leaf, as stored in the archive. */
+        struct ArchivedLeaf
+        {
+            octomap::OcTreeKey key;
+            uint8_t depth;
+            float logOdds;
+        };
+    }
+
+
+    /*! \param[in] _radius radius (in meters) of the window. A radius of `0` disables it.
+     *  \param[in] _step distance (in meters) the sensor has to travel between two sweeps. 
+     *                   The map keeps parts up to \f$ radius + step \f$ away, at times.
+     *  \param[in] archive file to archive the evicted leaves in. If empty, they get discarded.
+     */
+    SlidingWindow::SlidingWindow (double _radius, double _step, const std::string &archive) : 
+        radius (_radius), step (_step), swept (false), stats ({ 0, 0, 0, 0, 0 })
+    {
+        if (!archive.empty ()) openArchive (archive);
+    }
+
+
+    SlidingWindow::~SlidingWindow ()
+    {
+        if (archive.is_open ()) archive.close ();
+    }
+
+
+    void SlidingWindow::setRadius (double _radius)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        radius = _radius;
+        swept = false;
+    }
+
+
+    double SlidingWindow::getRadius () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return radius;
+    }
+
+
+    /*! \param[in] filename name of the archive. The leaves get appended to it.
+     *  \return `true` on success.
+     */
+    bool SlidingWindow::openArchive (const std::string &filename)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (archive.is_open ()) archive.close ();
+        archive.open (filename.c_str (), std::ios::binary | std::ios::app);
+        return archive.is_open ();
+    }
+
+
+    /*! \details The nodes are tested against the window by their nearest point 
+     *           to the center, so a node is evicted only if all of it is out.
+     *  \note It has to be called by the only thread that modifies the map.
+     *
+     *  \param[in,out] map the live map.
+     *  \param[in] center position (in meters) of the sensor.
+     *  \param[in] force flag to sweep regardless of how far the sensor has moved.
+     *  \param[out] deleted if given, the keys and depths of the deleted nodes get appended to it.
+     *  \return The number of leaves evicted.
+     */
+    size_t SlidingWindow::update (octomap::OcTree &map, const octomap::point3d &center, bool force, 
+                                  std::vector<std::pair<octomap::OcTreeKey, unsigned int>> *deleted)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        size_t evicted = 0;
+        if (radius > 0.0 && (force || !swept || (center - lastCenter).norm () > step))
+        {
+            // Nodes of about the size of a step are tested
+            unsigned int depth = map.getTreeDepth ();
+            double size = map.getResolution ();
+            while (depth > 1 && 2.0 * size <= step) { size *= 2.0; --depth; }
+
+            std::vector<std::pair<octomap::OcTreeKey, unsigned int>> outside;
+            std::vector<ArchivedLeaf> leaves;
+            for (auto it = map.begin_leafs (depth), end = map.end_leafs (); it != end; ++it)
+            {
+                octomap::point3d c = it.getCoordinate ();
+                double half = 0.5 * it.getSize (), d2 = 0.0;
+                for (unsigned int a = 0; a < 3; ++a)
+                {
+                    double d = std::max (0.0, std::abs ((double) c (a) - center (a)) - half);
+                    d2 += d * d;
+                }
+                if (d2 <= radius * radius) continue;
+
+                outside.emplace_back (it.getKey (), it.getDepth ());
+
+                // Collect the leaves of the subtree, by the centers of the cells it covers
+                double inset = 0.5 * map.getResolution ();
+                octomap::point3d lo (c.x () - half + inset, c.y () - half + inset, c.z () - half + inset);
+                octomap::point3d hi (c.x () + half - inset, c.y () + half - inset, c.z () + half - inset);
+                for (auto lf = map.begin_leafs_bbx (lo, hi), lend = map.end_leafs_bbx (); lf != lend; ++lf)
+                    leaves.push_back ({ lf.getKey (), (uint8_t) lf.getDepth (), lf->getLogOdds () });
+            }
+
+            if (archive.is_open () && !leaves.empty ())
+            {
+                uint32_t count = leaves.size ();
+                float c[3] = { center.x (), center.y (), center.z () };
+                archive.write ((const char *) &count, sizeof (count));
+                archive.write ((const char *) c, sizeof (c));
+                for (const ArchivedLeaf &leaf : leaves)
+                {
+                    uint16_t k[3] = { leaf.key[0], leaf.key[1], leaf.key[2] };
+                    archive.write ((const char *) k, sizeof (k));
+                    archive.write ((const char *) &leaf.depth, sizeof (leaf.depth));
+                    archive.write ((const char *) &leaf.logOdds, sizeof (leaf.logOdds));
+                }
+                archive.flush ();
+                stats.archiveBytes += sizeof (count) + sizeof (c) + 11 * leaves.size ();
+            }
+
+            for (const auto &node : outside)
+                map.deleteNode (node.first, node.second);
+            if (deleted) deleted->insert (deleted->end (), outside.begin (), outside.end ());
+
+            evicted = leaves.size ();
+            stats.evicted += evicted;
+            ++stats.sweeps;
+            lastCenter = center;
+            swept = true;
+        }
+
+        stats.nodes = map.size ();
+        stats.memory = map.size () * map.memoryUsageNode ();
+        return evicted;
+    }
+
+
+    SlidingWindow::Stats SlidingWindow::getStats () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return stats;
+    }
+
+
+    /*! \details The leaves are set in the order they were archived, 
+     *           so the latest state of every region prevails.
+     *
+     *  \param[in] filename name of the archive.
+     *  \param[in,out] map map in which to set the leaves. It should 
+     *                     have the resolution of the archived map.
+     *  \return The number of leaves read.
+     */
+    size_t SlidingWindow::readArchive (const std::string &filename, octomap::OcTree &map)
+    {
+        std::ifstream file (filename.c_str (), std::ios::binary);
+        size_t total = 0;
+
+        uint32_t count;
+        float c[3];
+        while (file.read ((char *) &count, sizeof (count)) && file.read ((char *) c, sizeof (c)))
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                uint16_t k[3];
+                uint8_t depth;
+                float logOdds;
+                file.read ((char *) k, sizeof (k));
+                file.read ((char *) &depth, sizeof (depth));
+                file.read ((char *) &logOdds, sizeof (logOdds));
+                if (!file) return total;
+
+                octomap::OcTreeKey key (k[0], k[1], k[2]);
+                if (depth < map.getTreeDepth ())
+                {
+                    // A pruned leaf covers all the cells of its subtree
+                    unsigned int side = 1u << (map.getTreeDepth () - depth);
+                    octomap::OcTreeKey base = map.adjustKeyAtDepth (key, depth);
+                    for (unsigned int j = 0; j < 3; ++j) base[j] -= side / 2;
+                    for (unsigned int x = 0; x < side; ++x)
+                        for (unsigned int y = 0; y < side; ++y)
+                            for (unsigned int z = 0; z < side; ++z)
+                                map.setNodeValue (octomap::OcTreeKey (base[0] + x, base[1] + y, base[2] + z), logOdds, true);
+                }
+                else
+                    map.setNodeValue (key, logOdds, true);
+                ++total;
+            }
+        }
+
+        map.updateInnerOccupancy ();
+        map.prune ();
+        return total;
+    }
+
+}
+}
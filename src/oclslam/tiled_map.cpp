@@ -0,0 +1,358 @@
+/*! \file tiled_map.cpp
+ *  \brief Defines an out-of-core map, stored in tiles on disk.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <streambuf>
+#include <iostream>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <oclslam/tiled_map.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    namespace
+    {
+        /*! \brief Presents a memory mapping as a stream buffer, for reading. */
+        struct MappedBuffer : public std::streambuf
+        {
+            MappedBuffer (char *data, size_t size) { setg (data, data, data + size); }
+        };
+    }
+
+
+    /*! \param[in] _resolution resolution (in meters) of the map.
+     *  \param[in] _tileSize side (in meters) of the tiles.
+     *  \param[in] _capacity maximum number of resident tiles.
+     */
+    TiledMap::TiledMap (double _resolution, double _tileSize, size_t _capacity) : 
+        resolution (_resolution), tileSize (_tileSize), capacity (_capacity), 
+        scratch (_resolution), loads (0), evictions (0)
+    {
+    }
+
+
+    TiledMap::~TiledMap ()
+    {
+        flush ();
+    }
+
+
+    /*! \details The directory gets created if it doesn't exist, and any 
+     *           chunk files in it become part of the map.
+     *
+     *  \param[in] _dir directory of the chunk files.
+     *  \return `true` on success.
+     */
+    bool TiledMap::open (const std::string &_dir)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        mkdir (_dir.c_str (), 0755);
+        DIR *d = opendir (_dir.c_str ());
+        if (d == nullptr) return false;
+
+        dir = _dir;
+        stored.clear ();
+        for (dirent *e = readdir (d); e != nullptr; e = readdir (d))
+        {
+            int x, y, z;
+            char tail[4] = { 0 };
+            if (std::sscanf (e->d_name, "tile_%d_%d_%d.%3s", &x, &y, &z, tail) == 4 && 
+                std::strcmp (tail, "ot") == 0)
+                stored.insert (TileIndex (x, y, z));
+        }
+        closedir (d);
+
+        return true;
+    }
+
+
+    bool TiledMap::isOpen () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return !dir.empty ();
+    }
+
+
+    std::string TiledMap::getDirectory () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return dir;
+    }
+
+
+    /*! \details Equivalent to `OcTree::insertPointCloud`, with the updates of the 
+     *           cells going to the tiles they belong to. Occupied cells take 
+     *           precedence over free ones.
+     *
+     *  \param[in] pc point cloud (in meters, in the frame of the map).
+     *  \param[in] origin position (in meters) of the sensor.
+     *  \param[in] maxRange maximum range (in meters) of the rays. If negative, it's unlimited.
+     */
+    void TiledMap::insertPointCloud (const octomap::Pointcloud &pc, const octomap::point3d &origin, double maxRange)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (dir.empty ()) return;
+
+        octomap::KeySet freeCells, occupiedCells;
+        scratch.computeUpdate (pc, origin, freeCells, occupiedCells, maxRange);
+
+        // Tiles are looked up once per run of cells in the same tile
+        std::set<TileIndex> touched;
+        TileIndex lastIdx;
+        Tile *tile = nullptr;
+        auto route = [&] (const octomap::OcTreeKey &key, bool occupied) {
+            TileIndex idx = getTileIndex (scratch.keyToCoord (key));
+            if (tile == nullptr || idx != lastIdx)
+            {
+                tile = &acquire (idx);
+                tile->dirty = true;
+                touched.insert (idx);
+                lastIdx = idx;
+            }
+            tile->tree->updateNode (key, occupied, true);
+        };
+
+        for (const octomap::OcTreeKey &key : freeCells)
+            if (occupiedCells.find (key) == occupiedCells.end ()) route (key, false);
+        for (const octomap::OcTreeKey &key : occupiedCells)
+            route (key, true);
+
+        for (const TileIndex &idx : touched)
+            tiles[idx].tree->updateInnerOccupancy ();
+
+        evict (touched.size ());
+    }
+
+
+    /*! \param[in] center position (in meters) of the sensor.
+     *  \param[in] radius distance (in meters) within which to load the stored tiles.
+     */
+    void TiledMap::update (const octomap::point3d &center, double radius)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (dir.empty ()) return;
+
+        TileIndex lo = getTileIndex (center - octomap::point3d (radius, radius, radius));
+        TileIndex hi = getTileIndex (center + octomap::point3d (radius, radius, radius));
+        size_t near = 0;
+        for (int x = std::get<0> (lo); x <= std::get<0> (hi); ++x)
+            for (int y = std::get<1> (lo); y <= std::get<1> (hi); ++y)
+                for (int z = std::get<2> (lo); z <= std::get<2> (hi); ++z)
+                {
+                    TileIndex idx (x, y, z);
+                    if (tiles.count (idx) || stored.count (idx)) { acquire (idx); ++near; }
+                }
+
+        evict (near);
+    }
+
+
+    void TiledMap::flush ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        for (auto &t : tiles)
+        {
+            if (!t.second.dirty) continue;
+            writeChunk (t.first, *t.second.tree);
+            t.second.dirty = false;
+        }
+    }
+
+
+    /*! \param[in] idx index of the tile.
+     *  \return The tile, or `nullptr` if it's neither resident nor stored.
+     */
+    std::shared_ptr<octomap::OcTree> TiledMap::getTile (const TileIndex &idx)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (dir.empty () || (!tiles.count (idx) && !stored.count (idx))) return nullptr;
+        std::shared_ptr<octomap::OcTree> tree = acquire (idx).tree;
+        evict (1);
+        return tree;
+    }
+
+
+    TiledMap::TileIndex TiledMap::getTileIndex (const octomap::point3d &p) const
+    {
+        return TileIndex ((int) std::floor (p.x () / tileSize), 
+                          (int) std::floor (p.y () / tileSize), 
+                          (int) std::floor (p.z () / tileSize));
+    }
+
+
+    TiledMap::Stats TiledMap::getStats () const
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        Stats stats = { tiles.size (), stored.size (), 0, loads, evictions };
+        for (const auto &t : tiles) stats.nodes += t.second.tree->size ();
+        return stats;
+    }
+
+
+    std::string TiledMap::getChunkName (const TileIndex &idx) const
+    {
+        std::ostringstream oss;
+        oss << dir << "/tile_" << std::get<0> (idx) << "_" << std::get<1> (idx) << "_" << std::get<2> (idx) << ".ot";
+        return oss.str ();
+    }
+
+
+    /*! \details Marks the tile as the most recently used. A tile that isn't 
+     *           resident gets read from its chunk file, or else created.
+     *  \note It doesn't evict anything, so references to tiles stay valid 
+     *        until the next call to `evict`.
+     */
+    TiledMap::Tile& TiledMap::acquire (const TileIndex &idx)
+    {
+        auto it = tiles.find (idx);
+        if (it != tiles.end ())
+        {
+            lru.splice (lru.begin (), lru, it->second.lru);
+            return it->second;
+        }
+
+        Tile tile;
+        tile.tree = std::make_shared<octomap::OcTree> (resolution);
+        tile.dirty = false;
+        if (stored.count (idx))
+        {
+            if (readChunk (idx, tile.tree)) ++loads;
+            else std::cerr << "Warning[TiledMap]: Failed to read " << getChunkName (idx) << std::endl;
+        }
+
+        lru.push_front (idx);
+        tile.lru = lru.begin ();
+        return tiles[idx] = tile;
+    }
+
+
+    /*! \param[in] keep number of most recently used tiles that are kept, 
+     *                  even if they exceed the capacity.
+     */
+    void TiledMap::evict (size_t keep)
+    {
+        while (tiles.size () > std::max (capacity, keep))
+        {
+            TileIndex idx = lru.back ();
+            Tile &tile = tiles[idx];
+            if (tile.dirty) writeChunk (idx, *tile.tree);
+            lru.pop_back ();
+            tiles.erase (idx);
+            ++evictions;
+        }
+    }
+
+
+    /*! \details The tile is serialized, and copied into a mapping of a temporary 
+     *           file, which then replaces the chunk file. Failures are reported, 
+     *           and leave the previous chunk file in place.
+     *  \note The full format is used, not the binary one, which keeps only 
+     *        the maximum likelihood state of the cells.
+     */
+    void TiledMap::writeChunk (const TileIndex &idx, const octomap::OcTree &tree)
+    {
+        std::ostringstream oss;
+        tree.write (oss);
+        std::string data = oss.str ();
+
+        std::string path = getChunkName (idx);
+        std::string tmpPath = path + ".tmp";
+        int fd = ::open (tmpPath.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd >= 0 && ftruncate (fd, data.size ()) == 0;
+        if (ok)
+        {
+            void *ptr = mmap (nullptr, data.size (), PROT_WRITE, MAP_SHARED, fd, 0);
+            ok = ptr != MAP_FAILED;
+            if (ok)
+            {
+                std::memcpy (ptr, data.data (), data.size ());
+                ok = msync (ptr, data.size (), MS_SYNC) == 0;
+                munmap (ptr, data.size ());
+            }
+        }
+        if (fd >= 0) close (fd);
+
+        if (ok && std::rename (tmpPath.c_str (), path.c_str ()) == 0)
+            stored.insert (idx);
+        else
+        {
+            std::remove (tmpPath.c_str ());
+            std::cerr << "Warning[TiledMap]: Failed to write " << path << std::endl;
+        }
+    }
+
+
+    /*! \param[in] idx index of the tile.
+     *  \param[out] tree the tile, replaced by the one read on success.
+     *  \return `true` on success.
+     */
+    bool TiledMap::readChunk (const TileIndex &idx, std::shared_ptr<octomap::OcTree> &tree)
+    {
+        int fd = ::open (getChunkName (idx).c_str (), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        bool ok = fstat (fd, &st) == 0 && st.st_size > 0;
+        if (ok)
+        {
+            void *ptr = mmap (nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = ptr != MAP_FAILED;
+            if (ok)
+            {
+                MappedBuffer buf ((char *) ptr, st.st_size);
+                std::istream is (&buf);
+                std::unique_ptr<octomap::AbstractOcTree> read (octomap::AbstractOcTree::read (is));
+                octomap::OcTree *loaded = dynamic_cast<octomap::OcTree *> (read.get ());
+                ok = loaded != nullptr && loaded->getResolution () == resolution;
+                if (ok)
+                {
+                    read.release ();
+                    tree.reset (loaded);
+                }
+                munmap (ptr, st.st_size);
+            }
+        }
+        close (fd);
+
+        return ok;
+    }
+
+}
+}
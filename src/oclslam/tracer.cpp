@@ -0,0 +1,336 @@
+/*! \file tracer.cpp
+ *  \brief Defines a tracer that exports a timeline of the pipeline in the Chrome trace-event format.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <oclslam/tracer.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    namespace
+    {
+        /*! \brief Escapes a string for a JSON document. */
+        std::string escape (const std::string &str)
+        {
+            std::ostringstream out;
+            for (char c : str)
+            {
+                if (c == '\0') break;
+                if (c == '"' || c == '\\') out << '\\' << c;
+                else if ((unsigned char) c < 0x20) 
+                    out << "\\u" << std::hex << std::setw (4) << std::setfill ('0') << (int) c << std::dec;
+                else out << c;
+            }
+            return out.str ();
+        }
+    }
+
+
+    /*! \details A queue that isn't named, gets a name when its first command is recorded.
+     *
+     *  \param[in] queue command queue.
+     *  \param[in] name name of the queue.
+     */
+    void Tracer::addQueue (const cl::CommandQueue &queue, const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        lanes[getLane (queue)].name = name;
+    }
+
+
+    /*! \details The clocks of the queues get mapped to the host clock. Commands 
+     *           of queues without profiling enabled are not recorded.
+     *
+     *  \param[in] filename name for the trace file.
+     *  \return `false` if the file failed to open.
+     */
+    bool Tracer::open (const std::string &filename)
+    {
+        close ();
+
+        std::lock_guard<std::mutex> lock (mtx);
+
+        if (!std::ofstream (filename.c_str (), std::ios::out | std::ios::trunc).is_open ())
+        {
+            std::cerr << "Error[Tracer]: Failed to open " << filename << std::endl;
+            return false;
+        }
+        this->filename = filename;
+
+        for (Lane &lane : lanes)
+        {
+            if (lane.enabled) calibrate (lane);
+            else std::cerr << "Warning[Tracer]: Queue " << lane.name 
+                           << " has no profiling enabled, and won't be traced" << std::endl;
+        }
+
+        pending.clear ();
+        entries.clear ();
+        threads.clear ();
+        dropped = 0;
+        origin = now ();
+        tracing = true;
+
+        return true;
+    }
+
+
+    /*! \details It blocks until all the recorded commands have completed. */
+    void Tracer::close ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        if (!tracing) return;
+        tracing = false;
+
+        resolve (true);
+
+        std::ofstream file (filename.c_str (), std::ios::out | std::ios::trunc);
+        write (file);
+
+        pending.clear ();
+        entries.clear ();
+    }
+
+
+    /*! \details The command is resolved once it completes. When `first` is given, 
+     *           the entry spans from the end of `first` to the end of `event`. For 
+     *           an in-order queue, `first` can be a marker enqueued before a sequence 
+     *           of commands, with `event` the event of the last one of them.
+     *
+     *  \param[in] queue command queue on which the commands were enqueued.
+     *  \param[in] name name of the command.
+     *  \param[in] event event of the (last) command.
+     *  \param[in] first event of a command that precedes a sequence of commands.
+     */
+    void Tracer::record (const cl::CommandQueue &queue, const std::string &name, 
+                         const cl::Event &event, const cl::Event &first)
+    {
+        if (!tracing || event () == nullptr) return;
+
+        std::lock_guard<std::mutex> lock (mtx);
+
+        if (!tracing) return;
+        unsigned int lane = getLane (queue);
+        if (!lanes[lane].enabled) return;
+
+        // Every command turns into two entries
+        if (entries.size () + 2 * pending.size () + 2 > capacity)
+        {
+            dropped++;
+            return;
+        }
+
+        pending.push_back ({ lane, name, first, event });
+        if (pending.size () >= 64) resolve (false);
+    }
+
+
+    /*! \param[in] name name of the work.
+     *  \param[in] start time (in us) at which the work started, as given by `now`.
+     *  \param[in] end time (in us) at which the work ended, as given by `now`.
+     */
+    void Tracer::recordSpan (const std::string &name, double start, double end)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        if (!tracing) return;
+        if (entries.size () + 2 * pending.size () + 1 > capacity)
+        {
+            dropped++;
+            return;
+        }
+
+        unsigned int tid = threads.emplace (std::this_thread::get_id (), threads.size ()).first->second;
+        entries.push_back ({ name, 0, tid, start, end - start, false, false, 0.0, 0.0, 0.0, 0.0 });
+    }
+
+
+    double Tracer::now ()
+    {
+        return std::chrono::duration<double, std::micro> (
+            std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+    }
+
+
+    bool Tracer::isProfiling (const cl::CommandQueue &queue)
+    {
+        return (queue.getInfo<CL_QUEUE_PROPERTIES> () & CL_QUEUE_PROFILING_ENABLE) != 0;
+    }
+
+
+    /*! \details Every device gets a process, and every queue on it two tracks.
+     *
+     *  \param[in] queue command queue.
+     *  \return The index of the lane.
+     */
+    unsigned int Tracer::getLane (const cl::CommandQueue &queue)
+    {
+        for (unsigned int i = 0; i < lanes.size (); ++i)
+            if (lanes[i].queue () == queue ()) return i;
+
+        cl::Device device = queue.getInfo<CL_QUEUE_DEVICE> ();
+        unsigned int pid = 0;
+        while (pid < devices.size () && devices[pid] () != device ()) pid++;
+        if (pid == devices.size ()) devices.push_back (device);
+        pid++;  // The host is process 0
+
+        unsigned int tid = 0;
+        for (const Lane &lane : lanes)
+            if (lane.pid == pid) tid += 2;
+
+        Lane lane { queue, "queue" + std::to_string (lanes.size ()), pid, tid, 0.0, isProfiling (queue) };
+        if (tracing && lane.enabled) calibrate (lane);
+        lanes.push_back (lane);
+        return lanes.size () - 1;
+    }
+
+
+    /*! \details The end of a marker is taken to coincide with the host time at which 
+     *           the wait on it returns. The offset is late by the latency of the wait, 
+     *           and by the time the marker spends behind other commands of the queue, 
+     *           so `open` is best called between time steps.
+     *
+     *  \param[in] lane lane of the queue.
+     */
+    void Tracer::calibrate (Lane &lane)
+    {
+        cl::Event marker;
+        lane.queue.enqueueMarkerWithWaitList (nullptr, &marker);
+        marker.wait ();
+        double host = now ();
+        lane.offset = host - marker.getProfilingInfo<CL_PROFILING_COMMAND_END> () * 1e-3;
+    }
+
+
+    /*! \details A command that failed is dropped.
+     *
+     *  \param[in] wait flag to indicate whether to wait for the commands 
+     *                  that are still in flight, or to keep them pending.
+     */
+    void Tracer::resolve (bool wait)
+    {
+        size_t kept = 0;
+        for (Command &c : pending)
+        {
+            try
+            {
+                cl_int status = c.last.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS> ();
+                if (status < CL_COMPLETE) continue;
+                if (status > CL_COMPLETE)
+                {
+                    if (!wait)
+                    {
+                        pending[kept++] = c;
+                        continue;
+                    }
+                    c.last.wait ();
+                }
+
+                const Lane &lane = lanes[c.lane];
+                bool seq = c.first () != nullptr;
+                double queued = (seq ? c.first : c.last).getProfilingInfo<CL_PROFILING_COMMAND_QUEUED> () * 1e-3 + lane.offset;
+                double submit = c.last.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT> () * 1e-3 + lane.offset;
+                double start = c.last.getProfilingInfo<CL_PROFILING_COMMAND_START> () * 1e-3 + lane.offset;
+                double end = c.last.getProfilingInfo<CL_PROFILING_COMMAND_END> () * 1e-3 + lane.offset;
+                double begin = seq ? c.first.getProfilingInfo<CL_PROFILING_COMMAND_END> () * 1e-3 + lane.offset : start;
+
+                entries.push_back ({ c.name, lane.pid, lane.tid, begin, end - begin, true, false, queued, submit, start, end });
+                if (begin > queued)
+                    entries.push_back ({ c.name, lane.pid, lane.tid + 1, queued, begin - queued, true, true, queued, submit, start, end });
+            }
+            catch (const cl::Error &error)
+            {
+                // The command failed, or its profiling information is not available
+            }
+        }
+        pending.resize (kept);
+    }
+
+
+    /*! \details Commands and host spans are complete events (`X`), and the times 
+     *           the commands spent in the queues are async events (`b`, `e`), since 
+     *           they overlap. The times are in us from the start of the recording.
+     *
+     *  \param[in] out stream to write to.
+     */
+    void Tracer::write (std::ostream &out)
+    {
+        out << std::fixed << std::setprecision (3);
+        out << "{\"traceEvents\":[\n";
+
+        // Names of the processes and the tracks
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"host\"}}";
+        for (unsigned int i = 0; i < devices.size (); ++i)
+            out << ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << i + 1 
+                << ",\"args\":{\"name\":\"" << escape (devices[i].getInfo<CL_DEVICE_NAME> ()) << "\"}}";
+        for (const Lane &lane : lanes)
+        {
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << lane.pid << ",\"tid\":" << lane.tid 
+                << ",\"args\":{\"name\":\"" << escape (lane.name) << "\"}}";
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << lane.pid << ",\"tid\":" << lane.tid + 1 
+                << ",\"args\":{\"name\":\"" << escape (lane.name) << " (queued)\"}}";
+        }
+        for (const auto &thread : threads)
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread.second 
+                << ",\"args\":{\"name\":\"thread " << thread.second << "\"}}";
+
+        for (size_t i = 0; i < entries.size (); ++i)
+        {
+            const Entry &e = entries[i];
+            std::string name = escape (e.name);
+            if (e.wait)
+            {
+                out << ",\n{\"name\":\"" << name << "\",\"cat\":\"queued\",\"ph\":\"b\",\"id\":" << i 
+                    << ",\"pid\":" << e.pid << ",\"tid\":" << e.tid << ",\"ts\":" << e.ts - origin << "}";
+                out << ",\n{\"name\":\"" << name << "\",\"cat\":\"queued\",\"ph\":\"e\",\"id\":" << i 
+                    << ",\"pid\":" << e.pid << ",\"tid\":" << e.tid << ",\"ts\":" << e.ts + e.dur - origin << "}";
+                continue;
+            }
+
+            out << ",\n{\"name\":\"" << name << "\",\"cat\":\"" << (e.device ? "device" : "host") 
+                << "\",\"ph\":\"X\",\"pid\":" << e.pid << ",\"tid\":" << e.tid 
+                << ",\"ts\":" << e.ts - origin << ",\"dur\":" << e.dur;
+            if (e.device)
+                out << ",\"args\":{\"queued\":" << e.queued - origin << ",\"submit\":" << e.submit - origin 
+                    << ",\"start\":" << e.start - origin << ",\"end\":" << e.end - origin << "}";
+            out << "}";
+        }
+
+        out << "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"dropped\":" << dropped << "}}\n";
+    }
+
+}
+}
@@ -0,0 +1,293 @@
+/*! \file trajectory.cpp
+ *  \brief Defines classes for logging and evaluating the estimated trajectory.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <tuple>
+#include <eigen3/Eigen/Geometry>
+#include <oclslam/pose_graph.hpp>
+#include <oclslam/trajectory.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    namespace
+    {
+        /*! \brief Converts a record to a rigid body transformation. */
+        inline Pose toPose (const TrajectoryRecord &rec)
+        {
+            return Pose (rec.q.normalized ().toRotationMatrix ().cast<double> (), rec.t.cast<double> (), 1.0);
+        }
+    }
+
+
+    /*! \param[in] filename name of the file.
+     *  \return `false` if the file failed to open.
+     */
+    bool TrajectoryLog::open (const std::string &filename)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        if (file.is_open ()) file.close ();
+        file.open (filename.c_str (), std::ios::out | std::ios::trunc);
+        if (!file.is_open ())
+        {
+            std::cerr << "Error[TrajectoryLog]: Failed to open " << filename << std::endl;
+            return false;
+        }
+
+        file << "# timestamp tx ty tz qx qy qz qw scale sensor_timestamp time_step "
+             << "icp_iterations latency_ms pre_latency_ms icp_latency_ms" << std::endl;
+        file << std::fixed;
+
+        return true;
+    }
+
+
+    void TrajectoryLog::close ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (file.is_open ()) file.close ();
+    }
+
+
+    bool TrajectoryLog::isOpen ()
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        return file.is_open ();
+    }
+
+
+    /*! \note The call is a no-op if no file is open.
+     *
+     *  \param[in] rec record to write.
+     */
+    void TrajectoryLog::append (const TrajectoryRecord &rec)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+        if (!file.is_open ()) return;
+
+        file << std::setprecision (6) << rec.timestamp << " "
+             << std::setprecision (6) << 1e-3f * rec.t[0] << " " << 1e-3f * rec.t[1] << " " << 1e-3f * rec.t[2] << " "
+             << std::setprecision (7) << rec.q.x () << " " << rec.q.y () << " " << rec.q.z () << " " << rec.q.w () << " "
+             << rec.s << " " << rec.sensorTimestamp << " " << rec.timeStep << " " << rec.icpIterations << " "
+             << std::setprecision (3) << rec.latency << " " << rec.preLatency << " " << rec.icpLatency << "\n";
+    }
+
+
+    /*! \details Lines starting with `#` are ignored. Missing extra columns are zero,
+     *           apart from the scale which is one.
+     *
+     *  \param[in] filename name of the file.
+     *  \return The records, sorted by their timestamps.
+     */
+    std::vector<TrajectoryRecord> readTrajectory (const std::string &filename)
+    {
+        std::vector<TrajectoryRecord> records;
+        std::ifstream file (filename.c_str ());
+        if (!file.is_open ())
+        {
+            std::cerr << "Error[readTrajectory]: Failed to open " << filename << std::endl;
+            return records;
+        }
+
+        std::string line;
+        while (std::getline (file, line))
+        {
+            if (line.empty () || line[0] == '#') continue;
+            std::replace (line.begin (), line.end (), ',', ' ');
+            std::istringstream iss (line);
+
+            TrajectoryRecord rec;
+            float qx, qy, qz, qw;
+            if (!(iss >> rec.timestamp >> rec.t[0] >> rec.t[1] >> rec.t[2] >> qx >> qy >> qz >> qw)) continue;
+            rec.t *= 1e3f;  // to mm
+            rec.q = Eigen::Quaternion<float, Eigen::DontAlign> (qw, qx, qy, qz);
+
+            rec.s = 1.f; rec.sensorTimestamp = 0; rec.timeStep = records.size (); rec.icpIterations = 0;
+            rec.latency = 0.f; rec.preLatency = 0.f; rec.icpLatency = 0.f;
+            iss >> rec.s >> rec.sensorTimestamp >> rec.timeStep >> rec.icpIterations
+                >> rec.latency >> rec.preLatency >> rec.icpLatency;
+
+            records.push_back (rec);
+        }
+
+        std::stable_sort (records.begin (), records.end (),
+            [] (const TrajectoryRecord &a, const TrajectoryRecord &b) { return a.timestamp < b.timestamp; });
+
+        return records;
+    }
+
+
+    /*! \param[in] errors set of errors.
+     *  \return The statistics of the set.
+     */
+    ErrorStats computeStats (std::vector<double> errors)
+    {
+        ErrorStats stats = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, (unsigned int) errors.size () };
+        if (errors.empty ()) return stats;
+
+        double sum = 0.0, sqSum = 0.0;
+        for (double e : errors) { sum += e; sqSum += e * e; }
+
+        std::sort (errors.begin (), errors.end ());
+        size_t N = errors.size ();
+
+        stats.mean = sum / N;
+        stats.rmse = std::sqrt (sqSum / N);
+        stats.stddev = std::sqrt (std::max (0.0, sqSum / N - stats.mean * stats.mean));
+        stats.median = (N % 2) ? errors[N / 2] : 0.5 * (errors[N / 2 - 1] + errors[N / 2]);
+        stats.min = errors.front ();
+        stats.max = errors.back ();
+
+        return stats;
+    }
+
+
+    /*! \details Follows the scheme of the `TUM RGB-D` benchmark tools. Candidate pairs
+     *           within `maxDiff` are considered in order of increasing time difference,
+     *           and each record participates in at most one pair.
+     *
+     *  \param[in] est estimated trajectory (sorted by timestamp).
+     *  \param[in] gt ground truth trajectory (sorted by timestamp).
+     *  \param[in] maxDiff maximum time difference (in s) between two associated records.
+     *  \return The pairs of indices of the associated records (est, gt), sorted by time.
+     */
+    std::vector<std::pair<unsigned int, unsigned int>>
+    associate (const std::vector<TrajectoryRecord> &est, const std::vector<TrajectoryRecord> &gt, double maxDiff)
+    {
+        std::vector<std::tuple<double, unsigned int, unsigned int>> candidates;
+        for (unsigned int i = 0; i < est.size (); ++i)
+        {
+            auto it = std::lower_bound (gt.begin (), gt.end (), est[i].timestamp,
+                [] (const TrajectoryRecord &rec, double t) { return rec.timestamp < t; });
+
+            // Neighbors on either side within the window
+            for (auto jt = it; jt != gt.end () && jt->timestamp - est[i].timestamp <= maxDiff; ++jt)
+                candidates.emplace_back (jt->timestamp - est[i].timestamp, i, jt - gt.begin ());
+            for (auto jt = it; jt != gt.begin () && est[i].timestamp - (jt - 1)->timestamp <= maxDiff; --jt)
+                candidates.emplace_back (est[i].timestamp - (jt - 1)->timestamp, i, jt - 1 - gt.begin ());
+        }
+        std::sort (candidates.begin (), candidates.end ());
+
+        std::vector<bool> usedEst (est.size (), false), usedGT (gt.size (), false);
+        std::vector<std::pair<unsigned int, unsigned int>> matches;
+        for (const auto &c : candidates)
+        {
+            unsigned int i = std::get<1> (c), j = std::get<2> (c);
+            if (usedEst[i] || usedGT[j]) continue;
+            usedEst[i] = usedGT[j] = true;
+            matches.emplace_back (i, j);
+        }
+        std::sort (matches.begin (), matches.end ());
+
+        return matches;
+    }
+
+
+    /*! \details The estimated positions are first aligned to the ground truth with
+     *           the closed-form solution of Umeyama.
+     *
+     *  \param[in] est estimated trajectory.
+     *  \param[in] gt ground truth trajectory.
+     *  \param[in] matches associated records (see `associate`).
+     *  \param[in] withScale flag to indicate whether to estimate a scale in the alignment.
+     *  \param[out] alignment transformation that aligns the estimated trajectory to the ground truth.
+     *  \return The statistics of the position errors (in mm).
+     */
+    ErrorStats computeATE (const std::vector<TrajectoryRecord> &est, const std::vector<TrajectoryRecord> &gt,
+                           const std::vector<std::pair<unsigned int, unsigned int>> &matches,
+                           bool withScale, Eigen::Matrix4d *alignment)
+    {
+        if (matches.size () < 3) return computeStats (std::vector<double> ());
+
+        Eigen::Matrix3Xd src (3, matches.size ()), dst (3, matches.size ());
+        for (unsigned int k = 0; k < matches.size (); ++k)
+        {
+            src.col (k) = est[matches[k].first].t.cast<double> ();
+            dst.col (k) = gt[matches[k].second].t.cast<double> ();
+        }
+
+        Eigen::Matrix4d T = Eigen::umeyama (src, dst, withScale);
+        if (alignment != nullptr) *alignment = T;
+
+        Eigen::Matrix3Xd aligned = (T.topLeftCorner<3, 3> () * src).colwise () + T.topRightCorner<3, 1> ();
+        std::vector<double> errors (matches.size ());
+        for (unsigned int k = 0; k < matches.size (); ++k)
+            errors[k] = (aligned.col (k) - dst.col (k)).norm ();
+
+        return computeStats (errors);
+    }
+
+
+    /*! \details For every associated record, the record that follows after `delta`
+     *           seconds is found, and the relative motion between the two is compared
+     *           against the ground truth.
+     *
+     *  \param[in] est estimated trajectory.
+     *  \param[in] gt ground truth trajectory.
+     *  \param[in] matches associated records (see `associate`).
+     *  \param[in] delta time interval (in s) over which to measure the drift.
+     *  \param[out] trans statistics of the translational errors (in mm).
+     *  \param[out] rot statistics of the rotational errors (in degrees).
+     */
+    void computeRPE (const std::vector<TrajectoryRecord> &est, const std::vector<TrajectoryRecord> &gt,
+                     const std::vector<std::pair<unsigned int, unsigned int>> &matches, double delta,
+                     ErrorStats &trans, ErrorStats &rot)
+    {
+        std::vector<double> tErrors, rErrors;
+
+        unsigned int b = 0;
+        for (unsigned int a = 0; a < matches.size (); ++a)
+        {
+            double target = gt[matches[a].second].timestamp + delta;
+            if (b <= a) b = a + 1;
+            while (b < matches.size () && gt[matches[b].second].timestamp < target) ++b;
+            if (b == matches.size ()) break;
+
+            Pose relGT = toPose (gt[matches[a].second]).inverse () * toPose (gt[matches[b].second]);
+            Pose relEst = toPose (est[matches[a].first]).inverse () * toPose (est[matches[b].first]);
+            Pose E = relGT.inverse () * relEst;
+
+            tErrors.push_back (E.t.norm ());
+            rErrors.push_back (180.0 / M_PI * logRotation (E.R).norm ());
+        }
+
+        trans = computeStats (tErrors);
+        rot = computeStats (rErrors);
+    }
+
+}
+}
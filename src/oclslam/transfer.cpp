@@ -0,0 +1,136 @@
+/*! \file transfer.cpp
+ *  \brief Defines a class for moving buffers between the devices of the pipeline.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <vector>
+#include <oclslam/transfer.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    BufferTransfer::BufferTransfer () : 
+        srcQueue (nullptr), dstQueue (nullptr), hPtr (nullptr), size (0), 
+        active (false), staged (false), pending (false)
+    {
+    }
+
+
+    BufferTransfer::~BufferTransfer ()
+    {
+        if (!staged) return;
+
+        if (dstEvent ()) dstEvent.wait ();
+        srcQueue->enqueueUnmapMemObject (hBuffer, hPtr);
+        srcQueue->finish ();
+    }
+
+
+    /*! \details The transfer is staged through host memory when the contexts differ.
+     *
+     *  \param[in] srcContext context of the source buffer.
+     *  \param[in] srcQueue command queue that computes the source buffer.
+     *  \param[in] src source buffer.
+     *  \param[in] dstContext context of the destination buffer.
+     *  \param[in] dstQueue command queue that consumes the destination buffer.
+     *  \param[in] dst destination buffer.
+     *  \param[in] _size number of bytes to transfer.
+     */
+    void BufferTransfer::init (cl::Context &srcContext, cl::CommandQueue &srcQueue, const cl::Buffer &src, 
+                               cl::Context &dstContext, cl::CommandQueue &dstQueue, const cl::Buffer &dst, size_t _size)
+    {
+        this->srcQueue = &srcQueue;
+        this->dstQueue = &dstQueue;
+        this->src = src;
+        this->dst = dst;
+        size = _size;
+        staged = srcContext () != dstContext ();
+        active = true;
+
+        if (staged)
+        {
+            // Pinned memory on the side of the read, kept mapped for the lifetime of the object
+            hBuffer = cl::Buffer (srcContext, CL_MEM_ALLOC_HOST_PTR, size);
+            hPtr = srcQueue.enqueueMapBuffer (hBuffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size);
+        }
+    }
+
+
+    /*! \details Within a context, it places a marker on the source queue. Across contexts, 
+     *           it enqueues a non-blocking read into the host buffer, after the write of 
+     *           the previous transfer has released it.
+     */
+    void BufferTransfer::begin ()
+    {
+        if (!active) return;
+
+        if (staged)
+        {
+            if (dstEvent ()) dstEvent.wait ();
+            if (pending) srcEvent.wait ();  // The previous transfer never completed
+            srcQueue->enqueueReadBuffer (src, CL_FALSE, 0, size, hPtr, nullptr, &srcEvent);
+            srcQueue->flush ();
+        }
+        else
+            srcQueue->enqueueMarkerWithWaitList (nullptr, &srcEvent);
+
+        pending = true;
+    }
+
+
+    /*! \details Within a context, it enqueues the copy on the destination queue, 
+     *           after the marker of the source queue, and holds back the source 
+     *           queue until the copy is done, so the source buffer doesn't get 
+     *           overwritten in the meantime. Across contexts, it waits on the host 
+     *           for the read (events can't be shared between contexts) and then 
+     *           enqueues a non-blocking write.
+     */
+    void BufferTransfer::end ()
+    {
+        if (!active || !pending) return;
+
+        if (staged)
+        {
+            srcEvent.wait ();
+            dstQueue->enqueueWriteBuffer (dst, CL_FALSE, 0, size, hPtr, nullptr, &dstEvent);
+        }
+        else
+        {
+            std::vector<cl::Event> waitList (1, srcEvent);
+            dstQueue->enqueueCopyBuffer (src, dst, 0, 0, size, &waitList, &dstEvent);
+            waitList[0] = dstEvent;
+            srcQueue->enqueueBarrierWithWaitList (&waitList);
+        }
+        dstQueue->flush ();
+
+        pending = false;
+    }
+
+}
+}
@@ -0,0 +1,219 @@
+/*! \file tuner.cpp
+ *  \brief Defines a facility that finds the fastest launch configurations of the kernels on a device.
+ *  \author Nick Lamprianidis
+ *  \version 0.1.0
+ *  \date 2015
+ *  \copyright The MIT License (MIT)
+ *  \par
+ *  Copyright (c) 2015 Nick Lamprianidis
+ *  \par
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  \par
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *  \par
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cmath>
+#include <unistd.h>
+#include <oclslam/tuner.hpp>
+
+
+namespace cl_algo
+{
+namespace oclslam
+{
+
+    /*! \param[in] _dir directory of the stored configurations. It's expected 
+     *                  to exist. An empty string keeps them in memory only.
+     */
+    LaunchTuner::LaunchTuner (const std::string &_dir) : dir (_dir)
+    {
+    }
+
+
+    /*! \param[in] device OpenCL device.
+     *  \param[in] kernel name of the kernel.
+     *  \param[in] size problem size the kernel was tuned for (e.g. number of points).
+     *  \param[out] config the stored configuration. Untouched if there is none.
+     *  \return `true` if a configuration was found.
+     */
+    bool LaunchTuner::lookup (const cl::Device &device, const std::string &kernel, unsigned int size, 
+                              LaunchConfig &config)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        std::string path;
+        Table &table = getTable (device, path);
+        auto it = table.find (std::make_pair (kernel, size));
+        if (it == table.end ()) return false;
+
+        config = it->second;
+        return true;
+    }
+
+
+    /*! \details The file of the device is rewritten right away.
+     *
+     *  \param[in] device OpenCL device.
+     *  \param[in] kernel name of the kernel.
+     *  \param[in] size problem size the kernel was tuned for (e.g. number of points).
+     *  \param[in] config the configuration.
+     */
+    void LaunchTuner::store (const cl::Device &device, const std::string &kernel, unsigned int size, 
+                             const LaunchConfig &config)
+    {
+        std::lock_guard<std::mutex> lock (mtx);
+
+        std::string path;
+        Table &table = getTable (device, path);
+        table[std::make_pair (kernel, size)] = config;
+        if (!path.empty ()) save (path, table);
+    }
+
+
+    /*! \details The sizes are limited by the work-group size of the kernel on the device, 
+     *           which accounts for the register and local memory usage of the kernel.
+     *
+     *  \param[in] kernel OpenCL kernel.
+     *  \param[in] device OpenCL device.
+     *  \param[in] minSize smallest local size.
+     *  \param[in] maxSize largest local size.
+     *  \return The local sizes, in increasing order.
+     */
+    std::vector<unsigned int> LaunchTuner::getLocalSizes (const cl::Kernel &kernel, const cl::Device &device, 
+                                                          unsigned int minSize, unsigned int maxSize)
+    {
+        size_t limit = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE> (device);
+
+        std::vector<unsigned int> sizes;
+        for (unsigned int size = minSize; size <= maxSize && size <= limit; size <<= 1)
+            sizes.push_back (size);
+        return sizes;
+    }
+
+
+    /*! \details Every candidate is applied, run once to warm up, and then timed over 
+     *           `repeats` runs. Candidates the device rejects are skipped.
+     *
+     *  \param[in] queue command queue on which `run` enqueues its work.
+     *  \param[in] candidates configurations to time.
+     *  \param[in] apply function that sets up a configuration.
+     *  \param[in] run function that enqueues the work to time.
+     *  \param[in] repeats number of timed runs for each configuration.
+     *  \return The fastest configuration, which is left applied.
+     */
+    LaunchConfig LaunchTuner::sweep (cl::CommandQueue &queue, const std::vector<LaunchConfig> &candidates, 
+                                     std::function<void (const LaunchConfig &)> apply, 
+                                     std::function<void ()> run, unsigned int repeats)
+    {
+        clutils::CPUTimer<double, std::micro> timer;
+        LaunchConfig best = candidates.front ();
+        double bestTime = INFINITY;
+
+        for (const LaunchConfig &config : candidates)
+        {
+            try
+            {
+                apply (config);
+                run ();
+                queue.finish ();
+
+                timer.start ();
+                for (unsigned int i = 0; i < repeats; ++i) run ();
+                queue.finish ();
+                double time = timer.stop () / repeats;
+
+                if (time < bestTime)
+                {
+                    best = config;
+                    bestTime = time;
+                }
+            }
+            catch (const cl::Error &error)
+            {
+                queue.finish ();
+            }
+        }
+
+        apply (best);
+        return best;
+    }
+
+
+    /*! \details The table of a device is loaded from its file on first access. 
+     *           Malformed lines, and the lines of older files without the 
+     *           problem size, are ignored.
+     *
+     *  \param[in] device OpenCL device.
+     *  \param[out] path path of the file of the device. Empty if there is no directory.
+     *  \return The table.
+     */
+    LaunchTuner::Table& LaunchTuner::getTable (const cl::Device &device, std::string &path)
+    {
+        std::ostringstream oss;
+        oss << std::hex << std::setw (16) << std::setfill ('0') << hashDevice (device);
+        std::string key = oss.str ();
+        if (!dir.empty ()) path = dir + "/tuning-" + key + ".txt";
+
+        auto it = tables.find (key);
+        if (it != tables.end ()) return it->second;
+
+        Table &table = tables[key];
+        if (path.empty ()) return table;
+
+        std::ifstream file (path.c_str ());
+        std::string line;
+        while (std::getline (file, line))
+        {
+            if (line.empty () || line[0] == '#') continue;
+
+            std::istringstream iss (line);
+            std::string kernel;
+            unsigned int size;
+            LaunchConfig config;
+            if (iss >> kernel >> size >> config.local >> config.ppw && config.ppw > 0)
+                table[std::make_pair (kernel, size)] = config;
+        }
+
+        return table;
+    }
+
+
+    /*! \details The table is written to a temporary file, which is then renamed, 
+     *           so concurrent processes never see a partial file. Failures are ignored.
+     */
+    void LaunchTuner::save (const std::string &path, const Table &table)
+    {
+        std::string tmpPath = path + ".tmp" + std::to_string (getpid ());
+        {
+            std::ofstream file (tmpPath.c_str (), std::ios::trunc);
+            if (!file.is_open ()) return;
+            file << "# kernel size local points-per-work-item\n";
+            for (const auto &entry : table)
+                file << entry.first.first << " " << entry.first.second << " " 
+                     << entry.second.local << " " << entry.second.ppw << "\n";
+            if (!file) { file.close (); std::remove (tmpPath.c_str ()); return; }
+        }
+        if (std::rename (tmpPath.c_str (), path.c_str ()) != 0) std::remove (tmpPath.c_str ());
+    }
+
+}
+}
@@ -38,11 +38,42 @@
 #include <random>
 #include <limits>
 #include <cmath>
+#include <numeric>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <dirent.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
 #include <CLUtils.hpp>
 #include <RBC/data_types.hpp>
 #include <oclslam/algorithms.hpp>
+#include <oclslam/pose_graph.hpp>
+#include <oclslam/loop_closure.hpp>
+#include <oclslam/registration.hpp>
+#include <oclslam/trajectory.hpp>
+#include <oclslam/map_server.hpp>
+#include <oclslam/sliding_window.hpp>
+#include <oclslam/tiled_map.hpp>
+#include <oclslam/map_maintenance.hpp>
+#include <oclslam/distance_field.hpp>
+#include <oclslam/batched_update.hpp>
+#include <oclslam/occupancy_grid.hpp>
+#include <oclslam/frontiers.hpp>
+#include <oclslam/linear_octree.hpp>
+#include <oclslam/brick_map.hpp>
+#include <oclslam/program_cache.hpp>
+#include <oclslam/transfer.hpp>
+#include <oclslam/memory.hpp>
+#include <oclslam/scheduler.hpp>
+#include <oclslam/tracer.hpp>
+#include <oclslam/tuner.hpp>
+#include <oclslam/cpu/thread_pool.hpp>
+#include <oclslam/cpu/algorithms.hpp>
 #include <oclslam/tests/helper_funcs.hpp>
+#include <icp_config.hpp>
 
 
 // Kernel filenames
@@ -153,6 +184,2677 @@ TEST (OCLSLAM, splitPC8D_octomap)
 }
 
 
+/*! \brief Tests the zero-copy staging of the **splitPC8D_octomap** kernel.
+ *  \details On a device with unified memory, the outputs are mapped instead 
+ *           of copied. Anywhere else, the staging falls back to explicit copies. 
+ *           Either way, the results have to be valid on every time step.
+ */
+TEST (OCLSLAM, splitPC8D_zeroCopy)
+{
+    try
+    {
+        const unsigned int points = 640 * 480;
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        // Configure kernel execution parameters
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+        cl_algo::oclslam::SplitPC8D sp8D (clEnv, info);
+        sp8D.init (points, cl_algo::oclslam::Staging::ZC);
+
+        std::vector<cl_float8> in (points);
+        std::vector<cl_float> refPC3D (3 * points);
+        std::vector<cl_uchar> refRGB (3 * points);
+
+        for (int step = 0; step < 2; ++step)
+        {
+            cl_float *pIn = (cl_float *) in.data ();
+            std::generate (pIn, pIn + 8 * points, oclslam::rNum_R_0_1);
+
+            sp8D.write (cl_algo::oclslam::SplitPC8D::Memory::D_IN, in.data ());
+            sp8D.run ();
+            cl_float *pc3d = (cl_float *) sp8D.read (cl_algo::oclslam::SplitPC8D::Memory::H_OUT_PC3D, CL_FALSE);
+            cl_uchar *rgb = (cl_uchar *) sp8D.read (cl_algo::oclslam::SplitPC8D::Memory::H_OUT_RGB);
+
+            oclslam::cpuSplitPC8D (pIn, refPC3D.data (), refRGB.data (), points);
+
+            float eps = 42 * std::numeric_limits<float>::epsilon ();
+            for (uint k = 0; k < 3 * points; ++k)
+            {
+                ASSERT_LT (std::abs (refPC3D[k] - pc3d[k]), eps);
+                ASSERT_EQ (refRGB[k], rgb[k]);
+            }
+        }
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the **icpResiduals** kernel.
+ *  \details The kernel transforms a sample of the moving landmarks and 
+ *           computes the squared distances to their nearest fixed landmarks.
+ */
+TEST (OCLSLAM, icpResiduals)
+{
+    try
+    {
+        const unsigned int m = 16384, samples = 1024;
+        const unsigned int bufferInSize = m * sizeof (cl_float8);
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0, CL_QUEUE_PROFILING_ENABLE);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        // Configure kernel execution parameters
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+        cl_algo::oclslam::ICPResiduals res (clEnv, info);
+        res.init (m, samples);
+
+        // Initialize data (writes on staging buffers directly)
+        for (unsigned int k = 0; k < 8 * m; ++k)
+        {
+            res.hPtrInF[k] = 2000.f * oclslam::rNum_R_0_1 ();
+            res.hPtrInM[k] = 2000.f * oclslam::rNum_R_0_1 ();
+        }
+        for (unsigned int k = 0; k < m; k += 7)  // Invalidate some landmarks
+        {
+            res.hPtrInF[8 * k + 2] = 0.f;
+            res.hPtrInM[8 * k + 2] = 0.f;
+        }
+
+        Eigen::Quaternionf q (Eigen::AngleAxisf (0.1f, Eigen::Vector3f (1.f, 2.f, 3.f).normalized ()));
+        Eigen::Vector3f t (15.f, -20.f, 35.f);
+        float sc = 1.02f;
+        cl_float T[8] = { q.x (), q.y (), q.z (), q.w (), t[0], t[1], t[2], sc };
+        res.setTransformation (q, t, sc);
+
+        // Copy data to device
+        res.write (cl_algo::oclslam::ICPResiduals::Memory::D_IN_F);
+        res.write (cl_algo::oclslam::ICPResiduals::Memory::D_IN_M);
+
+        res.run ();  // Execute kernels
+        
+        // Copy results to host
+        cl_float *results = (cl_float *) res.read ();
+
+        // Produce reference residuals
+        cl_float *refRes = new cl_float[samples];
+        oclslam::cpuICPResiduals (res.hPtrInF, res.hPtrInM, refRes, T, m, samples);
+
+        // Verify the residuals
+        for (uint k = 0; k < samples; ++k)
+            ASSERT_LE (std::abs (refRes[k] - results[k]), 1e-4f * std::max (1.f, std::abs (refRes[k])));
+
+        // Profiling ===========================================================
+        if (profiling)
+        {
+            const int nRepeat = 1;  /* Number of times to perform the tests. */
+
+            // CPU
+            clutils::CPUTimer<double, std::milli> cTimer;
+            clutils::ProfilingInfo<nRepeat> pCPU ("CPU");
+            for (int i = 0; i < nRepeat; ++i)
+            {
+                cTimer.start ();
+                oclslam::cpuICPResiduals (res.hPtrInF, res.hPtrInM, refRes, T, m, samples);
+                pCPU[i] = cTimer.stop ();
+            }
+            
+            // GPU
+            clutils::GPUTimer<std::milli> gTimer (clEnv.devices[0][0]);
+            clutils::ProfilingInfo<nRepeat> pGPU ("GPU");
+            for (int i = 0; i < nRepeat; ++i)
+                pGPU[i] = res.run (gTimer);
+
+            // Benchmark
+            pGPU.print (pCPU, "icpResiduals");
+        }
+
+        delete[] refRes;
+
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the **icpAssociate** and **icpSolve** kernels.
+ *  \details A surface sampled on the landmark grid is registered against 
+ *           a displaced copy of itself, with the whole iteration loop on the 
+ *           device. The result has to agree with the serial reference and 
+ *           with the known transformation.
+ */
+TEST (OCLSLAM, deviceICP)
+{
+    try
+    {
+        const unsigned int side = 128, m = side * side;
+        const unsigned int maxIterations = 40;
+        const int radius = 4;
+        const float maxDist = 100.f, angleThreshold = 0.001f, translationThreshold = 0.01f;
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0, CL_QUEUE_PROFILING_ENABLE);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        // Configure kernel execution parameters
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+        cl_algo::oclslam::DeviceICP icp (clEnv, info);
+        icp.init (side, side, maxIterations, angleThreshold, translationThreshold, 
+                  radius, maxDist, cl_algo::oclslam::Staging::IO);
+
+        // Initialize data (writes on staging buffers directly)
+        // A surface sampled on a grid, and the same surface displaced
+        Eigen::Matrix3f R = Eigen::AngleAxisf (3.f * M_PI / 180.f, 
+            Eigen::Vector3f (1.f, 2.f, 3.f).normalized ()).toRotationMatrix ();
+        Eigen::Vector3f t (20.f, -15.f, 30.f);
+        for (unsigned int k = 0; k < m; ++k)
+        {
+            float x = 15.f * ((int) (k % side) - (int) side / 2);
+            float y = 15.f * ((int) (k / side) - (int) side / 2);
+            float z = 2000.f + 200.f * std::sin (x / 120.f) * std::cos (y / 150.f) + 0.1f * x;
+            Eigen::Vector3f pF (x, y, z), pM = R.transpose () * (pF - t);
+
+            for (unsigned int j = 0; j < 3; ++j)
+            {
+                icp.hPtrInF[8 * k + j] = pF[j];
+                icp.hPtrInM[8 * k + j] = pM[j];
+            }
+            icp.hPtrInF[8 * k + 3] = icp.hPtrInM[8 * k + 3] = 1.f;
+            for (unsigned int j = 4; j < 8; ++j)
+                icp.hPtrInF[8 * k + j] = icp.hPtrInM[8 * k + j] = 0.5f;
+        }
+        for (unsigned int k = 0; k < m; k += 13)  // Invalidate some landmarks
+            icp.hPtrInF[8 * k + 2] = 0.f;
+        for (unsigned int k = 0; k < m; k += 17)
+            icp.hPtrInM[8 * k + 2] = 0.f;
+
+        // Copy data to device
+        icp.write (cl_algo::oclslam::DeviceICP::Memory::D_IN_F);
+        icp.write (cl_algo::oclslam::DeviceICP::Memory::D_IN_M);
+
+        icp.run ();  // Execute kernels
+        
+        // Copy results to host
+        icp.read ();
+
+        // Produce reference transformation
+        cl_float refT[8];
+        unsigned int refK = oclslam::cpuDeviceICP (icp.hPtrInF, icp.hPtrInM, refT, side, side, radius, 
+                                                   maxDist, maxIterations, angleThreshold, translationThreshold);
+        Eigen::Matrix3f refR = Eigen::Quaternionf (refT[3], refT[0], refT[1], refT[2]).toRotationMatrix ();
+
+        // Verify the transformation against the reference and the ground truth
+        ASSERT_TRUE (icp.converged);
+        ASSERT_LE (std::abs ((int) icp.k - (int) refK), 2);
+        ASSERT_LT (180.f / M_PI * Eigen::AngleAxisf (icp.R * refR.transpose ()).angle (), 0.01f);
+        ASSERT_LT ((icp.t - Eigen::Vector3f (refT[4], refT[5], refT[6])).norm (), 0.5f);
+        ASSERT_LT (180.f / M_PI * Eigen::AngleAxisf (icp.R * R.transpose ()).angle (), 0.05f);
+        ASSERT_LT ((icp.t - t).norm (), 2.f);
+        ASSERT_NEAR (icp.s, 1.f, 1e-3f);
+
+        // Profiling ===========================================================
+        if (profiling)
+        {
+            const int nRepeat = 1;  /* Number of times to perform the tests. */
+
+            // CPU
+            clutils::CPUTimer<double, std::milli> cTimer;
+            clutils::ProfilingInfo<nRepeat> pCPU ("CPU");
+            for (int i = 0; i < nRepeat; ++i)
+            {
+                cTimer.start ();
+                oclslam::cpuDeviceICP (icp.hPtrInF, icp.hPtrInM, refT, side, side, radius, 
+                                       maxDist, maxIterations, angleThreshold, translationThreshold);
+                pCPU[i] = cTimer.stop ();
+            }
+            
+            // GPU
+            clutils::GPUTimer<std::milli> gTimer (clEnv.devices[0][0]);
+            clutils::ProfilingInfo<nRepeat> pGPU ("GPU");
+            for (int i = 0; i < nRepeat; ++i)
+                pGPU[i] = icp.run (gTimer);
+
+            // Benchmark
+            pGPU.print (pCPU, "deviceICP");
+        }
+
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the **downsampleRGBD** kernel.
+ *  \details A 640x480 frame pair gets downsampled to 320x240. The depth 
+ *           frame has holes, so that blocks with any number of valid 
+ *           depths get tested.
+ */
+TEST (OCLSLAM, downsampleRGBD)
+{
+    try
+    {
+        const unsigned int width = 640, height = 480, n = width * height;
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0, CL_QUEUE_PROFILING_ENABLE);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        // Configure kernel execution parameters
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+        cl_algo::oclslam::DownsampleRGBD down (clEnv, info);
+        down.init (width, height);
+
+        // Initialize data (writes on staging buffers directly)
+        for (unsigned int k = 0; k < 3 * n; ++k)
+            down.hPtrInRGB[k] = (cl_uchar) (255 * oclslam::rNum_R_0_1 ());
+        for (unsigned int k = 0; k < n; ++k)
+            down.hPtrInD[k] = (oclslam::rNum_R_0_1 () < 0.3f) ? 0 : 
+                (cl_ushort) (500 + 4000 * oclslam::rNum_R_0_1 ());
+
+        // Copy data to device
+        down.write (cl_algo::oclslam::DownsampleRGBD::Memory::D_IN_RGB);
+        down.write (cl_algo::oclslam::DownsampleRGBD::Memory::D_IN_D);
+
+        down.run ();  // Execute kernels
+        
+        // Copy results to host
+        cl_uchar *rgb = (cl_uchar *) down.read (cl_algo::oclslam::DownsampleRGBD::Memory::H_OUT_RGB);
+        cl_ushort *depth = (cl_ushort *) down.read (cl_algo::oclslam::DownsampleRGBD::Memory::H_OUT_D);
+
+        // Produce reference frames
+        cl_uchar *refRGB = new cl_uchar[3 * n / 4];
+        cl_ushort *refD = new cl_ushort[n / 4];
+        oclslam::cpuDownsampleRGBD (down.hPtrInRGB, down.hPtrInD, refRGB, refD, width, height);
+
+        // Verify the frames
+        for (uint k = 0; k < 3 * n / 4; ++k)
+            ASSERT_LE (std::abs (refRGB[k] - rgb[k]), 1);
+        for (uint k = 0; k < n / 4; ++k)
+            ASSERT_EQ (refD[k], depth[k]);
+
+        // Profiling ===========================================================
+        if (profiling)
+        {
+            const int nRepeat = 1;  /* Number of times to perform the tests. */
+
+            // CPU
+            clutils::CPUTimer<double, std::milli> cTimer;
+            clutils::ProfilingInfo<nRepeat> pCPU ("CPU");
+            for (int i = 0; i < nRepeat; ++i)
+            {
+                cTimer.start ();
+                oclslam::cpuDownsampleRGBD (down.hPtrInRGB, down.hPtrInD, refRGB, refD, width, height);
+                pCPU[i] = cTimer.stop ();
+            }
+            
+            // GPU
+            clutils::GPUTimer<std::milli> gTimer (clEnv.devices[0][0]);
+            clutils::ProfilingInfo<nRepeat> pGPU ("GPU");
+            for (int i = 0; i < nRepeat; ++i)
+                pGPU[i] = down.run (gTimer);
+
+            // Benchmark
+            pGPU.print (pCPU, "downsampleRGBD");
+        }
+
+        delete[] refRGB;
+        delete[] refD;
+
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the **icpLMs_grid** kernel.
+ *  \details The landmark grid follows the resolution of the point cloud, 
+ *           and every landmark is the point at the center of its cell.
+ */
+TEST (OCLSLAM, icpLMsGrid)
+{
+    try
+    {
+        ASSERT_EQ (128u, cl_algo::oclslam::ICPLMsGrid::getSide (640, 480));
+        ASSERT_EQ (64u, cl_algo::oclslam::ICPLMsGrid::getSide (320, 240));
+        ASSERT_EQ (32u, cl_algo::oclslam::ICPLMsGrid::getSide (160, 120));
+
+        const unsigned int width = 320, height = 240;
+        const unsigned int side = cl_algo::oclslam::ICPLMsGrid::getSide (width, height);
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0, CL_QUEUE_PROFILING_ENABLE);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        // Configure kernel execution parameters
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+        cl_algo::oclslam::ICPLMsGrid lm (clEnv, info);
+        lm.init (width, height, side);
+
+        // Initialize data (writes on staging buffers directly)
+        for (unsigned int k = 0; k < 8 * width * height; ++k)
+            lm.hPtrIn[k] = 2000.f * oclslam::rNum_R_0_1 ();
+
+        lm.write (cl_algo::oclslam::ICPLMsGrid::Memory::D_IN);
+        lm.run ();
+        cl_float *results = (cl_float *) lm.read (cl_algo::oclslam::ICPLMsGrid::Memory::H_OUT);
+
+        // Verify the landmarks
+        for (uint y = 0; y < side; ++y)
+        {
+            for (uint x = 0; x < side; ++x)
+            {
+                uint px = (2 * x + 1) * width / (2 * side), py = (2 * y + 1) * height / (2 * side);
+                for (uint j = 0; j < 8; ++j)
+                    ASSERT_EQ (lm.hPtrIn[8 * (py * width + px) + j], results[8 * (y * side + x) + j]);
+            }
+        }
+
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the **linearOctreeQuery** kernel.
+ *  \details The log-odds of the points have to be the ones of the octree.
+ */
+TEST (OCLSLAM, linearOctreeQuery)
+{
+    try
+    {
+        const unsigned int n = 1 << 16;
+
+        octomap::OcTree map (0.1);
+        octomap::Pointcloud pc;
+        for (float u = -1.f; u <= 1.f; u += 0.05f)
+            for (float v = -1.f; v <= 1.f; v += 0.05f)
+                pc.push_back (2.f, u, v);
+        map.insertPointCloud (pc, octomap::point3d (0.f, 0.f, 0.f));
+        cl_algo::oclslam::LinearOctree tree;
+        tree.build (map);
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0, CL_QUEUE_PROFILING_ENABLE);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        // Configure kernel execution parameters
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+        cl_algo::oclslam::LinearOctreeQuery query (clEnv, info);
+        query.init (n);
+        query.upload (tree);
+
+        // Initialize data (writes on staging buffers directly)
+        std::vector<octomap::point3d> points (n);
+        for (unsigned int k = 0; k < n; ++k)
+        {
+            points[k] = octomap::point3d (3.f * oclslam::rNum_R_0_1 () - 0.5f, 
+                                          3.f * oclslam::rNum_R_0_1 () - 1.5f, 
+                                          3.f * oclslam::rNum_R_0_1 () - 1.5f);
+            for (int j = 0; j < 3; ++j) query.hPtrIn[4 * k + j] = points[k] (j);
+            query.hPtrIn[4 * k + 3] = 1.f;
+        }
+
+        // Copy data to device
+        query.write (cl_algo::oclslam::LinearOctreeQuery::Memory::D_IN);
+
+        query.run ();  // Execute kernels
+        
+        // Copy results to host
+        cl_float *logOdds = (cl_float *) query.read (cl_algo::oclslam::LinearOctreeQuery::Memory::H_OUT);
+
+        // Produce reference values
+        std::vector<float> refLogOdds;
+        tree.query (points, refLogOdds);
+
+        // Verify the values (points on a cell boundary may be rounded to either side)
+        unsigned int mismatches = 0;
+        for (unsigned int k = 0; k < n; ++k)
+            if (std::isnan (refLogOdds[k]) ? !std::isnan (logOdds[k]) : refLogOdds[k] != logOdds[k])
+                mismatches++;
+        ASSERT_LE (mismatches, n / 1000);
+
+        // Profiling ===========================================================
+        if (profiling)
+        {
+            const int nRepeat = 1;  /* Number of times to perform the tests. */
+
+            // CPU
+            clutils::CPUTimer<double, std::milli> cTimer;
+            clutils::ProfilingInfo<nRepeat> pCPU ("CPU");
+            for (int i = 0; i < nRepeat; ++i)
+            {
+                cTimer.start ();
+                tree.query (points, refLogOdds);
+                pCPU[i] = cTimer.stop ();
+            }
+            
+            // GPU
+            clutils::GPUTimer<std::milli> gTimer (clEnv.devices[0][0]);
+            clutils::ProfilingInfo<nRepeat> pGPU ("GPU");
+            for (int i = 0; i < nRepeat; ++i)
+                pGPU[i] = query.run (gTimer);
+
+            // Benchmark
+            pGPU.print (pCPU, "linearOctreeQuery");
+        }
+
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the **rayCastBricks** kernel.
+ *  \details The rays have to stop at the occupied cells that `OcTree::castRay` 
+ *           stops at, ignoring the unknown ones, and the mirror has to follow 
+ *           the changes of the map.
+ */
+TEST (OCLSLAM, rayCastService)
+{
+    try
+    {
+        const unsigned int n = 1 << 14;
+        const float range = 5.f;
+
+        // A wall at x = 2m
+        octomap::OcTree map (0.1);
+        for (float y = -1.f; y < 1.f; y += 0.1f)
+            for (float z = -1.f; z < 1.f; z += 0.1f)
+                map.updateNode (octomap::point3d (2.05f, y + 0.05f, z + 0.05f), true);
+        cl_algo::oclslam::BrickMap bricks;
+        bricks.setEnabled (true);
+        bricks.update (map);
+        map.resetChangeDetection ();
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0, CL_QUEUE_PROFILING_ENABLE);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        // Configure kernel execution parameters
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+        cl_algo::oclslam::RayCastService rays (clEnv, info);
+        rays.init (n, range);
+        ASSERT_EQ (rays.update (bricks), bricks.getStats ().bricks);
+
+        // Initialize data (writes on staging buffers directly)
+        std::vector<octomap::point3d> origins (n), directions (n);
+        for (unsigned int k = 0; k < n; ++k)
+        {
+            origins[k] = octomap::point3d (oclslam::rNum_R_0_1 () - 0.5f, 
+                                           oclslam::rNum_R_0_1 () - 0.5f, 
+                                           oclslam::rNum_R_0_1 () - 0.5f);
+            directions[k] = octomap::point3d (oclslam::rNum_R_0_1 () - 0.5f, 
+                                              oclslam::rNum_R_0_1 () - 0.5f, 
+                                              oclslam::rNum_R_0_1 () - 0.5f);
+            if (k % 16 == 0) directions[k] = octomap::point3d ();  // Point queries
+            for (int j = 0; j < 3; ++j)
+            {
+                rays.hPtrInO[4 * k + j] = origins[k] (j);
+                rays.hPtrInD[4 * k + j] = directions[k] (j);
+            }
+            rays.hPtrInO[4 * k + 3] = 0.f;  // Default range
+            rays.hPtrInD[4 * k + 3] = 0.f;
+        }
+        origins[0] = octomap::point3d (2.05f, 0.05f, 0.05f);  // A point query on the wall
+        for (int j = 0; j < 3; ++j) rays.hPtrInO[j] = origins[0] (j);
+
+        // Copy data to device
+        rays.write (cl_algo::oclslam::RayCastService::Memory::D_IN_O);
+        rays.write (cl_algo::oclslam::RayCastService::Memory::D_IN_D);
+
+        rays.run ();  // Execute kernels
+        
+        // Copy results to host
+        cl_float *hits = (cl_float *) rays.read (cl_algo::oclslam::RayCastService::Memory::H_OUT);
+
+        // Verify the hits (rays through a cell corner may go either way)
+        ASSERT_EQ (hits[3], 0.f);
+        unsigned int mismatches = 0, hitCount = 0;
+        for (unsigned int k = 1; k < n; ++k)
+        {
+            octomap::point3d end, hit (hits[4 * k], hits[4 * k + 1], hits[4 * k + 2]);
+            bool h = (directions[k].norm () > 0.f) && 
+                     map.castRay (origins[k], directions[k], end, true, range);
+            if (h != (hits[4 * k + 3] >= 0.f) || (h && (end - hit).norm () > 1e-3f)) mismatches++;
+            hitCount += h;
+        }
+        ASSERT_GT (hitCount, 0u);
+        ASSERT_LE (mismatches, n / 1000);
+
+        // The wall is cleared in part, and only the changed bricks are transferred
+        for (float y = -1.f; y < 0.f; y += 0.1f)
+            for (float z = -1.f; z < 1.f; z += 0.1f)
+                for (int i = 0; i < 5; ++i)
+                    map.updateNode (octomap::point3d (2.05f, y + 0.05f, z + 0.05f), false);
+        bricks.update (map);
+        map.resetChangeDetection ();
+        ASSERT_LT (rays.update (bricks), bricks.getStats ().bricks);
+
+        rays.run ();
+        hits = (cl_float *) rays.read (cl_algo::oclslam::RayCastService::Memory::H_OUT);
+        mismatches = 0;
+        for (unsigned int k = 1; k < n; ++k)
+        {
+            octomap::point3d end;
+            bool h = (directions[k].norm () > 0.f) && 
+                     map.castRay (origins[k], directions[k], end, true, range);
+            if (h != (hits[4 * k + 3] >= 0.f)) mismatches++;
+        }
+        ASSERT_LE (mismatches, n / 1000);
+
+        // Profiling ===========================================================
+        if (profiling)
+        {
+            const int nRepeat = 1;  /* Number of times to perform the tests. */
+
+            // CPU
+            clutils::CPUTimer<double, std::milli> cTimer;
+            clutils::ProfilingInfo<nRepeat> pCPU ("CPU");
+            for (int i = 0; i < nRepeat; ++i)
+            {
+                octomap::point3d end;
+                cTimer.start ();
+                for (unsigned int k = 0; k < n; ++k)
+                    if (directions[k].norm () > 0.f) map.castRay (origins[k], directions[k], end, true, range);
+                pCPU[i] = cTimer.stop ();
+            }
+            
+            // GPU
+            clutils::GPUTimer<std::milli> gTimer (clEnv.devices[0][0]);
+            clutils::ProfilingInfo<nRepeat> pGPU ("GPU");
+            for (int i = 0; i < nRepeat; ++i)
+                pGPU[i] = rays.run (gTimer);
+
+            // Benchmark
+            pGPU.print (pCPU, "rayCastBricks");
+        }
+
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the `ProgramCache`.
+ *  \details A program is built from source on the first run, and loaded 
+ *           from its binary on the second. A corrupted binary gets rebuilt.
+ */
+TEST (OCLSLAM, programCache)
+{
+    ASSERT_EQ (cl_algo::oclslam::fnv1a (""), 0xcbf29ce484222325ULL);
+    ASSERT_EQ (cl_algo::oclslam::fnv1a ("foobar"), 0x85944171f73967e8ULL);
+
+    try
+    {
+        char dirTemplate[] = "/tmp/oclslam_cache_XXXXXX";
+        ASSERT_NE (mkdtemp (dirTemplate), nullptr);
+        std::string dir (dirTemplate);
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0);
+        cl::Context &context = clEnv.getContext (0);
+        cl::Device &device = clEnv.devices[0][0];
+
+        std::vector<cl_algo::oclslam::ProgramSpec> specs = { 
+            { { kernel_filename_oclslam }, "" }, { { kernel_filename_oclslam }, "-cl-fast-relaxed-math" } };
+
+        // Cold start, both programs get built (in parallel)
+        cl_algo::oclslam::ProgramCache cold (dir);
+        std::vector<cl::Program> programs = cold.build (context, device, specs);
+        ASSERT_EQ (programs.size (), 2);
+        ASSERT_EQ (cold.getHits (), 0);
+        ASSERT_EQ (cold.getMisses (), 2);
+
+        // Warm start, both programs get loaded
+        cl_algo::oclslam::ProgramCache warm (dir);
+        programs = warm.build (context, device, specs);
+        ASSERT_EQ (warm.getHits (), 2);
+        ASSERT_EQ (warm.getMisses (), 0);
+        cl::Kernel kernel (programs[0], "splitPC8D_octomap");
+
+        // Corrupt the binaries
+        std::vector<std::string> files;
+        DIR *d = opendir (dir.c_str ());
+        for (dirent *e = readdir (d); e != nullptr; e = readdir (d))
+            if (e->d_name[0] != '.') files.push_back (dir + "/" + e->d_name);
+        closedir (d);
+        ASSERT_EQ (files.size (), 2);
+        for (const std::string &f : files)
+            std::ofstream (f.c_str (), std::ios::binary | std::ios::in | std::ios::out) << "corrupted";
+
+        cl_algo::oclslam::ProgramCache corrupted (dir);
+        corrupted.build (context, device, specs[0]);
+        ASSERT_EQ (corrupted.getHits (), 0);
+        ASSERT_EQ (corrupted.getMisses (), 1);
+
+        for (const std::string &f : files) std::remove (f.c_str ());
+        rmdir (dir.c_str ());
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests `ProgramVariants`.
+ *  \details A variant is built once per set of definitions, and a program 
+ *           that isn't registered is returned unspecialized. `SplitPC8D` with 
+ *           a kernel specialized for the number of points has to give the 
+ *           same results as with the generic one.
+ */
+TEST (OCLSLAM, programVariants)
+{
+    typedef cl_algo::oclslam::SplitPC8D SplitPC8D;
+
+    ASSERT_EQ (cl_algo::oclslam::defineOption ("FRAME_WIDTH", 640u), " -D FRAME_WIDTH=640u");
+    ASSERT_EQ (cl_algo::oclslam::defineOption ("PC_SCALE", 1e-3f), " -D PC_SCALE=1.00000005e-03f");
+
+    try
+    {
+        const unsigned int n = 640 * 480;
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        cl_algo::oclslam::ProgramVariants variants (clEnv, "");
+        cl::Program &generic = variants.get (0, cl_algo::oclslam::defineOption ("NUM_POINTS", n));
+        ASSERT_EQ (generic (), clEnv.getProgram (0) ());
+        ASSERT_EQ (variants.getCount (), 0);
+
+        variants.add (0, 0, { { kernel_filename_oclslam }, "" });
+        cl::Program &p1 = variants.get (0, cl_algo::oclslam::defineOption ("NUM_POINTS", n));
+        cl::Program &p2 = variants.get (0, cl_algo::oclslam::defineOption ("NUM_POINTS", n));
+        variants.get (0, cl_algo::oclslam::defineOption ("NUM_POINTS", n / 4));
+        ASSERT_EQ (p1 (), p2 ());
+        ASSERT_EQ (variants.getCount (), 2);
+
+        // Configure kernel execution parameters
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+        SplitPC8D sp (clEnv, info);
+        sp.init (n);
+        SplitPC8D spVariant (clEnv, info, nullptr, nullptr, &variants);
+        spVariant.get (SplitPC8D::Memory::D_IN) = sp.get (SplitPC8D::Memory::D_IN);
+        spVariant.init (n);
+
+        // Initialize data (writes on staging buffers directly)
+        for (unsigned int k = 0; k < 8 * n; ++k)
+            sp.hPtrIn[k] = oclslam::rNum_R_0_1 ();
+        sp.write ();
+
+        sp.run ();
+        spVariant.run ();
+        cl_float *pc3d = (cl_float *) sp.read ();
+        cl_float *pc3dVariant = (cl_float *) spVariant.read ();
+        cl_uchar *rgb = (cl_uchar *) sp.read (SplitPC8D::Memory::H_OUT_RGB);
+        cl_uchar *rgbVariant = (cl_uchar *) spVariant.read (SplitPC8D::Memory::H_OUT_RGB);
+
+        // Verify the results
+        for (uint k = 0; k < 3 * n; ++k)
+        {
+            ASSERT_EQ (pc3d[k], pc3dVariant[k]);
+            ASSERT_EQ (rgb[k], rgbVariant[k]);
+        }
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests `LaunchTuner`.
+ *  \details The launch configurations of `splitPC8D_octomap` are swept, stored, 
+ *           and picked up by a new instance at `init`, but only for the same number 
+ *           of points. The results have to be the same for any local size and number 
+ *           of points per work-item.
+ */
+TEST (OCLSLAM, launchTuner)
+{
+    typedef cl_algo::oclslam::LaunchConfig LaunchConfig;
+    typedef cl_algo::oclslam::LaunchTuner LaunchTuner;
+
+    try
+    {
+        char dirTemplate[] = "/tmp/oclslam_tuner_XXXXXX";
+        ASSERT_NE (mkdtemp (dirTemplate), nullptr);
+        std::string dir (dirTemplate);
+
+        const unsigned int points = 640 * 480 + 7;  // Not a multiple of any local size
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+        cl::Device &device = clEnv.devices[0][0];
+        clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+
+        std::vector<cl_float8> in (points);
+        cl_float *pIn = (cl_float *) in.data ();
+        std::generate (pIn, pIn + 8 * points, oclslam::rNum_R_0_1);
+        std::vector<cl_float> refPC3D (3 * points);
+        std::vector<cl_uchar> refRGB (3 * points);
+        oclslam::cpuSplitPC8D (pIn, refPC3D.data (), refRGB.data (), points);
+
+        // Sweep and store
+        LaunchTuner tuner (dir);
+        cl_algo::oclslam::SplitPC8D sp8D (clEnv, info);
+        sp8D.init (points);
+        LaunchConfig best = sp8D.tune (tuner, 2);
+        ASSERT_TRUE (sp8D.getConfig () == best);
+
+        // A new tuner loads the configuration from disk
+        LaunchConfig config = { 0, 0 };
+        LaunchTuner reloaded (dir);
+        ASSERT_TRUE (reloaded.lookup (device, "splitPC8D_octomap", points, config));
+        ASSERT_TRUE (config == best);
+        ASSERT_FALSE (reloaded.lookup (device, "icpResiduals", points, config));
+
+        // The configuration holds only for the problem size it was tuned for
+        ASSERT_FALSE (reloaded.lookup (device, "splitPC8D_octomap", points / 4, config));
+        cl_algo::oclslam::SplitPC8D smaller (clEnv, info, nullptr, &reloaded);
+        smaller.init (points / 4);
+        ASSERT_TRUE (smaller.getConfig () == (LaunchConfig { 0, 1 }));  // The default
+
+        // Every configuration gives the same results
+        for (LaunchConfig c : { best, LaunchConfig { 64, 4 }, LaunchConfig { 0, 8 } })
+        {
+            reloaded.store (device, "splitPC8D_octomap", points, c);
+            cl_algo::oclslam::SplitPC8D tuned (clEnv, info, nullptr, &reloaded);
+            tuned.init (points);
+            ASSERT_TRUE (tuned.getConfig () == c);
+
+            tuned.write (cl_algo::oclslam::SplitPC8D::Memory::D_IN, in.data ());
+            tuned.run ();
+            cl_float *pc3d = (cl_float *) tuned.read (cl_algo::oclslam::SplitPC8D::Memory::H_OUT_PC3D, CL_FALSE);
+            cl_uchar *rgb = (cl_uchar *) tuned.read (cl_algo::oclslam::SplitPC8D::Memory::H_OUT_RGB);
+
+            float eps = 42 * std::numeric_limits<float>::epsilon ();
+            for (uint k = 0; k < 3 * points; ++k)
+            {
+                ASSERT_LT (std::abs (refPC3D[k] - pc3d[k]), eps);
+                ASSERT_EQ (refRGB[k], rgb[k]);
+            }
+        }
+
+        DIR *d = opendir (dir.c_str ());
+        for (dirent *e = readdir (d); e != nullptr; e = readdir (d))
+            if (e->d_name[0] != '.') std::remove ((dir + "/" + e->d_name).c_str ());
+        closedir (d);
+        rmdir (dir.c_str ());
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the transfers of `BufferTransfer`.
+ *  \details A buffer is moved between two queues of the same context, 
+ *           and between two contexts, through host memory.
+ */
+TEST (OCLSLAM, bufferTransfer)
+{
+    try
+    {
+        const unsigned int n = 1 << 16;
+        const size_t bufferSize = n * sizeof (cl_float);
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0);
+        clEnv.addQueue (0, 0);
+        clEnv.addContext (0);
+        clEnv.addQueue (1, 0);
+        cl::Context &context0 = clEnv.getContext (0);
+        cl::Context &context1 = clEnv.getContext (1);
+        cl::CommandQueue &queue0 = clEnv.getQueue (0, 0);
+        cl::CommandQueue &queue1 = clEnv.getQueue (0, 1);
+        cl::CommandQueue &queue2 = clEnv.getQueue (1, 0);
+
+        std::vector<cl_float> data (n), results (n);
+        for (unsigned int i = 0; i < n; ++i) data[i] = oclslam::rNum_R_0_1 ();
+
+        cl::Buffer src (context0, CL_MEM_READ_WRITE, bufferSize);
+        cl::Buffer dstLocal (context0, CL_MEM_READ_WRITE, bufferSize);
+        cl::Buffer dstRemote (context1, CL_MEM_READ_WRITE, bufferSize);
+        queue0.enqueueWriteBuffer (src, CL_FALSE, 0, bufferSize, data.data ());
+
+        cl_algo::oclslam::BufferTransfer local, remote;
+        local.init (context0, queue0, src, context0, queue1, dstLocal, bufferSize);
+        remote.init (context0, queue0, src, context1, queue2, dstRemote, bufferSize);
+        ASSERT_FALSE (local.isStaged ());
+        ASSERT_TRUE (remote.isStaged ());
+
+        // Two rounds, for the reuse of the host buffer
+        for (int k = 0; k < 2; ++k)
+        {
+            local.begin ();
+            remote.begin ();
+            local.end ();
+            remote.end ();
+
+            queue1.enqueueReadBuffer (dstLocal, CL_TRUE, 0, bufferSize, results.data ());
+            for (unsigned int i = 0; i < n; ++i) ASSERT_EQ (data[i], results[i]);
+
+            queue2.enqueueReadBuffer (dstRemote, CL_TRUE, 0, bufferSize, results.data ());
+            for (unsigned int i = 0; i < n; ++i) ASSERT_EQ (data[i], results[i]);
+
+            for (unsigned int i = 0; i < n; ++i) data[i] += 1.f;
+            queue0.enqueueWriteBuffer (src, CL_FALSE, 0, bufferSize, data.data ());
+        }
+        queue0.finish ();
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests `BufferPool` and `BufferPlanner`.
+ *  \details Checks the size classes, the reuse of released buffers, the slot 
+ *           assignment for the buffers of a time step of the pipeline, and 
+ *           the re-initialization of a class that draws from a pool.
+ */
+TEST (OCLSLAM, bufferPool)
+{
+    typedef cl_algo::oclslam::BufferPool BufferPool;
+    typedef cl_algo::oclslam::BufferPlanner BufferPlanner;
+
+    ASSERT_EQ (BufferPool::getSizeClass (1), 4096);
+    ASSERT_EQ (BufferPool::getSizeClass (4097), 5120);
+    ASSERT_EQ (BufferPool::getSizeClass (8192), 8192);
+    ASSERT_EQ (BufferPool::getSizeClass (640 * 480 * sizeof (cl_float8)), 10485760);
+    for (size_t size = 1; size < (1 << 24); size = size * 3 / 2 + 1)
+    {
+        ASSERT_GE (BufferPool::getSizeClass (size), size);
+        ASSERT_LE (BufferPool::getSizeClass (size), std::max<size_t> (4096, size + size / 4));
+    }
+
+    // Frame delivery, filtering, point cloud, landmarks, transformation, splitting
+    const size_t n = 640 * 480;
+    std::vector<BufferPlanner::Interval> buffers = { 
+        { 3 * n, 0, 1 }, { 2 * n, 0, 1 }, { 4 * n, 1, 2 }, { 4 * n, 1, 2 }, 
+        { 4 * n, 1, 2 }, { 4 * n, 1, 2 }, { 32 * n, 2, 4 }, { 32 * n, 4, 5 } };
+    std::vector<size_t> slotSizes;
+    std::vector<unsigned int> slots = BufferPlanner::assignSlots (buffers, slotSizes);
+    ASSERT_EQ (slotSizes.size (), 6);
+    ASSERT_EQ (std::accumulate (slotSizes.begin (), slotSizes.end (), (size_t) 0), 78 * n);
+    for (unsigned int i = 0; i < buffers.size (); ++i)
+    {
+        ASSERT_GE (slotSizes[slots[i]], buffers[i].size);
+        for (unsigned int j = i + 1; j < buffers.size (); ++j)
+        {
+            bool overlap = buffers[i].first <= buffers[j].last && buffers[j].first <= buffers[i].last;
+            if (overlap) ASSERT_NE (slots[i], slots[j]);
+        }
+    }
+
+    try
+    {
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0);
+        clEnv.addProgram (0, kernel_filename_oclslam);
+
+        BufferPool pool (clEnv.getContext (0));
+
+        // A released buffer serves the next request of its size class
+        cl::Buffer a = pool.acquire (1000000);
+        pool.release (a);
+        cl::Buffer b = pool.acquire (999000);
+        ASSERT_EQ (a (), b ());
+        ASSERT_EQ (pool.getAllocations (), 1);
+        pool.release (b);
+
+        // A planner draws its slots from the pool
+        BufferPlanner planner;
+        for (const BufferPlanner::Interval &i : buffers) planner.add (i.size, i.first, i.last);
+        planner.plan (pool);
+        ASSERT_EQ (planner.get (0) (), planner.get (6) ());
+        ASSERT_EQ (pool.getAllocations (), 7);
+        planner.release (pool);
+        ASSERT_EQ (pool.getInUseSize (), 0);
+
+        // Re-initialization with fewer points doesn't allocate
+        {
+            clutils::CLEnvInfo<1> info (0, 0, 0, { 0 }, 0);
+            cl_algo::oclslam::SplitPC8D sp8D (clEnv, info, &pool);
+            sp8D.init (n, cl_algo::oclslam::Staging::NONE);
+            unsigned int allocations = pool.getAllocations ();
+            sp8D.init (n / 4, cl_algo::oclslam::Staging::NONE);
+            ASSERT_EQ (pool.getAllocations (), allocations);
+            sp8D.init (2 * n, cl_algo::oclslam::Staging::NONE);
+            ASSERT_GT (pool.getAllocations (), allocations);
+        }
+        ASSERT_EQ (pool.getInUseSize (), 0);
+
+        pool.trim ();
+        ASSERT_EQ (pool.getAllocatedSize (), 0);
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests `StageGraph`.
+ *  \details A buffer is filled on one queue, copied on a second one, and 
+ *           refilled on the first, while the copy is still reading it. The 
+ *           dependencies have to be derived from the buffers, and the 
+ *           copy has to see the first fill.
+ */
+TEST (OCLSLAM, stageGraph)
+{
+    typedef std::vector<cl::Event> Events;
+
+    try
+    {
+        const unsigned int n = 1 << 20;
+        const size_t size = n * sizeof (cl_uint);
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0);
+        clEnv.addQueue (0, 0);
+        cl::Context &context = clEnv.getContext (0);
+        cl::CommandQueue &q0 = clEnv.getQueue (0, 0);
+        cl::CommandQueue &q1 = clEnv.getQueue (0, 1);
+
+        cl::Buffer x (context, CL_MEM_READ_WRITE, size);
+        cl::Buffer y (context, CL_MEM_READ_WRITE, size);
+        cl::Buffer z (context, CL_MEM_READ_WRITE, size);
+
+        cl_algo::oclslam::StageGraph graph;
+        unsigned int sFill = graph.add ("fill", q0, [&] (const Events *e, cl::Event *ev) {
+                q0.enqueueFillBuffer<cl_uint> (x, 1, 0, size, e, ev); }, {}, { x });
+        unsigned int sCopy = graph.add ("copy", q1, [&] (const Events *e, cl::Event *ev) {
+                q1.enqueueCopyBuffer (x, y, 0, 0, size, e, ev); }, { x }, { y });
+        unsigned int sRefill = graph.add ("refill", q0, [&] (const Events *e, cl::Event *ev) {
+                q0.enqueueFillBuffer<cl_uint> (x, 2, 0, size, e, ev); }, {}, { x });
+        unsigned int sCopyY = graph.add ("copyY", q1, [&] (const Events *e, cl::Event *ev) {
+                q1.enqueueCopyBuffer (y, z, 0, 0, size, e, ev); }, { y }, { z });
+        unsigned int sHost = graph.add ("host", q0, cl_algo::oclslam::StageGraph::fence (q0, [] {}), { z }, {});
+
+        graph.run (sFill, sHost);
+        graph.finish ();
+
+        // RAW across queues, WAR across queues, RAW on the same queue (implied), RAW across queues
+        ASSERT_EQ (graph.getDependencies (sCopy), std::vector<unsigned int> { sFill });
+        ASSERT_EQ (graph.getDependencies (sRefill), std::vector<unsigned int> { sCopy });
+        ASSERT_TRUE (graph.getDependencies (sCopyY).empty ());
+        ASSERT_EQ (graph.getDependencies (sHost), std::vector<unsigned int> { sCopyY });
+
+        std::vector<cl_uint> hx (n), hz (n);
+        q0.enqueueReadBuffer (x, CL_TRUE, 0, size, hx.data ());
+        q0.enqueueReadBuffer (z, CL_TRUE, 0, size, hz.data ());
+        for (unsigned int i = 0; i < n; ++i)
+        {
+            ASSERT_EQ (hx[i], 2);
+            ASSERT_EQ (hz[i], 1);
+        }
+
+        // On the next time step, the accesses of the previous one are accounted for (WAR on z), 
+        // while a disabled stage is skipped and takes no part in the dependencies
+        graph.setEnabled (sRefill, false);
+        graph.run (sFill, sCopyY);
+        ASSERT_FALSE (graph.isEnabled (sRefill));
+        ASSERT_EQ (graph.getDependencies (sCopyY), std::vector<unsigned int> { sHost });
+
+        // Without the refill, the fill has to wait for the copy that reads x (WAR)
+        graph.dispatch (sFill);
+        ASSERT_EQ (graph.getDependencies (sFill), std::vector<unsigned int> { sCopy });
+        graph.finish ();
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests `Tracer`.
+ *  \details A `StageGraph` fills a buffer on one queue, and copies it on a second 
+ *           one, while a host span is open. The trace has to hold the stages, 
+ *           on the tracks of their queues, with the copy following the fill.
+ */
+TEST (OCLSLAM, tracer)
+{
+    typedef std::vector<cl::Event> Events;
+
+    try
+    {
+        const unsigned int n = 1 << 20;
+        const size_t size = n * sizeof (cl_uint);
+        const std::string filename ("oclslam_test_trace.json");
+
+        // Setup the OpenCL environment
+        clutils::CLEnv clEnv;
+        clEnv.addContext (0);
+        clEnv.addQueue (0, 0, CL_QUEUE_PROFILING_ENABLE);
+        clEnv.addQueue (0, 0, CL_QUEUE_PROFILING_ENABLE);
+        cl::Context &context = clEnv.getContext (0);
+        cl::CommandQueue &q0 = clEnv.getQueue (0, 0);
+        cl::CommandQueue &q1 = clEnv.getQueue (0, 1);
+
+        cl::Buffer x (context, CL_MEM_READ_WRITE, size);
+        cl::Buffer y (context, CL_MEM_READ_WRITE, size);
+
+        cl_algo::oclslam::Tracer tracer;
+        tracer.addQueue (q0, "q0");
+        tracer.addQueue (q1, "q1");
+
+        cl_algo::oclslam::StageGraph graph;
+        graph.setTracer (&tracer);
+        unsigned int sFill = graph.add ("fill", q0, [&] (const Events *e, cl::Event *ev) {
+                q0.enqueueFillBuffer<cl_uint> (x, 1, 0, size, e, ev); }, {}, { x });
+        unsigned int sCopy = graph.add ("copy", q1, [&] (const Events *e, cl::Event *ev) {
+                q1.enqueueCopyBuffer (x, y, 0, 0, size, e, ev); }, { x }, { y });
+
+        // Nothing is recorded before the tracer is opened
+        graph.run (sFill, sCopy);
+        graph.finish ();
+
+        ASSERT_TRUE (cl_algo::oclslam::Tracer::isProfiling (q0));
+        ASSERT_TRUE (tracer.open (filename));
+        {
+            cl_algo::oclslam::Tracer::Span span (tracer, "dispatch");
+            graph.run (sFill, sCopy);
+            graph.flush ();
+        }
+        tracer.close ();
+        ASSERT_FALSE (tracer.isOpen ());
+        ASSERT_EQ (tracer.getDropped (), 0);
+
+        std::ifstream file (filename.c_str ());
+        std::string trace ((std::istreambuf_iterator<char> (file)), std::istreambuf_iterator<char> ());
+        std::remove (filename.c_str ());
+
+        ASSERT_EQ (trace.compare (0, 15, "{\"traceEvents\":"), 0);
+        ASSERT_NE (trace.find ("\"name\":\"q0\""), std::string::npos);
+        ASSERT_NE (trace.find ("\"name\":\"q1 (queued)\""), std::string::npos);
+        ASSERT_NE (trace.find ("{\"name\":\"dispatch\",\"cat\":\"host\",\"ph\":\"X\",\"pid\":0"), std::string::npos);
+
+        // Returns the time stamp and the duration of a command
+        auto getTimes = [&trace] (const std::string &name, double &ts, double &dur) {
+            size_t pos = trace.find ("{\"name\":\"" + name + "\",\"cat\":\"device\",\"ph\":\"X\"");
+            ASSERT_NE (pos, std::string::npos);
+            ASSERT_EQ (trace.find ("{\"name\":\"" + name + "\",\"cat\":\"device\",\"ph\":\"X\"", pos + 1), std::string::npos);
+            ts = std::atof (trace.c_str () + trace.find ("\"ts\":", pos) + 5);
+            dur = std::atof (trace.c_str () + trace.find ("\"dur\":", pos) + 6);
+        };
+
+        double tsFill, durFill, tsCopy, durCopy;
+        getTimes ("fill", tsFill, durFill);
+        getTimes ("copy", tsCopy, durCopy);
+        ASSERT_GE (durFill, 0.0);
+        ASSERT_GE (durCopy, 0.0);
+        // The copy finishes after the fill it waits on (the clocks of 
+        // the queues are calibrated separately, so there is some slack)
+        ASSERT_GT (tsCopy + durCopy + 50.0, tsFill + durFill);
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+/*! \brief Tests the optimization of a `PoseGraph`.
+ *  \details The odometry edges of a closed trajectory carry a systematic 
+ *           error. A single loop edge has to pull the last pose back to 
+ *           its true position.
+ */
+TEST (OCLSLAM, poseGraph)
+{
+    using cl_algo::oclslam::Pose;
+
+    const unsigned int nodes = 8;
+    const double radius = 1000.0;  // in mm
+
+    // Ground truth poses on a circle
+    std::vector<Pose> gt;
+    for (unsigned int k = 0; k < nodes; ++k)
+    {
+        double a = 2.0 * M_PI * k / nodes;
+        gt.emplace_back (Eigen::AngleAxisd (a, Eigen::Vector3d::UnitY ()).toRotationMatrix (), 
+                         Eigen::Vector3d (radius * std::cos (a), 0.0, radius * std::sin (a)), 1.0);
+    }
+
+    // Drifting odometry
+    Pose drift (Eigen::AngleAxisd (0.02, Eigen::Vector3d::UnitY ()).toRotationMatrix (), 
+                Eigen::Vector3d (10.0, 5.0, 0.0), 1.0);
+
+    cl_algo::oclslam::PoseGraph graph;
+    Pose pose = gt[0];
+    graph.addNode (pose);
+    for (unsigned int k = 1; k < nodes; ++k)
+    {
+        Pose Z = gt[k - 1].inverse () * gt[k] * drift;
+        pose = pose * Z;
+        graph.addNode (pose);
+        graph.addEdge (k - 1, k, Z);
+    }
+    graph.addEdge (0, nodes - 1, gt[0].inverse () * gt[nodes - 1], 10.0);
+
+    double errBefore = (graph.getPose (nodes - 1).t - gt[nodes - 1].t).norm ();
+    graph.optimize ();
+    double errAfter = (graph.getPose (nodes - 1).t - gt[nodes - 1].t).norm ();
+
+    ASSERT_GT (errBefore, 100.0);
+    ASSERT_LT (errAfter, 5.0);
+    ASSERT_LT ((graph.getPose (0).t - gt[0].t).norm (), 1e-9);  // The first node is fixed
+}
+
+
+/*! \brief Tests the loop closure detection.
+ *  \details A trajectory on a circle returns close to its start, and the odometry 
+ *           carries a systematic error. The first and the last keyframes view the 
+ *           same surface, from poses a known transformation apart, while the rest 
+ *           view unrelated scenes. `alignPointClouds` has to recover the transformation 
+ *           (exactly, for a moved copy of a cloud), `LoopClosure` has to find the loop, 
+ *           and the corrected poses have to be closer to the ground truth than the odometry.
+ */
+TEST (OCLSLAM, loopClosure)
+{
+    using cl_algo::oclslam::Pose;
+
+    const unsigned int width = 640, height = 480;
+    const float f = 595.f;  // Focal length (in pixels)
+    const unsigned int nodes = 12;
+    const double radius = 1000.0;  // in mm
+
+    // Renders (in the sensor coordinate frame) the surface z = S(x,y) of the first 
+    // view, from the pose T (with respect to the first view), by marching the rays
+    auto S = [] (float x, float y) { return 2500.f + 300.f * std::sin (x / 300.f) * std::cos (y / 250.f); };
+    auto render = [&] (const Pose &T) {
+        std::vector<Eigen::Vector3f> pc (width * height);
+        Pose invT = T.inverse ();
+        for (unsigned int v = 0; v < height; ++v)
+            for (unsigned int u = 0; u < width; ++u)
+            {
+                Eigen::Vector3d d = T.R * Eigen::Vector3d ((u - 0.5 * width) / f, (v - 0.5 * height) / f, 1.0);
+                double t = 2500.0;
+                for (int i = 0; i < 30; ++i)
+                {
+                    Eigen::Vector3d p = T.t + t * d;
+                    t = (S (p[0], p[1]) - T.t[2]) / d[2];
+                }
+                pc[v * width + u] = (invT * (T.t + t * d)).cast<float> ();
+            }
+        return pc;
+    };
+
+    // Renders a scene unrelated to the rest, with random depths over blocks of pixels
+    std::mt19937 gen (7);
+    std::uniform_real_distribution<float> depthDist (1500.f, 3500.f);
+    auto renderRandom = [&] () {
+        std::vector<float> blocks ((width / 32) * (height / 32));
+        for (float &b : blocks) b = depthDist (gen);
+        std::vector<Eigen::Vector3f> pc (width * height);
+        for (unsigned int v = 0; v < height; ++v)
+            for (unsigned int u = 0; u < width; ++u)
+            {
+                float z = blocks[(v / 32) * (width / 32) + u / 32];
+                pc[v * width + u] = Eigen::Vector3f ((u - 0.5f * width) * z / f, (v - 0.5f * height) * z / f, z);
+            }
+        return pc;
+    };
+
+    // Transforms a point cloud to the global coordinate frame (in meters), as the pipeline does
+    auto toGlobal = [] (const std::vector<Eigen::Vector3f> &pc, const Pose &T) {
+        std::vector<float> pc3d (3 * pc.size ());
+        for (unsigned int i = 0; i < pc.size (); ++i)
+        {
+            Eigen::Vector3f p = (1e-3 * (T * pc[i].cast<double> ())).cast<float> ();
+            std::copy (p.data (), p.data () + 3, &pc3d[3 * i]);
+        }
+        return pc3d;
+    };
+
+    // The trajectory ends with an offset from its start
+    Pose offset (Eigen::AngleAxisd (M_PI / 180.0, Eigen::Vector3d::UnitY ()).toRotationMatrix (), 
+                 Eigen::Vector3d (20.0, -10.0, 15.0), 1.0);
+    std::vector<Pose> gt;
+    for (unsigned int k = 0; k < nodes - 1; ++k)
+    {
+        double a = 2.0 * M_PI * k / (nodes - 1);
+        gt.emplace_back (Eigen::AngleAxisd (a, Eigen::Vector3d::UnitY ()).toRotationMatrix (), 
+                         Eigen::Vector3d (radius * std::cos (a), 0.0, radius * std::sin (a)), 1.0);
+    }
+    gt.push_back (gt[0] * offset);
+
+    // The views of the same surface have to align to within the sampling error
+    std::vector<Eigen::Vector3f> pcFirst = render (Pose ()), pcLast = render (offset);
+    std::vector<float> pc3dFirst = toGlobal (pcFirst, Pose ()), pc3dLast = toGlobal (pcLast, Pose ());
+    std::vector<Eigen::Vector3f> cloudFirst = cl_algo::oclslam::sampleCloud (pc3dFirst.data (), width, height, Pose ());
+    std::vector<Eigen::Vector3f> cloudLast = cl_algo::oclslam::sampleCloud (pc3dLast.data (), width, height, Pose ());
+    ASSERT_EQ ((width / 8) * (height / 8), cloudFirst.size ());
+
+    Pose T;
+    float rms, inlierRatio;
+    ASSERT_TRUE (cl_algo::oclslam::alignPointClouds (cloudFirst, cloudLast, T, 100.f, 30, rms, inlierRatio));
+    ASSERT_LT (cl_algo::oclslam::logRotation (T.R.transpose () * offset.R).norm (), 0.5 * M_PI / 180.0);
+    ASSERT_LT ((T.t - offset.t).norm (), 15.0);
+    ASSERT_LT (rms, 25.f);
+    ASSERT_GT (inlierRatio, 0.9f);
+
+    // A copy of the cloud, moved by a known transformation, has to align exactly
+    Pose known (Eigen::AngleAxisd (3.0 * M_PI / 180.0, Eigen::Vector3d (1.0, 2.0, 0.5).normalized ()).toRotationMatrix (), 
+                Eigen::Vector3d (40.0, -20.0, 30.0), 1.0);
+    std::vector<Eigen::Vector3f> cloudMoved;
+    for (const Eigen::Vector3f &p : cloudFirst)
+        cloudMoved.push_back ((known.inverse () * p.cast<double> ()).cast<float> ());
+    T = Pose ();
+    ASSERT_TRUE (cl_algo::oclslam::alignPointClouds (cloudFirst, cloudMoved, T, 100.f, 100, rms, inlierRatio));
+    ASSERT_LT (cl_algo::oclslam::logRotation (T.R.transpose () * known.R).norm (), 0.01 * M_PI / 180.0);
+    ASSERT_LT ((T.t - known.t).norm (), 0.5);
+    ASSERT_LT (rms, 0.1f);
+    ASSERT_GT (inlierRatio, 0.99f);
+
+    // Only the views of the same surface look alike
+    std::vector<float> dFirst = cl_algo::oclslam::computeDescriptor (pc3dFirst.data (), width, height, Pose ());
+    std::vector<float> dLast = cl_algo::oclslam::computeDescriptor (pc3dLast.data (), width, height, Pose ());
+    ASSERT_EQ ((width / 32) * (height / 32), dFirst.size ());
+    ASSERT_GT (Eigen::Map<Eigen::VectorXf> (dFirst.data (), dFirst.size ()).dot (
+               Eigen::Map<Eigen::VectorXf> (dLast.data (), dLast.size ())), 0.9f);
+
+    // Drifting odometry
+    Pose drift (Eigen::AngleAxisd (0.02, Eigen::Vector3d::UnitY ()).toRotationMatrix (), 
+                Eigen::Vector3d (10.0, 5.0, 0.0), 1.0);
+
+    cl_algo::oclslam::LoopClosure loopClosure;
+    loopClosure.setMinSeparation (5);
+    Pose pose = gt[0];
+    for (unsigned int k = 0; k < nodes; ++k)
+    {
+        if (k > 0) pose = pose * gt[k - 1].inverse () * gt[k] * drift;
+        std::vector<Eigen::Vector3f> pc = (k == 0) ? pcFirst : (k == nodes - 1) ? pcLast : renderRandom ();
+        std::vector<float> pc3d = toGlobal (pc, pose);
+        loopClosure.addKeyframe (10 * k, pose, 
+            cl_algo::oclslam::computeDescriptor (pc3d.data (), width, height, pose), 
+            cl_algo::oclslam::sampleCloud (pc3d.data (), width, height, pose));
+    }
+
+    // The keyframes are processed on the detection thread
+    std::vector<Pose> corrected;
+    for (int i = 0; i < 10000 && corrected.size () < nodes; ++i)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        corrected = loopClosure.getCorrectedPoses ();
+    }
+    ASSERT_EQ (nodes, corrected.size ());
+    ASSERT_EQ (1u, loopClosure.getNumLoops ());
+
+    double errBefore = (pose.t - gt[nodes - 1].t).norm ();
+    double errAfter = (corrected[nodes - 1].t - gt[nodes - 1].t).norm ();
+    ASSERT_GT (errBefore, 100.0);
+    ASSERT_LT (errAfter, 0.5 * errBefore);
+    ASSERT_LT ((corrected[0].t - gt[0].t).norm (), 1e-9);  // The first keyframe is fixed
+}
+
+
+/*! \brief Tests `computeRegistrationStats`.
+ *  \details Residuals (squared distances) with known values, some of them 
+ *           invalid (negative) and some beyond the inlier distance, have to 
+ *           give the expected inlier ratio and RMS residual.
+ */
+TEST (OCLSLAM, registrationStats)
+{
+    using cl_algo::oclslam::RegistrationStats;
+    using cl_algo::oclslam::computeRegistrationStats;
+
+    const float inlierDistance = 10.f;  // in mm
+    
+    // 2 invalid, 2 outliers (including one exactly at the inlier distance), 4 inliers
+    std::vector<float> res { -1.f, 9.f, 400.f, 25.f, -1.f, 100.f, 0.f, 16.f };
+    RegistrationStats stats = computeRegistrationStats (res.data (), res.size (), inlierDistance);
+
+    ASSERT_FLOAT_EQ (4.f / 6.f, stats.inlierRatio);
+    ASSERT_FLOAT_EQ (std::sqrt ((9.f + 25.f + 0.f + 16.f) / 4.f), stats.rmsResidual);
+
+    // No inliers
+    std::vector<float> far { 400.f, -1.f, 900.f };
+    stats = computeRegistrationStats (far.data (), far.size (), inlierDistance);
+    ASSERT_EQ (0.f, stats.inlierRatio);
+    ASSERT_TRUE (std::isinf (stats.rmsResidual));
+
+    // No valid samples
+    std::vector<float> invalid (4, -1.f);
+    stats = computeRegistrationStats (invalid.data (), invalid.size (), inlierDistance);
+    ASSERT_EQ (0.f, stats.inlierRatio);
+    ASSERT_TRUE (std::isinf (stats.rmsResidual));
+}
+
+
+/*! \brief Tests `applyRegistration` and `checkMotion`.
+ *  \details A registration against a reference with a known pose, \f$ T_k \f$, 
+ *           has to give the pose \f$ T_{icp} \circ T_k \f$, i.e. it has to map 
+ *           the points of the current point cloud to the same global points as 
+ *           the reference. The motion check has to enforce each of its bounds.
+ */
+TEST (OCLSLAM, registrationPose)
+{
+    using cl_algo::oclslam::Pose;
+    using cl_algo::oclslam::applyRegistration;
+    using cl_algo::oclslam::checkMotion;
+
+    Eigen::Matrix3f R_k = Eigen::AngleAxisf (0.3f, Eigen::Vector3f (1.f, 2.f, 3.f).normalized ()).toRotationMatrix ();
+    Eigen::Vector3f t_k (400.f, -150.f, 900.f);
+    float s_k = 1.02f;
+
+    Eigen::Matrix3f R_icp = Eigen::AngleAxisf (0.1f, Eigen::Vector3f::UnitY ()).toRotationMatrix ();
+    Eigen::Vector3f t_icp (50.f, 20.f, -30.f);
+    float s_icp = 0.99f;
+
+    Eigen::Matrix3f R = R_k;
+    Eigen::Vector3f t = t_k;
+    float s = s_k;
+    applyRegistration (R_icp, t_icp, s_icp, R, t, s);
+
+    // The registration maps a point onto the reference frame, and the keyframe pose 
+    // onto the global frame, so a point goes through T_icp and T_k in turn
+    Pose T_icp (R_icp, t_icp, s_icp), T_k (R_k, t_k, s_k), T (R, t, s);
+    Pose expected = T_icp * T_k;
+    ASSERT_LT ((T.R - expected.R).norm (), 1e-5);
+    ASSERT_LT ((T.t - expected.t).norm (), 1e-3);
+    ASSERT_NEAR (expected.s, T.s, 1e-6);
+    Eigen::Vector3d p (-200.0, 300.0, 1500.0);
+    ASSERT_LT ((T * p - T_icp * (T_k * p)).norm (), 1e-2);
+
+    // Applying the identity leaves the pose unchanged
+    applyRegistration (Eigen::Matrix3f::Identity (), Eigen::Vector3f::Zero (), 1.f, R, t, s);
+    ASSERT_LT ((R.cast<double> () - expected.R).norm (), 1e-5);
+    ASSERT_LT ((t.cast<double> () - expected.t).norm (), 1e-3);
+
+    // |t| ~ 61.6 mm, angle ~ 5.7 deg, |ln s| ~ 0.01
+    ASSERT_TRUE (checkMotion (R_icp, t_icp, s_icp, 200.f, 20.f, 0.1f));
+    ASSERT_FALSE (checkMotion (R_icp, t_icp, s_icp, 50.f, 20.f, 0.1f));
+    ASSERT_FALSE (checkMotion (R_icp, t_icp, s_icp, 200.f, 5.f, 0.1f));
+    ASSERT_FALSE (checkMotion (R_icp, t_icp, s_icp, 200.f, 20.f, 0.005f));
+    ASSERT_FALSE (checkMotion (R_icp, t_icp, 1.2f, 200.f, 20.f, 0.1f));
+}
+
+
+/*! \brief Tests `readTrajectory`.
+ *  \details Comments, and lines that don't start with a timestamp and a pose, 
+ *           have to be skipped. Commas have to be accepted as separators, the 
+ *           missing extra columns have to get their defaults, and the records 
+ *           have to come out sorted. A log written by `TrajectoryLog` has to 
+ *           be read back as it was written.
+ */
+TEST (OCLSLAM, trajectoryRead)
+{
+    using cl_algo::oclslam::TrajectoryRecord;
+
+    char fileTemplate[] = "/tmp/oclslam_trajectory_XXXXXX";
+    int fd = mkstemp (fileTemplate);
+    ASSERT_NE (fd, -1);
+    close (fd);
+    std::string filename (fileTemplate);
+
+    {
+        std::ofstream file (filename.c_str ());
+        file << "# timestamp tx ty tz qx qy qz qw\n"
+             << "2.0 1.0 2.0 3.0 0 0 0 1\n"
+             << "\n"
+             << "1.0 2.0 3.0\n"                       // Too few fields
+             << "abc 0 0 0 0 0 0 1\n"                 // Not a timestamp
+             << "1.5,0.5,0,0,0,0,0,1\n"               // Commas
+             << "3.0 0 0 0 0 0 0 1 1.5 42 7 12\n";    // Extra columns
+    }
+
+    std::vector<TrajectoryRecord> records = cl_algo::oclslam::readTrajectory (filename);
+    ASSERT_EQ (records.size (), 3u);
+    ASSERT_DOUBLE_EQ (records[0].timestamp, 1.5);
+    ASSERT_DOUBLE_EQ (records[1].timestamp, 2.0);
+    ASSERT_DOUBLE_EQ (records[2].timestamp, 3.0);
+    ASSERT_NEAR (records[0].t[0], 500.f, 1e-3f);  // in mm
+    ASSERT_NEAR ((records[1].t - Eigen::Vector3f (1000.f, 2000.f, 3000.f)).norm (), 0.f, 1e-3f);
+    ASSERT_EQ (records[1].s, 1.f);
+    ASSERT_EQ (records[1].timeStep, 0u);  // The line number among the records
+    ASSERT_EQ (records[0].timeStep, 1u);
+    ASSERT_EQ (records[2].s, 1.5f);
+    ASSERT_EQ (records[2].sensorTimestamp, 42u);
+    ASSERT_EQ (records[2].timeStep, 7u);
+    ASSERT_EQ (records[2].icpIterations, 12u);
+    ASSERT_EQ (records[2].latency, 0.f);
+
+    // A log that's written has to be read back
+    cl_algo::oclslam::TrajectoryLog log;
+    ASSERT_TRUE (log.open (filename));
+    TrajectoryRecord rec;
+    rec.timestamp = 10.0;
+    rec.t = Eigen::Vector3f (100.f, -200.f, 300.f);
+    rec.q = Eigen::Quaternion<float, Eigen::DontAlign> (Eigen::AngleAxisf (0.3f, Eigen::Vector3f::UnitY ()));
+    rec.s = 1.f; rec.sensorTimestamp = 5; rec.timeStep = 3; rec.icpIterations = 9;
+    rec.latency = 30.f; rec.preLatency = 10.f; rec.icpLatency = 15.f;
+    log.append (rec);
+    log.close ();
+
+    records = cl_algo::oclslam::readTrajectory (filename);
+    ASSERT_EQ (records.size (), 1u);
+    ASSERT_NEAR ((records[0].t - rec.t).norm (), 0.f, 1e-2f);
+    ASSERT_NEAR (records[0].q.angularDistance (rec.q), 0.f, 1e-5f);
+    ASSERT_EQ (records[0].timeStep, 3u);
+    ASSERT_EQ (records[0].icpIterations, 9u);
+    ASSERT_NEAR (records[0].icpLatency, 15.f, 1e-3f);
+
+    std::remove (filename.c_str ());
+    ASSERT_TRUE (cl_algo::oclslam::readTrajectory (filename).empty ());
+}
+
+
+/*! \brief Tests `associate`.
+ *  \details The estimated records are off the ground truth by a few ms, 
+ *           two of them compete for the same ground truth record, and one 
+ *           has no ground truth near it. Every record has to take part in 
+ *           one pair at most, with the closest one winning.
+ */
+TEST (OCLSLAM, trajectoryAssociate)
+{
+    using cl_algo::oclslam::TrajectoryRecord;
+
+    auto records = [] (const std::vector<double> &timestamps) {
+        std::vector<TrajectoryRecord> recs (timestamps.size ());
+        for (size_t i = 0; i < timestamps.size (); ++i) recs[i].timestamp = timestamps[i];
+        return recs;
+    };
+    std::vector<TrajectoryRecord> gt = records ({ 0.0, 0.1, 0.2, 0.3 });
+    std::vector<TrajectoryRecord> est = records ({ 0.005, 0.105, 0.195, 0.21, 0.5 });
+
+    std::vector<std::pair<unsigned int, unsigned int>> matches = cl_algo::oclslam::associate (est, gt, 0.02);
+    ASSERT_EQ (matches.size (), 3u);
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+        ASSERT_EQ (matches[k].first, k);
+        ASSERT_EQ (matches[k].second, k);
+    }
+
+    ASSERT_TRUE (cl_algo::oclslam::associate (est, gt, 0.001).empty ());
+    ASSERT_TRUE (cl_algo::oclslam::associate (est, std::vector<TrajectoryRecord> ()).empty ());
+}
+
+
+/*! \brief Tests `computeATE` and `computeRPE`.
+ *  \details A trajectory that's off the ground truth by a rigid transformation 
+ *           has no ATE, and one that's off by a known amount, perpendicular 
+ *           to the path, has exactly that ATE. A trajectory with a constant 
+ *           drift per step has that drift as its RPE over a step.
+ */
+TEST (OCLSLAM, trajectoryErrors)
+{
+    using cl_algo::oclslam::Pose;
+    using cl_algo::oclslam::TrajectoryRecord;
+    using cl_algo::oclslam::ErrorStats;
+
+    const unsigned int N = 8;
+    const double radius = 1000.0;  // in mm
+
+    auto toRecord = [] (double timestamp, const Pose &pose) {
+        TrajectoryRecord rec;
+        rec.timestamp = timestamp;
+        rec.t = pose.t.cast<float> ();
+        rec.q = Eigen::Quaternion<float, Eigen::DontAlign> (Eigen::Quaternionf (pose.R.cast<float> ()));
+        rec.s = 1.f;
+        return rec;
+    };
+
+    // Ground truth poses on a circle, 0.1s apart
+    std::vector<Pose> poses;
+    std::vector<TrajectoryRecord> gt;
+    for (unsigned int k = 0; k < N; ++k)
+    {
+        double a = 2.0 * M_PI * k / N;
+        poses.emplace_back (Eigen::AngleAxisd (a, Eigen::Vector3d::UnitY ()).toRotationMatrix (), 
+                            Eigen::Vector3d (radius * std::cos (a), 0.0, radius * std::sin (a)), 1.0);
+        gt.push_back (toRecord (0.1 * k, poses.back ()));
+    }
+    std::vector<std::pair<unsigned int, unsigned int>> matches;
+    for (unsigned int k = 0; k < N; ++k) matches.emplace_back (k, k);
+
+    // A rigid offset gets aligned away
+    Pose offset (Eigen::AngleAxisd (0.5, Eigen::Vector3d::UnitZ ()).toRotationMatrix (), 
+                 Eigen::Vector3d (300.0, -100.0, 50.0), 1.0);
+    std::vector<TrajectoryRecord> est;
+    for (unsigned int k = 0; k < N; ++k) est.push_back (toRecord (gt[k].timestamp, offset * poses[k]));
+    Eigen::Matrix4d alignment;
+    ErrorStats ate = cl_algo::oclslam::computeATE (est, gt, matches, false, &alignment);
+    ASSERT_EQ (ate.count, N);
+    ASSERT_LT (ate.rmse, 1e-2);
+    Eigen::Vector3d p = alignment.topLeftCorner<3, 3> () * offset.t + alignment.topRightCorner<3, 1> ();
+    ASSERT_LT (p.norm (), 1e-2);  // The alignment undoes the offset
+
+    // Points off the plane of the circle, alternately above and below it
+    const double d = 10.0;  // in mm
+    for (unsigned int k = 0; k < N; ++k)
+        est[k] = toRecord (gt[k].timestamp, Pose (poses[k].R, poses[k].t + Eigen::Vector3d (0.0, (k % 2) ? d : -d, 0.0), 1.0));
+    ate = cl_algo::oclslam::computeATE (est, gt, matches);
+    ASSERT_NEAR (ate.rmse, d, 1e-2);
+    ASSERT_NEAR (ate.mean, d, 1e-2);
+    ASSERT_NEAR (ate.max, d, 1e-2);
+    ASSERT_LT (ate.stddev, 1e-2);
+    ASSERT_EQ (cl_algo::oclslam::computeATE (est, gt, { { 0, 0 }, { 1, 1 } }).count, 0u);  // Too few pairs
+
+    // Odometry with a constant drift per step
+    Pose drift (Eigen::AngleAxisd (0.02, Eigen::Vector3d::UnitY ()).toRotationMatrix (), 
+                Eigen::Vector3d (10.0, 5.0, 0.0), 1.0);
+    Pose pose = poses[0];
+    est[0] = toRecord (gt[0].timestamp, pose);
+    for (unsigned int k = 1; k < N; ++k)
+    {
+        pose = pose * (poses[k - 1].inverse () * poses[k] * drift);
+        est[k] = toRecord (gt[k].timestamp, pose);
+    }
+
+    ErrorStats trans, rot;
+    cl_algo::oclslam::computeRPE (est, gt, matches, 0.05, trans, rot);
+    ASSERT_EQ (trans.count, N - 1);
+    ASSERT_NEAR (trans.mean, drift.t.norm (), 0.1);
+    ASSERT_LT (trans.max - trans.min, 0.1);
+    ASSERT_NEAR (rot.mean, 180.0 / M_PI * 0.02, 1e-2);
+
+    // Over the whole circle, a single pair is left
+    cl_algo::oclslam::computeRPE (est, gt, matches, 0.1 * (N - 1) - 0.05, trans, rot);
+    ASSERT_EQ (trans.count, 1u);
+    ASSERT_GT (trans.mean, drift.t.norm ());
+}
+
+
+/*! \brief Tests the `MapServer`.
+ *  \details The queries see the map as of the latest snapshot, and not the 
+ *           live one. The snapshots, whether recycled or copied, have to 
+ *           match the map as of the last recording. Readers that query while 
+ *           the map is being updated and published have to see the epochs in order.
+ */
+TEST (OCLSLAM, mapServer)
+{
+    typedef cl_algo::oclslam::MapServer MapServer;
+
+    octomap::OcTree map (0.1);
+    map.updateNode (octomap::point3d (1.05f, 0.05f, 0.05f), true);
+    for (int k = 0; k < 10; ++k)
+        map.updateNode (octomap::point3d (0.05f + 0.1f * k, 0.05f, 0.05f), false);
+    map.updateNode (octomap::point3d (1.05f, 0.05f, 0.05f), true);
+
+    MapServer server (3600.0);
+    std::vector<MapServer::Occupancy> states;
+    ASSERT_EQ (server.queryOccupancy ({ octomap::point3d () }, states), 0u);
+    ASSERT_EQ (states[0], MapServer::Occupancy::UNKNOWN);
+
+    ASSERT_FALSE (server.publish ());  // Nothing is recorded yet
+    server.record (map);
+    ASSERT_TRUE (server.publish ());
+    std::vector<octomap::point3d> points { octomap::point3d (1.05f, 0.05f, 0.05f), 
+        octomap::point3d (0.55f, 0.05f, 0.05f), octomap::point3d (5.f, 5.f, 5.f) };
+    ASSERT_EQ (server.queryOccupancy (points, states), 1u);
+    ASSERT_EQ (states[0], MapServer::Occupancy::OCCUPIED);
+    ASSERT_EQ (states[1], MapServer::Occupancy::FREE);
+    ASSERT_EQ (states[2], MapServer::Occupancy::UNKNOWN);
+
+    // The snapshot doesn't change with the map, until the next publication
+    map.updateNode (octomap::point3d (5.f, 5.f, 5.f), true);
+    server.record (map);
+    map.resetChangeDetection ();
+    ASSERT_FALSE (server.publish ());
+    server.queryOccupancy (points, states);
+    ASSERT_EQ (states[2], MapServer::Occupancy::UNKNOWN);
+    ASSERT_TRUE (server.publish (true));
+    ASSERT_EQ (server.queryOccupancy (points, states), 2u);
+    ASSERT_EQ (states[2], MapServer::Occupancy::OCCUPIED);
+
+    std::vector<MapServer::RayHit> hits;
+    server.castRays ({ octomap::point3d (0.05f, 0.05f, 0.05f) }, { octomap::point3d (1.f, 0.f, 0.f) }, hits, 5.0);
+    ASSERT_TRUE (hits[0].hit);
+    ASSERT_NEAR (hits[0].end.x (), 1.05f, 1e-4f);
+
+    std::vector<MapServer::Leaf> leaves;
+    server.queryBox (octomap::point3d (0.f, 0.f, 0.f), octomap::point3d (2.f, 0.1f, 0.1f), leaves);
+    ASSERT_EQ (leaves.size (), 1u);
+    server.queryBox (octomap::point3d (0.f, 0.f, 0.f), octomap::point3d (2.f, 0.1f, 0.1f), leaves, false);
+    ASSERT_EQ (leaves.size (), 11u);
+
+    // The previous snapshot is recycled once released, and copied while held, 
+    // and either way it has to take the changes recorded since, deletions included
+    MapServer::Snapshot held = server.getSnapshot ();
+    map.updateNode (octomap::point3d (0.55f, 0.05f, 0.05f), true);
+    map.updateNode (octomap::point3d (0.55f, 0.05f, 0.05f), true);
+    map.updateNode (octomap::point3d (0.55f, 0.05f, 0.05f), true);
+    server.record (map);
+    map.resetChangeDetection ();
+    ASSERT_TRUE (server.publish (true));
+    octomap::OcTreeKey key = map.coordToKey (octomap::point3d (5.f, 5.f, 5.f));
+    map.deleteNode (key);
+    server.erase ({ { key, 0u } });
+    ASSERT_TRUE (server.publish (true));
+    held.map.reset ();
+    ASSERT_EQ (server.queryOccupancy (points, states), 4u);
+    ASSERT_EQ (states[1], MapServer::Occupancy::OCCUPIED);
+    ASSERT_EQ (states[2], MapServer::Occupancy::UNKNOWN);
+    MapServer::Snapshot snap = server.getSnapshot ();
+    for (auto it = map.begin_leafs (), end = map.end_leafs (); it != end; ++it)
+    {
+        const octomap::OcTreeNode *node = snap.map->search (it.getKey ());
+        ASSERT_NE (node, nullptr);
+        ASSERT_FLOAT_EQ (node->getLogOdds (), it->getLogOdds ());
+    }
+
+    // Readers run alongside the integration
+    server.setPeriod (0.0);
+    std::atomic<bool> done (false);
+    std::atomic<bool> ordered (true);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+    {
+        readers.emplace_back ([&] {
+            uint64_t last = 0;
+            std::vector<MapServer::Occupancy> s;
+            while (!done)
+            {
+                uint64_t epoch = server.queryOccupancy (points, s);
+                if (epoch < last || s[0] != MapServer::Occupancy::OCCUPIED) ordered = false;
+                last = epoch;
+            }
+        });
+    }
+    for (int k = 0; k < 200; ++k)
+    {
+        map.updateNode (octomap::point3d (-1.f - 0.1f * k, 0.f, 0.f), true);
+        server.record (map);
+        map.resetChangeDetection ();
+        server.publish ();
+    }
+    done = true;
+    for (std::thread &t : readers) t.join ();
+
+    ASSERT_TRUE (ordered);
+    ASSERT_EQ (server.getEpoch (), 204u);
+}
+
+
+/*! \brief Tests the `SlidingWindow`.
+ *  \details Along a straight path, the map has to stay within the window, 
+ *           and the archive has to hold everything that was evicted, so the 
+ *           map can be put back together from it.
+ */
+TEST (OCLSLAM, slidingWindow)
+{
+    char fileTemplate[] = "/tmp/oclslam_archive_XXXXXX";
+    int fd = mkstemp (fileTemplate);
+    ASSERT_NE (fd, -1);
+    close (fd);
+    std::string archive (fileTemplate);
+
+    const double radius = 3.0;
+    octomap::OcTree map (0.1), full (0.1);
+    cl_algo::oclslam::SlidingWindow window (radius, 0.5, archive);
+
+    // A wall along the path, 1m to the side
+    size_t evicted = 0;
+    for (int k = 0; k < 200; ++k)
+    {
+        octomap::point3d center (0.1f * k, 0.f, 0.f);
+        for (int j = -5; j <= 5; ++j)
+        {
+            octomap::point3d p (0.1f * k + 0.05f, 1.05f, 0.1f * j + 0.05f);
+            map.updateNode (p, true);
+            full.updateNode (p, true);
+        }
+        evicted += window.update (map, center);
+
+        // Nothing further than a step, and a swept node (0.4m), past the radius
+        for (auto it = map.begin_leafs (), end = map.end_leafs (); it != end; ++it)
+            ASSERT_LT ((it.getCoordinate () - center).norm (), radius + 0.5 + 0.4 * std::sqrt (3.0));
+    }
+
+    cl_algo::oclslam::SlidingWindow::Stats stats = window.getStats ();
+    ASSERT_GT (evicted, 0u);
+    ASSERT_EQ (stats.evicted, evicted);
+    ASSERT_EQ (stats.nodes, map.size ());
+    ASSERT_LT (map.getNumLeafNodes (), full.getNumLeafNodes ());
+    ASSERT_GT (stats.archiveBytes, 11 * evicted);
+
+    // The archive and the live map make up the whole map
+    octomap::OcTree restored (0.1);
+    ASSERT_EQ (cl_algo::oclslam::SlidingWindow::readArchive (archive, restored), evicted);
+    for (auto it = map.begin_leafs (), end = map.end_leafs (); it != end; ++it)
+        restored.setNodeValue (it.getKey (), it->getLogOdds ());
+    for (auto it = full.begin_leafs (), end = full.end_leafs (); it != end; ++it)
+    {
+        octomap::OcTreeNode *node = restored.search (it.getCoordinate ());
+        ASSERT_NE (node, nullptr);
+        ASSERT_FLOAT_EQ (node->getLogOdds (), it->getLogOdds ());
+    }
+
+    std::remove (archive.c_str ());
+}
+
+
+/*! \brief Tests the `TiledMap`.
+ *  \details The tiles that don't fit in memory have to be written to disk, 
+ *           and a map opened on the same directory has to read back the same 
+ *           log-odds. A revisit has to integrate like on a map in memory.
+ */
+TEST (OCLSLAM, tiledMap)
+{
+    char dirTemplate[] = "/tmp/oclslam_tiles_XXXXXX";
+    ASSERT_NE (mkdtemp (dirTemplate), nullptr);
+    std::string dir (dirTemplate);
+
+    // A wall 3m in front of the sensor, across 2m tiles
+    octomap::Pointcloud pc;
+    for (int i = -10; i < 10; ++i)
+        for (int j = -10; j < 10; ++j)
+            pc.push_back (3.05f, 0.1f * i + 0.05f, 0.1f * j + 0.05f);
+    octomap::point3d origin (0.05f, 0.05f, 0.05f);
+
+    octomap::OcTree reference (0.1);
+    reference.insertPointCloud (pc, origin);
+    {
+        cl_algo::oclslam::TiledMap tiles (0.1, 2.0, 1);
+        ASSERT_FALSE (tiles.isOpen ());
+        ASSERT_TRUE (tiles.open (dir));
+        tiles.insertPointCloud (pc, origin);
+
+        // The tiles touched by the cloud stay in memory, until the next update,
+        // which keeps only the one around the position
+        cl_algo::oclslam::TiledMap::Stats stats = tiles.getStats ();
+        ASSERT_GT (stats.resident, 1u);
+        ASSERT_EQ (stats.evictions, 0u);
+
+        tiles.update (octomap::point3d (1.f, 1.f, 1.f), 0.5);
+        stats = tiles.getStats ();
+        ASSERT_EQ (stats.resident, 1u);
+        ASSERT_GT (stats.evictions, 0u);
+        ASSERT_EQ (stats.stored, stats.evictions);
+
+        // A stored tile is read back on demand
+        ASSERT_NE (tiles.getTile (tiles.getTileIndex (pc[0])), nullptr);
+        ASSERT_EQ (tiles.getStats ().loads, 1u);
+    }
+
+    cl_algo::oclslam::TiledMap tiles (0.1, 2.0, 1);
+    ASSERT_TRUE (tiles.open (dir));
+    ASSERT_GT (tiles.getStats ().stored, 1u);
+    size_t leafs = 0;
+    for (auto it = reference.begin_leafs (), end = reference.end_leafs (); it != end; ++it)
+    {
+        std::shared_ptr<octomap::OcTree> tile = tiles.getTile (tiles.getTileIndex (it.getCoordinate ()));
+        ASSERT_NE (tile, nullptr);
+        octomap::OcTreeNode *node = tile->search (it.getCoordinate ());
+        ASSERT_NE (node, nullptr);
+        ASSERT_EQ (node->getLogOdds (), it->getLogOdds ());
+        ++leafs;
+    }
+    ASSERT_GT (leafs, 0u);
+
+    // A revisit integrates on top of the stored log-odds
+    reference.insertPointCloud (pc, origin);
+    tiles.insertPointCloud (pc, origin);
+    tiles.update (octomap::point3d (1.f, 1.f, 1.f), 0.5);
+    for (auto it = reference.begin_leafs (), end = reference.end_leafs (); it != end; ++it)
+    {
+        std::shared_ptr<octomap::OcTree> tile = tiles.getTile (tiles.getTileIndex (it.getCoordinate ()));
+        octomap::OcTreeNode *node = tile->search (it.getCoordinate ());
+        ASSERT_NE (node, nullptr);
+        ASSERT_EQ (node->getLogOdds (), it->getLogOdds ());
+    }
+
+    DIR *d = opendir (dir.c_str ());
+    ASSERT_NE (d, nullptr);
+    while (struct dirent *entry = readdir (d))
+        if (entry->d_name[0] != '.') std::remove ((dir + "/" + entry->d_name).c_str ());
+    closedir (d);
+    rmdir (dir.c_str ());
+}
+
+
+/*! \brief Tests the `MapMaintenance`.
+ *  \details A map that is integrated lazily, and then maintained, has to end up 
+ *           the same as one that is integrated eagerly. The worker has to get 
+ *           through the touched subtrees on its own.
+ */
+TEST (OCLSLAM, mapMaintenance)
+{
+    // Sweeps of a wall 3m in front of the sensor
+    std::vector<octomap::Pointcloud> clouds (5);
+    std::vector<octomap::point3d> origins;
+    for (int k = 0; k < 5; ++k)
+    {
+        for (int i = -15; i < 15; ++i)
+            for (int j = -10; j < 10; ++j)
+                clouds[k].push_back (3.05f, 0.1f * i + 0.2f * k + 0.05f, 0.1f * j + 0.05f);
+        origins.push_back (octomap::point3d (0.05f, 0.2f * k + 0.05f, 0.05f));
+    }
+
+    octomap::OcTree eager (0.1), lazy (0.1);
+    cl_algo::oclslam::MapMaintenance maintenance (12);
+    for (size_t k = 0; k < clouds.size (); ++k)
+    {
+        eager.insertPointCloud (clouds[k], origins[k], -1, false, true);
+        lazy.insertPointCloud (clouds[k], origins[k], -1, true, true);
+        maintenance.touch (lazy, clouds[k], origins[k]);
+    }
+    ASSERT_GT (maintenance.getPending (), 0u);
+    ASSERT_GT (lazy.size (), eager.size ());
+
+    ASSERT_GT (maintenance.run (lazy), 0u);
+    ASSERT_EQ (maintenance.getPending (), 0u);
+    ASSERT_EQ (lazy.size (), eager.size ());
+    ASSERT_FLOAT_EQ (lazy.getRoot ()->getLogOdds (), eager.getRoot ()->getLogOdds ());
+    for (auto it = eager.begin_leafs (), end = eager.end_leafs (); it != end; ++it)
+    {
+        octomap::OcTreeNode *node = lazy.search (it.getKey ());
+        ASSERT_NE (node, nullptr);
+        ASSERT_FLOAT_EQ (node->getLogOdds (), it->getLogOdds ());
+    }
+
+    cl_algo::oclslam::MapMaintenance::Stats stats = maintenance.getStats ();
+    ASSERT_EQ (stats.passes, 1u);
+    ASSERT_GT (stats.pruned, 0u);
+    ASSERT_EQ (stats.nodes, lazy.size ());
+    ASSERT_GT (stats.memory, 0u);
+
+    // The worker, a few subtrees at a time
+    octomap::OcTree map (0.1);
+    std::mutex mapMtx;
+    cl_algo::oclslam::MapMaintenance worker (12, 1);
+    worker.start (map, mapMtx, 0.001);
+    for (size_t k = 0; k < clouds.size (); ++k)
+    {
+        std::lock_guard<std::mutex> lock (mapMtx);
+        map.insertPointCloud (clouds[k], origins[k], -1, true, true);
+        worker.touch (map, clouds[k], origins[k]);
+    }
+    for (int i = 0; i < 5000 && worker.getPending () > 0; ++i)
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    worker.stop ();
+    ASSERT_EQ (worker.getPending (), 0u);
+    ASSERT_GT (worker.getStats ().passes, 1u);
+    ASSERT_EQ (map.size (), eager.size ());
+}
+
+
+/*! \brief Tests the `DistanceField`.
+ *  \details The distances have to follow the obstacles, as they 
+ *           get added to and removed from the map.
+ */
+TEST (OCLSLAM, distanceField)
+{
+    octomap::OcTree map (0.1);
+    cl_algo::oclslam::DistanceField field (2.f);
+    ASSERT_FALSE (field.isEnabled ());
+    ASSERT_EQ (field.getDistance (octomap::point3d ()), cl_algo::oclslam::DistanceField::unknown);
+
+    octomap::point3d wall (0.05f, 0.05f, 0.05f), p (1.05f, 0.05f, 0.05f);
+    map.updateNode (wall, true);
+    field.setBounds (octomap::point3d (-3.f, -3.f, -3.f), octomap::point3d (3.f, 3.f, 3.f));
+    ASSERT_TRUE (field.isEnabled ());
+    field.update (map);
+    ASSERT_NEAR (field.getDistance (p), 1.f, 1e-4f);
+    ASSERT_NEAR (field.getDistance (octomap::point3d (-2.95f, 0.05f, 0.05f)), 2.f, 1e-4f);
+    ASSERT_EQ (field.getDistance (octomap::point3d (5.f, 0.f, 0.f)), cl_algo::oclslam::DistanceField::unknown);
+
+    // The distance grows away from the obstacle
+    octomap::point3d gradient;
+    ASSERT_TRUE (field.getGradient (p, gradient));
+    ASSERT_NEAR (gradient.x (), 1.f, 1e-4f);
+    ASSERT_NEAR (gradient.y (), 0.f, 1e-4f);
+    ASSERT_NEAR (gradient.z (), 0.f, 1e-4f);
+
+    // A new obstacle closer to the point
+    octomap::point3d obstacle, near (0.55f, 0.05f, 0.05f);
+    map.updateNode (near, true);
+    field.update (map);
+    ASSERT_NEAR (field.getDistance (p, obstacle), 0.5f, 1e-4f);
+    ASSERT_NEAR ((obstacle - near).norm (), 0.f, 1e-4f);
+    ASSERT_EQ (field.getStats ().changes, 1u);
+
+    // It goes away again
+    while (map.isNodeOccupied (map.search (near))) map.updateNode (near, false);
+    field.update (map);
+    std::vector<octomap::point3d> points (1, p);
+    std::vector<float> distances;
+    field.getDistances (points, distances);
+    ASSERT_NEAR (distances[0], 1.f, 1e-4f);
+    ASSERT_EQ (field.getStats ().updates, 3u);
+}
+
+
+/*! \brief Tests the `BatchedUpdate`.
+ *  \details A map that is updated in batches has to match 
+ *           one that is updated with every point cloud.
+ */
+TEST (OCLSLAM, batchedUpdate)
+{
+    // Sweeps of a wall 3m in front of the sensor, from a moving origin
+    const size_t frames = 5;
+    std::vector<octomap::Pointcloud> clouds (2 * frames);
+    std::vector<octomap::point3d> origins;
+    for (size_t k = 0; k < clouds.size (); ++k)
+    {
+        for (int i = -15; i < 15; ++i)
+            for (int j = -10; j < 10; ++j)
+                clouds[k].push_back (3.05f, 0.1f * i + 0.1f * k + 0.05f, 0.1f * j + 0.05f);
+        origins.push_back (octomap::point3d (0.05f, 0.1f * k + 0.05f, 0.05f));
+    }
+
+    octomap::OcTree single (0.1), batched (0.1);
+    cl_algo::oclslam::BatchedUpdate batch (frames);
+    size_t applied = 0;
+    for (size_t k = 0; k < clouds.size (); ++k)
+    {
+        single.insertPointCloud (clouds[k], origins[k], -1, false, true);
+        batch.add (batched, clouds[k], origins[k]);
+        ASSERT_EQ (batch.isReady (), (k + 1) % frames == 0);
+        if (batch.isReady ())
+        {
+            octomap::point3d lo, hi;
+            ASSERT_TRUE (batch.getBounds (batched, lo, hi));
+            ASSERT_LE (lo.x (), origins[k].x ());
+            ASSERT_GE (hi.x (), 3.f);
+            applied += batch.apply (batched);
+        }
+    }
+
+    // Only cells that hit a clamping threshold, and turned back, may differ
+    size_t leaves = 0, mismatches = 0;
+    for (auto it = single.begin_leafs (), end = single.end_leafs (); it != end; ++it, ++leaves)
+    {
+        octomap::OcTreeNode *node = batched.search (it.getCoordinate ());
+        ASSERT_NE (node, nullptr);
+        if (std::abs (node->getLogOdds () - it->getLogOdds ()) > 1e-4f) ++mismatches;
+    }
+    ASSERT_GT (leaves, 0u);
+    ASSERT_LT (100 * mismatches, leaves);
+
+    // Fewer updates reach the tree
+    cl_algo::oclslam::BatchedUpdate::Stats stats = batch.getStats ();
+    ASSERT_EQ (stats.frames, clouds.size ());
+    ASSERT_EQ (stats.batches, 2u);
+    ASSERT_EQ (stats.treeUpdates, applied);
+    ASSERT_LT (2 * stats.treeUpdates, stats.cellUpdates);
+
+    // The batches are capped, so the 16-bit counts can't wrap around
+    cl_algo::oclslam::BatchedUpdate capped (1 << 20);
+    ASSERT_EQ (capped.getFrames (), 65535u);
+    capped.setFrames (70000);
+    ASSERT_EQ (capped.getFrames (), 65535u);
+}
+
+
+/*! \brief Tests the `OccupancyGrid2D`.
+ *  \details The columns have to reflect the cells of the map within the band, 
+ *           and only the tiles that change have to be reported.
+ */
+TEST (OCLSLAM, occupancyGrid2D)
+{
+    typedef cl_algo::oclslam::OccupancyGrid2D Grid;
+
+    octomap::OcTree map (0.1);
+    for (int x = -1; x < 20; ++x)
+        for (int y = -1; y < 10; ++y)
+            map.updateNode (octomap::point3d (0.1f * x + 0.05f, 0.1f * y + 0.05f, 0.55f), false);
+    octomap::point3d obstacle (1.05f, 0.55f, 0.85f);
+    map.updateNode (obstacle, true);
+    map.updateNode (octomap::point3d (0.25f, 0.25f, 2.05f), true);  // Above the band
+
+    Grid grid (8);
+    grid.touch (octomap::point3d (-0.1f, -0.1f, 0.f), octomap::point3d (2.f, 1.f, 3.f));
+    ASSERT_EQ (grid.update (map), 0u);
+    grid.setBand (0.1, 1.0);
+    ASSERT_TRUE (grid.isEnabled ());
+    grid.touch (octomap::point3d (-0.1f, -0.1f, 0.f), octomap::point3d (2.f, 1.f, 3.f));
+    ASSERT_GE (grid.update (map), 21u * 11u);
+
+    ASSERT_EQ (grid.getCell (obstacle), Grid::OCCUPIED);
+    ASSERT_EQ (grid.getCell (octomap::point3d (0.25f, 0.25f, 0.f)), Grid::FREE);
+    ASSERT_EQ (grid.getCell (octomap::point3d (-0.05f, -0.05f, 0.f)), Grid::FREE);
+    ASSERT_EQ (grid.getCell (octomap::point3d (5.f, 5.f, 0.f)), Grid::UNKNOWN);
+
+    // Tiles of 8x8 columns, from -1 to 19 by -1 to 9
+    ASSERT_EQ (grid.takeDirtyTiles ().size (), 12u);
+    ASSERT_EQ (grid.takeDirtyTiles ().size (), 0u);
+    ASSERT_EQ (grid.getStats ().tiles, 12u);
+
+    std::vector<int8_t> cells;
+    unsigned int width, height;
+    double originU, originV;
+    ASSERT_TRUE (grid.getGrid (cells, width, height, originU, originV));
+    ASSERT_EQ (width, 32u);
+    ASSERT_EQ (height, 24u);
+    ASSERT_NEAR (originU, -0.8, 1e-9);
+    ASSERT_NEAR (originV, -0.8, 1e-9);
+    ASSERT_EQ (cells[(5 + 8) * width + (10 + 8)], Grid::OCCUPIED);
+    ASSERT_EQ (cells[(2 + 8) * width + (2 + 8)], Grid::FREE);
+    ASSERT_EQ (cells[(10 + 8) * width + (20 + 8)], Grid::UNKNOWN);
+
+    ASSERT_TRUE (grid.getTile (Grid::TileIndex (1, 0), cells, originU, originV));
+    ASSERT_EQ (cells.size (), 64u);
+    ASSERT_EQ (cells[5 * 8 + 2], Grid::OCCUPIED);
+
+    // The obstacle goes away, and only its tile changes
+    while (map.isNodeOccupied (map.search (obstacle))) map.updateNode (obstacle, false);
+    grid.touch (obstacle, obstacle);
+    ASSERT_EQ (grid.update (map), 1u);
+    ASSERT_EQ (grid.getCell (obstacle), Grid::FREE);
+    std::vector<Grid::TileIndex> dirty = grid.takeDirtyTiles ();
+    ASSERT_EQ (dirty.size (), 1u);
+    ASSERT_EQ (dirty[0], Grid::TileIndex (1, 0));
+}
+
+
+/*! \brief Tests the `FrontierSet`.
+ *  \details The frontier of a free box is its surface, and it has 
+ *           to follow the box as it grows, examining only the new cells.
+ */
+TEST (OCLSLAM, frontierSet)
+{
+    octomap::OcTree map (0.1);
+    for (int x = 0; x < 10; ++x)
+        for (int y = 0; y < 5; ++y)
+            for (int z = 0; z < 5; ++z)
+                map.updateNode (octomap::point3d (0.1f * x + 0.05f, 0.1f * y + 0.05f, 0.1f * z + 0.05f), false);
+
+    cl_algo::oclslam::FrontierSet frontiers;
+    ASSERT_EQ (frontiers.update (map), 0u);
+    frontiers.setEnabled (true);
+    frontiers.update (map);
+    ASSERT_EQ (frontiers.getStats ().cells, 10u * 5u * 5u - 8u * 3u * 3u);
+    ASSERT_TRUE (frontiers.isFrontier (octomap::point3d (0.05f, 0.05f, 0.05f)));
+    ASSERT_FALSE (frontiers.isFrontier (octomap::point3d (0.45f, 0.25f, 0.25f)));
+
+    std::vector<cl_algo::oclslam::FrontierSet::Region> regions;
+    frontiers.getRegions (regions);
+    ASSERT_EQ (regions.size (), 1u);
+    ASSERT_EQ (regions[0].size, 10u * 5u * 5u - 8u * 3u * 3u);
+    ASSERT_NEAR (regions[0].centroid.x (), 0.5f, 1e-4f);
+    ASSERT_NEAR (regions[0].min.x (), 0.05f, 1e-4f);
+    ASSERT_NEAR (regions[0].max.x (), 0.95f, 1e-4f);
+
+    // The box grows by a slab, and a separate cell appears
+    map.resetChangeDetection ();
+    for (int y = 0; y < 5; ++y)
+        for (int z = 0; z < 5; ++z)
+            map.updateNode (octomap::point3d (1.05f, 0.1f * y + 0.05f, 0.1f * z + 0.05f), false);
+    octomap::point3d lone (3.05f, 0.05f, 0.05f);
+    map.updateNode (lone, false);
+    uint64_t checked = frontiers.getStats ().checked;
+    ASSERT_LE (frontiers.update (map), 26u * 7u);
+    ASSERT_LE (frontiers.getStats ().checked - checked, 26u * 7u);
+    ASSERT_EQ (frontiers.getStats ().cells, 11u * 5u * 5u - 9u * 3u * 3u + 1u);
+    ASSERT_FALSE (frontiers.isFrontier (octomap::point3d (0.95f, 0.25f, 0.25f)));
+    ASSERT_TRUE (frontiers.isFrontier (lone));
+
+    frontiers.getRegions (regions);
+    ASSERT_EQ (regions.size (), 2u);
+    ASSERT_EQ (regions[1].size, 1u);
+    frontiers.getRegions (regions, 2);
+    ASSERT_EQ (regions.size (), 1u);
+
+    cl_algo::oclslam::FrontierSet::Region nearest;
+    ASSERT_TRUE (frontiers.getNearestRegion (octomap::point3d (3.f, 0.f, 0.f), nearest));
+    ASSERT_EQ (nearest.size, 1u);
+    ASSERT_TRUE (frontiers.getNearestRegion (octomap::point3d (3.f, 0.f, 0.f), nearest, 2));
+    ASSERT_GT (nearest.size, 1u);
+    ASSERT_FALSE (frontiers.getNearestRegion (lone, nearest, 1000));
+}
+
+
+/*! \brief Tests the `LinearOctree`.
+ *  \details The lookups and the ray casts have to agree with the ones 
+ *           on the map, and the octree has to survive a round trip to disk.
+ */
+TEST (OCLSLAM, linearOctree)
+{
+    octomap::OcTreeKey key (1, 40000, 65535);
+    ASSERT_EQ (cl_algo::oclslam::LinearOctree::decode (cl_algo::oclslam::LinearOctree::encode (key)), key);
+    ASSERT_EQ (cl_algo::oclslam::LinearOctree::encode (octomap::OcTreeKey (1, 0, 0)), 1u);
+    ASSERT_EQ (cl_algo::oclslam::LinearOctree::encode (octomap::OcTreeKey (0, 0, 1)), 4u);
+
+    // A room with an opening, scanned from its center
+    octomap::OcTree map (0.1);
+    octomap::Pointcloud pc;
+    for (float u = -1.f; u <= 1.f; u += 0.05f)
+        for (float v = -1.f; v <= 1.f; v += 0.05f)
+        {
+            pc.push_back (2.f, u, v);
+            pc.push_back (u, -2.f, v);
+            pc.push_back (u, 2.f, v);
+            if (u < 0.f) pc.push_back (-2.f, u, v);
+        }
+    map.insertPointCloud (pc, octomap::point3d (0.f, 0.f, 0.f));
+
+    cl_algo::oclslam::LinearOctree tree;
+    tree.build (map);
+    ASSERT_EQ (tree.size (), map.getNumLeafNodes ());
+    ASSERT_GT (tree.getBlockCount (), 0u);
+    ASSERT_TRUE (std::is_sorted (tree.getCodes ().begin (), tree.getCodes ().end ()));
+
+    // Lookups
+    std::vector<octomap::point3d> points;
+    for (int i = 0; i < 10000; ++i)
+        points.emplace_back (5.f * oclslam::rNum_R_0_1 () - 2.5f, 
+                             5.f * oclslam::rNum_R_0_1 () - 2.5f, 
+                             5.f * oclslam::rNum_R_0_1 () - 2.5f);
+    std::vector<float> logOdds;
+    tree.query (points, logOdds);
+    for (size_t i = 0; i < points.size (); ++i)
+    {
+        octomap::OcTreeNode *node = map.search (points[i]);
+        float value;
+        ASSERT_EQ (node != nullptr, tree.search (points[i], value));
+        if (node == nullptr) ASSERT_TRUE (std::isnan (logOdds[i]));
+        else
+        {
+            ASSERT_EQ (node->getLogOdds (), value);
+            ASSERT_EQ (node->getLogOdds (), logOdds[i]);
+        }
+    }
+
+    // Ray casts
+    std::vector<octomap::point3d> origins, directions;
+    for (int i = 0; i < 2000; ++i)
+    {
+        origins.emplace_back (oclslam::rNum_R_0_1 () - 0.5f, oclslam::rNum_R_0_1 () - 0.5f, 0.5f * oclslam::rNum_R_0_1 ());
+        directions.emplace_back (oclslam::rNum_R_0_1 () - 0.5f, oclslam::rNum_R_0_1 () - 0.5f, 0.2f * oclslam::rNum_R_0_1 () - 0.1f);
+    }
+    std::vector<cl_algo::oclslam::LinearOctree::RayHit> hits;
+    tree.castRays (origins, directions, hits);
+    unsigned int agree = 0, hit = 0;
+    for (size_t i = 0; i < origins.size (); ++i)
+    {
+        octomap::point3d end;
+        bool h = map.castRay (origins[i], directions[i], end);
+        if (h == hits[i].hit && (end - hits[i].end).norm () < 1e-3f) agree++;
+        hit += h;
+    }
+    ASSERT_GT (hit, 0u);
+    ASSERT_GE (agree, 0.99 * origins.size ());  // Ties can break differently in float
+
+    // Round trip
+    std::string filename = "oclslam_linear_octree_test.bin";
+    ASSERT_TRUE (tree.write (filename));
+    cl_algo::oclslam::LinearOctree copy;
+    ASSERT_TRUE (copy.read (filename));
+    std::remove (filename.c_str ());
+    ASSERT_EQ (copy.getCodes (), tree.getCodes ());
+    ASSERT_EQ (copy.getLevels (), tree.getLevels ());
+    ASSERT_EQ (copy.getValues (), tree.getValues ());
+    ASSERT_EQ (copy.getBlockCount (), tree.getBlockCount ());
+}
+
+
+/*! \brief Tests the `BrickMap`.
+ *  \details The bricks have to follow the occupied cells of the map, 
+ *           and the changes have to include only the bricks that changed.
+ */
+TEST (OCLSLAM, brickMap)
+{
+    octomap::OcTree map (0.1);
+    for (int x = 0; x < 20; ++x)
+        map.updateNode (octomap::point3d (0.1f * x + 0.05f, 0.05f, 0.05f), true);
+    map.updateNode (octomap::point3d (-0.05f, 0.05f, 0.05f), false);
+
+    cl_algo::oclslam::BrickMap bricks;
+    ASSERT_EQ (bricks.update (map), 0u);
+    bricks.setEnabled (true);
+    ASSERT_EQ (bricks.update (map), 20u);
+    map.resetChangeDetection ();
+    ASSERT_EQ (bricks.getStats ().cells, 20u);
+    ASSERT_EQ (bricks.getStats ().bricks, 3u);  // 20 cells along x span 3 blocks
+    ASSERT_TRUE (bricks.isOccupied (octomap::point3d (0.05f, 0.05f, 0.05f)));
+    ASSERT_FALSE (bricks.isOccupied (octomap::point3d (-0.05f, 0.05f, 0.05f)));
+    ASSERT_FALSE (bricks.isOccupied (octomap::point3d (0.05f, 0.15f, 0.05f)));
+
+    cl_algo::oclslam::BrickMap::Delta delta;
+    bricks.takeDelta (delta);
+    ASSERT_TRUE (delta.table);
+    ASSERT_EQ (delta.indices.size (), 3u);
+    ASSERT_EQ (delta.words.size (), 3u * cl_algo::oclslam::BrickMap::brickWords);
+    size_t used = 0;
+    for (size_t i = 0; i < delta.slotCodes.size (); ++i)
+    {
+        if (delta.slotCodes[i] == cl_algo::oclslam::BrickMap::emptySlot) continue;
+        ++used;
+        ASSERT_LT (delta.slotBricks[i], 3u);
+    }
+    ASSERT_EQ (used, 3u);
+
+    // A cell gets cleared, so only its brick changes
+    for (int i = 0; i < 5; ++i)
+        map.updateNode (octomap::point3d (0.05f, 0.05f, 0.05f), false);
+    ASSERT_EQ (bricks.update (map), 1u);
+    map.resetChangeDetection ();
+    ASSERT_FALSE (bricks.isOccupied (octomap::point3d (0.05f, 0.05f, 0.05f)));
+    bricks.takeDelta (delta);
+    ASSERT_FALSE (delta.table);
+    ASSERT_EQ (delta.indices.size (), 1u);
+    bricks.takeDelta (delta);
+    ASSERT_EQ (delta.indices.size (), 0u);
+
+    // Many new blocks make the table grow
+    for (int x = 0; x < 1000; ++x)
+        map.updateNode (octomap::point3d (0.8f * x + 0.05f, 5.05f, 0.05f), true);
+    ASSERT_EQ (bricks.update (map), 1000u);
+    map.resetChangeDetection ();
+    ASSERT_EQ (bricks.getStats ().bricks, 1003u);
+    bricks.takeDelta (delta);
+    ASSERT_TRUE (delta.table);
+    ASSERT_GE (delta.slotCodes.size (), 2u * 1003u);
+    ASSERT_EQ (delta.indices.size (), 1000u);
+    for (int x = 0; x < 1000; x += 100)
+        ASSERT_TRUE (bricks.isOccupied (octomap::point3d (0.8f * x + 0.05f, 5.05f, 0.05f)));
+
+    bricks.takeDelta (delta, true);
+    ASSERT_EQ (delta.indices.size (), 1003u);
+}
+
+
+/*! \brief Tests the `cpu::ThreadPool`.
+ *  \details Every iteration of a loop has to run exactly once, 
+ *           and an exception has to reach the calling thread.
+ */
+TEST (OCLSLAM, cpuThreadPool)
+{
+    cl_algo::oclslam::cpu::ThreadPool pool (4);
+    ASSERT_EQ (pool.size (), 4u);
+
+    const size_t n = 100003, grain = 1000;
+    std::vector<int> hits (n, 0);
+    std::vector<uint64_t> sums (cl_algo::oclslam::cpu::ThreadPool::getChunks (n, grain), 0);
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        pool.parallelFor (n, grain, [&] (size_t begin, size_t end)
+        {
+            for (size_t k = begin; k < end; ++k)
+            {
+                ++hits[k];
+                sums[begin / grain] += k;
+            }
+        });
+    }
+    for (size_t k = 0; k < n; ++k)
+        ASSERT_EQ (hits[k], 3);
+    ASSERT_EQ (std::accumulate (sums.begin (), sums.end (), (uint64_t) 0), 3 * (uint64_t) n * (n - 1) / 2);
+
+    ASSERT_THROW (pool.parallelFor (n, grain, [] (size_t begin, size_t end)
+    {
+        if (begin <= 50000 && 50000 < end) throw std::runtime_error ("chunk");
+    }), std::runtime_error);
+}
+
+
+/*! \brief Tests the point-wise stages of the `CPU` backend.
+ *  \details The frame width is not a multiple of the vector width, 
+ *           so both the vector loops and their tails are exercised.
+ */
+TEST (OCLSLAM, cpuStages)
+{
+    namespace cpu = cl_algo::oclslam::cpu;
+
+    const unsigned int width = 37, height = 11, n = width * height;
+    const float f = 595.f;
+    cpu::ThreadPool pool (2);
+
+    // Depth and RGB frames
+    std::vector<uint16_t> depth (n);
+    std::vector<uint8_t> rgb (3 * n);
+    for (unsigned int k = 0; k < n; ++k)
+    {
+        depth[k] = (k % 5 == 0) ? 0 : oclslam::rNum_0_10000 ();
+        for (unsigned int j = 0; j < 3; ++j) rgb[3 * k + j] = oclslam::rNum_0_255 ();
+    }
+
+    std::vector<float> D (n), R (n), G (n), B (n), pc (8 * n), pcT (8 * n), pc3D (3 * n), refPC3D (3 * n);
+    std::vector<uint8_t> rgb3D (3 * n), refRGB3D (3 * n);
+
+    cpu::Depth convD (pool);
+    convD.init (n, 1.f);
+    convD.run (depth.data (), D.data ());
+    cpu::SeparateRGB sepRGB (pool);
+    sepRGB.init (n);
+    sepRGB.run (rgb.data (), R.data (), G.data (), B.data ());
+    cpu::RGBDTo8D to8D (pool);
+    to8D.init (width, height, f, 1.f, 1);
+    to8D.run (D.data (), R.data (), G.data (), B.data (), pc.data ());
+
+    // Verify the point cloud
+    for (unsigned int k = 0; k < n; ++k)
+    {
+        float d = depth[k], u = k % width - 0.5f * (width - 1), v = k / width - 0.5f * (height - 1);
+        float sum = (rgb[3 * k] + rgb[3 * k + 1] + rgb[3 * k + 2]) / 255.f;
+        ASSERT_NEAR (pc[8 * k], u * d / f, 1e-3f);
+        ASSERT_NEAR (pc[8 * k + 1], v * d / f, 1e-3f);
+        ASSERT_EQ (pc[8 * k + 2], d);
+        ASSERT_EQ (pc[8 * k + 3], 1.f);
+        for (unsigned int j = 0; j < 3; ++j)
+            ASSERT_NEAR (pc[8 * k + 4 + j], (sum > 0) ? rgb[3 * k + j] / 255.f / sum : 0.f, 1e-5f);
+    }
+
+    // Transformation
+    Eigen::Quaternionf q (Eigen::AngleAxisf (0.3f, Eigen::Vector3f (1.f, -2.f, 3.f).normalized ()));
+    Eigen::Vector3f t (15.f, -20.f, 35.f);
+    float sc = 1.02f;
+    cl_float T[8] = { q.x (), q.y (), q.z (), q.w (), t[0], t[1], t[2], sc };
+
+    cpu::ICPTransform transform (pool);
+    transform.init (n);
+    transform.setTransformation (q, t, sc);
+    transform.run (pc.data (), pcT.data ());
+
+    for (unsigned int k = 0; k < n; ++k)
+    {
+        const float *p = pc.data () + 8 * k, *pT = pcT.data () + 8 * k;
+        cl_float ref[3];
+        oclslam::cpuICPTransformPoint (T, p, ref);
+        for (unsigned int j = 0; j < 3; ++j)
+            ASSERT_NEAR (pT[j], (p[2] == 0.f) ? 0.f : ref[j], 1e-3f * std::max (1.f, std::abs (ref[j])));
+        for (unsigned int j = 3; j < 8; ++j)
+            ASSERT_EQ (pT[j], p[j]);
+    }
+
+    // Splitting
+    cpu::SplitPC8D sp8D (pool);
+    sp8D.init (n);
+    sp8D.run (pcT.data (), pc3D.data (), rgb3D.data ());
+    oclslam::cpuSplitPC8D (pcT.data (), refPC3D.data (), refRGB3D.data (), n);
+
+    for (unsigned int k = 0; k < 3 * n; ++k)
+    {
+        ASSERT_NEAR (pc3D[k], refPC3D[k], 1e-6f * std::max (1.f, std::abs (refPC3D[k])));
+        ASSERT_LE (std::abs ((int) rgb3D[k] - (int) refRGB3D[k]), 1);
+    }
+}
+
+
+/*! \brief Tests the `cpu::RBC`.
+ *  \details The search has to agree with a brute force search, for a single 
+ *           representative, a few, and every point as a representative.
+ */
+TEST (OCLSLAM, cpuRBC)
+{
+    namespace cpu = cl_algo::oclslam::cpu;
+
+    const unsigned int m = 1000, nq = 300;
+    const float a = 2e2f;
+    cpu::ThreadPool pool (2);
+
+    std::vector<float> X (8 * m), Q (8 * nq);
+    for (unsigned int k = 0; k < 8 * m; ++k) X[k] = (k % 8 < 3) ? 1000.f * oclslam::rNum_R_0_1 () : oclslam::rNum_R_0_1 ();
+    for (unsigned int k = 0; k < 8 * nq; ++k) Q[k] = (k % 8 < 3) ? 1000.f * oclslam::rNum_R_0_1 () : oclslam::rNum_R_0_1 ();
+    for (unsigned int k = 0; k < m; k += 11) X[8 * k + 2] = 0.f;  // Invalidate some points
+
+    auto distance = [&] (const float *p, const float *q)
+    {
+        float d = 0.f;
+        for (unsigned int j = 0; j < 3; ++j) d += (p[j] - q[j]) * (p[j] - q[j]);
+        for (unsigned int j = 4; j < 7; ++j) d += a * (p[j] - q[j]) * (p[j] - q[j]);
+        return d;
+    };
+
+    std::vector<unsigned int> idx (nq);
+    std::vector<float> dist (nq);
+    for (unsigned int r : { 1u, 31u, m })
+    {
+        cpu::RBC rbc (pool);
+        rbc.build (X.data (), m, r, a);
+        rbc.query (Q.data (), nq, idx.data (), dist.data ());
+
+        for (unsigned int i = 0; i < nq; ++i)
+        {
+            const float *q = Q.data () + 8 * i;
+            ASSERT_NE (idx[i], cpu::RBC::none);
+            ASSERT_NE (X[8 * idx[i] + 2], 0.f);
+            ASSERT_NEAR (dist[i], distance (X.data () + 8 * idx[i], q), 1e-2f);
+
+            float best = std::numeric_limits<float>::infinity ();
+            for (unsigned int k = 0; k < m; ++k)
+                if (X[8 * k + 2] != 0.f) best = std::min (best, distance (X.data () + 8 * k, q));
+            ASSERT_NEAR (dist[i], best, 1e-2f);
+        }
+    }
+}
+
+
+/*! \brief Tests the `cpu::ICP`.
+ *  \details A surface sampled on the landmark grid is registered against 
+ *           a displaced copy of itself. The result has to agree with the 
+ *           known transformation.
+ */
+TEST (OCLSLAM, cpuICP)
+{
+    namespace cpu = cl_algo::oclslam::cpu;
+
+    const unsigned int side = 128, m = side * side, r = 256;
+    cpu::ThreadPool pool;
+
+    // A surface sampled on a grid, and the same surface displaced
+    Eigen::Matrix3f R = Eigen::AngleAxisf (3.f * M_PI / 180.f, 
+        Eigen::Vector3f (1.f, 2.f, 3.f).normalized ()).toRotationMatrix ();
+    Eigen::Vector3f t (20.f, -15.f, 30.f);
+    std::vector<float> F (8 * m), M (8 * m);
+    for (unsigned int k = 0; k < m; ++k)
+    {
+        float x = 15.f * ((int) (k % side) - (int) side / 2);
+        float y = 15.f * ((int) (k / side) - (int) side / 2);
+        float z = 2000.f + 200.f * std::sin (x / 120.f) * std::cos (y / 150.f) + 0.1f * x;
+        Eigen::Vector3f pF (x, y, z), pM = R.transpose () * (pF - t);
+        Eigen::Vector3f c (0.5f + 0.5f * std::sin (x / 200.f), 0.5f + 0.5f * std::cos (y / 200.f), 
+                           0.5f + 0.5f * std::sin ((x + y) / 300.f));
+
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            F[8 * k + j] = pF[j];
+            M[8 * k + j] = pM[j];
+            F[8 * k + 4 + j] = M[8 * k + 4 + j] = c[j];
+        }
+        F[8 * k + 3] = M[8 * k + 3] = F[8 * k + 7] = M[8 * k + 7] = 1.f;
+    }
+    for (unsigned int k = 0; k < m; k += 17)  // Invalidate some landmarks
+        M[8 * k + 2] = 0.f;
+
+    cpu::ICP icp (pool);
+    icp.init (m, r, 2e2f, 40, 0.001, 0.01);
+    icp.buildRBC (F.data ());
+    unsigned int k = icp.run (M.data ());
+
+    // Verify the transformation against the ground truth
+    ASSERT_LT (k, 40u);
+    ASSERT_LT (180.f / M_PI * Eigen::AngleAxisf (icp.R * R.transpose ()).angle (), 0.05f);
+    ASSERT_LT ((icp.t - t).norm (), 2.f);
+    ASSERT_NEAR (icp.s, 1.f, 1e-3f);
+
+    // Profiling ===============================================================
+    if (profiling)
+    {
+        const int nRepeat = 1;  /* Number of times to perform the tests. */
+
+        // Serial
+        cpu::ThreadPool serial (1);
+        cpu::ICP icpSerial (serial);
+        icpSerial.init (m, r, 2e2f, 40, 0.001, 0.01);
+        clutils::CPUTimer<double, std::milli> cTimer;
+        clutils::ProfilingInfo<nRepeat> pSerial ("CPU (1 thread)");
+        for (int i = 0; i < nRepeat; ++i)
+        {
+            cTimer.start ();
+            icpSerial.buildRBC (F.data ());
+            icpSerial.run (M.data ());
+            pSerial[i] = cTimer.stop ();
+        }
+
+        // Threaded
+        clutils::ProfilingInfo<nRepeat> pThreaded ("CPU (" + std::to_string (pool.size ()) + " threads, " + 
+                                                   cpu::getInstructionSet () + ")");
+        for (int i = 0; i < nRepeat; ++i)
+        {
+            cTimer.start ();
+            icp.buildRBC (F.data ());
+            icp.run (M.data ());
+            pThreaded[i] = cTimer.stop ();
+        }
+
+        // Benchmark
+        pThreaded.print (pSerial, "cpu::ICP");
+    }
+}
+
+
+
+/*! \brief Tests the naming and the selection of the `ICP` configurations.
+ *  \details Every configuration has to get its name back, and invalid 
+ *           names have to be rejected, without touching the configuration. 
+ *           The selected configuration, as well as the native `CPU` 
+ *           baseline, has to meet the accuracy threshold.
+ */
+TEST (OCLSLAM, icpConfig)
+{
+    typedef ICP::ICPStepConfigT ICPStepConfigT;
+    typedef ICP::ICPStepConfigW ICPStepConfigW;
+
+    std::vector<std::string> names;
+    for (ICPStepConfigT cr : { ICPStepConfigT::EIGEN, ICPStepConfigT::POWER_METHOD })
+    {
+        for (ICPStepConfigW cw : { ICPStepConfigW::REGULAR, ICPStepConfigW::WEIGHTED })
+        {
+            std::string name = getICPConfigName (cr, cw);
+            ICPStepConfigT CR = (cr == ICPStepConfigT::EIGEN) ? ICPStepConfigT::POWER_METHOD : ICPStepConfigT::EIGEN;
+            ICPStepConfigW CW = (cw == ICPStepConfigW::REGULAR) ? ICPStepConfigW::WEIGHTED : ICPStepConfigW::REGULAR;
+            ASSERT_TRUE (parseICPConfigName (name, CR, CW));
+            ASSERT_EQ (CR, cr);
+            ASSERT_EQ (CW, cw);
+            names.push_back (name);
+        }
+    }
+    std::sort (names.begin (), names.end ());
+    ASSERT_TRUE (std::unique (names.begin (), names.end ()) == names.end ());
+    ASSERT_EQ (getICPConfigName (ICPStepConfigT::POWER_METHOD, ICPStepConfigW::WEIGHTED), "power-weighted");
+
+    for (const std::string &name : { "", "auto", "eigen", "power-", "-weighted", "Eigen-regular", 
+                                     "power-weighted ", "power_weighted", "eigen-regular-weighted" })
+    {
+        ICPStepConfigT CR = ICPStepConfigT::EIGEN;
+        ICPStepConfigW CW = ICPStepConfigW::WEIGHTED;
+        ASSERT_FALSE (parseICPConfigName (name, CR, CW));
+        ASSERT_EQ (CR, ICPStepConfigT::EIGEN);
+        ASSERT_EQ (CW, ICPStepConfigW::WEIGHTED);
+    }
+
+    const double maxRotError = 0.1, maxTransError = 1.0;  // The defaults of the selection
+
+    // The baseline
+    ICPBenchmarkResult cpu = benchmarkCPUICP (1);
+    ASSERT_LE (cpu.rotError, maxRotError);
+    ASSERT_LE (cpu.transError, maxTransError);
+
+    try
+    {
+        ICPStepConfigT CR = ICPStepConfigT::EIGEN;
+        ICPStepConfigW CW = ICPStepConfigW::REGULAR;
+        ASSERT_TRUE (selectICPConfig (CR, CW, maxRotError, maxTransError, 1));
+
+        bool accurate = false;
+        for (const ICPBenchmarkResult &res : benchmarkICP (1))
+            if (res.CR == CR && res.CW == CW)
+                accurate = res.rotError <= maxRotError && res.transError <= maxTransError;
+        ASSERT_TRUE (accurate);
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << error.what ()
+                  << " (" << clutils::getOpenCLErrorCodeString (error.err ()) 
+                  << ")"  << std::endl;
+        exit (EXIT_FAILURE);
+    }
+}
+
 int main (int argc, char **argv)
 {
     profiling = oclslam::setProfilingFlag (argc, argv);